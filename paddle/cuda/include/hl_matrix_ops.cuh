@@ -250,4 +250,90 @@ limitations under the License. */
   };\
   }
 
+/**
+ * @brief   fused operators, which apply a chain of operators to the
+ *          elements in one pass.
+ *
+ * Chain<Op1, Op2> applies Op1 and then Op2 to the same operands.
+ * First<Op> applies an unary operator to the first operand only.
+ * e.g. a = 1 / sqrt(b + c + p) in one pass:
+ *
+ * @code
+ *   applyTernary(fused::chain(ternary::Add1<T>(1, 1),
+ *                             fused::first(unary::Add<T>(p)),
+ *                             fused::first(unary::Sqrt<T>()),
+ *                             fused::first(unary::Reciprocal<T>())), b, c);
+ * @endcode
+ */
+namespace fused {
+template<class Op1, class Op2>
+class Chain {
+private:
+  Op1 op1;
+  Op2 op2;
+public:
+  Chain(const Op1& s1, const Op2& s2) : op1(s1), op2(s2) {}
+
+  template<class... Args>
+  HL_DEVICE inline void gpuOperator(Args&... args) {
+    op1.gpuOperator(args...);
+    op2.gpuOperator(args...);
+  }
+
+  template<class... Args>
+  inline void cpuOperator(Args&... args) {
+    op1.cpuOperator(args...);
+    op2.cpuOperator(args...);
+  }
+};
+
+template<class Op>
+class First {
+private:
+  Op op;
+public:
+  explicit First(const Op& s) : op(s) {}
+
+  template<class T, class... Args>
+  HL_DEVICE inline void gpuOperator(T &a, Args&...) {
+    op.gpuOperator(a);
+  }
+
+  template<class T, class... Args>
+  inline void cpuOperator(T &a, Args&...) {
+    op.cpuOperator(a);
+  }
+};
+
+template<class Op>
+inline First<Op> first(const Op& op) {
+  return First<Op>(op);
+}
+
+template<class... Ops>
+struct ChainType;
+
+template<class Op>
+struct ChainType<Op> {
+  typedef Op type;
+};
+
+template<class Op1, class Op2, class... Ops>
+struct ChainType<Op1, Op2, Ops...> {
+  typedef Chain<Op1, typename ChainType<Op2, Ops...>::type> type;
+};
+
+template<class Op>
+inline Op chain(const Op& op) {
+  return op;
+}
+
+template<class Op1, class Op2, class... Ops>
+inline typename ChainType<Op1, Op2, Ops...>::type chain(const Op1& op1,
+                                                        const Op2& op2,
+                                                        const Ops&... ops) {
+  return typename ChainType<Op1, Op2, Ops...>::type(op1, chain(op2, ops...));
+}
+}  // namespace fused
+
 #endif /* HL_MATRIX_OPS_CUH_ */
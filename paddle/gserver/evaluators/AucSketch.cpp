@@ -0,0 +1,148 @@
+/* Copyright (c) 2016 Baidu, Inc. All Rights Reserve.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include "AucSketch.h"
+
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+#include "paddle/utils/Logging.h"
+
+namespace paddle {
+
+static inline double trapezoidArea(double X1, double X2, double Y1,
+                                   double Y2) {
+  return (X1 > X2 ? (X1 - X2) : (X2 - X1)) * (Y1 + Y2) / 2.0;
+}
+
+AucSketch::AucSketch(size_t maxBins) : maxBins_(maxBins), shift_(0) {
+  CHECK_GT(maxBins_, 0UL);
+}
+
+void AucSketch::add(real score, bool positive, double weight) {
+  uint32_t binIdx = static_cast<uint32_t>(score * kBinNum);
+  CHECK(binIdx <= kBinNum) << "bin index [" << binIdx
+                           << "] out of range, predict value[" << score
+                           << "]";
+  Stat& stat = bins_[binIdx >> shift_];
+  if (positive) {
+    stat.pos += weight;
+  } else {
+    stat.neg += weight;
+  }
+  if (bins_.size() > maxBins_) {
+    shrink();
+  }
+}
+
+void AucSketch::merge(const AucSketch& other) {
+  if (other.shift_ > shift_) {
+    coarsen(other.shift_);
+  }
+  for (auto& bin : other.bins_) {
+    Stat& stat = bins_[bin.first >> (shift_ - other.shift_)];
+    stat.pos += bin.second.pos;
+    stat.neg += bin.second.neg;
+  }
+  shrink();
+}
+
+void AucSketch::clear() {
+  bins_.clear();
+  shift_ = 0;
+}
+
+void AucSketch::coarsen(int shift) {
+  CHECK_LE(shift, kMaxBits);
+  std::unordered_map<uint32_t, Stat> bins;
+  for (auto& bin : bins_) {
+    Stat& stat = bins[bin.first >> (shift - shift_)];
+    stat.pos += bin.second.pos;
+    stat.neg += bin.second.neg;
+  }
+  bins_.swap(bins);
+  shift_ = shift;
+}
+
+void AucSketch::shrink() {
+  while (bins_.size() > maxBins_) {
+    coarsen(shift_ + 1);
+  }
+}
+
+double AucSketch::calcAuc() const {
+  std::vector<std::pair<uint32_t, Stat>> bins(bins_.begin(), bins_.end());
+  std::sort(bins.begin(), bins.end(),
+            [](const std::pair<uint32_t, Stat>& a,
+               const std::pair<uint32_t, Stat>& b) {
+              return a.first > b.first;
+            });
+
+  double totPos = 0.0;
+  double totNeg = 0.0;
+  double totPosPrev = 0.0;
+  double totNegPrev = 0.0;
+  double auc = 0.0;
+  for (auto& bin : bins) {
+    totPosPrev = totPos;
+    totNegPrev = totNeg;
+    totPos += bin.second.pos;
+    totNeg += bin.second.neg;
+    auc += trapezoidArea(totNeg, totNegPrev, totPos, totPosPrev);
+  }
+
+  if (totPos > 0.0 && totNeg > 0.0) {
+    return auc / totPos / totNeg;
+  } else {
+    return 0.0;
+  }
+}
+
+int AucSketch::getDenseBits() const {
+  int bits = 0;
+  while (bits < kMaxBits && (size_t(2) << bits) <= maxBins_) {
+    ++bits;
+  }
+  return bits;
+}
+
+void AucSketch::toDense(int bits, double* pos, double* neg) const {
+  CHECK_LE(bits, kMaxBits);
+  memset(pos, 0, sizeof(double) << bits);
+  memset(neg, 0, sizeof(double) << bits);
+  int denseShift = kMaxBits - bits;
+  for (auto& bin : bins_) {
+    uint32_t idx = shift_ >= denseShift ? bin.first << (shift_ - denseShift)
+                                        : bin.first >> (denseShift - shift_);
+    pos[idx] += bin.second.pos;
+    neg[idx] += bin.second.neg;
+  }
+}
+
+void AucSketch::fromDense(int bits, const double* pos, const double* neg) {
+  CHECK_LE(bits, kMaxBits);
+  bins_.clear();
+  shift_ = kMaxBits - bits;
+  for (uint32_t idx = 0; idx < (1U << bits); ++idx) {
+    if (pos[idx] != 0.0 || neg[idx] != 0.0) {
+      Stat& stat = bins_[idx];
+      stat.pos = pos[idx];
+      stat.neg = neg[idx];
+    }
+  }
+  shrink();
+}
+
+}  // namespace paddle
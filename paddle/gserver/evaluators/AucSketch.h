@@ -0,0 +1,90 @@
+/* Copyright (c) 2016 Baidu, Inc. All Rights Reserve.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <unordered_map>
+
+#include "paddle/utils/TypeDefs.h"
+
+namespace paddle {
+
+/**
+ * @brief weighted positive and negative counts of the scores in [0, 1],
+ *        for computing AUC with bounded memory.
+ *
+ * A score falls into bin (score * (2^24 - 1)) >> shift. Only the bins which
+ * have been seen are stored. When there are more than maxBins of them, the
+ * shift grows and every two neighbouring bins are merged, until at most
+ * maxBins remain. So the memory is O(min(distinct scores, maxBins)) and the
+ * bins are never wider than 2^24 / maxBins of the finest ones.
+ *
+ * Scores in the same bin are taken as ties, so the error of calcAuc() is at
+ * most sum(pos_b * neg_b) / (2 * totPos * totNeg) over the bins b. With no
+ * coarsening it is the same as the 2^24 dense bins.
+ */
+class AucSketch {
+public:
+  static const int kMaxBits = 24;
+  static const uint32_t kBinNum = (1 << kMaxBits) - 1;
+
+  explicit AucSketch(size_t maxBins);
+
+  void add(real score, bool positive, double weight);
+
+  /// add the counts of other, which may have another shift
+  void merge(const AucSketch& other);
+
+  void clear();
+
+  double calcAuc() const;
+
+  /**
+   * @brief dense counts of the 2^bits bins of shift kMaxBits - bits.
+   *
+   * Bins of a larger shift are put into the first dense bin they cover.
+   * pos and neg have 2^bits elements.
+   */
+  void toDense(int bits, double* pos, double* neg) const;
+
+  /// replace the counts by dense counts of toDense()
+  void fromDense(int bits, const double* pos, const double* neg);
+
+  size_t getNumBins() const { return bins_.size(); }
+  int getShift() const { return shift_; }
+
+  /// log2 of the largest number of dense bins not more than maxBins
+  int getDenseBits() const;
+
+protected:
+  struct Stat {
+    double pos;
+    double neg;
+    Stat() : pos(0), neg(0) {}
+  };
+
+  /// merge the bins into those of a larger shift
+  void coarsen(int shift);
+
+  /// merge the bins until there are at most maxBins_ of them
+  void shrink();
+
+  size_t maxBins_;
+  int shift_;
+  std::unordered_map<uint32_t, Stat> bins_;
+};
+
+}  // namespace paddle
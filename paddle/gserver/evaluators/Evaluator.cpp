@@ -19,6 +19,8 @@ limitations under the License. */
 #include "paddle/gserver/gradientmachines/NeuralNetwork.h"
 
 P_DECLARE_int32(trainer_id);
+P_DEFINE_int32(auc_max_bins, 1 << 16,
+               "Max number of score bins kept by an auc evaluator");
 
 namespace paddle {
 
@@ -342,10 +344,17 @@ private:
   MatrixPtr sum_; /* cpu matrix */
 };
 
+AucEvaluator::AucEvaluator(int32_t colIdx)
+    : sketch_(FLAGS_auc_max_bins),
+      colIdx_(colIdx),
+      realColumnIdx_(0),
+      cpuOutput_(nullptr),
+      cpuLabel_(nullptr),
+      cpuWeight_(nullptr) {}
+
 void AucEvaluator::start() {
   Evaluator::start();
-  memset(statPos_, 0, sizeof(statPos_));
-  memset(statNeg_, 0, sizeof(statNeg_));
+  sketch_.clear();
 }
 
 real AucEvaluator::evalImp(std::vector<Argument>& arguments) {
@@ -400,48 +409,25 @@ real AucEvaluator::evalImp(std::vector<Argument>& arguments) {
   real* weightD = supportWeight ? weight->getData() : nullptr;
   size_t pos = realColumnIdx_;
   for (size_t i = 0; i < insNum; ++i) {
-    real value = outputD[pos];
-    uint32_t binIdx = static_cast<uint32_t>(value * kBinNum_);
-    CHECK(binIdx <= kBinNum_) << "bin index [" << binIdx
-                              << "] out of range, predict value[" << value
-                              << "]";
     real w = supportWeight ? weightD[i] : 1.0;
-    if (labelD[i] == kNegativeLabel_) {
-      statNeg_[binIdx] += w;
-    } else {
-      statPos_[binIdx] += w;
-    }
+    sketch_.add(outputD[pos], labelD[i] != kNegativeLabel_, w);
     pos += outputDim;
   }
   return 0;
 }
 
 void AucEvaluator::distributeEval(ParameterClient2* client) {
-  client->reduce(statPos_, statPos_, kBinNum_ + 1, FLAGS_trainer_id, 0);
-  client->reduce(statNeg_, statNeg_, kBinNum_ + 1, FLAGS_trainer_id, 0);
-}
-
-double AucEvaluator::calcAuc() {
-  double totPos = 0.0;
-  double totNeg = 0.0;
-  double totPosPrev = 0.0;
-  double totNegPrev = 0.0;
-  double auc = 0.0;
-
-  int64_t idx = kBinNum_;
-  while (idx >= 0) {
-    totPosPrev = totPos;
-    totNegPrev = totNeg;
-    totPos += statPos_[idx];
-    totNeg += statNeg_[idx];
-    auc += trapezoidArea(totNeg, totNegPrev, totPos, totPosPrev);
-    --idx;
-  }
-
-  if (totPos > 0.0 && totNeg > 0.0) {
-    return auc / totPos / totNeg;
-  } else {
-    return 0.0;
+  /// all the trainers reduce the same 2^bits dense bins
+  int bits = sketch_.getDenseBits();
+  std::vector<double> statPos(1 << bits);
+  std::vector<double> statNeg(1 << bits);
+  sketch_.toDense(bits, statPos.data(), statNeg.data());
+  client->reduce(statPos.data(), statPos.data(), statPos.size(),
+                 FLAGS_trainer_id, 0);
+  client->reduce(statNeg.data(), statNeg.data(), statNeg.size(),
+                 FLAGS_trainer_id, 0);
+  if (FLAGS_trainer_id == 0) {
+    sketch_.fromDense(bits, statPos.data(), statNeg.data());
   }
 }
 
@@ -19,6 +19,7 @@ limitations under the License. */
 #include "paddle/utils/ClassRegistrar.h"
 #include "ModelConfig.pb.h"
 #include "paddle/parameter/Argument.h"
+#include "paddle/gserver/evaluators/AucSketch.h"
 #include <fstream>
 
 namespace paddle {
@@ -154,42 +155,27 @@ public:
  */
 class AucEvaluator : public Evaluator {
 public:
-  AucEvaluator(int32_t colIdx)
-      : colIdx_(colIdx),
-        realColumnIdx_(0),
-        cpuOutput_(nullptr),
-        cpuLabel_(nullptr),
-        cpuWeight_(nullptr) {}
+  AucEvaluator(int32_t colIdx);
 
   virtual void start();
 
   virtual real evalImp(std::vector<Argument>& arguments);
 
   virtual void printStats(std::ostream& os) {
-    os << config_.name() << "=" << calcAuc();
+    os << config_.name() << "=" << sketch_.calcAuc();
   }
 
   virtual void distributeEval(ParameterClient2* client);
 
 private:
-  static const uint32_t kBinNum_ = (1 << 24) - 1;
   static const int kNegativeLabel_ = 0;
-  double statPos_[kBinNum_ + 1];
-  double statNeg_[kBinNum_ + 1];
+  /// weighted counts of the predictions, see AucSketch
+  AucSketch sketch_;
   int32_t colIdx_;
   uint32_t realColumnIdx_;
   MatrixPtr cpuOutput_;
   IVectorPtr cpuLabel_;
   MatrixPtr cpuWeight_;
-
-  AucEvaluator() {}
-
-  inline static double trapezoidArea(double X1, double X2, double Y1,
-                                     double Y2) {
-    return (X1 > X2 ? (X1 - X2) : (X2 - X1)) * (Y1 + Y2) / 2.0;
-  }
-
-  double calcAuc();
 };
 
 /**
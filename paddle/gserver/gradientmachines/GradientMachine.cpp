@@ -35,7 +35,7 @@ GradientMachine* GradientMachine::create(
     return gm;
   }
   if (FLAGS_trainer_count > 1) {
-    return new MultiGradientMachine(config, FLAGS_use_gpu);
+    return new MultiGradientMachine(config, FLAGS_use_gpu, mode);
   }
   if (FLAGS_trainer_count == 1) {  // single
     NeuralNetwork* nn;
@@ -108,6 +108,14 @@ GradientMachine* GradientMachine::create(std::istream& is,
   return machine.release();
 }
 
+void GradientMachine::swapSnapshotValue() {
+  for (auto& para : parameters_) {
+    if (para->isStatic()) continue;
+    if (!para->getBuf(PARAMETER_SNAPSHOT_VALUE)) continue;
+    para->swapSnapshotValue();
+  }
+}
+
 void GradientMachine::saveParameters(const std::string& dir) const {
   LOG(INFO) << "Saving parameters to " << dir;
 
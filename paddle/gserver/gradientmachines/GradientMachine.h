@@ -167,6 +167,41 @@ public:
     backward(callback);
   }
 
+  /**
+   * @brief Prepare paired evaluation for variance reduced training.
+   *
+   * @return false if this machine cannot evaluate PARAMETER_SNAPSHOT_VALUE
+   *         and PARAMETER_VALUE side by side. The caller should fall back to
+   *         swapping the two buffers around forwardBackward().
+   */
+  virtual bool initPairedEvaluation() { return false; }
+
+  /**
+   * @brief Paired forward/backward for variance reduced training.
+   *
+   * Evaluate the snapshot parameters (PARAMETER_SNAPSHOT_VALUE) and the
+   * current parameters (PARAMETER_VALUE) on the same inArgs, and accumulate
+   * grad(PARAMETER_VALUE) - grad(PARAMETER_SNAPSHOT_VALUE) into
+   * PARAMETER_GRADIENT. outArgs are the outputs of the current parameters.
+   * callback is invoked for each parameter once both gradients are in.
+   *
+   * @note initPairedEvaluation() must have returned true.
+   */
+  virtual void forwardBackwardPaired(const std::vector<Argument>& inArgs,
+                                     std::vector<Argument>* outArgs,
+                                     PassType passType,
+                                     const UpdateCallback& callback = nullptr) {
+    LOG(FATAL) << "Not implemented!";
+  }
+
+  /**
+   * @brief Swap PARAMETER_VALUE and PARAMETER_SNAPSHOT_VALUE.
+   *
+   * The next forward() uses the swapped values. Parameters without
+   * PARAMETER_SNAPSHOT_VALUE are left alone.
+   */
+  virtual void swapSnapshotValue();
+
   // see comment in Layer.h for the function with the same name
   virtual void resetState() {}
 
@@ -40,7 +40,7 @@ static void fillMergeTypes(PassType passType,
 }
 
 MultiGradientMachine::MultiGradientMachine(
-    const ModelConfig& config, bool useGpu)
+    const ModelConfig& config, bool useGpu, int mode)
     : useGpu_(useGpu),
       trainerBarrier_(FLAGS_trainer_count),
       allBarrier_(FLAGS_trainer_count + 1),
@@ -87,9 +87,6 @@ MultiGradientMachine::MultiGradientMachine(
       para->enableType(PARAMETER_VALUE);
       if (!para->isStatic()) {
         para->enableType(PARAMETER_GRADIENT);
-        // todo, only for svrg
-        para->enableType(PARAMETER_GRADIENT_SUM);
-        para->enableType(PARAMETER_SNAPSHOT_VALUE);
       }
     }
   };
@@ -173,6 +170,10 @@ MultiGradientMachine::MultiGradientMachine(
     }
   }
 
+  if (mode == kSVRG) {
+    enableSvrgTypes();
+  }
+
   gradBufs_.resize(numThreads_);
   for (int i = 0; i < numThreads_; ++i) {
     gradBufs_[i].resize(numLogicalDevices_);
@@ -198,6 +199,22 @@ MultiGradientMachine::getSlaveParameters() {
   return vec;
 }
 
+void MultiGradientMachine::enableSvrgTypes() {
+  for (auto& para : parameters_) {
+    if (para->isStatic() || para->isValueShared() ||
+        para->isSparseRemoteUpdate()) {
+      continue;
+    }
+    // Only the main copy keeps the snapshot and the full gradient. CPU
+    // threads share the value and its views with it. A swap marks the value
+    // as updated, so the other GPU threads get it from valueDispatchThread()
+    // before the next forward().
+    SetDevice device(para->getDeviceId());
+    para->enableType(PARAMETER_GRADIENT_SUM);
+    para->enableType(PARAMETER_SNAPSHOT_VALUE);
+  }
+}
+
 void MultiGradientMachine::notifyGradientTransfer(int paramId) {
   gradQueue_.enqueue(paramId);
 }
@@ -248,6 +265,28 @@ void MultiGradientMachine::prefetch(const std::vector<Argument>& inArgs) {
       auto matGrad = dynamic_cast<SparseRowCpuMatrix*>(
           para->getMat(PARAMETER_GRADIENT).get());
       matGrad->reserveStore();
+    } else if (para->isGradSparseUpdate()) {
+      // the rows of the batch are registered in the gradients of the
+      // threads, collect them for ParameterUpdater::catchUpBatchRows().
+      // mergeGradSparse() rebuilds the ids after backward.
+      SparseRowIdsCpuMatrix* mainMat = dynamic_cast<SparseRowIdsCpuMatrix*>(
+          para->getMat(PARAMETER_GRADIENT).get());
+      size_t numThreads = threads_.size();
+      for (size_t tid = 0; tid < numThreads; ++tid) {
+        mainMat->getIds(tid).clear();
+      }
+      for (auto& thread : threads_) {
+        SparseRowCpuMatrix* mat = dynamic_cast<SparseRowCpuMatrix*>(
+            thread->getParameters()[para->getID()]
+                ->getMat(PARAMETER_GRADIENT)
+                .get());
+        for (auto id : mat->getIndexDictHandle()->localIndices) {
+          mainMat->getIds(id % numThreads).push_back(id);
+        }
+      }
+      for (size_t tid = 0; tid < numThreads; ++tid) {
+        uniqueIds(mainMat->getIds(tid));
+      }
     }
   }
 }
@@ -161,7 +161,12 @@ public:
     TASK_COPY_IN_ARGS = 3,
   };
 
-  explicit MultiGradientMachine(const ModelConfig& config, bool useGpu);
+  /**
+   * @param mode  GradientMachine::CreateMode. With kSVRG, the main parameters
+   *              also get PARAMETER_GRADIENT_SUM and PARAMETER_SNAPSHOT_VALUE.
+   */
+  MultiGradientMachine(const ModelConfig& config, bool useGpu,
+                       int mode = kNormal);
 
   virtual void prefetch(const std::vector<Argument>& inArgs);
 
@@ -307,6 +312,9 @@ protected:
 
   void allocGradBufs();
 
+  /// enable the SVRG buffers on the main copy of each parameter
+  void enableSvrgTypes();
+
 protected:
   bool useGpu_;
 
@@ -33,6 +33,8 @@ void parameterInitNN(int paramId, Parameter* para,
     para->enableSharedType(PARAMETER_VALUE,
                            (*sharedParams)[paramId]->getBuf(PARAMETER_VALUE),
                            (*sharedParams)[paramId]->getMat(PARAMETER_VALUE));
+    para->shareBufferViews(PARAMETER_VALUE, (*sharedParams)[paramId].get(),
+                           PARAMETER_VALUE);
   } else {
     if (para->isSparseRemoteUpdate()) {
       para->enableType(
@@ -287,6 +289,134 @@ void NeuralNetwork::backward(const UpdateCallback& callback) {
   }
 }
 
+bool NeuralNetwork::initPairedEvaluation() {
+  if (pairedNetwork_) {
+    return true;
+  }
+  if (rootNetwork_ != nullptr || !paramSelfInited_ || config_.type() != "nn" ||
+      config_.has_external_config() || FLAGS_parallel_nn) {
+    return false;
+  }
+
+  for (auto& para : parameters_) {
+    if (para->isStatic()) continue;
+    if (!para->hasType(PARAMETER_SNAPSHOT_VALUE) || para->isSparse() ||
+        para->isGradSparseUpdate()) {
+      VLOG(1) << "paired evaluation is not supported for parameter "
+              << para->getName();
+      return false;
+    }
+  }
+
+  // The snapshot gradient is subtracted by negating the coeff of the cost
+  // layers. This is only exact if a cost layer has no parameter and is the
+  // last layer whose gradient flows into its input layer, since
+  // CostLayer::backward() scales the whole gradient of its input by coeff.
+  ModelConfig config = config_;
+  for (auto& outputLayer : outputLayers_) {
+    auto costLayer = dynamic_cast<CostLayer*>(outputLayer.get());
+    if (!costLayer) {
+      VLOG(1) << "paired evaluation needs cost layers as outputs, but got "
+              << outputLayer->getName();
+      return false;
+    }
+    for (auto& para : costLayer->getParameters()) {
+      if (para) return false;
+    }
+    int costIndex = -1;
+    for (int i = 0; i < config.layers_size(); ++i) {
+      if (config.layers(i).name() == costLayer->getName()) {
+        costIndex = i;
+        break;
+      }
+    }
+    CHECK_GE(costIndex, 0);
+    auto costConfig = config.mutable_layers(costIndex);
+    const std::string& inputName = costConfig->inputs(0).input_layer_name();
+    for (int i = costIndex + 1; i < config.layers_size(); ++i) {
+      for (const auto& input : config.layers(i).inputs()) {
+        if (input.input_layer_name() == inputName) {
+          VLOG(1) << "paired evaluation: layer " << inputName
+                  << " feeds more than cost layer " << costLayer->getName();
+          return false;
+        }
+      }
+    }
+    costConfig->set_coeff(-costConfig->coeff());
+  }
+
+  ParamInitCallback shareSnapshot = [this](int paramId, Parameter* para) {
+    Parameter* mainPara = parameters_[paramId].get();
+    if (mainPara->isStatic()) {
+      para->enableSharedType(PARAMETER_VALUE,
+                             mainPara->getBuf(PARAMETER_VALUE),
+                             mainPara->getMat(PARAMETER_VALUE));
+      para->shareBufferViews(PARAMETER_VALUE, mainPara, PARAMETER_VALUE);
+    } else {
+      para->enableSharedType(PARAMETER_VALUE,
+                             mainPara->getBuf(PARAMETER_SNAPSHOT_VALUE),
+                             Parameter::MAT_NORMAL);
+      para->shareBufferViews(PARAMETER_VALUE, mainPara,
+                             PARAMETER_SNAPSHOT_VALUE);
+      // the matrix is not the one of mainPara, so it is a view as well
+      para->registerValueView(para->getMat(PARAMETER_VALUE));
+      para->enableSharedType(PARAMETER_GRADIENT,
+                             mainPara->getBuf(PARAMETER_GRADIENT),
+                             mainPara->getMat(PARAMETER_GRADIENT));
+    }
+  };
+
+  bool useGpu = parameters_.empty() ? FLAGS_use_gpu : parameters_[0]->useGpu();
+  pairedNetwork_.reset(newNeuralNetwork());
+  pairedNetwork_->init(config, shareSnapshot,
+                       std::vector<ParameterType>{PARAMETER_VALUE,
+                                                  PARAMETER_GRADIENT},
+                       useGpu);
+  CHECK_EQ(pairedNetwork_->layers_.size(), layers_.size());
+  LOG(INFO) << "paired evaluation enabled for variance reduction";
+  return true;
+}
+
+void NeuralNetwork::forwardBackwardPaired(const std::vector<Argument>& inArgs,
+                                          std::vector<Argument>* outArgs,
+                                          PassType passType,
+                                          const UpdateCallback& callback) {
+  CHECK(pairedNetwork_) << "initPairedEvaluation() is not called";
+  CHECK_EQ(inArgs.size(), dataLayers_.size());
+  for (size_t i = 0; i != dataLayers_.size(); ++i) {
+    pairedNetwork_->dataLayers_[i]->setData(inArgs[i]);
+    dataLayers_[i]->setData(inArgs[i]);
+  }
+
+  // Run each layer at w_s and then at w_t, so that the input of the layer
+  // is still hot in cache for the second evaluation.
+  auto& pairedLayers = pairedNetwork_->layers_;
+  for (size_t i = 0; i < layers_.size(); ++i) {
+    REGISTER_TIMER_INFO("ForwardTimer", layers_[i]->getName().c_str());
+    gLayerStackTrace.push(layers_[i]->getName());
+    pairedLayers[i]->forward(passType);
+    layers_[i]->forward(passType);
+  }
+
+  outArgs->clear();
+  outArgs->reserve(outputLayers_.size());
+  for (auto& layer : outputLayers_) {
+    outArgs->push_back(layer->getOutput());
+  }
+
+  // The paired layer always runs backward first, so -grad(w_s) is already
+  // accumulated when the callback of a parameter is invoked.
+  gLayerStackTrace.pop("");
+  for (size_t i = layers_.size(); i-- > 0;) {
+    REGISTER_TIMER_INFO("BackwardTimer", layers_[i]->getName().c_str());
+    if (layers_[i]->needGradient()) {
+      pairedLayers[i]->backward(nullptr);
+      layers_[i]->backward(callback);
+    }
+    gLayerStackTrace.pop(layers_[i]->getName());
+  }
+}
+
 MatrixPtr NeuralNetwork::getLayerOutput(const std::string& layerName) {
   auto it = layerMap_.find(layerName);
   CHECK(it != layerMap_.end()) << "Cannot find layer: " << layerName;
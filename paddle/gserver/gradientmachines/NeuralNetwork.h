@@ -86,6 +86,20 @@ public:
 
   virtual void backward(const UpdateCallback& callback = nullptr);
 
+  /**
+   * Paired evaluation is done by a shadow network built from the same
+   * config. Its PARAMETER_VALUE is PARAMETER_SNAPSHOT_VALUE of this network,
+   * its PARAMETER_GRADIENT is shared with this network, and the coeff of
+   * its cost layers is negated, so its backward subtracts grad(w_s) from
+   * the gradient buffer directly.
+   */
+  virtual bool initPairedEvaluation();
+
+  virtual void forwardBackwardPaired(const std::vector<Argument>& inArgs,
+                                     std::vector<Argument>* outArgs,
+                                     PassType passType,
+                                     const UpdateCallback& callback = nullptr);
+
   MatrixPtr getLayerOutput(const std::string& layerName);
   const LayerPtr& getLayer(const std::string& layerName) const {
     auto it = layerMap_.find(layerName);
@@ -158,6 +172,10 @@ protected:
   /// Whether parameter of this NN is initialized by its own
   /// (i.e., not by callback supplied with the caller)
   bool paramSelfInited_;
+
+  /// Shadow network evaluated at PARAMETER_SNAPSHOT_VALUE.
+  /// Only created by initPairedEvaluation().
+  std::unique_ptr<NeuralNetwork> pairedNetwork_;
 };
 
 }  // namespace paddle
@@ -318,6 +318,8 @@ void RecurrentGradientMachine::resizeOrCreateFrames(int numFrames) {
     para->enableSharedType(PARAMETER_VALUE,
                            this->parameters_[paramId]->getBuf(PARAMETER_VALUE),
                            this->parameters_[paramId]->getMat(PARAMETER_VALUE));
+    para->shareBufferViews(PARAMETER_VALUE, this->parameters_[paramId].get(),
+                           PARAMETER_VALUE);
     para->enableSharedType(
         PARAMETER_GRADIENT,
         this->parameters_[paramId]->getBuf(PARAMETER_GRADIENT),
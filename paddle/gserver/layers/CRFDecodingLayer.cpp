@@ -24,8 +24,8 @@ bool CRFDecodingLayer::init(const LayerMap& layerMap,
   if (!CRFLayer::init(layerMap, parameterMap)) {
     return false;
   }
-  crf_.reset(new LinearChainCRF(
-      numClasses_, parameter_->getBuf(PARAMETER_VALUE)->getData(), nullptr));
+  crfValue_ = parameter_->getBuf(PARAMETER_VALUE)->getData();
+  crf_.reset(new LinearChainCRF(numClasses_, crfValue_, nullptr));
   return true;
 }
 
@@ -34,6 +34,11 @@ void CRFDecodingLayer::forward(PassType passType) {
 
   CHECK(!useGpu_) << "GPU is not supported";
 
+  if (parameter_->getBuf(PARAMETER_VALUE)->getData() != crfValue_) {
+    crfValue_ = parameter_->getBuf(PARAMETER_VALUE)->getData();
+    crf_.reset(new LinearChainCRF(numClasses_, crfValue_, nullptr));
+  }
+
   const Argument& output = getInput(0);
   CHECK(output.sequenceStartPositions);
 
@@ -68,6 +68,10 @@ void CRFLayer::forward(PassType passType) {
   const int* starts = label.sequenceStartPositions->getData(false);
   CHECK_EQ(starts[numSequences], batchSize);
 
+  if (parameter_->getBuf(PARAMETER_VALUE)->getData() != crfValue_) {
+    crfs_.clear();
+    crfValue_ = parameter_->getBuf(PARAMETER_VALUE)->getData();
+  }
   for (size_t i = 0; i < numSequences; ++i) {
     if (i >= crfs_.size()) {
       crfs_.emplace_back(numClasses_,
@@ -29,7 +29,8 @@ namespace paddle {
  */
 class CRFLayer : public Layer {
 public:
-  explicit CRFLayer(const LayerConfig& config) : Layer(config) {}
+  explicit CRFLayer(const LayerConfig& config)
+      : Layer(config), crfValue_(nullptr) {}
   virtual bool init(const LayerMap& layerMap, const ParameterMap& parameterMap);
   virtual void forward(PassType passType);
   virtual void backward(const UpdateCallback& callback);
@@ -38,6 +39,9 @@ protected:
   size_t numClasses_;
   ParameterPtr parameter_;
   std::vector<LinearChainCRF> crfs_;
+  /// the value the crfs are created on, it moves when the parameter swaps
+  /// its value with the snapshot
+  real* crfValue_;
   LayerPtr weightLayer_;  // weight for each sequence
   real coeff_;  // weight for the layer
 };
@@ -0,0 +1,579 @@
+/* Copyright (c) 2016 Baidu, Inc. All Rights Reserve.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include "CpuRnnKernel.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <cmath>
+#include <vector>
+
+#include "hl_functions.h"
+#include "paddle/math/CpuApply.h"
+#include "paddle/math/MathFunctions.h"
+#include "paddle/utils/Logging.h"
+#include "paddle/utils/Util.h"
+
+P_DEFINE_bool(rnn_fused_cpu_kernel, true,
+              "Use the fused cpu kernels of the lstm and gru cells, "
+              "see cpu_apply_isa and cpu_apply_threads");
+
+namespace paddle {
+
+namespace cpu_rnn {
+
+template <class T>
+struct SelectBits;
+
+template <>
+struct SelectBits<float> {
+  typedef int32_t type;
+};
+
+template <>
+struct SelectBits<double> {
+  typedef int64_t type;
+};
+
+/**
+ * cond ? a : b by the bits, which the compiler keeps a select. It splits
+ * the loops at the ternaries of floats with a constant operand.
+ */
+template <class T>
+CPU_APPLY_INLINE T select(bool cond, T a, T b) {
+  typedef typename SelectBits<T>::type Bits;
+  Bits bitsA, bitsB;
+  memcpy(&bitsA, &a, sizeof(T));
+  memcpy(&bitsB, &b, sizeof(T));
+  Bits mask = -(Bits)cond;
+  Bits bits = (bitsA & mask) | (bitsB & ~mask);
+  T result;
+  memcpy(&result, &bits, sizeof(T));
+  return result;
+}
+
+template <class T>
+CPU_APPLY_INLINE T clamp(T x, T min, T max) {
+  x = select(x < min, min, x);
+  return select(x > max, max, x);
+}
+
+/**
+ * exp() of float by a polynomial, without branches nor calls, so the
+ * loops of the activations vectorize. The error is about 2 ulp.
+ */
+CPU_APPLY_INLINE float vecExp(float x) {
+  x = clamp(x, -87.3f, 88.3f);
+  /// round to the nearest integer by the float addition, |n| < 2^22
+  float n = (x * 1.44269504f + 12582912.0f) - 12582912.0f;
+  float r = x - n * 0.693359375f + n * 2.12194440e-4f;
+  float p = 1.9875691500e-4f;
+  p = p * r + 1.3981999507e-3f;
+  p = p * r + 8.3334519073e-3f;
+  p = p * r + 4.1665795894e-2f;
+  p = p * r + 1.6666665459e-1f;
+  p = p * r + 5.0000001201e-1f;
+  p = p * r * r + r + 1.0f;
+  int32_t bits = ((int32_t)n + 127) << 23;
+  float scale;
+  memcpy(&scale, &bits, sizeof(scale));
+  return p * scale;
+}
+
+CPU_APPLY_INLINE double vecExp(double x) { return std::exp(x); }
+
+/// the activations of hl_activation_mode_t, see hl_cpu_functions.cc
+template <int mode>
+struct Active;
+
+template <>
+struct Active<HL_ACTIVATION_SIGMOID> {
+  static CPU_APPLY_INLINE real forward(real a) {
+    a = clamp<real>(a, SIGMOID_THRESHOLD_MIN, SIGMOID_THRESHOLD_MAX);
+    return 1.0f / (1.0f + vecExp(-a));
+  }
+  static CPU_APPLY_INLINE real backward(real grad, real out) {
+    return grad * out * (1 - out);
+  }
+};
+
+template <>
+struct Active<HL_ACTIVATION_RELU> {
+  static CPU_APPLY_INLINE real forward(real a) {
+    return select<real>(a > 0, a, 0);
+  }
+  static CPU_APPLY_INLINE real backward(real grad, real out) {
+    return select<real>(out > 0, grad, 0);
+  }
+};
+
+template <>
+struct Active<HL_ACTIVATION_TANH> {
+  static CPU_APPLY_INLINE real forward(real a) {
+    return 2.0f / (1.0f + vecExp(-2.0f * a)) - 1.0f;
+  }
+  static CPU_APPLY_INLINE real backward(real grad, real out) {
+    return grad * (1.0f - out * out);
+  }
+};
+
+template <>
+struct Active<HL_ACTIVATION_LINEAR> {
+  static CPU_APPLY_INLINE real forward(real a) { return a; }
+  static CPU_APPLY_INLINE real backward(real grad, real out) { return grad; }
+};
+
+/**
+ * Kernel<modes...>::run(args...) with the runtime activation modes as the
+ * template arguments of Kernel.
+ */
+template <int N, template <int...> class Kernel, int... Modes>
+struct ActiveDispatch {
+  template <class... Args>
+  static void run(const hl_activation_mode_t* modes, Args... args) {
+    switch (modes[0]) {
+      case HL_ACTIVATION_SIGMOID:
+        ActiveDispatch<N - 1, Kernel, Modes..., HL_ACTIVATION_SIGMOID>::run(
+            modes + 1, args...);
+        break;
+      case HL_ACTIVATION_RELU:
+        ActiveDispatch<N - 1, Kernel, Modes..., HL_ACTIVATION_RELU>::run(
+            modes + 1, args...);
+        break;
+      case HL_ACTIVATION_TANH:
+        ActiveDispatch<N - 1, Kernel, Modes..., HL_ACTIVATION_TANH>::run(
+            modes + 1, args...);
+        break;
+      case HL_ACTIVATION_LINEAR:
+        ActiveDispatch<N - 1, Kernel, Modes..., HL_ACTIVATION_LINEAR>::run(
+            modes + 1, args...);
+        break;
+      default:
+        LOG(FATAL) << "Unknown activation mode " << modes[0];
+    }
+  }
+};
+
+template <template <int...> class Kernel, int... Modes>
+struct ActiveDispatch<0, Kernel, Modes...> {
+  template <class... Args>
+  static void run(const hl_activation_mode_t* modes, Args... args) {
+    Kernel<Modes...>::run(args...);
+  }
+};
+
+/**
+ * Rows for the absent, i.e. null, arguments of a kernel, so that the loops
+ * of the kernels have no branches: zeros to read and a sink to write.
+ */
+class AbsentRows {
+public:
+  /// data, or size zeros if data is null
+  real* input(real* data, size_t size) { return data ? data : alloc(size); }
+
+  /// data, or size elements, which are never read, if data is null
+  real* output(real* data, size_t size) { return data ? data : alloc(size); }
+
+private:
+  real* alloc(size_t size) {
+    buffers_.emplace_back(size, 0);
+    return buffers_.back().data();
+  }
+
+  std::vector<std::vector<real>> buffers_;
+};
+
+/// one row of hppl::forward::lstm
+template <int Node, int Gate, int State>
+CPU_APPLY_INLINE void lstmForwardRow(
+    real* __restrict__ valueIn, real* __restrict__ valueIg,
+    real* __restrict__ valueFg, real* __restrict__ valueOg,
+    const real* __restrict__ prevState, real* __restrict__ state,
+    real* __restrict__ stateAtv, real* __restrict__ output,
+    const real* __restrict__ checkI, const real* __restrict__ checkF,
+    const real* __restrict__ checkO, int colBegin, int colEnd) {
+  for (int i = colBegin; i < colEnd; ++i) {
+    real prev = prevState[i];
+    real in = Active<Node>::forward(valueIn[i]);
+    real ig = Active<Gate>::forward(valueIg[i] + prev * checkI[i]);
+    real fg = Active<Gate>::forward(valueFg[i] + prev * checkF[i]);
+    real s = in * ig + prev * fg;
+    real og = Active<Gate>::forward(valueOg[i] + s * checkO[i]);
+    real sa = Active<State>::forward(s);
+    valueIn[i] = in;
+    valueIg[i] = ig;
+    valueFg[i] = fg;
+    valueOg[i] = og;
+    state[i] = s;
+    stateAtv[i] = sa;
+    output[i] = og * sa;
+  }
+}
+
+template <int Node, int Gate, int State>
+struct LstmForward {
+  hl_lstm_value value;
+  int frameSize;
+
+  CPU_APPLY_INLINE void operator()(int rowBegin, int rowEnd, int colBegin,
+                                   int colEnd) {
+    for (int b = rowBegin; b < rowEnd; ++b) {
+      real* gate = value.gateValue + (size_t)b * frameSize * 4;
+      size_t offset = (size_t)b * frameSize;
+      lstmForwardRow<Node, Gate, State>(
+          gate, gate + frameSize, gate + frameSize * 2, gate + frameSize * 3,
+          value.prevStateValue + offset, value.stateValue + offset,
+          value.stateActiveValue + offset, value.outputValue + offset,
+          value.checkIg, value.checkFg, value.checkOg, colBegin, colEnd);
+    }
+  }
+
+  static void run(hl_lstm_value value, int frameSize, int batchSize) {
+    AbsentRows absent;
+    size_t size = (size_t)batchSize * frameSize;
+    value.prevStateValue = absent.input(value.prevStateValue, size);
+    LstmForward kernel = {value, frameSize};
+    cpu_apply::applyKernel(kernel, batchSize, frameSize);
+  }
+};
+
+/**
+ * one row of hppl::backward::lstm. The check gradients of absent previous
+ * states add zeros.
+ */
+template <int Node, int Gate, int State>
+CPU_APPLY_INLINE void lstmBackwardRow(
+    const real* __restrict__ valueIn, const real* __restrict__ valueIg,
+    const real* __restrict__ valueFg, const real* __restrict__ valueOg,
+    real* __restrict__ gradIn, real* __restrict__ gradIg,
+    real* __restrict__ gradFg, real* __restrict__ gradOg,
+    const real* __restrict__ prevState, real* __restrict__ prevStateGrad,
+    const real* __restrict__ state, real* __restrict__ stateGrad,
+    const real* __restrict__ stateAtv, const real* __restrict__ outputGrad,
+    const real* __restrict__ checkI, const real* __restrict__ checkF,
+    const real* __restrict__ checkO, real* __restrict__ checkIGrad,
+    real* __restrict__ checkFGrad, real* __restrict__ checkOGrad,
+    int colBegin, int colEnd) {
+  for (int i = colBegin; i < colEnd; ++i) {
+    real prev = prevState[i];
+    real og = Active<Gate>::backward(outputGrad[i] * stateAtv[i], valueOg[i]);
+    real sa = Active<State>::backward(outputGrad[i] * valueOg[i], stateAtv[i]);
+    real sg = stateGrad[i] + (sa + og * checkO[i]);
+    real ig = Active<Gate>::backward(sg * valueIn[i], valueIg[i]);
+    real fg = Active<Gate>::backward(sg * prev, valueFg[i]);
+    gradIn[i] = Active<Node>::backward(sg * valueIg[i], valueIn[i]);
+    gradIg[i] = ig;
+    gradFg[i] = fg;
+    gradOg[i] = og;
+    stateGrad[i] = sg;
+    prevStateGrad[i] = ig * checkI[i] + fg * checkF[i] + sg * valueFg[i];
+    checkIGrad[i] += ig * prev;
+    checkFGrad[i] += fg * prev;
+    checkOGrad[i] += og * state[i];
+  }
+}
+
+template <int Node, int Gate, int State>
+struct LstmBackward {
+  hl_lstm_value value;
+  hl_lstm_grad grad;
+  int frameSize;
+
+  CPU_APPLY_INLINE void operator()(int rowBegin, int rowEnd, int colBegin,
+                                   int colEnd) {
+    for (int b = rowBegin; b < rowEnd; ++b) {
+      const real* gate = value.gateValue + (size_t)b * frameSize * 4;
+      real* gateGrad = grad.gateGrad + (size_t)b * frameSize * 4;
+      size_t offset = (size_t)b * frameSize;
+      lstmBackwardRow<Node, Gate, State>(
+          gate, gate + frameSize, gate + frameSize * 2, gate + frameSize * 3,
+          gateGrad, gateGrad + frameSize, gateGrad + frameSize * 2,
+          gateGrad + frameSize * 3, value.prevStateValue + offset,
+          grad.prevStateGrad + offset, value.stateValue + offset,
+          grad.stateGrad + offset, value.stateActiveValue + offset,
+          grad.outputGrad + offset, value.checkIg, value.checkFg,
+          value.checkOg, grad.checkIgGrad, grad.checkFgGrad,
+          grad.checkOgGrad, colBegin, colEnd);
+    }
+  }
+
+  /// the check gradients are summed over the rows, so split the columns
+  static void run(hl_lstm_value value, hl_lstm_grad grad, int frameSize,
+                  int batchSize) {
+    AbsentRows absent;
+    size_t size = (size_t)batchSize * frameSize;
+    value.prevStateValue = absent.input(value.prevStateValue, size);
+    grad.prevStateGrad = absent.output(grad.prevStateGrad, size);
+    grad.checkIgGrad = absent.output(grad.checkIgGrad, frameSize);
+    grad.checkFgGrad = absent.output(grad.checkFgGrad, frameSize);
+    grad.checkOgGrad = absent.output(grad.checkOgGrad, frameSize);
+    LstmBackward kernel = {value, grad, frameSize};
+    cpu_apply::applyKernelByColumns(kernel, batchSize, frameSize);
+  }
+};
+
+/// hppl::forward::gru_resetOutput
+template <int Gate>
+struct GruResetOutput {
+  hl_gru_value value;
+  int frameSize;
+
+  CPU_APPLY_INLINE static void row(real* __restrict__ updateGate,
+                                   real* __restrict__ resetGate,
+                                   const real* __restrict__ prevOut,
+                                   real* __restrict__ resetOutput,
+                                   int colBegin, int colEnd) {
+    for (int i = colBegin; i < colEnd; ++i) {
+      real ug = Active<Gate>::forward(updateGate[i]);
+      real rg = Active<Gate>::forward(resetGate[i]);
+      updateGate[i] = ug;
+      resetGate[i] = rg;
+      resetOutput[i] = prevOut[i] * rg;
+    }
+  }
+
+  CPU_APPLY_INLINE void operator()(int rowBegin, int rowEnd, int colBegin,
+                                   int colEnd) {
+    for (int b = rowBegin; b < rowEnd; ++b) {
+      real* gate = value.gateValue + (size_t)b * frameSize * 3;
+      size_t offset = (size_t)b * frameSize;
+      row(gate, gate + frameSize, value.prevOutValue + offset,
+          value.resetOutputValue + offset, colBegin, colEnd);
+    }
+  }
+
+  static void run(hl_gru_value value, int frameSize, int batchSize) {
+    AbsentRows absent;
+    size_t size = (size_t)batchSize * frameSize;
+    value.prevOutValue = absent.input(value.prevOutValue, size);
+    GruResetOutput kernel = {value, frameSize};
+    cpu_apply::applyKernel(kernel, batchSize, frameSize);
+  }
+};
+
+/// hppl::forward::gru_finalOutput
+template <int Node>
+struct GruFinalOutput {
+  hl_gru_value value;
+  int frameSize;
+
+  CPU_APPLY_INLINE static void row(const real* __restrict__ updateGate,
+                                   real* __restrict__ frameState,
+                                   const real* __restrict__ prevOut,
+                                   real* __restrict__ output, int colBegin,
+                                   int colEnd) {
+    for (int i = colBegin; i < colEnd; ++i) {
+      real fs = Active<Node>::forward(frameState[i]);
+      frameState[i] = fs;
+      output[i] = prevOut[i] - updateGate[i] * prevOut[i] + updateGate[i] * fs;
+    }
+  }
+
+  CPU_APPLY_INLINE void operator()(int rowBegin, int rowEnd, int colBegin,
+                                   int colEnd) {
+    for (int b = rowBegin; b < rowEnd; ++b) {
+      real* gate = value.gateValue + (size_t)b * frameSize * 3;
+      size_t offset = (size_t)b * frameSize;
+      row(gate, gate + frameSize * 2, value.prevOutValue + offset,
+          value.outputValue + offset, colBegin, colEnd);
+    }
+  }
+
+  static void run(hl_gru_value value, int frameSize, int batchSize) {
+    AbsentRows absent;
+    size_t size = (size_t)batchSize * frameSize;
+    value.prevOutValue = absent.input(value.prevOutValue, size);
+    GruFinalOutput kernel = {value, frameSize};
+    cpu_apply::applyKernel(kernel, batchSize, frameSize);
+  }
+};
+
+/// hppl::backward::gru_stateGrad
+template <int Node>
+struct GruStateGrad {
+  hl_gru_value value;
+  hl_gru_grad grad;
+  int frameSize;
+
+  CPU_APPLY_INLINE static void row(const real* __restrict__ updateGate,
+                                   real* __restrict__ updateGateGrad,
+                                   const real* __restrict__ frameState,
+                                   real* __restrict__ frameStateGrad,
+                                   const real* __restrict__ prevOut,
+                                   real* __restrict__ prevOutGrad,
+                                   const real* __restrict__ outputGrad,
+                                   int colBegin, int colEnd) {
+    for (int i = colBegin; i < colEnd; ++i) {
+      real og = outputGrad[i];
+      updateGateGrad[i] = og * frameState[i] - og * prevOut[i];
+      prevOutGrad[i] = prevOutGrad[i] - og * updateGate[i] + og;
+      frameStateGrad[i] =
+          Active<Node>::backward(og * updateGate[i], frameState[i]);
+    }
+  }
+
+  CPU_APPLY_INLINE void operator()(int rowBegin, int rowEnd, int colBegin,
+                                   int colEnd) {
+    for (int b = rowBegin; b < rowEnd; ++b) {
+      const real* gate = value.gateValue + (size_t)b * frameSize * 3;
+      real* gateGrad = grad.gateGrad + (size_t)b * frameSize * 3;
+      size_t offset = (size_t)b * frameSize;
+      row(gate, gateGrad, gate + frameSize * 2, gateGrad + frameSize * 2,
+          value.prevOutValue + offset, grad.prevOutGrad + offset,
+          grad.outputGrad + offset, colBegin, colEnd);
+    }
+  }
+
+  static void run(hl_gru_value value, hl_gru_grad grad, int frameSize,
+                  int batchSize) {
+    AbsentRows absent;
+    size_t size = (size_t)batchSize * frameSize;
+    value.prevOutValue = absent.input(value.prevOutValue, size);
+    grad.prevOutGrad = absent.output(grad.prevOutGrad, size);
+    GruStateGrad kernel = {value, grad, frameSize};
+    cpu_apply::applyKernel(kernel, batchSize, frameSize);
+  }
+};
+
+/// hppl::backward::gru_resetGrad
+template <int Gate>
+struct GruResetGrad {
+  hl_gru_value value;
+  hl_gru_grad grad;
+  int frameSize;
+
+  CPU_APPLY_INLINE static void row(const real* __restrict__ updateGate,
+                                   real* __restrict__ updateGateGrad,
+                                   const real* __restrict__ resetGate,
+                                   real* __restrict__ resetGateGrad,
+                                   const real* __restrict__ prevOut,
+                                   real* __restrict__ prevOutGrad,
+                                   const real* __restrict__ resetOutputGrad,
+                                   int colBegin, int colEnd) {
+    for (int i = colBegin; i < colEnd; ++i) {
+      real rog = resetOutputGrad[i];
+      prevOutGrad[i] += rog * resetGate[i];
+      updateGateGrad[i] =
+          Active<Gate>::backward(updateGateGrad[i], updateGate[i]);
+      resetGateGrad[i] =
+          Active<Gate>::backward(rog * prevOut[i], resetGate[i]);
+    }
+  }
+
+  CPU_APPLY_INLINE void operator()(int rowBegin, int rowEnd, int colBegin,
+                                   int colEnd) {
+    for (int b = rowBegin; b < rowEnd; ++b) {
+      const real* gate = value.gateValue + (size_t)b * frameSize * 3;
+      real* gateGrad = grad.gateGrad + (size_t)b * frameSize * 3;
+      size_t offset = (size_t)b * frameSize;
+      row(gate, gateGrad, gate + frameSize, gateGrad + frameSize,
+          value.prevOutValue + offset, grad.prevOutGrad + offset,
+          grad.resetOutputGrad + offset, colBegin, colEnd);
+    }
+  }
+
+  static void run(hl_gru_value value, hl_gru_grad grad, int frameSize,
+                  int batchSize) {
+    AbsentRows absent;
+    size_t size = (size_t)batchSize * frameSize;
+    /// the reset output grad is only computed with the previous output
+    if (!value.prevOutValue || !grad.prevOutGrad) {
+      grad.resetOutputGrad = absent.input(nullptr, size);
+    }
+    value.prevOutValue = absent.input(value.prevOutValue, size);
+    grad.prevOutGrad = absent.output(grad.prevOutGrad, size);
+    GruResetGrad kernel = {value, grad, frameSize};
+    cpu_apply::applyKernel(kernel, batchSize, frameSize);
+  }
+};
+
+}  // namespace cpu_rnn
+
+void cpuLstmForward(hl_lstm_value value, int frameSize, int batchSize,
+                    hl_activation_mode_t activeNode,
+                    hl_activation_mode_t activeGate,
+                    hl_activation_mode_t activeState) {
+  hl_activation_mode_t modes[] = {activeNode, activeGate, activeState};
+  cpu_rnn::ActiveDispatch<3, cpu_rnn::LstmForward>::run(modes, value,
+                                                        frameSize, batchSize);
+}
+
+void cpuLstmBackward(hl_lstm_value value, hl_lstm_grad grad, int frameSize,
+                     int batchSize, hl_activation_mode_t activeNode,
+                     hl_activation_mode_t activeGate,
+                     hl_activation_mode_t activeState) {
+  hl_activation_mode_t modes[] = {activeNode, activeGate, activeState};
+  cpu_rnn::ActiveDispatch<3, cpu_rnn::LstmBackward>::run(
+      modes, value, grad, frameSize, batchSize);
+}
+
+void cpuGruForward(hl_gru_value value, int frameSize, int batchSize,
+                   hl_activation_mode_t activeNode,
+                   hl_activation_mode_t activeGate) {
+  if (value.prevOutValue) {
+    gemm<real>(CblasNoTrans, CblasNoTrans, batchSize, frameSize * 2,
+               frameSize, 1, value.prevOutValue, frameSize, value.gateWeight,
+               frameSize * 2, 1, value.gateValue, frameSize * 3);
+  }
+
+  cpu_rnn::ActiveDispatch<1, cpu_rnn::GruResetOutput>::run(
+      &activeGate, value, frameSize, batchSize);
+
+  if (value.prevOutValue) {
+    gemm<real>(CblasNoTrans, CblasNoTrans, batchSize, frameSize, frameSize, 1,
+               value.resetOutputValue, frameSize, value.stateWeight,
+               frameSize, 1, value.gateValue + frameSize * 2, frameSize * 3);
+  }
+
+  cpu_rnn::ActiveDispatch<1, cpu_rnn::GruFinalOutput>::run(
+      &activeNode, value, frameSize, batchSize);
+}
+
+void cpuGruBackward(hl_gru_value value, hl_gru_grad grad, int frameSize,
+                    int batchSize, hl_activation_mode_t activeNode,
+                    hl_activation_mode_t activeGate) {
+  cpu_rnn::ActiveDispatch<1, cpu_rnn::GruStateGrad>::run(
+      &activeNode, value, grad, frameSize, batchSize);
+
+  if (value.prevOutValue && grad.prevOutGrad) {
+    gemm<real>(CblasNoTrans, CblasTrans, batchSize, frameSize, frameSize, 1,
+               grad.gateGrad + frameSize * 2, frameSize * 3,
+               value.stateWeight, frameSize, 0, grad.resetOutputGrad,
+               frameSize);
+
+    if (grad.stateWeightGrad) {
+      gemm<real>(CblasTrans, CblasNoTrans, frameSize, frameSize, batchSize, 1,
+                 value.resetOutputValue, frameSize,
+                 grad.gateGrad + frameSize * 2, frameSize * 3, 1,
+                 grad.stateWeightGrad, frameSize);
+    }
+  }
+
+  cpu_rnn::ActiveDispatch<1, cpu_rnn::GruResetGrad>::run(
+      &activeGate, value, grad, frameSize, batchSize);
+
+  if (grad.prevOutGrad && value.prevOutValue) {
+    gemm<real>(CblasNoTrans, CblasTrans, batchSize, frameSize, frameSize * 2,
+               1, grad.gateGrad, frameSize * 3, value.gateWeight,
+               frameSize * 2, 1, grad.prevOutGrad, frameSize);
+
+    if (grad.gateWeightGrad) {
+      gemm<real>(CblasTrans, CblasNoTrans, frameSize, frameSize * 2,
+                 batchSize, 1, value.prevOutValue, frameSize, grad.gateGrad,
+                 frameSize * 3, 1, grad.gateWeightGrad, frameSize * 2);
+    }
+  }
+}
+
+}  // namespace paddle
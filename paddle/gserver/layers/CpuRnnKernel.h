@@ -0,0 +1,59 @@
+/* Copyright (c) 2016 Baidu, Inc. All Rights Reserve.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#pragma once
+
+#include "paddle/utils/TypeDefs.h"
+#include "hl_gpu.h"
+
+namespace paddle {
+
+/**
+ * @brief Fused cpu kernels of the lstm and gru cells.
+ *
+ * The same computation as hl_cpu_lstm_forward() and the others, for the
+ * batchSize rows of one time step at once, with
+ * - the activations as template arguments, so the whole cell is inlined
+ *   into one loop, which the compiler vectorizes;
+ * - the loops compiled for sse, avx2 and avx512, see getCpuApplyIsa();
+ * - the rows, or the columns, split among the threads of the cpu apply
+ *   pool for the large batches, see cpuApplyParallel().
+ *
+ * They are used by LstmCompute and GruCompute unless
+ * --rnn_fused_cpu_kernel=false.
+ */
+
+/// the same as hl_cpu_lstm_forward() for batchSize rows
+void cpuLstmForward(hl_lstm_value value, int frameSize, int batchSize,
+                    hl_activation_mode_t activeNode,
+                    hl_activation_mode_t activeGate,
+                    hl_activation_mode_t activeState);
+
+/// the same as hl_cpu_lstm_backward() for batchSize rows
+void cpuLstmBackward(hl_lstm_value value, hl_lstm_grad grad, int frameSize,
+                     int batchSize, hl_activation_mode_t activeNode,
+                     hl_activation_mode_t activeGate,
+                     hl_activation_mode_t activeState);
+
+/// the same as hl_cpu_gru_forward()
+void cpuGruForward(hl_gru_value value, int frameSize, int batchSize,
+                   hl_activation_mode_t activeNode,
+                   hl_activation_mode_t activeGate);
+
+/// the same as hl_cpu_gru_backward()
+void cpuGruBackward(hl_gru_value value, hl_gru_grad grad, int frameSize,
+                    int batchSize, hl_activation_mode_t activeNode,
+                    hl_activation_mode_t activeGate);
+
+}  // namespace paddle
@@ -53,6 +53,10 @@ bool DataNormLayer::init(const LayerMap& layerMap,
   mean_->setData(weight_->getW()->getData() + 2 * getSize());
   stdReciprocal_->setData(weight_->getW()->getData() + 3 * getSize());
   decimalReciprocal_->setData(weight_->getW()->getData() + 4 * getSize());
+  for (auto& view : {min_, rangeReciprocal_, mean_, stdReciprocal_,
+                     decimalReciprocal_}) {
+    weight_->getParameterPtr()->registerValueView(view);
+  }
 
   /* normalization strategy */
   if (config_.data_norm_strategy() == "z-score") {
@@ -15,8 +15,12 @@ limitations under the License. */
 
 #include "paddle/utils/Logging.h"
 #include "paddle/utils/Stat.h"
+#include "paddle/utils/CommandLineParser.h"
 #include "ExpandConvLayer.h"
 
+P_DEFINE_bool(conv_winograd, false,
+              "Use winograd for the cpu forward of 3x3 stride 1 convolution");
+
 namespace paddle {
 
 REGISTER_LAYER(exconv, ExpandConvLayer);
@@ -118,6 +122,45 @@ void ExpandConvLayer::expandFwdOnce(MatrixPtr image, int inIdx, int startIdx) {
   }
 }
 
+ConvShape ExpandConvLayer::getConvShape(int inIdx) {
+  ConvShape shape;
+  shape.channels = channels_[inIdx];
+  shape.imgH = imgSizeH_[inIdx];
+  shape.imgW = imgSizeW_[inIdx];
+  shape.filterSize = filterSize_[inIdx];
+  shape.stride = stride_[inIdx];
+  shape.padding = padding_[inIdx];
+  shape.outH = outputH_[inIdx];
+  shape.outW = outputW_[inIdx];
+  shape.numFilters = numFilters_;
+  shape.groups = groups_[inIdx];
+  return shape;
+}
+
+void ExpandConvLayer::forwardCpu(int inIdx) {
+  ConvShape shape = getConvShape(inIdx);
+  MatrixPtr image = getPrev(inIdx)->getOutputValue();
+  real *wgtData = weights_[inIdx]->getW()->getData();
+  real *outData = getOutputValue()->getData();
+  if (FLAGS_conv_winograd && CpuConvEngine::canUseWinograd(shape)) {
+    cpuEngine_.forwardWinograd(shape, image->getData(), image->getHeight(),
+                               wgtData, outData);
+  } else {
+    cpuEngine_.forward(shape, image->getData(), image->getHeight(), wgtData,
+                       outData);
+  }
+}
+
+void ExpandConvLayer::backwardCpu(MatrixPtr v, int inIdx) {
+  MatrixPtr inputV = getPrev(inIdx)->getOutputValue();
+  MatrixPtr inputGrad = getPrev(inIdx)->getOutputGrad();
+  MatrixPtr weightGrad = weights_[inIdx]->getWGrad();
+  cpuEngine_.backward(getConvShape(inIdx), inputV->getData(),
+                      inputV->getHeight(), weights_[inIdx]->getW()->getData(),
+                      v->getData(), inputGrad ? inputGrad->getData() : nullptr,
+                      weightGrad ? weightGrad->getData() : nullptr);
+}
+
 void ExpandConvLayer::addSharedBias() {
   size_t mapW = getSize() / numFilters_;
   size_t mapH = getOutputValue()->getElementCnt() / mapW;
@@ -162,6 +205,11 @@ void ExpandConvLayer::forward(PassType passType) {
 
   MatrixPtr image = nullptr;
   for (size_t i = 0; i != inputLayers_.size(); ++i) {
+    if (!useGpu_) {
+      REGISTER_TIMER_INFO("forwardCpu", getName().c_str());
+      forwardCpu(i);
+      continue;
+    }
     LayerPtr prevLayer = getPrev(i);
     image = prevLayer->getOutputValue();
     for (size_t off = 0; off < image->getHeight(); off++) {
@@ -217,6 +265,14 @@ void ExpandConvLayer::backward(const UpdateCallback &callback) {
   }
 
   for (size_t i = 0; i != inputLayers_.size(); ++i) {
+    if (!useGpu_) {
+      /* Both the input layers error and the W-gradient */
+      backwardCpu(outGrad, i);
+      if (weights_[i]->getWGrad()) {
+        weights_[i]->getParameterPtr()->incUpdate(callback);
+      }
+      continue;
+    }
     /* First, calculate the input layers error */
     bpropActs(outGrad, i);
     if (weights_[i]->getWGrad()) {
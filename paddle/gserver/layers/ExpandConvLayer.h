@@ -16,6 +16,7 @@ limitations under the License. */
 #pragma once
 
 #include "ConvBaseLayer.h"
+#include "paddle/math/CpuConvEngine.h"
 #include "paddle/math/Matrix.h"
 #include <vector>
 
@@ -50,6 +51,8 @@ protected:
   MatrixPtr expandInput_;
   /// The transpose of output, which is an auxiliary matrix.
   MatrixPtr transOutValue_;
+  /// Convolves a tile of samples at a time on cpu.
+  CpuConvEngine cpuEngine_;
 
 public:
   explicit ExpandConvLayer(const LayerConfig& config) : ConvBaseLayer(config) {}
@@ -80,6 +83,17 @@ public:
    */
   void expandFwdOnce(MatrixPtr image, int inIdx, int startIdx);
 
+  /**
+   * Shape of the convolution of one input for CpuConvEngine.
+   */
+  ConvShape getConvShape(int inIdx);
+
+  /**
+   * Forward and backward of one input by CpuConvEngine.
+   */
+  void forwardCpu(int inIdx);
+  void backwardCpu(MatrixPtr v, int inIdx);
+
   /**
    * Add shared bias.
    */
@@ -64,6 +64,13 @@ void FullyConnectedLayer::prefetch() {
       MatrixPtr input = getInputValue(i);
       sparseParam->addRows(input);
     }
+    // the rows of a local sparse update, caught up with before forward
+    // by ParameterUpdater::catchUpBatchRows()
+    auto* sparseGrad = dynamic_cast<SparseAutoGrowRowCpuMatrix*>(
+        weights_[i]->getWGrad().get());
+    if (sparseGrad) {
+      sparseGrad->addRows(getInputValue(i));
+    }
   }
 }
 
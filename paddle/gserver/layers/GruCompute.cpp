@@ -15,8 +15,11 @@ limitations under the License. */
 
 #include "paddle/utils/Util.h"
 #include "GruCompute.h"
+#include "CpuRnnKernel.h"
 #include "hl_recurrent_apply.cuh"
 
+P_DECLARE_bool(rnn_fused_cpu_kernel);
+
 namespace paddle {
 
 void GruCompute::init(LayerConfig &config) {
@@ -28,6 +31,10 @@ template <>
 void GruCompute::forward<0>(hl_gru_value value,
                             int frameSize,
                             int batchSize) {
+  if (FLAGS_rnn_fused_cpu_kernel) {
+    cpuGruForward(value, frameSize, batchSize, activeNode_, activeGate_);
+    return;
+  }
   hl_cpu_gru_forward(hppl::forward::gru_resetOutput(),
                      hppl::forward::gru_finalOutput(),
                      value,
@@ -42,6 +49,11 @@ void GruCompute::backward<0>(hl_gru_value value,
                             hl_gru_grad  grad,
                             int frameSize,
                             int batchSize) {
+  if (FLAGS_rnn_fused_cpu_kernel) {
+    cpuGruBackward(value, grad, frameSize, batchSize, activeNode_,
+                   activeGate_);
+    return;
+  }
 hl_cpu_gru_backward(hppl::backward::gru_stateGrad(),
                     hppl::backward::gru_resetGrad(),
                     value,
@@ -16,6 +16,9 @@ limitations under the License. */
 #include "paddle/utils/Util.h"
 #include "hl_recurrent_apply.cuh"
 #include "LstmCompute.h"
+#include "CpuRnnKernel.h"
+
+P_DECLARE_bool(rnn_fused_cpu_kernel);
 
 namespace paddle {
 
@@ -27,6 +30,11 @@ void LstmCompute::init(LayerConfig &config) {
 
 template <>
 void LstmCompute::forwardOneSequence<0>(hl_lstm_value value, int frameSize) {
+  if (FLAGS_rnn_fused_cpu_kernel) {
+    cpuLstmForward(value, frameSize, /* batchSize= */ 1, activeNode_,
+                   activeGate_, activeState_);
+    return;
+  }
   hl_cpu_lstm_forward(hppl::forward::lstm(), value,
                       frameSize, activeNode_, activeGate_,
                       activeState_);
@@ -35,6 +43,11 @@ void LstmCompute::forwardOneSequence<0>(hl_lstm_value value, int frameSize) {
 template <>
 void LstmCompute::backwardOneSequence<0>(hl_lstm_value value, hl_lstm_grad grad,
                                         int frameSize) {
+  if (FLAGS_rnn_fused_cpu_kernel) {
+    cpuLstmBackward(value, grad, frameSize, /* batchSize= */ 1, activeNode_,
+                    activeGate_, activeState_);
+    return;
+  }
   hl_cpu_lstm_backward(hppl::backward::lstm(), value, grad,
                        frameSize, activeNode_, activeGate_,
                        activeState_);
@@ -43,6 +56,11 @@ void LstmCompute::backwardOneSequence<0>(hl_lstm_value value, hl_lstm_grad grad,
 template <>
 void LstmCompute::forwardBatch<0>(hl_lstm_value value, int frameSize,
                                  int batchSize) {
+  if (FLAGS_rnn_fused_cpu_kernel) {
+    cpuLstmForward(value, frameSize, batchSize, activeNode_, activeGate_,
+                   activeState_);
+    return;
+  }
   for (int b = 0; b < batchSize; b++) {
     forwardOneSequence<0>(value, frameSize);
 
@@ -59,6 +77,11 @@ void LstmCompute::forwardBatch<0>(hl_lstm_value value, int frameSize,
 template <>
 void LstmCompute::backwardBatch<0>(hl_lstm_value value, hl_lstm_grad grad,
                                   int frameSize, int batchSize) {
+  if (FLAGS_rnn_fused_cpu_kernel) {
+    cpuLstmBackward(value, grad, frameSize, batchSize, activeNode_,
+                    activeGate_, activeState_);
+    return;
+  }
   for (int b = 0; b < batchSize; b++) {
     backwardOneSequence<0>(value, grad, frameSize);
 
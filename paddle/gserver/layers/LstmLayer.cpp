@@ -48,6 +48,10 @@ bool LstmLayer::init(const LayerMap &layerMap,
       checkIg_->setData(bias_->getW()->getData() + getSize() * 4);
       checkFg_->setData(bias_->getW()->getData() + getSize() * 5);
       checkOg_->setData(bias_->getW()->getData() + getSize() * 6);
+      // follow the bias when the value of the parameter is swapped
+      for (auto& view : {localBias_, checkIg_, checkFg_, checkOg_}) {
+        biasParameter_->registerValueView(view);
+      }
     }
 
     if (bias_->getWGrad()) {
@@ -76,6 +76,9 @@ bool LstmStepLayer::init(const LayerMap& layerMap,
       checkIg_->setData(data);
       checkFg_->setData(data + getSize());
       checkOg_->setData(data + getSize() * 2);
+      for (auto& view : {checkIg_, checkFg_, checkOg_}) {
+        biasParameter_->registerValueView(view);
+      }
     }
 
     if (weight_->getWGrad()) {
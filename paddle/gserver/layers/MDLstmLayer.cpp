@@ -256,6 +256,9 @@ bool MDLstmLayer::init(const LayerMap& layerMap,
     checkFg_->setData(bias_->getW()->getData() + numBlocks_ * (4 + numDims_));
     checkOg_->setData(bias_->getW()->getData() +
                       numBlocks_ * (4 + 2 * numDims_));
+    for (auto& view : {localBias_, checkIg_, checkFg_, checkOg_}) {
+      biasParameter_->registerValueView(view);
+    }
 
     if (bias_->getWGrad()) {
       localBiasGrad_->setData(bias_->getWGrad()->getData());
@@ -74,6 +74,9 @@ void RecurrentLayerGroup::initSubNetwork(
         PARAMETER_VALUE,
         rootNetwork->getParameters()[paramId]->getBuf(PARAMETER_VALUE),
         rootNetwork->getParameters()[paramId]->getMat(PARAMETER_VALUE));
+    para->shareBufferViews(PARAMETER_VALUE,
+                           rootNetwork->getParameters()[paramId].get(),
+                           PARAMETER_VALUE);
     para->enableSharedType(
         PARAMETER_GRADIENT,
         rootNetwork->getParameters()[paramId]->getBuf(PARAMETER_GRADIENT),
@@ -18,6 +18,7 @@ limitations under the License. */
 #include "SequenceToBatch.h"
 #include <iostream>
 #include <string.h>
+#include "paddle/math/CpuApply.h"
 
 namespace paddle {
 
@@ -164,15 +165,17 @@ void SequenceToBatch::sequence2BatchCopy(Matrix &batch, Matrix &sequence,
     hl_sequence2batch_copy(batchData, seqData, idxData, seqWidth,
                            batchCount, seq2batch);
   } else {
-    for (int i = 0; i < batchCount; ++i) {
-      if (seq2batch) {
-        memcpy(batch.rowBuf(i), sequence.rowBuf(idxData[i]),
-               seqWidth * sizeof(real));
-      } else {
-        memcpy(sequence.rowBuf(idxData[i]), batch.rowBuf(i),
-               seqWidth * sizeof(real));
+    cpuApplyParallel(batchCount, seqWidth, 1, [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; ++i) {
+        if (seq2batch) {
+          memcpy(batch.rowBuf(i), sequence.rowBuf(idxData[i]),
+                 seqWidth * sizeof(real));
+        } else {
+          memcpy(sequence.rowBuf(idxData[i]), batch.rowBuf(i),
+                 seqWidth * sizeof(real));
+        }
       }
-    }
+    });
   }
 }
 
@@ -188,13 +191,17 @@ void SequenceToBatch::sequence2BatchAdd(Matrix &batch, Matrix &sequence,
     hl_sequence2batch_add(batchData, seqData, idxData, seqWidth,
                           batchCount, seq2batch);
   } else {
-    for (int i = 0; i < batchCount; ++i) {
-      if (seq2batch) {
-        batch.subMatrix(i, 1)->add(*sequence.subMatrix(idxData[i], 1));
-      } else {
-        sequence.subMatrix(idxData[i], 1)->add(*batch.subMatrix(i, 1));
+    cpuApplyParallel(batchCount, seqWidth, 1, [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; ++i) {
+        real *batchRow = batch.rowBuf(i);
+        real *seqRow = sequence.rowBuf(idxData[i]);
+        real *dst = seq2batch ? batchRow : seqRow;
+        real *src = seq2batch ? seqRow : batchRow;
+        for (int j = 0; j < seqWidth; ++j) {
+          dst[j] += src[j];
+        }
       }
-    }
+    });
   }
 }
 
@@ -33,6 +33,12 @@ void TableProjection::prefetch(const Argument* in) {
   if (sparseParam) {
     sparseParam->addRows(in->ids);
   }
+  // the rows of a local sparse update, caught up with before forward
+  auto* sparseGrad =
+      dynamic_cast<SparseAutoGrowRowCpuMatrix*>(table_->getWGrad().get());
+  if (sparseGrad) {
+    sparseGrad->addRows(in->ids);
+  }
 }
 
 void TableProjection::forward() {
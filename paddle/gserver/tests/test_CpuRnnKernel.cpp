@@ -0,0 +1,467 @@
+/* Copyright (c) 2016 Baidu, Inc. All Rights Reserve.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include <gtest/gtest.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <cmath>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "hl_recurrent_apply.cuh"
+#include "paddle/gserver/layers/CpuRnnKernel.h"
+#include "paddle/math/MathFunctions.h"
+#include "paddle/utils/Util.h"
+
+P_DECLARE_string(cpu_apply_isa);
+P_DECLARE_int32(cpu_apply_threads);
+P_DECLARE_int32(cpu_apply_parallel_size);
+
+using namespace paddle;  // NOLINT
+
+/// aligned as the matrices, for the avx kernels of hl_cpu_lstm_forward()
+typedef std::vector<real, AlignedAllocator<real, 32>> Buffer;
+
+static const hl_activation_mode_t kModes[] = {
+    HL_ACTIVATION_SIGMOID, HL_ACTIVATION_RELU, HL_ACTIVATION_TANH,
+    HL_ACTIVATION_LINEAR};
+
+static void randData(Buffer* data, size_t size) {
+  data->resize(size);
+  for (auto& x : *data) {
+    x = 2.0 * rand() / RAND_MAX - 1.0;  // NOLINT
+  }
+}
+
+static void checkEqual(const Buffer& expected, const Buffer& actual) {
+  ASSERT_EQ(expected.size(), actual.size());
+  for (size_t i = 0; i < expected.size(); ++i) {
+    ASSERT_NEAR(expected[i], actual[i], 1e-4 * (1 + std::fabs(expected[i])))
+        << "at " << i;
+  }
+}
+
+static real* dataOrNull(Buffer& data) {
+  return data.empty() ? nullptr : data.data();
+}
+
+/// the buffers of hl_lstm_value and hl_lstm_grad for batchSize rows
+struct LstmBuffers {
+  Buffer gate, prevState, state, stateActive, output;
+  Buffer checkIg, checkFg, checkOg;
+  Buffer gateGrad, prevStateGrad, stateGrad, stateActiveGrad;
+  Buffer outputGrad, checkIgGrad, checkFgGrad, checkOgGrad;
+
+  LstmBuffers(int frameSize, int batchSize, bool hasPrev) {
+    size_t size = (size_t)frameSize * batchSize;
+    randData(&gate, size * 4);
+    if (hasPrev) {
+      randData(&prevState, size);
+      randData(&prevStateGrad, size);
+    }
+    randData(&state, size);
+    randData(&stateActive, size);
+    randData(&output, size);
+    randData(&checkIg, frameSize);
+    randData(&checkFg, frameSize);
+    randData(&checkOg, frameSize);
+    randData(&gateGrad, size * 4);
+    randData(&stateGrad, size);
+    randData(&stateActiveGrad, size);
+    randData(&outputGrad, size);
+    randData(&checkIgGrad, frameSize);
+    randData(&checkFgGrad, frameSize);
+    randData(&checkOgGrad, frameSize);
+  }
+
+  hl_lstm_value value() {
+    hl_lstm_value value;
+    value.gateValue = gate.data();
+    value.prevStateValue = dataOrNull(prevState);
+    value.stateValue = state.data();
+    value.stateActiveValue = stateActive.data();
+    value.outputValue = output.data();
+    value.checkIg = checkIg.data();
+    value.checkFg = checkFg.data();
+    value.checkOg = checkOg.data();
+    return value;
+  }
+
+  hl_lstm_grad grad() {
+    hl_lstm_grad grad;
+    grad.gateGrad = gateGrad.data();
+    grad.prevStateGrad = dataOrNull(prevStateGrad);
+    grad.stateGrad = stateGrad.data();
+    grad.stateActiveGrad = stateActiveGrad.data();
+    grad.outputGrad = outputGrad.data();
+    grad.checkIgGrad = checkIgGrad.data();
+    grad.checkFgGrad = checkFgGrad.data();
+    grad.checkOgGrad = checkOgGrad.data();
+    return grad;
+  }
+
+  void checkEqualTo(const LstmBuffers& other) const {
+    for (auto member : {&LstmBuffers::gate, &LstmBuffers::prevState,
+                        &LstmBuffers::state, &LstmBuffers::stateActive,
+                        &LstmBuffers::output, &LstmBuffers::gateGrad,
+                        &LstmBuffers::prevStateGrad, &LstmBuffers::stateGrad,
+                        &LstmBuffers::checkIgGrad, &LstmBuffers::checkFgGrad,
+                        &LstmBuffers::checkOgGrad}) {
+      checkEqual(this->*member, other.*member);
+    }
+  }
+};
+
+/// the rows of the batch one by one, as LstmCompute::forwardBatch<0>
+static void legacyLstmForward(hl_lstm_value value, int frameSize,
+                              int batchSize, const hl_activation_mode_t* m) {
+  for (int b = 0; b < batchSize; b++) {
+    hl_cpu_lstm_forward(hppl::forward::lstm(), value, frameSize, m[0], m[1],
+                        m[2]);
+    value.gateValue += frameSize * 4;
+    value.stateValue += frameSize;
+    value.stateActiveValue += frameSize;
+    value.outputValue += frameSize;
+    if (value.prevStateValue) {
+      value.prevStateValue += frameSize;
+    }
+  }
+}
+
+static void legacyLstmBackward(hl_lstm_value value, hl_lstm_grad grad,
+                               int frameSize, int batchSize,
+                               const hl_activation_mode_t* m) {
+  for (int b = 0; b < batchSize; b++) {
+    hl_cpu_lstm_backward(hppl::backward::lstm(), value, grad, frameSize, m[0],
+                         m[1], m[2]);
+    value.gateValue += frameSize * 4;
+    value.stateValue += frameSize;
+    value.stateActiveValue += frameSize;
+    value.outputValue += frameSize;
+    if (value.prevStateValue) {
+      value.prevStateValue += frameSize;
+    }
+    grad.gateGrad += frameSize * 4;
+    grad.stateGrad += frameSize;
+    grad.stateActiveGrad += frameSize;
+    grad.outputGrad += frameSize;
+    if (grad.prevStateGrad) {
+      grad.prevStateGrad += frameSize;
+    }
+  }
+}
+
+static void testLstm(int frameSize, int batchSize, bool hasPrev,
+                     const hl_activation_mode_t* m) {
+  LstmBuffers expected(frameSize, batchSize, hasPrev);
+  LstmBuffers actual = expected;
+
+  legacyLstmForward(expected.value(), frameSize, batchSize, m);
+  cpuLstmForward(actual.value(), frameSize, batchSize, m[0], m[1], m[2]);
+  expected.checkEqualTo(actual);
+
+  legacyLstmBackward(expected.value(), expected.grad(), frameSize, batchSize,
+                     m);
+  cpuLstmBackward(actual.value(), actual.grad(), frameSize, batchSize, m[0],
+                  m[1], m[2]);
+  expected.checkEqualTo(actual);
+}
+
+/// the buffers of hl_gru_value and hl_gru_grad for batchSize rows
+struct GruBuffers {
+  Buffer gateWeight, stateWeight, gate, resetOutput, output;
+  Buffer prevOut;
+  Buffer gateWeightGrad, stateWeightGrad, gateGrad;
+  Buffer resetOutputGrad, outputGrad, prevOutGrad;
+
+  GruBuffers(int frameSize, int batchSize, bool hasPrev) {
+    size_t size = (size_t)frameSize * batchSize;
+    randData(&gateWeight, (size_t)frameSize * frameSize * 2);
+    randData(&stateWeight, (size_t)frameSize * frameSize);
+    randData(&gate, size * 3);
+    randData(&resetOutput, size);
+    randData(&output, size);
+    if (hasPrev) {
+      randData(&prevOut, size);
+      randData(&prevOutGrad, size);
+    }
+    randData(&gateWeightGrad, (size_t)frameSize * frameSize * 2);
+    randData(&stateWeightGrad, (size_t)frameSize * frameSize);
+    randData(&gateGrad, size * 3);
+    randData(&resetOutputGrad, size);
+    randData(&outputGrad, size);
+  }
+
+  hl_gru_value value() {
+    hl_gru_value value;
+    value.gateWeight = gateWeight.data();
+    value.stateWeight = stateWeight.data();
+    value.gateValue = gate.data();
+    value.resetOutputValue = resetOutput.data();
+    value.outputValue = output.data();
+    value.prevOutValue = dataOrNull(prevOut);
+    return value;
+  }
+
+  hl_gru_grad grad() {
+    hl_gru_grad grad;
+    grad.gateWeightGrad = gateWeightGrad.data();
+    grad.stateWeightGrad = stateWeightGrad.data();
+    grad.gateGrad = gateGrad.data();
+    grad.resetOutputGrad = resetOutputGrad.data();
+    grad.outputGrad = outputGrad.data();
+    grad.prevOutGrad = dataOrNull(prevOutGrad);
+    return grad;
+  }
+
+  /// the reset output grad is only defined with the previous output
+  void checkEqualTo(const GruBuffers& other) const {
+    for (auto member : {&GruBuffers::gate, &GruBuffers::output,
+                        &GruBuffers::gateWeightGrad,
+                        &GruBuffers::stateWeightGrad, &GruBuffers::gateGrad,
+                        &GruBuffers::prevOutGrad}) {
+      checkEqual(this->*member, other.*member);
+    }
+    if (!prevOut.empty()) {
+      checkEqual(resetOutput, other.resetOutput);
+      checkEqual(resetOutputGrad, other.resetOutputGrad);
+    }
+  }
+};
+
+static void testGru(int frameSize, int batchSize, bool hasPrev,
+                    const hl_activation_mode_t* m) {
+  GruBuffers expected(frameSize, batchSize, hasPrev);
+  GruBuffers actual = expected;
+
+  hl_cpu_gru_forward(hppl::forward::gru_resetOutput(),
+                     hppl::forward::gru_finalOutput(), expected.value(),
+                     frameSize, batchSize, m[0], m[1]);
+  cpuGruForward(actual.value(), frameSize, batchSize, m[0], m[1]);
+  expected.checkEqualTo(actual);
+
+  hl_cpu_gru_backward(hppl::backward::gru_stateGrad(),
+                      hppl::backward::gru_resetGrad(), expected.value(),
+                      expected.grad(), frameSize, batchSize, m[0], m[1]);
+  cpuGruBackward(actual.value(), actual.grad(), frameSize, batchSize, m[0],
+                 m[1]);
+  expected.checkEqualTo(actual);
+}
+
+/// all the activations, frame sizes of and not of the vector width
+static void testAllShapes() {
+  for (auto frameSize : {1, 13, 32}) {
+    for (auto batchSize : {1, 7}) {
+      for (auto hasPrev : {false, true}) {
+        VLOG(3) << " frameSize=" << frameSize << " batchSize=" << batchSize
+                << " hasPrev=" << hasPrev;
+        for (auto node : kModes) {
+          for (auto gate : kModes) {
+            for (auto state : kModes) {
+              hl_activation_mode_t m[] = {node, gate, state};
+              testLstm(frameSize, batchSize, hasPrev, m);
+            }
+            hl_activation_mode_t m[] = {node, gate};
+            testGru(frameSize, batchSize, hasPrev, m);
+          }
+        }
+      }
+    }
+  }
+}
+
+TEST(CpuRnnKernel, serial) {
+  for (auto isa : {"sse", "avx2", "avx512", "auto"}) {
+    FLAGS_cpu_apply_isa = isa;
+    testAllShapes();
+  }
+  FLAGS_cpu_apply_isa = "auto";
+}
+
+TEST(CpuRnnKernel, parallel) {
+  int threads = FLAGS_cpu_apply_threads;
+  int parallelSize = FLAGS_cpu_apply_parallel_size;
+  FLAGS_cpu_apply_parallel_size = 1;
+  for (auto numThreads : {2, 3, 4}) {
+    FLAGS_cpu_apply_threads = numThreads;
+    testAllShapes();
+  }
+  FLAGS_cpu_apply_threads = threads;
+  FLAGS_cpu_apply_parallel_size = parallelSize;
+}
+
+static double timeIt(const std::function<void()>& func, int times) {
+  struct timeval begin, end;
+  func();
+  gettimeofday(&begin, nullptr);
+  for (int i = 0; i < times; ++i) {
+    func();
+  }
+  gettimeofday(&end, nullptr);
+  return ((end.tv_sec - begin.tv_sec) + (end.tv_usec - begin.tv_usec) * 1e-6) /
+         times;
+}
+
+/**
+ * tokens/s of the lstm and gru forward, numSeqs sequences of seqLength
+ * frames, as run by the layers:
+ * - sequence: the sequences one by one with the legacy kernels, as
+ *   forwardSequence() of the layers;
+ * - batch: one recurrent gemm and the legacy kernels of the rows for each
+ *   step of the batch, as forwardBatch();
+ * - batch fused: forwardBatch() with the fused kernels.
+ */
+TEST(CpuRnnKernel, benchmark) {
+  const int frameSize = 256;
+  const int numSeqs = 32;
+  const int seqLength = 50;
+  const int times = 3;
+  const hl_activation_mode_t sigmoid = HL_ACTIVATION_SIGMOID;
+  const hl_activation_mode_t tanh = HL_ACTIVATION_TANH;
+  const hl_activation_mode_t lstmModes[] = {tanh, sigmoid, tanh};
+
+  /// the frames of step t of all the sequences are the rows of a batch
+  Buffer weight, gate, state, stateActive, output, check;
+  size_t frames = (size_t)numSeqs * seqLength;
+  randData(&weight, (size_t)frameSize * frameSize * 4);
+  for (auto& w : weight) {
+    w *= 0.05;
+  }
+  randData(&gate, frames * frameSize * 4);
+  randData(&state, frames * frameSize);
+  randData(&stateActive, frames * frameSize);
+  randData(&output, frames * frameSize);
+  randData(&check, frameSize * 3);
+
+  /// the lstm value of the rows from sequence seq at step t
+  auto lstmValue = [&](int t, int seq) {
+    size_t offset = ((size_t)t * numSeqs + seq) * frameSize;
+    hl_lstm_value value;
+    value.gateValue = gate.data() + offset * 4;
+    value.prevStateValue =
+        t ? state.data() + offset - (size_t)numSeqs * frameSize : nullptr;
+    value.stateValue = state.data() + offset;
+    value.stateActiveValue = stateActive.data() + offset;
+    value.outputValue = output.data() + offset;
+    value.checkIg = check.data();
+    value.checkFg = check.data() + frameSize;
+    value.checkOg = check.data() + frameSize * 2;
+    return value;
+  };
+
+  auto lstmGemm = [&](int t, int seq, int numRows) {
+    if (t == 0) return;
+    size_t offset = ((size_t)t * numSeqs + seq) * frameSize;
+    gemm<real>(CblasNoTrans, CblasNoTrans, numRows, frameSize * 4, frameSize,
+               1, output.data() + offset - (size_t)numSeqs * frameSize,
+               frameSize, weight.data(), frameSize * 4, 1,
+               gate.data() + offset * 4, frameSize * 4);
+  };
+
+  auto bench = [&](const std::string& name,
+                   const std::function<void()>& func) {
+    double seconds = timeIt(func, times);
+    LOG(INFO) << name << ": " << frames / seconds << " tokens/s";
+  };
+
+  auto benchLstm = [&]() {
+    bench("lstm sequence", [&]() {
+      for (int seq = 0; seq < numSeqs; ++seq) {
+        for (int t = 0; t < seqLength; ++t) {
+          lstmGemm(t, seq, 1);
+          legacyLstmForward(lstmValue(t, seq), frameSize, 1, lstmModes);
+        }
+      }
+    });
+    bench("lstm batch", [&]() {
+      for (int t = 0; t < seqLength; ++t) {
+        lstmGemm(t, 0, numSeqs);
+        legacyLstmForward(lstmValue(t, 0), frameSize, numSeqs, lstmModes);
+      }
+    });
+    bench("lstm batch fused", [&]() {
+      for (int t = 0; t < seqLength; ++t) {
+        lstmGemm(t, 0, numSeqs);
+        cpuLstmForward(lstmValue(t, 0), frameSize, numSeqs, tanh, sigmoid,
+                       tanh);
+      }
+    });
+  };
+
+  GruBuffers gru(frameSize, numSeqs, true);
+  Buffer gruGate;
+  randData(&gruGate, frames * frameSize * 3);
+  for (auto* w : {&gru.gateWeight, &gru.stateWeight}) {
+    for (auto& x : *w) {
+      x *= 0.05;
+    }
+  }
+
+  /// the gru value of the rows from sequence seq at step t
+  auto gruValue = [&](int t, int seq) {
+    size_t offset = ((size_t)t * numSeqs + seq) * frameSize;
+    hl_gru_value value;
+    value.gateWeight = gru.gateWeight.data();
+    value.stateWeight = gru.stateWeight.data();
+    value.gateValue = gruGate.data() + offset * 3;
+    value.resetOutputValue = state.data() + offset;
+    value.outputValue = output.data() + offset;
+    value.prevOutValue =
+        t ? output.data() + offset - (size_t)numSeqs * frameSize : nullptr;
+    return value;
+  };
+
+  auto benchGru = [&]() {
+    bench("gru sequence", [&]() {
+      for (int seq = 0; seq < numSeqs; ++seq) {
+        for (int t = 0; t < seqLength; ++t) {
+          hl_cpu_gru_forward(hppl::forward::gru_resetOutput(),
+                             hppl::forward::gru_finalOutput(),
+                             gruValue(t, seq), frameSize, 1, tanh, sigmoid);
+        }
+      }
+    });
+    bench("gru batch", [&]() {
+      for (int t = 0; t < seqLength; ++t) {
+        hl_cpu_gru_forward(hppl::forward::gru_resetOutput(),
+                           hppl::forward::gru_finalOutput(), gruValue(t, 0),
+                           frameSize, numSeqs, tanh, sigmoid);
+      }
+    });
+    bench("gru batch fused", [&]() {
+      for (int t = 0; t < seqLength; ++t) {
+        cpuGruForward(gruValue(t, 0), frameSize, numSeqs, tanh, sigmoid);
+      }
+    });
+  };
+
+  int threads = FLAGS_cpu_apply_threads;
+  FLAGS_cpu_apply_threads = 1;
+  LOG(INFO) << "one thread:";
+  benchLstm();
+  benchGru();
+  FLAGS_cpu_apply_threads = threads;
+  LOG(INFO) << "all threads:";
+  benchLstm();
+  benchGru();
+}
+
+int main(int argc, char** argv) {
+  paddle::initMain(argc, argv);
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -224,6 +224,93 @@ TEST(Evaluator, ctc_error_evaluator) {
   testEvaluatorAll(config, "ctc_error_evaluator", 100);
 }
 
+/// AUC of all the (positive, negative) pairs, ties count a half
+static double pairwiseAuc(const std::vector<real>& scores,
+                          const std::vector<bool>& labels) {
+  double correct = 0;
+  double pairs = 0;
+  for (size_t i = 0; i < scores.size(); ++i) {
+    if (!labels[i]) continue;
+    for (size_t j = 0; j < scores.size(); ++j) {
+      if (labels[j]) continue;
+      correct += scores[i] > scores[j] ? 1 : scores[i] == scores[j] ? 0.5 : 0;
+      pairs += 1;
+    }
+  }
+  return correct / pairs;
+}
+
+TEST(AucSketch, exact) {
+  std::vector<real> scores;
+  std::vector<bool> labels;
+  AucSketch sketch(/* maxBins= */ 1 << 16);
+  for (int i = 0; i < 2000; ++i) {
+    /// a few distinct scores with ties
+    scores.push_back((rand() % 100) / 100.0f);  // NOLINT
+    labels.push_back(rand() % 3 < scores.back() * 3);  // NOLINT
+    sketch.add(scores.back(), labels.back(), 1.0);
+  }
+  EXPECT_EQ(0, sketch.getShift());
+  EXPECT_LE(sketch.getNumBins(), 100UL);
+  EXPECT_NEAR(pairwiseAuc(scores, labels), sketch.calcAuc(), 1e-9);
+}
+
+TEST(AucSketch, shrink) {
+  std::vector<real> scores;
+  std::vector<bool> labels;
+  const size_t maxBins = 64;
+  AucSketch sketch(maxBins);
+  for (int i = 0; i < 2000; ++i) {
+    scores.push_back(rand() / (RAND_MAX + 1.0f));  // NOLINT
+    labels.push_back(rand() % 3 < scores.back() * 3);  // NOLINT
+    sketch.add(scores.back(), labels.back(), 1.0);
+  }
+  EXPECT_LE(sketch.getNumBins(), maxBins);
+  EXPECT_GT(sketch.getShift(), 0);
+
+  /// the error is at most the ties within a bin
+  double binWidth = 1.0 / (1 << (AucSketch::kMaxBits - sketch.getShift()));
+  std::vector<real> binned;
+  for (real score : scores) {
+    binned.push_back(std::floor(score / binWidth));
+  }
+  double exact = pairwiseAuc(scores, labels);
+  EXPECT_NEAR(pairwiseAuc(binned, labels), sketch.calcAuc(), 1e-6);
+  EXPECT_NEAR(exact, sketch.calcAuc(), 0.02);
+}
+
+TEST(AucSketch, merge) {
+  AucSketch all(/* maxBins= */ 256);
+  AucSketch fine(/* maxBins= */ 256);
+  AucSketch coarse(/* maxBins= */ 16);
+  for (int i = 0; i < 1000; ++i) {
+    real score = rand() / (RAND_MAX + 1.0f);  // NOLINT
+    bool label = rand() % 2;  // NOLINT
+    all.add(score, label, 1.0);
+    fine.add(score, label, 1.0);
+  }
+  for (int i = 0; i < 1000; ++i) {
+    real score = rand() / (RAND_MAX + 1.0f);  // NOLINT
+    bool label = rand() % 4 == 0;  // NOLINT
+    all.add(score, label, 2.0);
+    coarse.add(score, label, 2.0);
+  }
+  fine.merge(coarse);
+  EXPECT_EQ(coarse.getShift(), fine.getShift());
+  EXPECT_NEAR(all.calcAuc(), fine.calcAuc(), 0.02);
+
+  /// the same bins as distributeEval() reduces
+  int bits = all.getDenseBits();
+  EXPECT_EQ(8, bits);
+  std::vector<double> pos(1 << bits);
+  std::vector<double> neg(1 << bits);
+  all.toDense(bits, pos.data(), neg.data());
+  AucSketch dense(/* maxBins= */ 256);
+  dense.fromDense(bits, pos.data(), neg.data());
+  EXPECT_EQ(all.getShift(), dense.getShift());
+  EXPECT_NEAR(all.calcAuc(), dense.calcAuc(), 1e-9);
+}
+
 int main(int argc, char** argv) {
   initMain(argc, argv);
   FLAGS_thread_local_rand_use_global_seed = true;
@@ -21,6 +21,7 @@ limitations under the License. */
 #include "hl_matrix_apply.cuh"
 #include "SIMDFunctions.h"
 #include "MathFunctions.h"
+#include "CpuApply.h"
 
 namespace paddle {
 
@@ -51,7 +52,7 @@ int BaseMatrixT<T>::applyUnary(Op op, int numRows, int numCols,
   if (true == useGpu_) {
     hl_gpu_apply_unary_op(op, A, dimM, dimN, lda);
   } else {
-    hl_cpu_apply_unary_op(op, A, dimM, dimN, lda);
+    cpuApplyUnary(op, A, dimM, dimN, lda);
   }
   return 0;
 }
@@ -108,7 +109,7 @@ int BaseMatrixT<T>::applyBinary(Op op, BaseMatrixT& b, int numRows, int numCols,
     hl_gpu_apply_binary_op<T, Op, bAsRowVector::value, bAsColVector::value>(
         op, A, B, dimM, dimN, lda, ldb);
   } else {
-    hl_cpu_apply_binary_op<T, Op, bAsRowVector::value, bAsColVector::value>(
+    cpuApplyBinary<T, Op, bAsRowVector::value, bAsColVector::value>(
         op, A, B, dimM, dimN, lda, ldb);
   }
 
@@ -184,7 +185,7 @@ int BaseMatrixT<T>::applyTernary(Op op, BaseMatrixT& b, BaseMatrixT& c,
       <T, Op, cAsRowVector::value, cAsColVector::value>(
         op, A, B, C, dimM, dimN, lda, ldb, ldc);
   } else {
-    hl_cpu_apply_ternary_op
+    cpuApplyTernary
       <T, Op, cAsRowVector::value, cAsColVector::value>(
         op, A, B, C, dimM, dimN, lda, ldb, ldc);
   }
@@ -253,8 +254,8 @@ int BaseMatrixT<T>::applyQuaternary(Op op, BaseMatrixT& b, BaseMatrixT& c,
     hl_gpu_apply_quaternary_op(op, A, B, C, D, dimM, dimN, lda, ldb,
                                ldc, ldd);
   } else {
-    hl_cpu_apply_quaternary_op(op, A, B, C, D, dimM, dimN, lda, ldb,
-                               ldc, ldd);
+    cpuApplyQuaternary(op, A, B, C, D, dimM, dimN, lda, ldb,
+                       ldc, ldd);
   }
 
   return 0;
@@ -774,6 +775,14 @@ void BaseMatrixT<T>::addScalar(BaseMatrixT& b, T p) {
   applyBinary(binary::AddScalar<T>(p), b);
 }
 
+template<>
+void BaseMatrixT<real>::invSqrtAdd(BaseMatrixT& b, real p) {
+  applyBinary(fused::chain(binary::AddScalar<real>(p),
+                           fused::first(unary::Sqrt<real>()),
+                           fused::first(unary::Reciprocal<real>())),
+              b);
+}
+
 DEFINE_MATRIX_BINARY_PARAMETER_OP(SubScalar, ONE_PARAMETER, a = b - p);
 template<class T>
 void BaseMatrixT<T>::subScalar(BaseMatrixT& b, T p) {
@@ -875,6 +884,25 @@ void BaseMatrixT<T>::sub(BaseMatrixT& b, T p1, BaseMatrixT& c, T p2) {
   applyTernary(ternary::Sub1<T>(p1, p2), b, c);
 }
 
+template<>
+void BaseMatrixT<real>::invSqrtSum(BaseMatrixT& b, BaseMatrixT& c, real p) {
+  applyTernary(fused::chain(ternary::Add<real>(),
+                            fused::first(unary::Add<real>(p)),
+                            fused::first(unary::Sqrt<real>()),
+                            fused::first(unary::Reciprocal<real>())),
+               b, c);
+}
+
+DEFINE_MATRIX_TERNARY_OP(SubSquare, a = b - c * c);
+template<>
+void BaseMatrixT<real>::invSqrtVar(BaseMatrixT& b, BaseMatrixT& c, real p) {
+  applyTernary(fused::chain(ternary::SubSquare<real>(),
+                            fused::first(unary::Add<real>(p)),
+                            fused::first(unary::Sqrt<real>()),
+                            fused::first(unary::Reciprocal<real>())),
+               b, c);
+}
+
 DEFINE_MATRIX_TERNARY_OP(Add2, a = a + b + c);
 template<class T>
 void BaseMatrixT<T>::add2(BaseMatrixT& b, BaseMatrixT& c) {
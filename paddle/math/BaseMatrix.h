@@ -588,6 +588,14 @@ public:
    */
   void invSqrt(BaseMatrixT& b);
 
+  /**
+   * @code
+   * this = 1.0f / sqrt(b + p)
+   * @endcode
+   * in one pass.
+   */
+  void invSqrtAdd(BaseMatrixT& b, T p);
+
   /// this = (b == value)
   void isEqualTo(BaseMatrixT& b, T value);
 
@@ -623,6 +631,20 @@ public:
    * @endcode
    */
   void sub(BaseMatrixT& b, T p1, BaseMatrixT& c, T p2);
+  /**
+   * @code
+   * this = 1.0f / sqrt(b + c + p)
+   * @endcode
+   * in one pass.
+   */
+  void invSqrtSum(BaseMatrixT& b, BaseMatrixT& c, T p);
+  /**
+   * @code
+   * this = 1.0f / sqrt(b - c*c + p)
+   * @endcode
+   * in one pass.
+   */
+  void invSqrtVar(BaseMatrixT& b, BaseMatrixT& c, T p);
 
   /**
    * @code
@@ -0,0 +1,119 @@
+/* Copyright (c) 2016 Baidu, Inc. All Rights Reserve.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include "CpuApply.h"
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "paddle/utils/Logging.h"
+#include "paddle/utils/Thread.h"
+#include "paddle/utils/Util.h"
+
+P_DEFINE_string(cpu_apply_isa, "auto",
+                "Instruction set of the cpu element wise matrix operators: "
+                "auto, sse, avx2 or avx512. auto is the best of the cpu");
+P_DEFINE_int32(cpu_apply_threads, 1,
+               "Threads of the cpu element wise matrix operators, "
+               "0 for one per cpu core. The pool is shared by the "
+               "process, one thread by default");
+P_DEFINE_int32(cpu_apply_parallel_size, 1 << 18,
+               "Cpu element wise matrix operators of at least this many "
+               "elements are split among the cpu_apply_threads");
+
+namespace paddle {
+
+static CpuApplyIsa detectCpuIsa() {
+#ifdef PADDLE_CPU_APPLY_MULTI_ISA
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) {
+    return CPU_APPLY_AVX512;
+  }
+  if (__builtin_cpu_supports("avx2")) {
+    return CPU_APPLY_AVX2;
+  }
+#endif
+  return CPU_APPLY_SSE;
+}
+
+CpuApplyIsa getCpuApplyIsa() {
+  static CpuApplyIsa cpuIsa = detectCpuIsa();
+  const std::string& isa = FLAGS_cpu_apply_isa;
+  if (isa == "auto") {
+    return cpuIsa;
+  } else if (isa == "sse") {
+    return CPU_APPLY_SSE;
+  } else if (isa == "avx2") {
+    return std::min(cpuIsa, CPU_APPLY_AVX2);
+  } else if (isa == "avx512") {
+    return std::min(cpuIsa, CPU_APPLY_AVX512);
+  }
+  LOG(FATAL) << "Unknown cpu_apply_isa: " << isa;
+  return CPU_APPLY_SSE;
+}
+
+size_t getCpuApplyThreads() {
+  if (FLAGS_cpu_apply_threads > 0) {
+    return FLAGS_cpu_apply_threads;
+  }
+  return std::max(std::thread::hardware_concurrency(), 1U);
+}
+
+bool cpuApplyIsParallel(size_t size) {
+  return size >= (size_t)FLAGS_cpu_apply_parallel_size &&
+         getCpuApplyThreads() > 1;
+}
+
+/// guards the pool, which runs one operator at a time
+static std::mutex poolMutex;
+
+/// the pool for the caller and numThreads - 1 workers
+static SyncThreadPool* getPool(size_t numThreads) {
+  static std::unique_ptr<SyncThreadPool> pool;
+  if (!pool || pool->getNumThreads() != numThreads - 1) {
+    pool.reset(new SyncThreadPool(numThreads - 1, /* checkOwner= */ false));
+  }
+  return pool.get();
+}
+
+void cpuApplyParallel(size_t numItems, size_t itemSize, size_t grain,
+                      const std::function<void(size_t, size_t)>& job) {
+  size_t numThreads = getCpuApplyThreads();
+  if (numThreads <= 1 || numItems * itemSize <
+                             (size_t)FLAGS_cpu_apply_parallel_size) {
+    job(0, numItems);
+    return;
+  }
+  std::unique_lock<std::mutex> lock(poolMutex, std::try_to_lock);
+  if (!lock.owns_lock()) {
+    /// another trainer thread is using the pool
+    job(0, numItems);
+    return;
+  }
+
+  size_t chunk = (numItems + numThreads - 1) / numThreads;
+  chunk = (chunk + grain - 1) / grain * grain;
+  getPool(numThreads)->execPlusOwner([&](int tid, size_t numWorkers) {
+    (void)numWorkers;
+    size_t begin = std::min(tid * chunk, numItems);
+    size_t end = std::min(begin + chunk, numItems);
+    if (begin < end) {
+      job(begin, end);
+    }
+  });
+}
+
+}  // namespace paddle
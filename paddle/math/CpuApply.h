@@ -0,0 +1,319 @@
+/* Copyright (c) 2016 Baidu, Inc. All Rights Reserve.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#pragma once
+
+#include <limits.h>
+#include <stddef.h>
+#include <functional>
+
+/**
+ * @file CpuApply.h
+ * @brief cpu engine of the element wise operators of BaseMatrix.
+ *
+ * The same operators as hl_cpu_apply_unary_op() and the others, with
+ * - the rows of contiguous operands merged into one loop, which the compiler
+ *   vectorizes;
+ * - the loops compiled for sse, avx2 and avx512, picked at runtime by the
+ *   cpu, see getCpuApplyIsa();
+ * - large operators split into chunks run by a shared thread pool, see
+ *   cpuApplyParallel().
+ *
+ * Chains of operators can be applied in one pass by fused::chain() of
+ * hl_matrix_ops.cuh.
+ */
+
+#if defined(__GNUC__) && !defined(__NVCC__) && \
+    (defined(__x86_64__) || defined(__i386__))
+#define PADDLE_CPU_APPLY_MULTI_ISA
+#define CPU_APPLY_INLINE inline __attribute__((always_inline))
+#else
+#define CPU_APPLY_INLINE inline
+#endif
+
+namespace paddle {
+
+/// instruction sets of the cpu apply loops
+enum CpuApplyIsa {
+  CPU_APPLY_SSE = 0,
+  CPU_APPLY_AVX2 = 1,
+  CPU_APPLY_AVX512 = 2,
+};
+
+/// the best instruction set of this cpu, limited by --cpu_apply_isa
+CpuApplyIsa getCpuApplyIsa();
+
+/**
+ * @brief job(begin, end) for the chunks of [0, numItems), run by the apply
+ *        thread pool and the caller.
+ *
+ * Runs job(0, numItems) in the caller when the work, numItems * itemSize
+ * elements, is less than --cpu_apply_parallel_size, or when another thread
+ * is using the pool. The chunks are multiples of grain items.
+ */
+void cpuApplyParallel(size_t numItems, size_t itemSize, size_t grain,
+                      const std::function<void(size_t, size_t)>& job);
+
+/// threads of the apply thread pool, the caller included
+size_t getCpuApplyThreads();
+
+/// whether the operator of size elements may run in the thread pool
+bool cpuApplyIsParallel(size_t size);
+
+namespace cpu_apply {
+
+#ifdef PADDLE_CPU_APPLY_MULTI_ISA
+/**
+ * The loops of all the instruction sets give the same results, so that
+ * the results do not depend on the cpu. None of them contracts a * b + c
+ * into fma, which rounds once instead of twice, even if the build enables
+ * fma or -ffp-contract=fast.
+ */
+#define CPU_APPLY_NO_CONTRACT __attribute__((optimize("fp-contract=off")))
+
+template <class Kernel>
+CPU_APPLY_NO_CONTRACT void runKernelSse(Kernel& kernel, int rowBegin,
+                                        int rowEnd, int colBegin,
+                                        int colEnd) {
+  kernel(rowBegin, rowEnd, colBegin, colEnd);
+}
+
+template <class Kernel>
+CPU_APPLY_NO_CONTRACT __attribute__((target("avx2"))) void runKernelAvx2(
+    Kernel& kernel, int rowBegin, int rowEnd, int colBegin, int colEnd) {
+  kernel(rowBegin, rowEnd, colBegin, colEnd);
+}
+
+template <class Kernel>
+CPU_APPLY_NO_CONTRACT __attribute__((target("avx512f"))) void runKernelAvx512(
+    Kernel& kernel, int rowBegin, int rowEnd, int colBegin, int colEnd) {
+  kernel(rowBegin, rowEnd, colBegin, colEnd);
+}
+#endif
+
+/// kernel(rows, cols) compiled for the instruction set of getCpuApplyIsa()
+template <class Kernel>
+void runKernel(Kernel& kernel, int rowBegin, int rowEnd, int colBegin,
+               int colEnd) {
+#ifdef PADDLE_CPU_APPLY_MULTI_ISA
+  switch (getCpuApplyIsa()) {
+    case CPU_APPLY_AVX512:
+      runKernelAvx512(kernel, rowBegin, rowEnd, colBegin, colEnd);
+      return;
+    case CPU_APPLY_AVX2:
+      runKernelAvx2(kernel, rowBegin, rowEnd, colBegin, colEnd);
+      return;
+    default:
+      runKernelSse(kernel, rowBegin, rowEnd, colBegin, colEnd);
+      return;
+  }
+#else
+  kernel(rowBegin, rowEnd, colBegin, colEnd);
+#endif
+}
+
+/**
+ * kernel over a (dimM, dimN) matrix, in chunks of rows, or in chunks of
+ * columns when there is one row.
+ */
+template <class Kernel>
+void applyKernel(Kernel& kernel, int dimM, int dimN) {
+  size_t size = (size_t)dimM * dimN;
+  if (!cpuApplyIsParallel(size)) {
+    runKernel(kernel, 0, dimM, 0, dimN);
+  } else if (dimM == 1) {
+    /// 16 elements are a cache line of float
+    cpuApplyParallel(dimN, 1, 16, [&kernel](size_t begin, size_t end) {
+      runKernel(kernel, 0, 1, begin, end);
+    });
+  } else {
+    cpuApplyParallel(dimM, dimN, 1,
+                     [&kernel, dimN](size_t begin, size_t end) {
+                       runKernel(kernel, begin, end, 0, dimN);
+                     });
+  }
+}
+
+/**
+ * kernel over a (dimM, dimN) matrix in chunks of columns, for the kernels
+ * which accumulate along the columns, e.g. over the rows of a batch.
+ */
+template <class Kernel>
+void applyKernelByColumns(Kernel& kernel, int dimM, int dimN) {
+  if (!cpuApplyIsParallel((size_t)dimM * dimN)) {
+    runKernel(kernel, 0, dimM, 0, dimN);
+  } else {
+    cpuApplyParallel(dimN, dimM, 16, [&kernel, dimM](size_t begin,
+                                                     size_t end) {
+      runKernel(kernel, 0, dimM, begin, end);
+    });
+  }
+}
+
+/// one row for the rows of the same leading dimensions as their width
+inline void mergeRows(int* dimM, int* dimN, bool contiguous) {
+  if (contiguous && *dimM > 1 && (size_t)*dimM * *dimN <= INT_MAX) {
+    *dimN *= *dimM;
+    *dimM = 1;
+  }
+}
+
+template <class T, class Op>
+struct UnaryKernel {
+  Op op;
+  T* A;
+  int lda;
+  CPU_APPLY_INLINE void operator()(int rowBegin, int rowEnd, int colBegin,
+                                   int colEnd) {
+    for (int i = rowBegin; i < rowEnd; ++i) {
+      T* a = A + (size_t)i * lda;
+      for (int j = colBegin; j < colEnd; ++j) {
+        op.cpuOperator(a[j]);
+      }
+    }
+  }
+};
+
+template <class T, class Op, bool BAsRowVector, bool BAsColVector>
+struct BinaryKernel {
+  Op op;
+  T* A;
+  T* B;
+  int lda;
+  int ldb;
+  CPU_APPLY_INLINE void operator()(int rowBegin, int rowEnd, int colBegin,
+                                   int colEnd) {
+    for (int i = rowBegin; i < rowEnd; ++i) {
+      T* a = A + (size_t)i * lda;
+      if (BAsRowVector && BAsColVector) {
+        for (int j = colBegin; j < colEnd; ++j) {
+          op.cpuOperator(a[j], B[0]);
+        }
+      } else if (BAsColVector) {
+        T* b = B + (size_t)i * ldb;
+        for (int j = colBegin; j < colEnd; ++j) {
+          op.cpuOperator(a[j], b[0]);
+        }
+      } else {
+        T* b = BAsRowVector ? B : B + (size_t)i * ldb;
+        for (int j = colBegin; j < colEnd; ++j) {
+          op.cpuOperator(a[j], b[j]);
+        }
+      }
+    }
+  }
+};
+
+template <class T, class Op, bool CAsRowVector, bool CAsColVector>
+struct TernaryKernel {
+  Op op;
+  T* A;
+  T* B;
+  T* C;
+  int lda;
+  int ldb;
+  int ldc;
+  CPU_APPLY_INLINE void operator()(int rowBegin, int rowEnd, int colBegin,
+                                   int colEnd) {
+    for (int i = rowBegin; i < rowEnd; ++i) {
+      T* a = A + (size_t)i * lda;
+      T* b = B + (size_t)i * ldb;
+      if (CAsRowVector && CAsColVector) {
+        for (int j = colBegin; j < colEnd; ++j) {
+          op.cpuOperator(a[j], b[j], C[0]);
+        }
+      } else if (CAsColVector) {
+        T* c = C + (size_t)i * ldc;
+        for (int j = colBegin; j < colEnd; ++j) {
+          op.cpuOperator(a[j], b[j], c[0]);
+        }
+      } else {
+        T* c = CAsRowVector ? C : C + (size_t)i * ldc;
+        for (int j = colBegin; j < colEnd; ++j) {
+          op.cpuOperator(a[j], b[j], c[j]);
+        }
+      }
+    }
+  }
+};
+
+template <class T, class Op>
+struct QuaternaryKernel {
+  Op op;
+  T* A;
+  T* B;
+  T* C;
+  T* D;
+  int lda;
+  int ldb;
+  int ldc;
+  int ldd;
+  CPU_APPLY_INLINE void operator()(int rowBegin, int rowEnd, int colBegin,
+                                   int colEnd) {
+    for (int i = rowBegin; i < rowEnd; ++i) {
+      T* a = A + (size_t)i * lda;
+      T* b = B + (size_t)i * ldb;
+      T* c = C + (size_t)i * ldc;
+      T* d = D + (size_t)i * ldd;
+      for (int j = colBegin; j < colEnd; ++j) {
+        op.cpuOperator(a[j], b[j], c[j], d[j]);
+      }
+    }
+  }
+};
+
+}  // namespace cpu_apply
+
+/// the same as hl_cpu_apply_unary_op()
+template <class T, class Op>
+void cpuApplyUnary(Op op, T* A, int dimM, int dimN, int lda) {
+  cpu_apply::mergeRows(&dimM, &dimN, lda == dimN);
+  cpu_apply::UnaryKernel<T, Op> kernel = {op, A, lda};
+  cpu_apply::applyKernel(kernel, dimM, dimN);
+}
+
+/// the same as hl_cpu_apply_binary_op()
+template <class T, class Op, bool BAsRowVector, bool BAsColVector>
+void cpuApplyBinary(Op op, T* A, T* B, int dimM, int dimN, int lda, int ldb) {
+  cpu_apply::mergeRows(&dimM, &dimN, !BAsRowVector && !BAsColVector &&
+                                         lda == dimN && ldb == dimN);
+  cpu_apply::BinaryKernel<T, Op, BAsRowVector, BAsColVector> kernel = {
+      op, A, B, lda, ldb};
+  cpu_apply::applyKernel(kernel, dimM, dimN);
+}
+
+/// the same as hl_cpu_apply_ternary_op()
+template <class T, class Op, bool CAsRowVector, bool CAsColVector>
+void cpuApplyTernary(Op op, T* A, T* B, T* C, int dimM, int dimN, int lda,
+                     int ldb, int ldc) {
+  cpu_apply::mergeRows(&dimM, &dimN, !CAsRowVector && !CAsColVector &&
+                                         lda == dimN && ldb == dimN &&
+                                         ldc == dimN);
+  cpu_apply::TernaryKernel<T, Op, CAsRowVector, CAsColVector> kernel = {
+      op, A, B, C, lda, ldb, ldc};
+  cpu_apply::applyKernel(kernel, dimM, dimN);
+}
+
+/// the same as hl_cpu_apply_quaternary_op()
+template <class T, class Op>
+void cpuApplyQuaternary(Op op, T* A, T* B, T* C, T* D, int dimM, int dimN,
+                        int lda, int ldb, int ldc, int ldd) {
+  cpu_apply::mergeRows(&dimM, &dimN, lda == dimN && ldb == dimN &&
+                                         ldc == dimN && ldd == dimN);
+  cpu_apply::QuaternaryKernel<T, Op> kernel = {op,  A,   B,   C,  D,
+                                               lda, ldb, ldc, ldd};
+  cpu_apply::applyKernel(kernel, dimM, dimN);
+}
+
+}  // namespace paddle
@@ -0,0 +1,371 @@
+/* Copyright (c) 2016 Baidu, Inc. All Rights Reserve.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include "CpuConvEngine.h"
+
+#include <string.h>
+#include <algorithm>
+
+#include "MathFunctions.h"
+#include "paddle/utils/Logging.h"
+
+namespace paddle {
+
+/**
+ * output positions o in [begin, end) read the image pixel
+ * o * stride + k - padding inside [0, imgSize)
+ */
+static void validRange(const ConvShape& shape, int k, int imgSize,
+                       int outSize, int* begin, int* end) {
+  int low = shape.padding - k;
+  int high = imgSize + shape.padding - k;
+  *begin = low > 0 ? (low + shape.stride - 1) / shape.stride : 0;
+  *end = high > 0 ? std::min((high - 1) / shape.stride + 1, outSize) : 0;
+  *begin = std::min(*begin, *end);
+}
+
+void CpuConvEngine::im2col(const ConvShape& shape, const real* image,
+                           real* col, size_t ldCol) {
+  const int filterSize = shape.filterSize;
+  const int stride = shape.stride;
+  const int outW = shape.outW;
+  for (int c = 0; c < shape.channels; ++c) {
+    const real* channel = image + c * shape.imgH * shape.imgW;
+    for (int kh = 0; kh < filterSize; ++kh) {
+      int hBegin, hEnd;
+      validRange(shape, kh, shape.imgH, shape.outH, &hBegin, &hEnd);
+      for (int kw = 0; kw < filterSize; ++kw, col += ldCol) {
+        int wBegin, wEnd;
+        validRange(shape, kw, shape.imgW, outW, &wBegin, &wEnd);
+        memset(col, 0, sizeof(real) * hBegin * outW);
+        for (int oh = hBegin; oh < hEnd; ++oh) {
+          real* dst = col + oh * outW;
+          const real* src =
+              channel + (oh * stride + kh - shape.padding) * shape.imgW;
+          int offset = kw - shape.padding;
+          memset(dst, 0, sizeof(real) * wBegin);
+          if (stride == 1) {
+            memcpy(dst + wBegin, src + wBegin + offset,
+                   sizeof(real) * (wEnd - wBegin));
+          } else {
+            for (int ow = wBegin; ow < wEnd; ++ow) {
+              dst[ow] = src[ow * stride + offset];
+            }
+          }
+          memset(dst + wEnd, 0, sizeof(real) * (outW - wEnd));
+        }
+        memset(col + hEnd * outW, 0,
+               sizeof(real) * (shape.outH - hEnd) * outW);
+      }
+    }
+  }
+}
+
+void CpuConvEngine::col2im(const ConvShape& shape, const real* col,
+                           size_t ldCol, real* image) {
+  const int filterSize = shape.filterSize;
+  const int stride = shape.stride;
+  const int outW = shape.outW;
+  for (int c = 0; c < shape.channels; ++c) {
+    real* channel = image + c * shape.imgH * shape.imgW;
+    for (int kh = 0; kh < filterSize; ++kh) {
+      int hBegin, hEnd;
+      validRange(shape, kh, shape.imgH, shape.outH, &hBegin, &hEnd);
+      for (int kw = 0; kw < filterSize; ++kw, col += ldCol) {
+        int wBegin, wEnd;
+        validRange(shape, kw, shape.imgW, outW, &wBegin, &wEnd);
+        int offset = kw - shape.padding;
+        for (int oh = hBegin; oh < hEnd; ++oh) {
+          const real* src = col + oh * outW;
+          real* dst =
+              channel + (oh * stride + kh - shape.padding) * shape.imgW;
+          if (stride == 1) {
+            real* dstBegin = dst + wBegin + offset;
+            const real* srcBegin = src + wBegin;
+            for (int i = 0; i < wEnd - wBegin; ++i) {
+              dstBegin[i] += srcBegin[i];
+            }
+          } else {
+            for (int ow = wBegin; ow < wEnd; ++ow) {
+              dst[ow * stride + offset] += src[ow];
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+size_t CpuConvEngine::getTileSize(size_t batchSize,
+                                  size_t realsPerSample) const {
+  size_t tileSize = maxBufferSize_ / std::max(realsPerSample, (size_t)1);
+  return std::max(std::min(tileSize, batchSize), (size_t)1);
+}
+
+void CpuConvEngine::forward(const ConvShape& shape, const real* input,
+                            size_t batchSize, const real* weight,
+                            real* output) {
+  const int subK = shape.getSubK();
+  const int subM = shape.getSubM();
+  const int subN = shape.getSubN();
+  const int numRows = subK * shape.groups;
+  const int outputSize = shape.getOutputSize();
+  size_t tileSize = getTileSize(batchSize,
+                                (size_t)(numRows + shape.numFilters) * subN);
+  colBuffer_.resize(numRows * tileSize * subN);
+  if (tileSize > 1) {
+    outBuffer_.resize(shape.numFilters * tileSize * subN);
+  }
+
+  for (size_t begin = 0; begin < batchSize; begin += tileSize) {
+    size_t num = std::min(tileSize, batchSize - begin);
+    int ld = num * subN;
+    for (size_t i = 0; i < num; ++i) {
+      im2col(shape, input + (begin + i) * shape.getImageSize(),
+             colBuffer_.data() + i * subN, ld);
+    }
+
+    /// one sample is already in the layout of the output
+    real* out = num == 1 ? output + begin * outputSize : outBuffer_.data();
+    for (int g = 0; g < shape.groups; ++g) {
+      gemm<real>(CblasTrans, CblasNoTrans, subM, ld, subK, 1.0f,
+                 weight + g * subK * subM, subM,
+                 colBuffer_.data() + g * subK * ld, ld, num == 1 ? 1.0f : 0.0f,
+                 out + g * subM * ld, ld);
+    }
+    if (num == 1) continue;
+
+    /// (numFilters, num * subN) -> num * (numFilters, subN)
+    for (size_t i = 0; i < num; ++i) {
+      real* dst = output + (begin + i) * outputSize;
+      for (int f = 0; f < shape.numFilters; ++f, dst += subN) {
+        const real* src = out + f * ld + i * subN;
+        for (int j = 0; j < subN; ++j) {
+          dst[j] += src[j];
+        }
+      }
+    }
+  }
+}
+
+void CpuConvEngine::backward(const ConvShape& shape, const real* input,
+                             size_t batchSize, const real* weight,
+                             const real* outputGrad, real* inputGrad,
+                             real* weightGrad) {
+  const int subK = shape.getSubK();
+  const int subM = shape.getSubM();
+  const int subN = shape.getSubN();
+  const int numRows = subK * shape.groups;
+  const int outputSize = shape.getOutputSize();
+  size_t tileSize = getTileSize(batchSize,
+                                (size_t)(numRows + shape.numFilters) * subN);
+  colBuffer_.resize(numRows * tileSize * subN);
+  if (tileSize > 1) {
+    outBuffer_.resize(shape.numFilters * tileSize * subN);
+  }
+
+  for (size_t begin = 0; begin < batchSize; begin += tileSize) {
+    size_t num = std::min(tileSize, batchSize - begin);
+    int ld = num * subN;
+
+    /// num * (numFilters, subN) -> (numFilters, num * subN)
+    const real* grad = outputGrad + begin * outputSize;
+    if (num > 1) {
+      for (size_t i = 0; i < num; ++i) {
+        for (int f = 0; f < shape.numFilters; ++f) {
+          memcpy(outBuffer_.data() + f * ld + i * subN,
+                 grad + i * outputSize + f * subN, sizeof(real) * subN);
+        }
+      }
+      grad = outBuffer_.data();
+    }
+
+    if (weightGrad) {
+      for (size_t i = 0; i < num; ++i) {
+        im2col(shape, input + (begin + i) * shape.getImageSize(),
+               colBuffer_.data() + i * subN, ld);
+      }
+      for (int g = 0; g < shape.groups; ++g) {
+        gemm<real>(CblasNoTrans, CblasTrans, subK, subM, ld, 1.0f,
+                   colBuffer_.data() + g * subK * ld, ld, grad + g * subM * ld,
+                   ld, 1.0f, weightGrad + g * subK * subM, subM);
+      }
+    }
+
+    if (inputGrad) {
+      for (int g = 0; g < shape.groups; ++g) {
+        gemm<real>(CblasNoTrans, CblasNoTrans, subK, ld, subM, 1.0f,
+                   weight + g * subK * subM, subM, grad + g * subM * ld, ld,
+                   0.0f, colBuffer_.data() + g * subK * ld, ld);
+      }
+      for (size_t i = 0; i < num; ++i) {
+        col2im(shape, colBuffer_.data() + i * subN, ld,
+               inputGrad + (begin + i) * shape.getImageSize());
+      }
+    }
+  }
+}
+
+/**
+ * winograd F(2x2, 3x3), see "Fast Algorithms for Convolutional Neural
+ * Networks" by Lavin and Gray. The output tile is A^T [U .* V] A, with
+ * the filter transform U = G g G^T and the input transform V = B^T d B.
+ */
+static void winogradFilter(const real g[3][3], real u[16]) {
+  real t[4][3];  // G g
+  for (int j = 0; j < 3; ++j) {
+    t[0][j] = g[0][j];
+    t[1][j] = 0.5f * (g[0][j] + g[1][j] + g[2][j]);
+    t[2][j] = 0.5f * (g[0][j] - g[1][j] + g[2][j]);
+    t[3][j] = g[2][j];
+  }
+  for (int i = 0; i < 4; ++i) {
+    u[i * 4 + 0] = t[i][0];
+    u[i * 4 + 1] = 0.5f * (t[i][0] + t[i][1] + t[i][2]);
+    u[i * 4 + 2] = 0.5f * (t[i][0] - t[i][1] + t[i][2]);
+    u[i * 4 + 3] = t[i][2];
+  }
+}
+
+static void winogradInput(const real d[4][4], real v[16]) {
+  real t[4][4];  // B^T d
+  for (int j = 0; j < 4; ++j) {
+    t[0][j] = d[0][j] - d[2][j];
+    t[1][j] = d[1][j] + d[2][j];
+    t[2][j] = d[2][j] - d[1][j];
+    t[3][j] = d[1][j] - d[3][j];
+  }
+  for (int i = 0; i < 4; ++i) {
+    v[i * 4 + 0] = t[i][0] - t[i][2];
+    v[i * 4 + 1] = t[i][1] + t[i][2];
+    v[i * 4 + 2] = t[i][2] - t[i][1];
+    v[i * 4 + 3] = t[i][1] - t[i][3];
+  }
+}
+
+static void winogradOutput(const real m[16], real y[2][2]) {
+  real t[2][4];  // A^T m
+  for (int j = 0; j < 4; ++j) {
+    t[0][j] = m[0 * 4 + j] + m[1 * 4 + j] + m[2 * 4 + j];
+    t[1][j] = m[1 * 4 + j] - m[2 * 4 + j] - m[3 * 4 + j];
+  }
+  for (int i = 0; i < 2; ++i) {
+    y[i][0] = t[i][0] + t[i][1] + t[i][2];
+    y[i][1] = t[i][1] - t[i][2] - t[i][3];
+  }
+}
+
+void CpuConvEngine::forwardWinograd(const ConvShape& shape,
+                                    const real* input, size_t batchSize,
+                                    const real* weight, real* output) {
+  CHECK(canUseWinograd(shape));
+  const int channels = shape.channels / shape.groups;
+  const int subK = shape.getSubK();
+  const int subM = shape.getSubM();
+  const int imgH = shape.imgH;
+  const int imgW = shape.imgW;
+  const int outH = shape.outH;
+  const int outW = shape.outW;
+  const int tilesW = (outW + 1) / 2;
+  const int tilesPerSample = (outH + 1) / 2 * tilesW;
+  const size_t numTiles = batchSize * tilesPerSample;
+
+  /// U of group g is 16 (subM, channels) matrices
+  weightBuffer_.resize(shape.groups * 16 * subM * channels);
+  for (int g = 0; g < shape.groups; ++g) {
+    const real* w = weight + g * subK * subM;
+    real* u = weightBuffer_.data() + g * 16 * subM * channels;
+    for (int k = 0; k < subM; ++k) {
+      for (int c = 0; c < channels; ++c) {
+        real filter[3][3];
+        real transformed[16];
+        for (int i = 0; i < 9; ++i) {
+          filter[i / 3][i % 3] = w[(c * 9 + i) * subM + k];
+        }
+        winogradFilter(filter, transformed);
+        for (int e = 0; e < 16; ++e) {
+          u[(e * subM + k) * channels + c] = transformed[e];
+        }
+      }
+    }
+  }
+
+  size_t tileSize = getTileSize(numTiles, 16 * (channels + subM));
+  colBuffer_.resize(16 * channels * tileSize);
+  outBuffer_.resize(16 * subM * tileSize);
+
+  for (int g = 0; g < shape.groups; ++g) {
+    for (size_t begin = 0; begin < numTiles; begin += tileSize) {
+      int num = std::min(tileSize, numTiles - begin);
+
+      /// V is 16 (channels, num) matrices
+      for (int c = 0; c < channels; ++c) {
+        for (int q = 0; q < num; ++q) {
+          size_t tile = begin + q;
+          int n = tile / tilesPerSample;
+          int th = tile % tilesPerSample / tilesW;
+          int tw = tile % tilesPerSample % tilesW;
+          const real* image = input + n * shape.getImageSize() +
+                              (g * channels + c) * imgH * imgW;
+          real d[4][4];
+          for (int i = 0; i < 4; ++i) {
+            int ih = th * 2 + i - shape.padding;
+            for (int j = 0; j < 4; ++j) {
+              int iw = tw * 2 + j - shape.padding;
+              d[i][j] = (ih >= 0 && ih < imgH && iw >= 0 && iw < imgW)
+                            ? image[ih * imgW + iw]
+                            : 0;
+            }
+          }
+          real v[16];
+          winogradInput(d, v);
+          for (int e = 0; e < 16; ++e) {
+            colBuffer_[(e * channels + c) * num + q] = v[e];
+          }
+        }
+      }
+
+      for (int e = 0; e < 16; ++e) {
+        gemm<real>(CblasNoTrans, CblasNoTrans, subM, num, channels, 1.0f,
+                   weightBuffer_.data() + (g * 16 + e) * subM * channels,
+                   channels, colBuffer_.data() + e * channels * num, num,
+                   0.0f, outBuffer_.data() + e * subM * num, num);
+      }
+
+      for (int k = 0; k < subM; ++k) {
+        for (int q = 0; q < num; ++q) {
+          size_t tile = begin + q;
+          int n = tile / tilesPerSample;
+          int th = tile % tilesPerSample / tilesW;
+          int tw = tile % tilesPerSample % tilesW;
+          real m[16];
+          for (int e = 0; e < 16; ++e) {
+            m[e] = outBuffer_[(e * subM + k) * num + q];
+          }
+          real y[2][2];
+          winogradOutput(m, y);
+          real* out = output + n * shape.getOutputSize() +
+                      (g * subM + k) * outH * outW;
+          for (int i = 0; i < 2 && th * 2 + i < outH; ++i) {
+            for (int j = 0; j < 2 && tw * 2 + j < outW; ++j) {
+              out[(th * 2 + i) * outW + tw * 2 + j] += y[i][j];
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+}  // namespace paddle
@@ -0,0 +1,126 @@
+/* Copyright (c) 2016 Baidu, Inc. All Rights Reserve.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#pragma once
+
+#include <stddef.h>
+#include <vector>
+
+#include "paddle/utils/TypeDefs.h"
+
+namespace paddle {
+
+/**
+ * Shape of a convolution with square filters, as in ExpandConvLayer.
+ *
+ * An image is (channels, imgH, imgW) and an output is
+ * (numFilters, outH, outW). The weight of group g is a
+ * (channels / groups * filterSize^2, numFilters / groups) matrix, stored
+ * after the weights of the previous groups.
+ */
+struct ConvShape {
+  int channels;
+  int imgH;
+  int imgW;
+  int filterSize;
+  int stride;
+  int padding;
+  int outH;
+  int outW;
+  int numFilters;
+  int groups;
+
+  /// subK: rows of the weight of one group
+  int getSubK() const {
+    return channels / groups * filterSize * filterSize;
+  }
+  /// subM: filters of one group
+  int getSubM() const { return numFilters / groups; }
+  /// subN: output pixels of one sample
+  int getSubN() const { return outH * outW; }
+  int getImageSize() const { return channels * imgH * imgW; }
+  int getOutputSize() const { return numFilters * outH * outW; }
+};
+
+/**
+ * @brief convolution on cpu by batched im2col and GEMM
+ *
+ * @note  CpuMatrix::convExpand() expands one sample at a time, and the GEMM
+ *        of one sample, (subM, subK) x (subK, subN), is too small for BLAS
+ *        to run well. The engine expands a tile of samples side by side
+ *        into one column buffer of (groups * subK, tile * subN), and runs
+ *        one GEMM per group per tile. The tile is the most samples whose
+ *        buffers fit in maxBufferSize reals.
+ *
+ *        The forward of 3x3 filters with stride 1 may use winograd
+ *        F(2x2, 3x3) instead, which needs 2.25 times less multiplications
+ *        than the direct convolution. It is 16 GEMMs of
+ *        (subM, channels / groups) x (channels / groups, 2x2 tiles).
+ *
+ *        All the results are added to the output arrays.
+ *        Not thread safe, the buffers are reused by the calls.
+ */
+class CpuConvEngine {
+public:
+  explicit CpuConvEngine(size_t maxBufferSize = 1 << 22)
+      : maxBufferSize_(maxBufferSize) {}
+
+  /// output += conv(input, weight), for batchSize samples
+  void forward(const ConvShape& shape, const real* input, size_t batchSize,
+               const real* weight, real* output);
+
+  /// forward by winograd, only for canUseWinograd() shapes
+  void forwardWinograd(const ConvShape& shape, const real* input,
+                       size_t batchSize, const real* weight, real* output);
+
+  static bool canUseWinograd(const ConvShape& shape) {
+    return shape.filterSize == 3 && shape.stride == 1 &&
+           shape.outH == shape.imgH + 2 * shape.padding - 2 &&
+           shape.outW == shape.imgW + 2 * shape.padding - 2;
+  }
+
+  /**
+   * @brief inputGrad += gradient of input, weightGrad += gradient of weight
+   *
+   * Either of inputGrad and weightGrad may be nullptr. input is only used
+   * for weightGrad and weight for inputGrad.
+   */
+  void backward(const ConvShape& shape, const real* input, size_t batchSize,
+                const real* weight, const real* outputGrad, real* inputGrad,
+                real* weightGrad);
+
+  /**
+   * @brief expand one image into the first subN columns of col, whose rows
+   *        have ldCol reals. The same layout as CpuMatrix::convExpand()
+   *        when ldCol is subN.
+   */
+  static void im2col(const ConvShape& shape, const real* image, real* col,
+                     size_t ldCol);
+
+  /// image += the sum of the columns of its pixels, reverse of im2col()
+  static void col2im(const ConvShape& shape, const real* col, size_t ldCol,
+                     real* image);
+
+protected:
+  /// number of samples whose buffers fit in maxBufferSize_
+  size_t getTileSize(size_t batchSize, size_t realsPerSample) const;
+
+  size_t maxBufferSize_;
+  std::vector<real> colBuffer_;
+  std::vector<real> outBuffer_;
+  /// winograd transformed weight
+  std::vector<real> weightBuffer_;
+};
+
+}  // namespace paddle
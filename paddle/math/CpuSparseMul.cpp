@@ -0,0 +1,254 @@
+/* Copyright (c) 2016 Baidu, Inc. All Rights Reserve.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include "CpuSparseMul.h"
+
+#include <algorithm>
+#include <string>
+
+#include "CpuApply.h"
+#include "CpuSparseMatrix.h"
+#include "paddle/utils/Logging.h"
+#include "paddle/utils/Util.h"
+
+P_DEFINE_string(sparse_mul_strategy, "auto",
+                "How the cpu sparse x dense multiplication is split among "
+                "the cpu_apply_threads: auto, rows or columns");
+
+namespace paddle {
+
+namespace {
+
+/// columns of c updated per pass, 4KB of float, which stay in the l1 cache
+const int kBlockSize = 1024;
+
+/// least columns of c per thread to split the columns
+const size_t kMinColumnsPerThread = 64;
+
+CPU_APPLY_INLINE void addRows4(real* __restrict__ c,
+                               const real* __restrict__ b0,
+                               const real* __restrict__ b1,
+                               const real* __restrict__ b2,
+                               const real* __restrict__ b3, real v0, real v1,
+                               real v2, real v3, int colBegin, int colEnd) {
+  for (int j = colBegin; j < colEnd; ++j) {
+    c[j] += v0 * b0[j] + v1 * b1[j] + v2 * b2[j] + v3 * b3[j];
+  }
+}
+
+CPU_APPLY_INLINE void addRow(real* __restrict__ c, const real* __restrict__ b0,
+                             real v0, int colBegin, int colEnd) {
+  for (int j = colBegin; j < colEnd; ++j) {
+    c[j] += v0 * b0[j];
+  }
+}
+
+/**
+ * cRows[i] += values[k] * (row index[k] of b), k in [start[i], start[i + 1]),
+ * all the values are 1 without HasValue
+ */
+template <bool HasValue>
+struct GatherKernel {
+  const int* start;
+  const int* index;
+  const real* values;
+  const real* b;
+  size_t ldb;
+  real* const* cRows;
+
+  CPU_APPLY_INLINE const real* row(int k) const {
+    return b + (size_t)index[k] * ldb;
+  }
+
+  CPU_APPLY_INLINE real value(int k) const {
+    return HasValue ? values[k] : (real)1;
+  }
+
+  CPU_APPLY_INLINE void operator()(int rowBegin, int rowEnd, int colBegin,
+                                   int colEnd) {
+    for (int i = rowBegin; i < rowEnd; ++i) {
+      int kBegin = start[i];
+      int kEnd = start[i + 1];
+      if (kBegin == kEnd) continue;
+      real* c = cRows[i];
+      for (int blockBegin = colBegin; blockBegin < colEnd;
+           blockBegin += kBlockSize) {
+        int blockEnd = std::min(blockBegin + kBlockSize, colEnd);
+        int k = kBegin;
+        for (; k + 4 <= kEnd; k += 4) {
+          addRows4(c, row(k), row(k + 1), row(k + 2), row(k + 3), value(k),
+                   value(k + 1), value(k + 2), value(k + 3), blockBegin,
+                   blockEnd);
+        }
+        for (; k < kEnd; ++k) {
+          addRow(c, row(k), value(k), blockBegin, blockEnd);
+        }
+      }
+    }
+  }
+};
+
+template <bool HasValue>
+void runGather(GatherKernel<HasValue>& kernel, int numRows, int width) {
+  size_t nnz = kernel.start[numRows] - kernel.start[0];
+  if (!cpuApplyIsParallel(nnz * width)) {
+    cpu_apply::runKernel(kernel, 0, numRows, 0, width);
+    return;
+  }
+
+  size_t maxRowNnz = 0;
+  for (int i = 0; i < numRows; ++i) {
+    maxRowNnz = std::max(maxRowNnz,
+                         (size_t)(kernel.start[i + 1] - kernel.start[i]));
+  }
+  auto strategy =
+      CpuSparseMulEngine::chooseStrategy(numRows, nnz, maxRowNnz, width);
+  if (strategy == CpuSparseMulEngine::COLUMN_BLOCKED) {
+    cpuApplyParallel(width, nnz, 16, [&kernel, numRows](size_t begin,
+                                                        size_t end) {
+      cpu_apply::runKernel(kernel, 0, numRows, begin, end);
+    });
+    return;
+  }
+
+  /// the first row of the part, whose nonzeros start at part * nnz / numParts
+  size_t numParts = getCpuApplyThreads();
+  const int* start = kernel.start;
+  auto partBegin = [=](size_t part) {
+    if (part == numParts) return numRows;
+    int first = start[0] + (int)(part * nnz / numParts);
+    return (int)(std::lower_bound(start, start + numRows, first) - start);
+  };
+  cpuApplyParallel(numParts, nnz * width / numParts, 1,
+                   [&](size_t begin, size_t end) {
+                     cpu_apply::runKernel(kernel, partBegin(begin),
+                                          partBegin(end), 0, width);
+                   });
+}
+
+}  // namespace
+
+CpuSparseMulEngine::Strategy CpuSparseMulEngine::chooseStrategy(
+    size_t numRows, size_t nnz, size_t maxRowNnz, size_t width) {
+  const std::string& strategy = FLAGS_sparse_mul_strategy;
+  if (strategy == "rows") {
+    return ROW_PARALLEL;
+  } else if (strategy == "columns") {
+    return COLUMN_BLOCKED;
+  } else if (strategy != "auto") {
+    LOG(FATAL) << "Unknown sparse_mul_strategy: " << strategy;
+  }
+
+  /// the parts of rows exceed nnz / numThreads by up to maxRowNnz
+  size_t numThreads = getCpuApplyThreads();
+  bool unbalanced = numRows < numThreads || maxRowNnz * numThreads * 2 > nnz;
+  if (unbalanced && width >= numThreads * kMinColumnsPerThread) {
+    return COLUMN_BLOCKED;
+  }
+  return ROW_PARALLEL;
+}
+
+void CpuSparseMulEngine::mul(const CpuSparseMatrix& a, const real* b,
+                             size_t ldb, size_t width,
+                             const std::function<real*(size_t)>& getCRow) {
+  CHECK_EQ(a.getFormat(), SPARSE_CSR) << "Not supported";
+  bool hasValue = a.getValueType() == FLOAT_VALUE;
+
+  if (!a.isTransposed()) {
+    size_t numRows = a.getHeight();
+    const int* start = a.getRows();
+    for (size_t i = 0; i < numRows; ++i) {
+      if (start[i] < start[i + 1]) getCRow(i);
+    }
+    cRows_.resize(numRows);
+    for (size_t i = 0; i < numRows; ++i) {
+      cRows_[i] = start[i] < start[i + 1] ? getCRow(i) : nullptr;
+    }
+    gather(numRows, start, a.getCols(), hasValue ? a.getValue() : nullptr, b,
+           ldb, width);
+  } else {
+    transpose(a, getCRow);
+    gather(cRows_.size(), start_.data(), index_.data(),
+           hasValue ? values_.data() : nullptr, b, ldb, width);
+  }
+}
+
+void CpuSparseMulEngine::gather(size_t numRows, const int* start,
+                                const int* index, const real* values,
+                                const real* b, size_t ldb, size_t width) {
+  if (numRows == 0 || width == 0) return;
+  if (values) {
+    GatherKernel<true> kernel = {start, index, values, b, ldb, cRows_.data()};
+    runGather(kernel, numRows, width);
+  } else {
+    GatherKernel<false> kernel = {start, index, values, b, ldb,
+                                  cRows_.data()};
+    runGather(kernel, numRows, width);
+  }
+}
+
+void CpuSparseMulEngine::transpose(
+    const CpuSparseMatrix& a, const std::function<real*(size_t)>& getCRow) {
+  size_t height = a.getHeight();
+  const int* rows = a.getRows();
+  const int* cols = a.getCols();
+  const real* values =
+      a.getValueType() == FLOAT_VALUE ? a.getValue() : nullptr;
+  int nnzBegin = rows[0];
+  int nnzEnd = rows[height];
+  if (slot_.size() < a.getWidth()) {
+    slot_.resize(a.getWidth(), -1);
+  }
+
+  /// the used rows of c, and their numbers of nonzeros
+  cRowIds_.clear();
+  start_.assign(1, 0);
+  for (int k = nnzBegin; k < nnzEnd; ++k) {
+    int& slot = slot_[cols[k]];
+    if (slot < 0) {
+      slot = cRowIds_.size();
+      cRowIds_.push_back(cols[k]);
+      getCRow(cols[k]);
+      start_.push_back(0);
+    }
+    ++start_[slot + 1];
+  }
+  cRows_.resize(cRowIds_.size());
+  for (size_t i = 0; i < cRowIds_.size(); ++i) {
+    cRows_[i] = getCRow(cRowIds_[i]);
+  }
+  for (size_t i = 1; i < start_.size(); ++i) {
+    start_[i] += start_[i - 1];
+  }
+
+  /// the nonzeros of each row of c by the rows of a
+  cursor_.assign(start_.begin(), start_.end() - 1);
+  index_.resize(nnzEnd - nnzBegin);
+  values_.resize(values ? nnzEnd - nnzBegin : 0);
+  for (size_t i = 0; i < height; ++i) {
+    for (int k = rows[i]; k < rows[i + 1]; ++k) {
+      int pos = cursor_[slot_[cols[k]]]++;
+      index_[pos] = i;
+      if (values) {
+        values_[pos] = values[k];
+      }
+    }
+  }
+
+  for (auto id : cRowIds_) {
+    slot_[id] = -1;
+  }
+}
+
+}  // namespace paddle
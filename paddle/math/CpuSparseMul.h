@@ -0,0 +1,93 @@
+/* Copyright (c) 2016 Baidu, Inc. All Rights Reserve.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#pragma once
+
+#include <stddef.h>
+#include <functional>
+#include <vector>
+
+#include "paddle/utils/TypeDefs.h"
+
+namespace paddle {
+
+class CpuSparseMatrix;
+
+/**
+ * @brief sparse x dense multiplication on cpu, for the sparse inputs of
+ *        FullyConnectedLayer.
+ *
+ * @note  Each row of c gathers the rows of b of its nonzeros, 4 of them
+ *        per pass over a block of columns, in loops compiled for the
+ *        instruction set of getCpuApplyIsa(). a * b gathers by the csr
+ *        rows of a. a^T * b, the weight gradient, first sorts the nonzeros
+ *        of a by column, so that no two threads write the same row of c.
+ *
+ *        The work is split among the cpu apply threads by one of
+ *        - ROW_PARALLEL: ranges of rows of c with the same number of
+ *          nonzeros;
+ *        - COLUMN_BLOCKED: blocks of the columns of b and c, for too few
+ *          rows, or too uneven rows, to balance the threads.
+ *
+ *        Not thread safe, the buffers are reused by the calls.
+ */
+class CpuSparseMulEngine {
+public:
+  enum Strategy {
+    ROW_PARALLEL = 0,
+    COLUMN_BLOCKED = 1,
+  };
+
+  /**
+   * @brief c += a * b, or c += a^T * b if a is transposed.
+   *
+   * a is csr. b is the dense (a.getWidth(), width) matrix, or
+   * (a.getHeight(), width) if a is transposed, of leading dimension ldb.
+   * getCRow(i) is the row i of c. It is called by the calling thread, for
+   * each row of c used in the order of the first use, and once again for
+   * all of them, so that the rows may be allocated, and moved, by the
+   * first calls, as SparseAutoGrowRowCpuMatrix::getRow().
+   */
+  void mul(const CpuSparseMatrix& a, const real* b, size_t ldb, size_t width,
+           const std::function<real*(size_t)>& getCRow);
+
+  /**
+   * the strategy for numRows rows of c, of the nonzeros nnz in total
+   * and maxRowNnz in the largest row, limited by --sparse_mul_strategy
+   */
+  static Strategy chooseStrategy(size_t numRows, size_t nnz,
+                                 size_t maxRowNnz, size_t width);
+
+protected:
+  /// c += the csr (numRows, ...) matrix of start, index and values, times b
+  void gather(size_t numRows, const int* start, const int* index,
+              const real* values, const real* b, size_t ldb, size_t width);
+
+  /// sort the nonzeros of the transposed csr matrix a by column
+  void transpose(const CpuSparseMatrix& a,
+                 const std::function<real*(size_t)>& getCRow);
+
+  /// the used rows of c
+  std::vector<size_t> cRowIds_;
+  std::vector<real*> cRows_;
+  /// a^T by columns: start_, index_ and values_ of the used rows of c
+  std::vector<int> start_;
+  std::vector<int> index_;
+  std::vector<real> values_;
+  std::vector<int> cursor_;
+  /// the column of a -> the used row of c, -1 if unused
+  std::vector<int> slot_;
+};
+
+}  // namespace paddle
@@ -16,6 +16,7 @@ limitations under the License. */
 #include "MathFunctions.h"
 #include "hl_matrix_ops.cuh"
 #include "hl_matrix_apply.cuh"
+#include "CpuApply.h"
 
 namespace paddle {
 
@@ -135,49 +136,49 @@ void vTanh<double>(const int n, const double* a, double* r) {
 DEFINE_MATRIX_BINARY_OP(vExp, b = std::exp(a));
 template<class T>
 void vExp(const int n, const T* a, T* r) {
-  hl_cpu_apply_binary_op<T, binary::vExp<T>, 0, 0>(
+  cpuApplyBinary<T, binary::vExp<T>, 0, 0>(
     binary::vExp<T>(), const_cast<T*>(a), r, 1, n, n, n);
 }
 
 DEFINE_MATRIX_BINARY_OP(vLog, b = std::log(a));
 template<class T>
 void vLog(const int n, const T* a, T* r) {
-  hl_cpu_apply_binary_op<T, binary::vLog<T>, 0, 0>(
+  cpuApplyBinary<T, binary::vLog<T>, 0, 0>(
     binary::vLog<T>(), const_cast<T*>(a), r, 1, n, n, n);
 }
 
 DEFINE_MATRIX_BINARY_OP(vInvSqrt, b = 1.0f / std::sqrt(a));
 template<class T>
 void vInvSqrt(const int n, const T* a, T* r) {
-  hl_cpu_apply_binary_op<T, binary::vInvSqrt<T>, 0, 0>(
+  cpuApplyBinary<T, binary::vInvSqrt<T>, 0, 0>(
     binary::vInvSqrt<T>(), const_cast<T*>(a), r, 1, n, n, n);
 }
 
 DEFINE_MATRIX_BINARY_OP(vLog1p, b = std::log(1.0f + a));
 template<class T>
 void vLog1p(const int n, const T* a, T* r) {
-  hl_cpu_apply_binary_op<T, binary::vLog1p<T>, 0, 0>(
+  cpuApplyBinary<T, binary::vLog1p<T>, 0, 0>(
     binary::vLog1p<T>(), const_cast<T*>(a), r, 1, n, n, n);
 }
 
 DEFINE_MATRIX_BINARY_OP(vTanh, b = 2.0 / (1.0 + std::exp(-2 * a)) - 1.0);
 template<class T>
 void vTanh(const int n, const T* a, T* r) {
-  hl_cpu_apply_binary_op<T, binary::vTanh<T>, 0, 0>(
+  cpuApplyBinary<T, binary::vTanh<T>, 0, 0>(
     binary::vTanh<T>(), const_cast<T*>(a), r, 1, n, n, n);
 }
 
 DEFINE_MATRIX_BINARY_PARAMETER_OP(vPow, ONE_PARAMETER, b = std::pow(a, p));
 template<class T>
 void vPow(const int n, const T* a, const T b, T* r) {
-  hl_cpu_apply_binary_op<T, binary::vPow<T>, 0, 0>(
+  cpuApplyBinary<T, binary::vPow<T>, 0, 0>(
     binary::vPow<T>(b), const_cast<T*>(a), r, 1, n, n, n);
 }
 
 DEFINE_MATRIX_TERNARY_OP(vAdd, c = a + b);
 template<class T>
 void vAdd(const int n, const T* a, const T* b, T* r) {
-  hl_cpu_apply_ternary_op<T, ternary::vAdd<T>, 0, 0>(ternary::vAdd<T>(),
+  cpuApplyTernary<T, ternary::vAdd<T>, 0, 0>(ternary::vAdd<T>(),
     const_cast<T*>(a), const_cast<T*>(b), r, 1, n, n, n , n);
 }
 
@@ -30,6 +30,7 @@ limitations under the License. */
 #include "paddle/utils/ThreadLocal.h"
 
 #include "SIMDFunctions.h"
+#include "CpuSparseMul.h"
 
 namespace paddle {
 
@@ -2356,7 +2357,7 @@ void CpuMatrix::addToRowsImp(TableMatType& table, IVector& ids) {
   }
 }
 
-static ThreadLocal<std::vector<const real*>> threadLocalColArray;
+static ThreadLocal<CpuSparseMulEngine> threadLocalSparseMulEngine;
 
 template <typename MatBType, typename MatCType>
 void CpuMatrix::mul(CpuSparseMatrix* a, MatBType* b, MatCType* c, real scaleAB,
@@ -2368,12 +2369,8 @@ void CpuMatrix::mul(CpuSparseMatrix* a, MatBType* b, MatCType* c, real scaleAB,
   CHECK(scaleT == 0 || scaleT == 1) << "Not supported";
   CHECK_EQ(a->getFormat(), SPARSE_CSR) << "Not supported";
 
-  real* B = b->getData();
-  real* C = c->getData();
   size_t height = c->getHeight();
   size_t width = c->getWidth();
-  int* cols = a->getCols();
-  real* values = a->getValue();
 
   if (scaleT == 0) {
     c->zeroMem();
@@ -2384,81 +2381,16 @@ void CpuMatrix::mul(CpuSparseMatrix* a, MatBType* b, MatCType* c, real scaleAB,
     CHECK_EQ(b->getHeight(), m);
     CHECK_EQ(a->getHeight(), height);
     CHECK_EQ(b->getWidth(), width);
-
-    if (a->getValueType() == NO_VALUE) {
-      if (width % 32 == 0) {  // use libaddto
-        // @TODO(yuyang18) Make input addr can be unaligned.
-        // So merge this if and else
-        CHECK_EQ((size_t)B % 32, 0UL);
-        CHECK_EQ((size_t)C % 32, 0UL);
-        auto& colArray = *threadLocalColArray;
-        for (size_t i = 0; i < a->getHeight(); ++i) {
-          const int start = a->getRowStartIdx(i);
-          const int end = a->getRowStartIdx(i + 1);
-          size_t colNum = end - start;
-          colArray.resize(colNum);
-          for (int j = 0; j < end - start; ++j) {
-            colArray[j] = b->getRow(cols[j + start]);
-          }
-          simd::batchAddTo(c->getRow(i), &colArray[0], colNum, width);
-        }
-
-      } else {
-        for (size_t i = 0; i < a->getHeight(); ++i) {
-          const int start = a->getRowStartIdx(i);
-          const int end = a->getRowStartIdx(i + 1);
-          for (int j = start; j < end; ++j) {
-            vecAddTo(c->getRow(i), b->getRow(cols[j]), width);
-          }
-        }
-      }
-    } else if (a->getValueType() == FLOAT_VALUE) {
-      for (size_t i = 0; i < a->getHeight(); ++i) {
-        const int start = a->getRowStartIdx(i);
-        const int end = a->getRowStartIdx(i + 1);
-        for (int j = start; j < end; ++j) {
-          vecAddTo(c->getRow(i), b->getRow(cols[j]), values[j], width);
-        }
-      }
-    }
   } else /*if (a->isTransposed())*/ {
     size_t m = a->getHeight();
     CHECK_EQ(b->getHeight(), m);
     CHECK_EQ(a->getWidth(), height);
     CHECK_EQ(b->getWidth(), width);
-    if (a->getValueType() == NO_VALUE) {
-      if (width % 32 == 0) {  // use libaddto
-        // @TODO(yuyang18) Make input addr can be unaligned.
-        // So merge this if and else
-        CHECK_EQ((size_t)B % 32, 0UL);
-        CHECK_EQ((size_t)C % 32, 0UL);
-        for (size_t i = 0; i < a->getHeight(); ++i) {
-          const int start = a->getRowStartIdx(i);
-          const int end = a->getRowStartIdx(i + 1);
-          for (int j = start; j < end; ++j) {
-            simd::addTo(c->getRow(cols[j]), b->getRow(i), width);
-          }
-        }
-
-      } else {
-        for (size_t i = 0; i < a->getHeight(); ++i) {
-          const int start = a->getRowStartIdx(i);
-          const int end = a->getRowStartIdx(i + 1);
-          for (int j = start; j < end; ++j) {
-            vecAddTo(c->getRow(cols[j]), b->getRow(i), width);
-          }
-        }
-      }
-    } else if (a->getValueType() == FLOAT_VALUE) {
-      for (size_t i = 0; i < a->getHeight(); ++i) {
-        const int start = a->getRowStartIdx(i);
-        const int end = a->getRowStartIdx(i + 1);
-        for (int j = start; j < end; ++j) {
-          vecAddTo(c->getRow(cols[j]), b->getRow(i), values[j], width);
-        }
-      }
-    }
   }
+
+  threadLocalSparseMulEngine.get()->mul(
+      *a, b->getData(), b->getStride(), width,
+      [c](size_t i) { return c->getRow(i); });
 }
 
 // instantiation mul() called in SparseRowMatrix.cpp
@@ -353,6 +353,316 @@ static void decayL1_avx(float* dst, float* src, float* lr, float lambda,
   }
 }
 
+// The parameter blocks are not necessarily 32 bytes aligned,
+// so the svrg kernels use unaligned loads and stores.
+static void svrg_momentum_avx(float* value, float* mom, const float* grad,
+                              const float* gradSum, float learningRate,
+                              float gradSumRate, float momentum,
+                              float decayRate, size_t sz) {
+  size_t i = 0;
+  __m256 lr = _mm256_set1_ps(learningRate);
+  __m256 rate = _mm256_set1_ps(gradSumRate);
+  __m256 mo = _mm256_set1_ps(momentum);
+  __m256 dr = _mm256_set1_ps(decayRate);
+
+  for (; i + 8 <= sz; i += 8) {
+    __m256 g = _mm256_loadu_ps(grad + i);
+    __m256 s = _mm256_loadu_ps(gradSum + i);
+    __m256 w = _mm256_loadu_ps(value + i);
+    __m256 m = _mm256_loadu_ps(mom + i);
+    g = _mm256_add_ps(g, _mm256_mul_ps(rate, s));
+    g = _mm256_add_ps(g, _mm256_mul_ps(dr, w));
+    m = _mm256_sub_ps(_mm256_mul_ps(mo, m), _mm256_mul_ps(lr, g));
+    _mm256_storeu_ps(mom + i, m);
+    _mm256_storeu_ps(value + i, _mm256_add_ps(w, m));
+  }
+  paddle::simd::naive::svrgMomentum(value + i, mom + i, grad + i, gradSum + i,
+                                    learningRate, gradSumRate, momentum,
+                                    decayRate, sz - i);
+}
+
+static void svrg_adagrad_avx(float* value, float* mom, float* lr,
+                             float* sqsum1, const float* sqsum,
+                             const float* grad, const float* gradSum,
+                             float learningRate, float gradSumRate,
+                             float momentum, float decayRate, float epsilon,
+                             size_t sz) {
+  size_t i = 0;
+  __m256 rate = _mm256_set1_ps(learningRate);
+  __m256 sumRate = _mm256_set1_ps(gradSumRate);
+  __m256 mo = _mm256_set1_ps(momentum);
+  __m256 dr = _mm256_set1_ps(decayRate);
+  __m256 eps = _mm256_set1_ps(epsilon);
+  __m256 one = _mm256_set1_ps(1.0f);
+
+  for (; i + 8 <= sz; i += 8) {
+    __m256 g = _mm256_loadu_ps(grad + i);
+    __m256 s = _mm256_loadu_ps(gradSum + i);
+    __m256 w = _mm256_loadu_ps(value + i);
+    __m256 m = _mm256_loadu_ps(mom + i);
+    __m256 sq1 = _mm256_loadu_ps(sqsum1 + i);
+    __m256 sq = _mm256_loadu_ps(sqsum + i);
+    g = _mm256_add_ps(g, _mm256_mul_ps(sumRate, s));
+    sq1 = _mm256_add_ps(sq1, _mm256_mul_ps(g, g));
+    _mm256_storeu_ps(sqsum1 + i, sq1);
+    // sqrt and div instead of rsqrt, to keep the precision of invSqrt()
+    __m256 l = _mm256_div_ps(
+        one, _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(sq, sq1), eps)));
+    _mm256_storeu_ps(lr + i, l);
+    g = _mm256_add_ps(g, _mm256_mul_ps(dr, w));
+    g = _mm256_mul_ps(_mm256_mul_ps(rate, l), g);
+    m = _mm256_sub_ps(_mm256_mul_ps(mo, m), g);
+    _mm256_storeu_ps(mom + i, m);
+    _mm256_storeu_ps(value + i, _mm256_add_ps(w, m));
+  }
+  paddle::simd::naive::svrgAdagrad(value + i, mom + i, lr + i, sqsum1 + i,
+                                   sqsum + i, grad + i, gradSum + i,
+                                   learningRate, gradSumRate, momentum,
+                                   decayRate, epsilon, sz - i);
+}
+
+// mom = momentum * mom - learningRate * l * (g + decayRate * value)
+// value += mom, for the optimizers with a learning rate per element.
+static inline void sgd_update_lr_avx(float* value, float* mom, __m256 g,
+                                     __m256 l, __m256 rate, __m256 mo,
+                                     __m256 dr) {
+  __m256 w = _mm256_loadu_ps(value);
+  __m256 m = _mm256_loadu_ps(mom);
+  g = _mm256_add_ps(g, _mm256_mul_ps(dr, w));
+  g = _mm256_mul_ps(_mm256_mul_ps(rate, l), g);
+  m = _mm256_sub_ps(_mm256_mul_ps(mo, m), g);
+  _mm256_storeu_ps(mom, m);
+  _mm256_storeu_ps(value, _mm256_add_ps(w, m));
+}
+
+static void svrg_adadelta_avx(float* value, float* mom, float* lr,
+                              float* sqsum, float* sqsum1, const float* grad,
+                              const float* gradSum, float learningRate,
+                              float gradSumRate, float momentum,
+                              float decayRate, float rou, float epsilon,
+                              size_t sz) {
+  size_t i = 0;
+  __m256 rate = _mm256_set1_ps(learningRate);
+  __m256 sumRate = _mm256_set1_ps(gradSumRate);
+  __m256 mo = _mm256_set1_ps(momentum);
+  __m256 dr = _mm256_set1_ps(decayRate);
+  __m256 r = _mm256_set1_ps(rou);
+  __m256 r1 = _mm256_set1_ps(1 - rou);
+  __m256 eps = _mm256_set1_ps(epsilon);
+
+  for (; i + 8 <= sz; i += 8) {
+    __m256 g = _mm256_loadu_ps(grad + i);
+    __m256 s = _mm256_loadu_ps(gradSum + i);
+    __m256 sq = _mm256_loadu_ps(sqsum + i);
+    __m256 sq1 = _mm256_loadu_ps(sqsum1 + i);
+    g = _mm256_add_ps(g, _mm256_mul_ps(sumRate, s));
+    __m256 g2 = _mm256_mul_ps(_mm256_mul_ps(r1, g), g);
+    sq = _mm256_add_ps(_mm256_mul_ps(r, sq), g2);
+    _mm256_storeu_ps(sqsum + i, sq);
+    __m256 l = _mm256_sqrt_ps(
+        _mm256_div_ps(_mm256_add_ps(sq1, eps), _mm256_add_ps(sq, eps)));
+    _mm256_storeu_ps(lr + i, l);
+    sq1 = _mm256_add_ps(_mm256_mul_ps(r, sq1),
+                        _mm256_mul_ps(_mm256_mul_ps(g2, l), l));
+    _mm256_storeu_ps(sqsum1 + i, sq1);
+    sgd_update_lr_avx(value + i, mom + i, g, l, rate, mo, dr);
+  }
+  paddle::simd::naive::svrgAdadelta(value + i, mom + i, lr + i, sqsum + i,
+                                    sqsum1 + i, grad + i, gradSum + i,
+                                    learningRate, gradSumRate, momentum,
+                                    decayRate, rou, epsilon, sz - i);
+}
+
+static void svrg_rmsprop_avx(float* value, float* mom, float* lr,
+                             float* sqsum, float* sqsum1, const float* grad,
+                             const float* gradSum, float learningRate,
+                             float gradSumRate, float momentum,
+                             float decayRate, float rou, float sqsumRate,
+                             float epsilon, size_t sz) {
+  size_t i = 0;
+  __m256 rate = _mm256_set1_ps(learningRate);
+  __m256 sumRate = _mm256_set1_ps(gradSumRate);
+  __m256 mo = _mm256_set1_ps(momentum);
+  __m256 dr = _mm256_set1_ps(decayRate);
+  __m256 r = _mm256_set1_ps(rou);
+  __m256 r1 = _mm256_set1_ps(1 - rou);
+  __m256 sqRate = _mm256_set1_ps(sqsumRate);
+  __m256 eps = _mm256_set1_ps(epsilon);
+  __m256 one = _mm256_set1_ps(1.0f);
+
+  for (; i + 8 <= sz; i += 8) {
+    __m256 g = _mm256_loadu_ps(grad + i);
+    __m256 s = _mm256_loadu_ps(gradSum + i);
+    __m256 sq = _mm256_loadu_ps(sqsum + i);
+    __m256 sq1 = _mm256_loadu_ps(sqsum1 + i);
+    g = _mm256_add_ps(g, _mm256_mul_ps(sumRate, s));
+    sq = _mm256_add_ps(_mm256_mul_ps(r, sq),
+                       _mm256_mul_ps(_mm256_mul_ps(sqRate, g), g));
+    sq1 = _mm256_add_ps(_mm256_mul_ps(r, sq1), _mm256_mul_ps(r1, g));
+    _mm256_storeu_ps(sqsum + i, sq);
+    _mm256_storeu_ps(sqsum1 + i, sq1);
+    __m256 var = _mm256_sub_ps(sq, _mm256_mul_ps(sq1, sq1));
+    __m256 l =
+        _mm256_div_ps(one, _mm256_sqrt_ps(_mm256_add_ps(var, eps)));
+    _mm256_storeu_ps(lr + i, l);
+    sgd_update_lr_avx(value + i, mom + i, g, l, rate, mo, dr);
+  }
+  paddle::simd::naive::svrgRmsprop(value + i, mom + i, lr + i, sqsum + i,
+                                   sqsum1 + i, grad + i, gradSum + i,
+                                   learningRate, gradSumRate, momentum,
+                                   decayRate, rou, sqsumRate, epsilon, sz - i);
+}
+
+static void svrg_decayed_adagrad_avx(float* value, float* mom, float* lr,
+                                     float* sqsum, const float* grad,
+                                     const float* gradSum, float learningRate,
+                                     float gradSumRate, float momentum,
+                                     float decayRate, float rou,
+                                     float sqsumRate, float epsilon,
+                                     size_t sz) {
+  size_t i = 0;
+  __m256 rate = _mm256_set1_ps(learningRate);
+  __m256 sumRate = _mm256_set1_ps(gradSumRate);
+  __m256 mo = _mm256_set1_ps(momentum);
+  __m256 dr = _mm256_set1_ps(decayRate);
+  __m256 r = _mm256_set1_ps(rou);
+  __m256 sqRate = _mm256_set1_ps(sqsumRate);
+  __m256 eps = _mm256_set1_ps(epsilon);
+  __m256 one = _mm256_set1_ps(1.0f);
+
+  for (; i + 8 <= sz; i += 8) {
+    __m256 g = _mm256_loadu_ps(grad + i);
+    __m256 s = _mm256_loadu_ps(gradSum + i);
+    __m256 sq = _mm256_loadu_ps(sqsum + i);
+    g = _mm256_add_ps(g, _mm256_mul_ps(sumRate, s));
+    sq = _mm256_add_ps(_mm256_mul_ps(r, sq),
+                       _mm256_mul_ps(_mm256_mul_ps(sqRate, g), g));
+    _mm256_storeu_ps(sqsum + i, sq);
+    __m256 l = _mm256_div_ps(one, _mm256_sqrt_ps(_mm256_add_ps(sq, eps)));
+    _mm256_storeu_ps(lr + i, l);
+    sgd_update_lr_avx(value + i, mom + i, g, l, rate, mo, dr);
+  }
+  paddle::simd::naive::svrgDecayedAdagrad(value + i, mom + i, lr + i,
+                                          sqsum + i, grad + i, gradSum + i,
+                                          learningRate, gradSumRate, momentum,
+                                          decayRate, rou, sqsumRate, epsilon,
+                                          sz - i);
+}
+
+static void svrg_adam_avx(float* value, float* m, float* v, const float* grad,
+                          const float* gradSum, float alpha, float gradSumRate,
+                          float beta1, float beta2, float epsilon, size_t sz) {
+  size_t i = 0;
+  __m256 a = _mm256_set1_ps(alpha);
+  __m256 rate = _mm256_set1_ps(gradSumRate);
+  __m256 b1 = _mm256_set1_ps(beta1);
+  __m256 c1 = _mm256_set1_ps(1 - beta1);
+  __m256 b2 = _mm256_set1_ps(beta2);
+  __m256 c2 = _mm256_set1_ps(1 - beta2);
+  __m256 eps = _mm256_set1_ps(epsilon);
+
+  for (; i + 8 <= sz; i += 8) {
+    __m256 g = _mm256_loadu_ps(grad + i);
+    __m256 s = _mm256_loadu_ps(gradSum + i);
+    __m256 m1 = _mm256_loadu_ps(m + i);
+    __m256 v1 = _mm256_loadu_ps(v + i);
+    g = _mm256_add_ps(g, _mm256_mul_ps(rate, s));
+    m1 = _mm256_add_ps(_mm256_mul_ps(b1, m1), _mm256_mul_ps(c1, g));
+    v1 = _mm256_add_ps(_mm256_mul_ps(b2, v1),
+                       _mm256_mul_ps(c2, _mm256_mul_ps(g, g)));
+    _mm256_storeu_ps(m + i, m1);
+    _mm256_storeu_ps(v + i, v1);
+    __m256 denom = _mm256_add_ps(_mm256_sqrt_ps(v1), eps);
+    __m256 w = _mm256_loadu_ps(value + i);
+    w = _mm256_sub_ps(w, _mm256_div_ps(_mm256_mul_ps(a, m1), denom));
+    _mm256_storeu_ps(value + i, w);
+  }
+  paddle::simd::naive::svrgAdam(value + i, m + i, v + i, grad + i,
+                                gradSum + i, alpha, gradSumRate, beta1, beta2,
+                                epsilon, sz - i);
+}
+
+static void svrg_adamax_avx(float* value, float* m, float* u,
+                            const float* grad, const float* gradSum,
+                            float learningRate, float gradSumRate, float beta1,
+                            float beta2, size_t sz) {
+  size_t i = 0;
+  __m256 rate = _mm256_set1_ps(learningRate);
+  __m256 sumRate = _mm256_set1_ps(gradSumRate);
+  __m256 b1 = _mm256_set1_ps(beta1);
+  __m256 c1 = _mm256_set1_ps(1 - beta1);
+  __m256 b2 = _mm256_set1_ps(beta2);
+  __m256 signMask = _mm256_set1_ps(-0.0f);
+
+  for (; i + 8 <= sz; i += 8) {
+    __m256 g = _mm256_loadu_ps(grad + i);
+    __m256 s = _mm256_loadu_ps(gradSum + i);
+    __m256 m1 = _mm256_loadu_ps(m + i);
+    __m256 u1 = _mm256_loadu_ps(u + i);
+    g = _mm256_add_ps(g, _mm256_mul_ps(sumRate, s));
+    m1 = _mm256_add_ps(_mm256_mul_ps(b1, m1), _mm256_mul_ps(c1, g));
+    u1 = _mm256_max_ps(_mm256_mul_ps(b2, u1), _mm256_andnot_ps(signMask, g));
+    _mm256_storeu_ps(m + i, m1);
+    _mm256_storeu_ps(u + i, u1);
+    __m256 w = _mm256_loadu_ps(value + i);
+    w = _mm256_sub_ps(w, _mm256_mul_ps(rate, _mm256_div_ps(m1, u1)));
+    _mm256_storeu_ps(value + i, w);
+  }
+  paddle::simd::naive::svrgAdamax(value + i, m + i, u + i, grad + i,
+                                  gradSum + i, learningRate, gradSumRate,
+                                  beta1, beta2, sz - i);
+}
+
+// 4 fp16 in the low 16 bits of each lane -> 4 floats. Integer bit
+// manipulation instead of a float multiply, so that subnormal halfs are
+// not flushed by the denormals-are-zero mode.
+static inline __m128 half4_to_float(__m128i h) {
+  __m128i sign = _mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(0x8000)), 16);
+  __m128i exp = _mm_and_si128(h, _mm_set1_epi32(0x7c00));
+  __m128i bits = _mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(0x7fff)), 13);
+  __m128 normal =
+      _mm_castsi128_ps(_mm_add_epi32(bits, _mm_set1_epi32(112 << 23)));
+  __m128 infNan =
+      _mm_castsi128_ps(_mm_or_si128(bits, _mm_set1_epi32(0x7f800000)));
+  __m128 subnormal = _mm_mul_ps(
+      _mm_cvtepi32_ps(_mm_and_si128(h, _mm_set1_epi32(0x3ff))),
+      _mm_set1_ps(1.0f / (1 << 24)));
+  __m128 f = _mm_blendv_ps(
+      normal, infNan,
+      _mm_castsi128_ps(_mm_cmpeq_epi32(exp, _mm_set1_epi32(0x7c00))));
+  __m128i isSubnormal = _mm_cmpeq_epi32(exp, _mm_setzero_si128());
+  f = _mm_blendv_ps(f, subnormal, _mm_castsi128_ps(isSubnormal));
+  return _mm_or_ps(f, _mm_castsi128_ps(sign));
+}
+
+// The received blocks are not necessarily aligned.
+static void add_half_to_avx(float* a, const uint16_t* b, size_t sz) {
+  size_t i = 0;
+  for (; i + 8 <= sz; i += 8) {
+    __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+    __m256 f = _mm256_insertf128_ps(
+        _mm256_castps128_ps256(half4_to_float(_mm_cvtepu16_epi32(h))),
+        half4_to_float(_mm_cvtepu16_epi32(_mm_srli_si128(h, 8))), 1);
+    _mm256_storeu_ps(a + i, _mm256_add_ps(_mm256_loadu_ps(a + i), f));
+  }
+  paddle::simd::naive::addHalfTo(a + i, b + i, sz - i);
+}
+
+static void add_int8_to_avx(float* a, const int8_t* b, float scale,
+                            size_t sz) {
+  size_t i = 0;
+  __m256 s = _mm256_set1_ps(scale);
+  for (; i + 8 <= sz; i += 8) {
+    __m128i q = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(b + i));
+    __m256i q32 = _mm256_insertf128_si256(
+        _mm256_castsi128_si256(_mm_cvtepi8_epi32(q)),
+        _mm_cvtepi8_epi32(_mm_srli_si128(q, 4)), 1);
+    __m256 f = _mm256_mul_ps(s, _mm256_cvtepi32_ps(q32));
+    _mm256_storeu_ps(a + i, _mm256_add_ps(_mm256_loadu_ps(a + i), f));
+  }
+  paddle::simd::naive::addInt8To(a + i, b + i, scale, sz - i);
+}
+
 #endif
 
 #ifndef __AVX__
@@ -384,6 +694,77 @@ void decayL1AvxImpl(float* dst, float* src, float* lr, float lambda,
   decayL1_avx(dst, src, lr, lambda, len);
 }
 
+void svrgMomentumAvxImpl(float* value, float* mom, const float* grad,
+                         const float* gradSum, float learningRate,
+                         float gradSumRate, float momentum, float decayRate,
+                         size_t len) {
+  svrg_momentum_avx(value, mom, grad, gradSum, learningRate, gradSumRate,
+                    momentum, decayRate, len);
+}
+
+void svrgAdagradAvxImpl(float* value, float* mom, float* lr, float* sqsum1,
+                        const float* sqsum, const float* grad,
+                        const float* gradSum, float learningRate,
+                        float gradSumRate, float momentum, float decayRate,
+                        float epsilon, size_t len) {
+  svrg_adagrad_avx(value, mom, lr, sqsum1, sqsum, grad, gradSum, learningRate,
+                   gradSumRate, momentum, decayRate, epsilon, len);
+}
+
+void svrgAdadeltaAvxImpl(float* value, float* mom, float* lr, float* sqsum,
+                         float* sqsum1, const float* grad,
+                         const float* gradSum, float learningRate,
+                         float gradSumRate, float momentum, float decayRate,
+                         float rou, float epsilon, size_t len) {
+  svrg_adadelta_avx(value, mom, lr, sqsum, sqsum1, grad, gradSum,
+                    learningRate, gradSumRate, momentum, decayRate, rou,
+                    epsilon, len);
+}
+
+void svrgRmspropAvxImpl(float* value, float* mom, float* lr, float* sqsum,
+                        float* sqsum1, const float* grad, const float* gradSum,
+                        float learningRate, float gradSumRate, float momentum,
+                        float decayRate, float rou, float sqsumRate,
+                        float epsilon, size_t len) {
+  svrg_rmsprop_avx(value, mom, lr, sqsum, sqsum1, grad, gradSum, learningRate,
+                   gradSumRate, momentum, decayRate, rou, sqsumRate, epsilon,
+                   len);
+}
+
+void svrgDecayedAdagradAvxImpl(float* value, float* mom, float* lr,
+                               float* sqsum, const float* grad,
+                               const float* gradSum, float learningRate,
+                               float gradSumRate, float momentum,
+                               float decayRate, float rou, float sqsumRate,
+                               float epsilon, size_t len) {
+  svrg_decayed_adagrad_avx(value, mom, lr, sqsum, grad, gradSum, learningRate,
+                           gradSumRate, momentum, decayRate, rou, sqsumRate,
+                           epsilon, len);
+}
+
+void svrgAdamAvxImpl(float* value, float* m, float* v, const float* grad,
+                     const float* gradSum, float alpha, float gradSumRate,
+                     float beta1, float beta2, float epsilon, size_t len) {
+  svrg_adam_avx(value, m, v, grad, gradSum, alpha, gradSumRate, beta1, beta2,
+                epsilon, len);
+}
+
+void svrgAdamaxAvxImpl(float* value, float* m, float* u, const float* grad,
+                       const float* gradSum, float learningRate,
+                       float gradSumRate, float beta1, float beta2,
+                       size_t len) {
+  svrg_adamax_avx(value, m, u, grad, gradSum, learningRate, gradSumRate, beta1,
+                  beta2, len);
+}
+
+void addHalfToAvxImpl(float* a, const uint16_t* b, size_t len) {
+  add_half_to_avx(a, b, len);
+}
+
+void addInt8ToAvxImpl(float* a, const int8_t* b, float scale, size_t len) {
+  add_int8_to_avx(a, b, scale, len);
+}
+
 #endif
 }  // namespace internal
 }  // namespace simd
@@ -17,11 +17,58 @@ limitations under the License. */
 #pragma once
 #include <stddef.h>
 #include <stdint.h>
+#include <string.h>
+#include <cmath>
 
 namespace paddle {
 
 namespace simd {
 
+/// IEEE 754 binary32 -> binary16, round to nearest even.
+inline uint16_t floatToHalf(float f) {
+  uint32_t x;
+  memcpy(&x, &f, sizeof(x));
+  uint16_t sign = (x >> 16) & 0x8000;
+  uint32_t absx = x & 0x7fffffff;
+  if (absx >= 0x7f800000) {  // inf or nan
+    return sign | 0x7c00 | (absx > 0x7f800000 ? 0x200 : 0);
+  }
+  if (absx >= 0x47800000) {  // overflow
+    return sign | 0x7c00;
+  }
+  if (absx < 0x38800000) {  // subnormal half
+    uint32_t e = absx >> 23;
+    if (e < 102) return sign;
+    uint32_t m = (absx & 0x7fffff) | 0x800000;
+    uint32_t shift = 126 - e;
+    uint32_t h = m >> shift;
+    uint32_t rem = m & ((1U << shift) - 1);
+    uint32_t halfway = 1U << (shift - 1);
+    if (rem > halfway || (rem == halfway && (h & 1))) ++h;
+    return sign | h;
+  }
+  uint32_t h = (absx - 0x38000000) >> 13;
+  uint32_t rem = absx & 0x1fff;
+  if (rem > 0x1000 || (rem == 0x1000 && (h & 1))) ++h;
+  return sign | h;
+}
+
+/// IEEE 754 binary16 -> binary32, exact.
+inline float halfToFloat(uint16_t h) {
+  uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+  uint32_t e = (h >> 10) & 0x1f;
+  uint32_t m = h & 0x3ff;
+  if (e == 0) {
+    float f = ldexpf((float)m, -24);
+    return sign ? -f : f;
+  }
+  uint32_t x = sign | (e == 31 ? 0x7f800000 | (m << 13)
+                               : ((e + 112) << 23) | (m << 13));
+  float f;
+  memcpy(&f, &x, sizeof(f));
+  return f;
+}
+
 namespace naive {
 template <typename Type>
 inline void addTo(Type* a, const Type* b, size_t len) {
@@ -77,6 +124,173 @@ inline void decayL1(Type* dst, Type* src, Type lambda, size_t len) {
     }
   }
 }
+
+/**
+ * SVRG with momentum, g = grad + gradSumRate * gradSum
+ * mom = momentum * mom - learningRate * (g + decayRate * value)
+ * value += mom
+ */
+template <typename Type>
+inline void svrgMomentum(Type* value, Type* mom, const Type* grad,
+                         const Type* gradSum, Type learningRate,
+                         Type gradSumRate, Type momentum, Type decayRate,
+                         size_t len) {
+  for (size_t i = 0; i < len; ++i) {
+    Type g = grad[i] + gradSumRate * gradSum[i];
+    mom[i] = momentum * mom[i] - learningRate * (g + decayRate * value[i]);
+    value[i] += mom[i];
+  }
+}
+
+/**
+ * SVRG with adagrad, g = grad + gradSumRate * gradSum
+ * sqsum1 += g^2
+ * lr = 1 / sqrt(sqsum + sqsum1 + epsilon)
+ * mom = momentum * mom - learningRate * lr * (g + decayRate * value)
+ * value += mom
+ */
+template <typename Type>
+inline void svrgAdagrad(Type* value, Type* mom, Type* lr, Type* sqsum1,
+                        const Type* sqsum, const Type* grad,
+                        const Type* gradSum, Type learningRate,
+                        Type gradSumRate, Type momentum, Type decayRate,
+                        Type epsilon, size_t len) {
+  for (size_t i = 0; i < len; ++i) {
+    Type g = grad[i] + gradSumRate * gradSum[i];
+    sqsum1[i] += g * g;
+    lr[i] = 1 / std::sqrt(sqsum[i] + sqsum1[i] + epsilon);
+    mom[i] = momentum * mom[i] - learningRate * lr[i] *
+             (g + decayRate * value[i]);
+    value[i] += mom[i];
+  }
+}
+
+/**
+ * SVRG with adadelta, g = grad + gradSumRate * gradSum
+ * sqsum = rou * sqsum + (1 - rou) * g^2
+ * lr = sqrt((sqsum1 + epsilon) / (sqsum + epsilon))
+ * sqsum1 = rou * sqsum1 + (1 - rou) * (g * lr)^2
+ * mom = momentum * mom - learningRate * lr * (g + decayRate * value)
+ * value += mom
+ */
+template <typename Type>
+inline void svrgAdadelta(Type* value, Type* mom, Type* lr, Type* sqsum,
+                         Type* sqsum1, const Type* grad, const Type* gradSum,
+                         Type learningRate, Type gradSumRate, Type momentum,
+                         Type decayRate, Type rou, Type epsilon, size_t len) {
+  for (size_t i = 0; i < len; ++i) {
+    Type g = grad[i] + gradSumRate * gradSum[i];
+    sqsum[i] = rou * sqsum[i] + (1 - rou) * g * g;
+    lr[i] = std::sqrt((sqsum1[i] + epsilon) / (sqsum[i] + epsilon));
+    sqsum1[i] = rou * sqsum1[i] + (1 - rou) * g * g * lr[i] * lr[i];
+    mom[i] = momentum * mom[i] - learningRate * lr[i] *
+             (g + decayRate * value[i]);
+    value[i] += mom[i];
+  }
+}
+
+/**
+ * SVRG with rmsprop, g = grad + gradSumRate * gradSum
+ * sqsum = rou * sqsum + sqsumRate * g^2
+ * sqsum1 = rou * sqsum1 + (1 - rou) * g
+ * lr = 1 / sqrt(sqsum - sqsum1^2 + epsilon)
+ * mom = momentum * mom - learningRate * lr * (g + decayRate * value)
+ * value += mom
+ * sqsumRate is 1 for the first update, and 1 - rou after.
+ */
+template <typename Type>
+inline void svrgRmsprop(Type* value, Type* mom, Type* lr, Type* sqsum,
+                        Type* sqsum1, const Type* grad, const Type* gradSum,
+                        Type learningRate, Type gradSumRate, Type momentum,
+                        Type decayRate, Type rou, Type sqsumRate,
+                        Type epsilon, size_t len) {
+  for (size_t i = 0; i < len; ++i) {
+    Type g = grad[i] + gradSumRate * gradSum[i];
+    sqsum[i] = rou * sqsum[i] + sqsumRate * g * g;
+    sqsum1[i] = rou * sqsum1[i] + (1 - rou) * g;
+    lr[i] = 1 / std::sqrt(sqsum[i] - sqsum1[i] * sqsum1[i] + epsilon);
+    mom[i] = momentum * mom[i] - learningRate * lr[i] *
+             (g + decayRate * value[i]);
+    value[i] += mom[i];
+  }
+}
+
+/**
+ * SVRG with decayed adagrad, g = grad + gradSumRate * gradSum
+ * sqsum = rou * sqsum + sqsumRate * g^2
+ * lr = 1 / sqrt(sqsum + epsilon)
+ * mom = momentum * mom - learningRate * lr * (g + decayRate * value)
+ * value += mom
+ * sqsumRate is 1 for the first update, and 1 - rou after.
+ */
+template <typename Type>
+inline void svrgDecayedAdagrad(Type* value, Type* mom, Type* lr, Type* sqsum,
+                               const Type* grad, const Type* gradSum,
+                               Type learningRate, Type gradSumRate,
+                               Type momentum, Type decayRate, Type rou,
+                               Type sqsumRate, Type epsilon, size_t len) {
+  for (size_t i = 0; i < len; ++i) {
+    Type g = grad[i] + gradSumRate * gradSum[i];
+    sqsum[i] = rou * sqsum[i] + sqsumRate * g * g;
+    lr[i] = 1 / std::sqrt(sqsum[i] + epsilon);
+    mom[i] = momentum * mom[i] - learningRate * lr[i] *
+             (g + decayRate * value[i]);
+    value[i] += mom[i];
+  }
+}
+
+/**
+ * SVRG with adam, g = grad + gradSumRate * gradSum
+ * m = beta1 * m + (1 - beta1) * g
+ * v = beta2 * v + (1 - beta2) * g^2
+ * value -= alpha * m / (sqrt(v) + epsilon)
+ */
+template <typename Type>
+inline void svrgAdam(Type* value, Type* m, Type* v, const Type* grad,
+                     const Type* gradSum, Type alpha, Type gradSumRate,
+                     Type beta1, Type beta2, Type epsilon, size_t len) {
+  for (size_t i = 0; i < len; ++i) {
+    Type g = grad[i] + gradSumRate * gradSum[i];
+    m[i] = beta1 * m[i] + (1 - beta1) * g;
+    v[i] = beta2 * v[i] + (1 - beta2) * g * g;
+    value[i] -= alpha * m[i] / (std::sqrt(v[i]) + epsilon);
+  }
+}
+
+/// a += fp16 b
+template <typename Type>
+inline void addHalfTo(Type* a, const uint16_t* b, size_t len) {
+  for (size_t i = 0; i < len; ++i) {
+    a[i] += halfToFloat(b[i]);
+  }
+}
+
+/// a += scale * b
+template <typename Type>
+inline void addInt8To(Type* a, const int8_t* b, Type scale, size_t len) {
+  for (size_t i = 0; i < len; ++i) {
+    a[i] += scale * b[i];
+  }
+}
+
+/**
+ * SVRG with adamax, g = grad + gradSumRate * gradSum
+ * m = beta1 * m + (1 - beta1) * g
+ * u = max(beta2 * u, |g|)
+ * value -= learningRate * m / u
+ */
+template <typename Type>
+inline void svrgAdamax(Type* value, Type* m, Type* u, const Type* grad,
+                       const Type* gradSum, Type learningRate,
+                       Type gradSumRate, Type beta1, Type beta2, size_t len) {
+  for (size_t i = 0; i < len; ++i) {
+    Type g = grad[i] + gradSumRate * gradSum[i];
+    m[i] = beta1 * m[i] + (1 - beta1) * g;
+    Type absG = std::abs(g);
+    u[i] = beta2 * u[i] > absG ? beta2 * u[i] : absG;
+    value[i] -= learningRate * (m[i] / u[i]);
+  }
+}
 }  // namespace naive
 
 template <typename Type>
@@ -104,6 +318,84 @@ inline void decayL1(Type* dst, Type* src, Type lambda, size_t len) {
   naive::decayL1(dst, src, lambda, len);
 }
 
+template <typename Type>
+inline void svrgMomentum(Type* value, Type* mom, const Type* grad,
+                         const Type* gradSum, Type learningRate,
+                         Type gradSumRate, Type momentum, Type decayRate,
+                         size_t len) {
+  naive::svrgMomentum(value, mom, grad, gradSum, learningRate, gradSumRate,
+                      momentum, decayRate, len);
+}
+
+template <typename Type>
+inline void svrgAdagrad(Type* value, Type* mom, Type* lr, Type* sqsum1,
+                        const Type* sqsum, const Type* grad,
+                        const Type* gradSum, Type learningRate,
+                        Type gradSumRate, Type momentum, Type decayRate,
+                        Type epsilon, size_t len) {
+  naive::svrgAdagrad(value, mom, lr, sqsum1, sqsum, grad, gradSum,
+                     learningRate, gradSumRate, momentum, decayRate, epsilon,
+                     len);
+}
+
+template <typename Type>
+inline void svrgAdadelta(Type* value, Type* mom, Type* lr, Type* sqsum,
+                         Type* sqsum1, const Type* grad, const Type* gradSum,
+                         Type learningRate, Type gradSumRate, Type momentum,
+                         Type decayRate, Type rou, Type epsilon, size_t len) {
+  naive::svrgAdadelta(value, mom, lr, sqsum, sqsum1, grad, gradSum,
+                      learningRate, gradSumRate, momentum, decayRate, rou,
+                      epsilon, len);
+}
+
+template <typename Type>
+inline void svrgRmsprop(Type* value, Type* mom, Type* lr, Type* sqsum,
+                        Type* sqsum1, const Type* grad, const Type* gradSum,
+                        Type learningRate, Type gradSumRate, Type momentum,
+                        Type decayRate, Type rou, Type sqsumRate,
+                        Type epsilon, size_t len) {
+  naive::svrgRmsprop(value, mom, lr, sqsum, sqsum1, grad, gradSum,
+                     learningRate, gradSumRate, momentum, decayRate, rou,
+                     sqsumRate, epsilon, len);
+}
+
+template <typename Type>
+inline void svrgDecayedAdagrad(Type* value, Type* mom, Type* lr, Type* sqsum,
+                               const Type* grad, const Type* gradSum,
+                               Type learningRate, Type gradSumRate,
+                               Type momentum, Type decayRate, Type rou,
+                               Type sqsumRate, Type epsilon, size_t len) {
+  naive::svrgDecayedAdagrad(value, mom, lr, sqsum, grad, gradSum,
+                            learningRate, gradSumRate, momentum, decayRate,
+                            rou, sqsumRate, epsilon, len);
+}
+
+template <typename Type>
+inline void svrgAdam(Type* value, Type* m, Type* v, const Type* grad,
+                     const Type* gradSum, Type alpha, Type gradSumRate,
+                     Type beta1, Type beta2, Type epsilon, size_t len) {
+  naive::svrgAdam(value, m, v, grad, gradSum, alpha, gradSumRate, beta1,
+                  beta2, epsilon, len);
+}
+
+template <typename Type>
+inline void svrgAdamax(Type* value, Type* m, Type* u, const Type* grad,
+                       const Type* gradSum, Type learningRate,
+                       Type gradSumRate, Type beta1, Type beta2, size_t len) {
+  naive::svrgAdamax(value, m, u, grad, gradSum, learningRate, gradSumRate,
+                    beta1, beta2, len);
+}
+
+template <typename Type>
+inline void addHalfTo(Type* a, const uint16_t* b, size_t len) {
+  naive::addHalfTo(a, b, len);
+}
+
+template <typename Type>
+inline void addInt8To(Type* a, const int8_t* b, Type scale, size_t len) {
+  naive::addInt8To(a, b, scale, len);
+}
+
 template <size_t AlignSize>
 inline bool isPointerAlign(void* ptr) {
   return reinterpret_cast<uintptr_t>(ptr) % AlignSize == 0;
@@ -125,6 +417,40 @@ void colMaxImpl(float* result, const float* data, int dim, int numSamples);
 void decayL1AvxImpl(float* dst, float* src, float lambda, size_t len);
 void decayL1AvxImpl(float* dst, float* src, float* lr, float lambda,
                     size_t len);
+void svrgMomentumAvxImpl(float* value, float* mom, const float* grad,
+                         const float* gradSum, float learningRate,
+                         float gradSumRate, float momentum, float decayRate,
+                         size_t len);
+void svrgAdagradAvxImpl(float* value, float* mom, float* lr, float* sqsum1,
+                        const float* sqsum, const float* grad,
+                        const float* gradSum, float learningRate,
+                        float gradSumRate, float momentum, float decayRate,
+                        float epsilon, size_t len);
+void svrgAdadeltaAvxImpl(float* value, float* mom, float* lr, float* sqsum,
+                         float* sqsum1, const float* grad,
+                         const float* gradSum, float learningRate,
+                         float gradSumRate, float momentum, float decayRate,
+                         float rou, float epsilon, size_t len);
+void svrgRmspropAvxImpl(float* value, float* mom, float* lr, float* sqsum,
+                        float* sqsum1, const float* grad, const float* gradSum,
+                        float learningRate, float gradSumRate, float momentum,
+                        float decayRate, float rou, float sqsumRate,
+                        float epsilon, size_t len);
+void svrgDecayedAdagradAvxImpl(float* value, float* mom, float* lr,
+                               float* sqsum, const float* grad,
+                               const float* gradSum, float learningRate,
+                               float gradSumRate, float momentum,
+                               float decayRate, float rou, float sqsumRate,
+                               float epsilon, size_t len);
+void svrgAdamAvxImpl(float* value, float* m, float* v, const float* grad,
+                     const float* gradSum, float alpha, float gradSumRate,
+                     float beta1, float beta2, float epsilon, size_t len);
+void svrgAdamaxAvxImpl(float* value, float* m, float* u, const float* grad,
+                       const float* gradSum, float learningRate,
+                       float gradSumRate, float beta1, float beta2,
+                       size_t len);
+void addHalfToAvxImpl(float* a, const uint16_t* b, size_t len);
+void addInt8ToAvxImpl(float* a, const int8_t* b, float scale, size_t len);
 #endif
 }  // namespace internal
 
@@ -162,6 +488,134 @@ inline void decayL1(float* dst, float* src, float* lr, float lambda,
 #endif
 }
 
+template <>
+inline void svrgMomentum(float* value, float* mom, const float* grad,
+                         const float* gradSum, float learningRate,
+                         float gradSumRate, float momentum, float decayRate,
+                         size_t len) {
+#ifdef __AVX__
+  internal::svrgMomentumAvxImpl(value, mom, grad, gradSum, learningRate,
+                                gradSumRate, momentum, decayRate, len);
+#else
+  naive::svrgMomentum(value, mom, grad, gradSum, learningRate, gradSumRate,
+                      momentum, decayRate, len);
+#endif
+}
+
+template <>
+inline void svrgAdagrad(float* value, float* mom, float* lr, float* sqsum1,
+                        const float* sqsum, const float* grad,
+                        const float* gradSum, float learningRate,
+                        float gradSumRate, float momentum, float decayRate,
+                        float epsilon, size_t len) {
+#ifdef __AVX__
+  internal::svrgAdagradAvxImpl(value, mom, lr, sqsum1, sqsum, grad, gradSum,
+                               learningRate, gradSumRate, momentum, decayRate,
+                               epsilon, len);
+#else
+  naive::svrgAdagrad(value, mom, lr, sqsum1, sqsum, grad, gradSum,
+                     learningRate, gradSumRate, momentum, decayRate, epsilon,
+                     len);
+#endif
+}
+
+template <>
+inline void svrgAdadelta(float* value, float* mom, float* lr, float* sqsum,
+                         float* sqsum1, const float* grad,
+                         const float* gradSum, float learningRate,
+                         float gradSumRate, float momentum, float decayRate,
+                         float rou, float epsilon, size_t len) {
+#ifdef __AVX__
+  internal::svrgAdadeltaAvxImpl(value, mom, lr, sqsum, sqsum1, grad, gradSum,
+                                learningRate, gradSumRate, momentum,
+                                decayRate, rou, epsilon, len);
+#else
+  naive::svrgAdadelta(value, mom, lr, sqsum, sqsum1, grad, gradSum,
+                      learningRate, gradSumRate, momentum, decayRate, rou,
+                      epsilon, len);
+#endif
+}
+
+template <>
+inline void svrgRmsprop(float* value, float* mom, float* lr, float* sqsum,
+                        float* sqsum1, const float* grad, const float* gradSum,
+                        float learningRate, float gradSumRate, float momentum,
+                        float decayRate, float rou, float sqsumRate,
+                        float epsilon, size_t len) {
+#ifdef __AVX__
+  internal::svrgRmspropAvxImpl(value, mom, lr, sqsum, sqsum1, grad, gradSum,
+                               learningRate, gradSumRate, momentum, decayRate,
+                               rou, sqsumRate, epsilon, len);
+#else
+  naive::svrgRmsprop(value, mom, lr, sqsum, sqsum1, grad, gradSum,
+                     learningRate, gradSumRate, momentum, decayRate, rou,
+                     sqsumRate, epsilon, len);
+#endif
+}
+
+template <>
+inline void svrgDecayedAdagrad(float* value, float* mom, float* lr,
+                               float* sqsum, const float* grad,
+                               const float* gradSum, float learningRate,
+                               float gradSumRate, float momentum,
+                               float decayRate, float rou, float sqsumRate,
+                               float epsilon, size_t len) {
+#ifdef __AVX__
+  internal::svrgDecayedAdagradAvxImpl(value, mom, lr, sqsum, grad, gradSum,
+                                      learningRate, gradSumRate, momentum,
+                                      decayRate, rou, sqsumRate, epsilon, len);
+#else
+  naive::svrgDecayedAdagrad(value, mom, lr, sqsum, grad, gradSum,
+                            learningRate, gradSumRate, momentum, decayRate,
+                            rou, sqsumRate, epsilon, len);
+#endif
+}
+
+template <>
+inline void svrgAdam(float* value, float* m, float* v, const float* grad,
+                     const float* gradSum, float alpha, float gradSumRate,
+                     float beta1, float beta2, float epsilon, size_t len) {
+#ifdef __AVX__
+  internal::svrgAdamAvxImpl(value, m, v, grad, gradSum, alpha, gradSumRate,
+                            beta1, beta2, epsilon, len);
+#else
+  naive::svrgAdam(value, m, v, grad, gradSum, alpha, gradSumRate, beta1,
+                  beta2, epsilon, len);
+#endif
+}
+
+template <>
+inline void svrgAdamax(float* value, float* m, float* u, const float* grad,
+                       const float* gradSum, float learningRate,
+                       float gradSumRate, float beta1, float beta2,
+                       size_t len) {
+#ifdef __AVX__
+  internal::svrgAdamaxAvxImpl(value, m, u, grad, gradSum, learningRate,
+                              gradSumRate, beta1, beta2, len);
+#else
+  naive::svrgAdamax(value, m, u, grad, gradSum, learningRate, gradSumRate,
+                    beta1, beta2, len);
+#endif
+}
+
+template <>
+inline void addHalfTo(float* a, const uint16_t* b, size_t len) {
+#ifdef __AVX__
+  internal::addHalfToAvxImpl(a, b, len);
+#else
+  naive::addHalfTo(a, b, len);
+#endif
+}
+
+template <>
+inline void addInt8To(float* a, const int8_t* b, float scale, size_t len) {
+#ifdef __AVX__
+  internal::addInt8ToAvxImpl(a, b, scale, len);
+#else
+  naive::addInt8To(a, b, scale, len);
+#endif
+}
+
 }  // namespace simd
 
 }  // namespace paddle
@@ -247,6 +247,29 @@ void SparsePrefetchRowCpuMatrix::addRows(IVectorPtr ids) {
   }
 }
 
+void SparseAutoGrowRowCpuMatrix::addRows(MatrixPtr input) {
+  if (auto mat = dynamic_cast<CpuSparseMatrix*>(input.get())) {
+    const int* cols = mat->getCols();
+    for (size_t i = 0; i < mat->getElementCnt(); ++i) {
+      getRow(cols[i]);
+    }
+  } else {
+    // a dense input uses all the rows
+    for (size_t i = 0; i < height_; ++i) {
+      getRow(i);
+    }
+  }
+}
+
+void SparseAutoGrowRowCpuMatrix::addRows(IVectorPtr ids) {
+  size_t numSamples = ids->getSize();
+  int* index = ids->getData();
+  for (size_t i = 0; i < numSamples; ++i) {
+    if (index[i] == -1) continue;
+    getRow(index[i]);
+  }
+}
+
 void SparsePrefetchRowCpuMatrix::setupIndices() {
   auto& localIndices = indexDictHandle_->localIndices;
   uniqueIds(localIndices);
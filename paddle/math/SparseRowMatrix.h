@@ -257,6 +257,13 @@ public:
   virtual real* getRowBuf(size_t row) { return getRow(row); }
 
   virtual void mul(CpuSparseMatrix* a, CpuMatrix* b, real scaleAB, real scaleT);
+
+  /**
+   * register the rows before they are written, e.g. the rows of the
+   * gradient used by a batch are known in GradientMachine::prefetch()
+   */
+  void addRows(MatrixPtr input);
+  void addRows(IVectorPtr ids);
 };
 
 class CacheRowCpuMatrix : public SparseAutoGrowRowCpuMatrix {
@@ -308,6 +315,8 @@ public:
 
   std::vector<uint32_t>& getIds(size_t threadId) { return idsArray_[threadId]; }
 
+  size_t getNumOfThreads() const { return idsArray_.size(); }
+
 private:
   std::vector<std::vector<uint32_t>> idsArray_;
 };
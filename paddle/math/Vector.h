@@ -100,6 +100,17 @@ public:
 
   MemoryHandlePtr getMemoryHandle() const { return memoryHandle_; }
 
+  /**
+   * Exchange the memory of this and vec without copying any element.
+   * Other vectors and matrices created on the memory still point to it.
+   */
+  void swapMemory(VectorT<T>& vec) {
+    CHECK_EQ(this->size_, vec.size_);
+    CHECK_EQ(this->useGpu_, vec.useGpu_);
+    std::swap(this->data_, vec.data_);
+    std::swap(memoryHandle_, vec.memoryHandle_);
+  }
+
   /**
    * resizing to a big vector will not preserve old values.
    */
@@ -0,0 +1,253 @@
+/* Copyright (c) 2016 Baidu, Inc. All Rights Reserve.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include <gtest/gtest.h>
+
+#include <stdlib.h>
+#include <sys/time.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "hl_matrix_ops.cuh"
+#include "hl_matrix_apply.cuh"
+#include "paddle/math/CpuApply.h"
+#include "paddle/math/Vector.h"
+#include "paddle/utils/Util.h"
+
+P_DECLARE_string(cpu_apply_isa);
+P_DECLARE_int32(cpu_apply_threads);
+P_DECLARE_int32(cpu_apply_parallel_size);
+
+using namespace paddle;  // NOLINT
+
+DEFINE_MATRIX_UNARY_PARAMETER_OP(TestScale, ONE_PARAMETER, a = a * p + 1);
+DEFINE_MATRIX_BINARY_PARAMETER_OP(TestAxpy, ONE_PARAMETER, a = a + b * p);
+DEFINE_MATRIX_TERNARY_OP(TestFma, a = b * c + a);
+DEFINE_MATRIX_QUATERNARY_OP(TestMulSub, a = b * c - d + a);
+
+static std::vector<real> randData(size_t size) {
+  std::vector<real> data(size);
+  for (auto& x : data) {
+    x = (real)rand() / RAND_MAX + 0.1;  // NOLINT
+  }
+  return data;
+}
+
+/// bit for bit, the results must not depend on the cpu or the threads
+static void checkEqual(const std::vector<real>& expected,
+                       const std::vector<real>& actual) {
+  ASSERT_EQ(expected.size(), actual.size());
+  for (size_t i = 0; i < expected.size(); ++i) {
+    ASSERT_EQ(expected[i], actual[i]) << "at " << i;
+  }
+}
+
+/**
+ * the cpu apply engine against hl_cpu_apply_*_op for a (dimM, dimN)
+ * matrix of leading dimension ld, the row and column vectors of
+ * ld * dimM elements too.
+ */
+template <bool AsRowVector, bool AsColVector>
+void testApply(int dimM, int dimN, int ld) {
+  size_t size = (size_t)dimM * ld;
+  std::vector<real> a = randData(size);
+  std::vector<real> b = randData(size);
+  std::vector<real> c = randData(size);
+  std::vector<real> d = randData(size);
+  std::vector<real> expected;
+  std::vector<real> actual;
+
+  expected = a;
+  actual = a;
+  hl_cpu_apply_unary_op(unary::TestScale<real>(0.5), expected.data(), dimM,
+                        dimN, ld);
+  cpuApplyUnary(unary::TestScale<real>(0.5), actual.data(), dimM, dimN, ld);
+  checkEqual(expected, actual);
+
+  expected = a;
+  actual = a;
+  hl_cpu_apply_binary_op<real, binary::TestAxpy<real>, AsRowVector,
+                         AsColVector>(binary::TestAxpy<real>(2),
+                                      expected.data(), b.data(), dimM, dimN,
+                                      ld, ld);
+  cpuApplyBinary<real, binary::TestAxpy<real>, AsRowVector, AsColVector>(
+      binary::TestAxpy<real>(2), actual.data(), b.data(), dimM, dimN, ld, ld);
+  checkEqual(expected, actual);
+
+  expected = a;
+  actual = a;
+  hl_cpu_apply_ternary_op<real, ternary::TestFma<real>, AsRowVector,
+                          AsColVector>(ternary::TestFma<real>(),
+                                       expected.data(), b.data(), c.data(),
+                                       dimM, dimN, ld, ld, ld);
+  cpuApplyTernary<real, ternary::TestFma<real>, AsRowVector, AsColVector>(
+      ternary::TestFma<real>(), actual.data(), b.data(), c.data(), dimM, dimN,
+      ld, ld, ld);
+  checkEqual(expected, actual);
+
+  expected = a;
+  actual = a;
+  hl_cpu_apply_quaternary_op(quaternary::TestMulSub<real>(), expected.data(),
+                             b.data(), c.data(), d.data(), dimM, dimN, ld,
+                             ld, ld, ld);
+  cpuApplyQuaternary(quaternary::TestMulSub<real>(), actual.data(), b.data(),
+                     c.data(), d.data(), dimM, dimN, ld, ld, ld, ld);
+  checkEqual(expected, actual);
+}
+
+static void testAllShapes() {
+  for (auto dimM : {1, 7, 37}) {
+    for (auto dimN : {1, 13, 1000}) {
+      for (auto pad : {0, 3}) {
+        VLOG(3) << " dimM=" << dimM << " dimN=" << dimN << " pad=" << pad;
+        testApply<false, false>(dimM, dimN, dimN + pad);
+        testApply<true, false>(dimM, dimN, dimN + pad);
+        testApply<false, true>(dimM, dimN, dimN + pad);
+        testApply<true, true>(dimM, dimN, dimN + pad);
+      }
+    }
+  }
+}
+
+TEST(CpuApply, serial) {
+  for (auto isa : {"sse", "avx2", "avx512", "auto"}) {
+    FLAGS_cpu_apply_isa = isa;
+    testAllShapes();
+  }
+  FLAGS_cpu_apply_isa = "auto";
+}
+
+TEST(CpuApply, parallel) {
+  int threads = FLAGS_cpu_apply_threads;
+  int parallelSize = FLAGS_cpu_apply_parallel_size;
+  FLAGS_cpu_apply_parallel_size = 1;
+  for (auto numThreads : {2, 3, 4}) {
+    FLAGS_cpu_apply_threads = numThreads;
+    testAllShapes();
+  }
+  FLAGS_cpu_apply_threads = threads;
+  FLAGS_cpu_apply_parallel_size = parallelSize;
+}
+
+/// the fused operators against the unfused ones, under every isa
+TEST(CpuApply, fused) {
+  const size_t size = 1003;
+  CpuVector b(size);
+  CpuVector c(size);
+  CpuVector expected(size);
+  CpuVector actual(size);
+  b.uniform(1.0, 2.0);
+  c.uniform(0.0, 1.0);
+  auto data = [&](CpuVector& vec) {
+    return std::vector<real>(vec.getData(), vec.getData() + size);
+  };
+#ifdef PADDLE_USE_MKL
+  /// invSqrt() calls the vsInvSqrt of mkl, which is not correctly rounded
+  auto checkEqual = [](const std::vector<real>& expected,
+                       const std::vector<real>& actual) {
+    for (size_t i = 0; i < expected.size(); ++i) {
+      ASSERT_NEAR(expected[i], actual[i], 1e-5) << "at " << i;
+    }
+  };
+#endif
+
+  for (auto isa : {"sse", "avx2", "avx512"}) {
+    FLAGS_cpu_apply_isa = isa;
+    expected.add(b, c);
+    expected.add(1e-6);
+    expected.invSqrt(expected);
+    actual.invSqrtSum(b, c, 1e-6);
+    checkEqual(data(expected), data(actual));
+
+    expected.assign(b);
+    expected.addSquare(c, -1.0f);
+    expected.add(1e-6);
+    expected.invSqrt(expected);
+    actual.invSqrtVar(b, c, 1e-6);
+    checkEqual(data(expected), data(actual));
+
+    expected.assign(1e-6);
+    expected.add(b);
+    expected.invSqrt(expected);
+    actual.invSqrtAdd(b, 1e-6);
+    checkEqual(data(expected), data(actual));
+  }
+  FLAGS_cpu_apply_isa = "auto";
+}
+
+static double timeIt(const std::function<void()>& func, int times) {
+  struct timeval begin, end;
+  func();
+  gettimeofday(&begin, nullptr);
+  for (int i = 0; i < times; ++i) {
+    func();
+  }
+  gettimeofday(&end, nullptr);
+  return ((end.tv_sec - begin.tv_sec) + (end.tv_usec - begin.tv_usec) * 1e-6) /
+         times;
+}
+
+/// GB/s of the element wise operators, logged for comparison
+TEST(CpuApply, benchmark) {
+  const size_t size = 1 << 22;
+  const int times = 10;
+  CpuVector a(size);
+  CpuVector b(size);
+  CpuVector c(size);
+  CpuVector d(size);
+  a.uniform(0.0, 1.0);
+  b.uniform(0.0, 1.0);
+  c.uniform(0.0, 1.0);
+  d.uniform(0.0, 1.0);
+
+  /// numVectors is the number of vectors read or written
+  auto bench = [&](const std::string& name, int numVectors,
+                   const std::function<void()>& func) {
+    double seconds = timeIt(func, times);
+    double gbs = numVectors * size * sizeof(real) / seconds / 1e9;
+    LOG(INFO) << name << ": " << gbs << " GB/s";
+  };
+
+  auto benchAll = [&]() {
+    bench("add", 3, [&]() { a.add(b); });
+    bench("mulScalar", 2, [&]() { a.mulScalar(b, 0.5); });
+    bench("relu", 2, [&]() { a.relu(b); });
+    bench("sgdUpdate", 6,
+          [&]() { a.sgdUpdate(b, c, d, 1e-4, 0.9, 1e-5); });
+    bench("svrgUpdate", 4, [&]() { a.svrgUpdate(b, c, 1e-4, 1e-5, 1e-5); });
+    /// both counted as the traffic of the fused operator
+    bench("invSqrt unfused", 3, [&]() {
+      a.add(b, c);
+      a.add(1e-6);
+      a.invSqrt(a);
+    });
+    bench("invSqrtSum fused", 3, [&]() { a.invSqrtSum(b, c, 1e-6); });
+  };
+
+  int threads = FLAGS_cpu_apply_threads;
+  FLAGS_cpu_apply_threads = 1;
+  LOG(INFO) << "one thread:";
+  benchAll();
+  FLAGS_cpu_apply_threads = 0;
+  LOG(INFO) << "all threads:";
+  benchAll();
+  FLAGS_cpu_apply_threads = threads;
+}
+
+int main(int argc, char** argv) {
+  paddle::initMain(argc, argv);
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
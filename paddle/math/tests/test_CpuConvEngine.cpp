@@ -0,0 +1,275 @@
+/* Copyright (c) 2016 Baidu, Inc. All Rights Reserve.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include <gtest/gtest.h>
+
+#include <sys/time.h>
+#include <cmath>
+#include <functional>
+#include <vector>
+
+#include "paddle/math/CpuConvEngine.h"
+#include "paddle/math/Matrix.h"
+#include "paddle/utils/Util.h"
+
+using namespace paddle;  // NOLINT
+
+static ConvShape makeShape(int channels, int imgH, int imgW, int filterSize,
+                           int stride, int padding, int numFilters,
+                           int groups) {
+  ConvShape shape;
+  shape.channels = channels;
+  shape.imgH = imgH;
+  shape.imgW = imgW;
+  shape.filterSize = filterSize;
+  shape.stride = stride;
+  shape.padding = padding;
+  shape.outH = (imgH + 2 * padding - filterSize) / stride + 1;
+  shape.outW = (imgW + 2 * padding - filterSize) / stride + 1;
+  shape.numFilters = numFilters;
+  shape.groups = groups;
+  return shape;
+}
+
+static CpuMatrixPtr randMatrix(size_t height, size_t width) {
+  CpuMatrixPtr mat = std::make_shared<CpuMatrix>(height, width);
+  mat->randomizeUniform();
+  return mat;
+}
+
+/// the per sample convExpand() and mul() of ExpandConvLayer
+class SampleConv {
+public:
+  explicit SampleConv(const ConvShape& shape)
+      : shape_(shape),
+        subK_(shape.getSubK()),
+        subM_(shape.getSubM()),
+        subN_(shape.getSubN()),
+        expand_(new CpuMatrix(subK_ * shape.groups, subN_)) {}
+
+  void forward(CpuMatrix& input, CpuMatrix& weight, CpuMatrix& output) {
+    for (size_t n = 0; n < input.getHeight(); ++n) {
+      CpuMatrix image(input.getRowBuf(n), 1, shape_.getImageSize());
+      expand(image);
+      for (int g = 0; g < shape_.groups; ++g) {
+        MatrixPtr a = std::make_shared<CpuMatrix>(
+            weight.getData() + g * subK_ * subM_, subK_, subM_, true);
+        MatrixPtr b = std::make_shared<CpuMatrix>(
+            expand_->getData() + g * subK_ * subN_, subK_, subN_);
+        CpuMatrix c(output.getRowBuf(n) + g * subM_ * subN_, subM_, subN_);
+        c.mul(a, b, 1, 1);
+      }
+    }
+  }
+
+  void backward(CpuMatrix& input, CpuMatrix& weight, CpuMatrix& outputGrad,
+                CpuMatrix& inputGrad, CpuMatrix& weightGrad) {
+    for (size_t n = 0; n < input.getHeight(); ++n) {
+      CpuMatrix image(input.getRowBuf(n), 1, shape_.getImageSize());
+      expand(image);
+      for (int g = 0; g < shape_.groups; ++g) {
+        MatrixPtr a = std::make_shared<CpuMatrix>(
+            expand_->getData() + g * subK_ * subN_, subK_, subN_);
+        MatrixPtr b = std::make_shared<CpuMatrix>(
+            outputGrad.getRowBuf(n) + g * subM_ * subN_, subM_, subN_, true);
+        CpuMatrix c(weightGrad.getData() + g * subK_ * subM_, subK_, subM_);
+        c.mul(a, b, 1, 1);
+      }
+      for (int g = 0; g < shape_.groups; ++g) {
+        MatrixPtr a = std::make_shared<CpuMatrix>(
+            weight.getData() + g * subK_ * subM_, subK_, subM_);
+        MatrixPtr b = std::make_shared<CpuMatrix>(
+            outputGrad.getRowBuf(n) + g * subM_ * subN_, subM_, subN_);
+        CpuMatrix c(expand_->getData() + g * subK_ * subN_, subK_, subN_);
+        c.mul(a, b, 1, 0);
+      }
+      CpuMatrix imageGrad(inputGrad.getRowBuf(n), 1, shape_.getImageSize());
+      imageGrad.convShrink(*expand_, shape_.imgH, shape_.imgW, shape_.channels,
+                           shape_.filterSize, shape_.filterSize, shape_.stride,
+                           shape_.stride, shape_.padding, shape_.padding,
+                           shape_.outH, shape_.outW, 1.0f, 1.0f);
+    }
+  }
+
+protected:
+  void expand(CpuMatrix& image) {
+    expand_->convExpand(image, shape_.imgH, shape_.imgW, shape_.channels,
+                        shape_.filterSize, shape_.filterSize, shape_.stride,
+                        shape_.stride, shape_.padding, shape_.padding,
+                        shape_.outH, shape_.outW);
+  }
+
+  ConvShape shape_;
+  int subK_;
+  int subM_;
+  int subN_;
+  CpuMatrixPtr expand_;
+};
+
+static void checkEqual(CpuMatrix& expect, CpuMatrix& actual, real epsilon) {
+  ASSERT_EQ(expect.getElementCnt(), actual.getElementCnt());
+  for (size_t i = 0; i < expect.getElementCnt(); ++i) {
+    real e = expect.getData()[i];
+    real a = actual.getData()[i];
+    ASSERT_NEAR(e, a, epsilon * std::max((real)1, std::fabs(e))) << i;
+  }
+}
+
+static const size_t kBatchSize = 5;
+
+static std::vector<ConvShape> testShapes() {
+  /// the output of caffe_mode = false covers one more stride
+  ConvShape noCaffe = makeShape(2, 10, 10, 3, 2, 0, 3, 1);
+  noCaffe.outH = noCaffe.outW = 5;
+  return {
+      noCaffe,
+      makeShape(3, 8, 8, 3, 1, 1, 4, 1),
+      makeShape(4, 9, 7, 3, 1, 0, 6, 2),
+      makeShape(2, 11, 10, 3, 2, 1, 3, 1),
+      makeShape(6, 8, 9, 2, 2, 0, 4, 2),
+      makeShape(1, 5, 5, 5, 1, 2, 2, 1),
+      makeShape(3, 7, 7, 3, 3, 2, 4, 1),
+  };
+}
+
+TEST(CpuConvEngine, forward) {
+  for (auto& shape : testShapes()) {
+    CpuMatrixPtr input = randMatrix(kBatchSize, shape.getImageSize());
+    CpuMatrixPtr weight =
+        randMatrix(shape.getSubK() * shape.groups, shape.getSubM());
+    CpuMatrixPtr expect = randMatrix(kBatchSize, shape.getOutputSize());
+    CpuMatrixPtr actual = std::make_shared<CpuMatrix>(
+        kBatchSize, shape.getOutputSize());
+    actual->copyFrom(*expect);
+
+    SampleConv(shape).forward(*input, *weight, *expect);
+    /// tiles of 1, 2 and all the samples
+    for (size_t tileSize : {1, 2, 100}) {
+      CpuMatrixPtr output = std::make_shared<CpuMatrix>(
+          kBatchSize, shape.getOutputSize());
+      output->copyFrom(*actual);
+      size_t reals = (shape.getSubK() * shape.groups + shape.numFilters) *
+                     shape.getSubN();
+      CpuConvEngine(reals * tileSize)
+          .forward(shape, input->getData(), kBatchSize, weight->getData(),
+                   output->getData());
+      checkEqual(*expect, *output, 1e-5);
+    }
+  }
+}
+
+TEST(CpuConvEngine, winograd) {
+  for (auto& shape : testShapes()) {
+    if (!CpuConvEngine::canUseWinograd(shape)) continue;
+    CpuMatrixPtr input = randMatrix(kBatchSize, shape.getImageSize());
+    CpuMatrixPtr weight =
+        randMatrix(shape.getSubK() * shape.groups, shape.getSubM());
+    CpuMatrixPtr expect = randMatrix(kBatchSize, shape.getOutputSize());
+    CpuMatrixPtr actual = std::make_shared<CpuMatrix>(
+        kBatchSize, shape.getOutputSize());
+    actual->copyFrom(*expect);
+
+    SampleConv(shape).forward(*input, *weight, *expect);
+    /// a few tiles at a time
+    CpuConvEngine(100).forwardWinograd(shape, input->getData(), kBatchSize,
+                                        weight->getData(), actual->getData());
+    checkEqual(*expect, *actual, 1e-4);
+  }
+}
+
+TEST(CpuConvEngine, backward) {
+  for (auto& shape : testShapes()) {
+    CpuMatrixPtr input = randMatrix(kBatchSize, shape.getImageSize());
+    CpuMatrixPtr weight =
+        randMatrix(shape.getSubK() * shape.groups, shape.getSubM());
+    CpuMatrixPtr outputGrad = randMatrix(kBatchSize, shape.getOutputSize());
+    CpuMatrixPtr inputGrad = randMatrix(kBatchSize, shape.getImageSize());
+    CpuMatrixPtr weightGrad =
+        randMatrix(shape.getSubK() * shape.groups, shape.getSubM());
+    CpuMatrixPtr inputGrad2 =
+        std::make_shared<CpuMatrix>(kBatchSize, shape.getImageSize());
+    CpuMatrixPtr weightGrad2 = std::make_shared<CpuMatrix>(
+        shape.getSubK() * shape.groups, shape.getSubM());
+    inputGrad2->copyFrom(*inputGrad);
+    weightGrad2->copyFrom(*weightGrad);
+
+    SampleConv(shape).backward(*input, *weight, *outputGrad, *inputGrad,
+                               *weightGrad);
+    size_t reals =
+        (shape.getSubK() * shape.groups + shape.numFilters) * shape.getSubN();
+    CpuConvEngine(reals * 2).backward(
+        shape, input->getData(), kBatchSize, weight->getData(),
+        outputGrad->getData(), inputGrad2->getData(), weightGrad2->getData());
+    checkEqual(*inputGrad, *inputGrad2, 1e-5);
+    checkEqual(*weightGrad, *weightGrad2, 1e-4);
+  }
+}
+
+static double timeIt(const std::function<void()>& func, int times) {
+  func();  // warm up
+  timeval begin, end;
+  gettimeofday(&begin, nullptr);
+  for (int i = 0; i < times; ++i) {
+    func();
+  }
+  gettimeofday(&end, nullptr);
+  return (end.tv_sec - begin.tv_sec) + (end.tv_usec - begin.tv_usec) * 1e-6;
+}
+
+/// images/sec of a 3x3 stride 1 convolution, logged for comparison
+TEST(CpuConvEngine, benchmark) {
+  const size_t batchSize = 64;
+  const int times = 3;
+  ConvShape shape = makeShape(32, 32, 32, 3, 1, 1, 32, 1);
+  CpuMatrixPtr input = randMatrix(batchSize, shape.getImageSize());
+  CpuMatrixPtr weight = randMatrix(shape.getSubK(), shape.getSubM());
+  CpuMatrixPtr output = randMatrix(batchSize, shape.getOutputSize());
+  CpuMatrixPtr inputGrad = randMatrix(batchSize, shape.getImageSize());
+  CpuMatrixPtr weightGrad = randMatrix(shape.getSubK(), shape.getSubM());
+
+  SampleConv sample(shape);
+  CpuConvEngine engine;
+  auto images = [&](double seconds) { return batchSize * times / seconds; };
+
+  double sampleFwd = timeIt(
+      [&]() { sample.forward(*input, *weight, *output); }, times);
+  double batchFwd = timeIt([&]() {
+    engine.forward(shape, input->getData(), batchSize, weight->getData(),
+                   output->getData());
+  }, times);
+  double winogradFwd = timeIt([&]() {
+    engine.forwardWinograd(shape, input->getData(), batchSize,
+                           weight->getData(), output->getData());
+  }, times);
+  double sampleBwd = timeIt([&]() {
+    sample.backward(*input, *weight, *output, *inputGrad, *weightGrad);
+  }, times);
+  double batchBwd = timeIt([&]() {
+    engine.backward(shape, input->getData(), batchSize, weight->getData(),
+                    output->getData(), inputGrad->getData(),
+                    weightGrad->getData());
+  }, times);
+
+  LOG(INFO) << "forward images/sec: per sample=" << images(sampleFwd)
+            << " batched=" << images(batchFwd)
+            << " winograd=" << images(winogradFwd);
+  LOG(INFO) << "backward images/sec: per sample=" << images(sampleBwd)
+            << " batched=" << images(batchBwd);
+}
+
+int main(int argc, char** argv) {
+  paddle::initMain(argc, argv);
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,326 @@
+/* Copyright (c) 2016 Baidu, Inc. All Rights Reserve.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include <gtest/gtest.h>
+
+#include <stdlib.h>
+#include <sys/time.h>
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "paddle/math/CpuSparseMatrix.h"
+#include "paddle/math/CpuSparseMul.h"
+#include "paddle/math/Matrix.h"
+#include "paddle/math/SIMDFunctions.h"
+#include "paddle/math/SparseRowMatrix.h"
+#include "paddle/utils/Util.h"
+
+P_DECLARE_string(cpu_apply_isa);
+P_DECLARE_int32(cpu_apply_threads);
+P_DECLARE_int32(cpu_apply_parallel_size);
+P_DECLARE_string(sparse_mul_strategy);
+P_DECLARE_bool(allow_inefficient_sparse_update);
+
+using namespace paddle;  // NOLINT
+
+/// the nonzeros of a csr matrix
+struct Csr {
+  std::vector<int> rows;
+  std::vector<int> cols;
+  std::vector<real> values;
+};
+
+/**
+ * (height, width) csr matrix with about rowNnz() nonzeros per row, of the
+ * columns picked by pickCol(), e.g. a zipf distribution of the words
+ */
+static Csr randCsr(size_t height, const std::function<int()>& rowNnz,
+                   const std::function<int()>& pickCol) {
+  Csr csr;
+  csr.rows.push_back(0);
+  for (size_t i = 0; i < height; ++i) {
+    std::vector<int> cols;
+    for (int n = rowNnz(); n > 0; --n) {
+      cols.push_back(pickCol());
+    }
+    std::sort(cols.begin(), cols.end());
+    cols.erase(std::unique(cols.begin(), cols.end()), cols.end());
+    csr.cols.insert(csr.cols.end(), cols.begin(), cols.end());
+    csr.rows.push_back(csr.cols.size());
+  }
+  for (size_t k = 0; k < csr.cols.size(); ++k) {
+    csr.values.push_back((real)rand() / RAND_MAX - 0.5);  // NOLINT
+  }
+  return csr;
+}
+
+static CpuSparseMatrixPtr makeSparse(Csr& csr, size_t height, size_t width,
+                                     SparseValueType valueType) {
+  auto mat = std::make_shared<CpuSparseMatrix>(
+      height, width, csr.cols.size(), valueType, SPARSE_CSR, false);
+  mat->copyFrom(csr.rows, csr.cols, csr.values);
+  return mat;
+}
+
+/// c += a * b, or a^T * b, by the dense a
+static void referenceMul(const Csr& csr, bool valued, bool trans,
+                         const CpuMatrix& b, std::vector<double>* c) {
+  size_t width = b.getWidth();
+  for (size_t i = 0; i + 1 < csr.rows.size(); ++i) {
+    for (int k = csr.rows[i]; k < csr.rows[i + 1]; ++k) {
+      double v = valued ? csr.values[k] : 1.0;
+      size_t cRow = trans ? csr.cols[k] : i;
+      size_t bRow = trans ? i : csr.cols[k];
+      for (size_t j = 0; j < width; ++j) {
+        (*c)[cRow * width + j] += v * b.getElement(bRow, j);
+      }
+    }
+  }
+}
+
+static void checkEqual(const std::vector<double>& expected,
+                       const real* actual, size_t row, size_t width) {
+  for (size_t j = 0; j < width; ++j) {
+    double e = expected[row * width + j];
+    ASSERT_NEAR(e, actual[j], 1e-4 * (1 + std::fabs(e)))
+        << "at " << row << ", " << j;
+  }
+}
+
+/**
+ * CpuMatrix::mul() of a sparse a against the dense reference, into a dense
+ * c and a SparseAutoGrowRowCpuMatrix c, as the weight gradients
+ */
+static void testMul(size_t height, size_t dim, size_t width, int rowNnz,
+                    bool trans, SparseValueType valueType) {
+  Csr csr = randCsr(height, [=]() { return rand() % (2 * rowNnz + 1); },
+                    [=]() { return rand() % dim; });
+  CpuSparseMatrixPtr a = makeSparse(csr, height, dim, valueType);
+  MatrixPtr aMul = trans ? a->getTranspose() : a;
+  size_t cHeight = trans ? dim : height;
+  CpuMatrix b(trans ? height : dim, width);
+  b.randomizeUniform();
+
+  std::vector<double> expected(cHeight * width, 0);
+  CpuMatrix c(cHeight, width);
+  c.randomizeUniform();
+  for (size_t i = 0; i < cHeight; ++i) {
+    for (size_t j = 0; j < width; ++j) {
+      expected[i * width + j] = c.getElement(i, j);
+    }
+  }
+  referenceMul(csr, valueType == FLOAT_VALUE, trans, b, &expected);
+
+  c.mul(dynamic_cast<CpuSparseMatrix*>(aMul.get()), &b, 1, 1);
+  for (size_t i = 0; i < cHeight; ++i) {
+    checkEqual(expected, c.getRow(i), i, width);
+  }
+
+  /// the rows of SparseRowCpuMatrix are whole simd vectors
+  if (!trans || !simd::vec_check(width)) return;
+  std::vector<double> grad(cHeight * width, 0);
+  referenceMul(csr, valueType == FLOAT_VALUE, trans, b, &grad);
+  SparseAutoGrowRowCpuMatrix rowGrad(cHeight, width);
+  rowGrad.mul(dynamic_cast<CpuSparseMatrix*>(aMul.get()), &b, 1, 0);
+  std::vector<bool> used(cHeight, false);
+  for (auto col : csr.cols) {
+    used[col] = true;
+  }
+  for (size_t i = 0; i < cHeight; ++i) {
+    if (used[i]) {
+      checkEqual(grad, rowGrad.getRow(i), i, width);
+    }
+  }
+}
+
+static void testAllShapes() {
+  for (auto height : {1, 7, 64}) {
+    for (auto width : {1, 13, 32, 100, 1032}) {
+      for (auto rowNnz : {0, 3, 40}) {
+        for (auto trans : {false, true}) {
+          VLOG(3) << " height=" << height << " width=" << width
+                  << " rowNnz=" << rowNnz << " trans=" << trans;
+          testMul(height, 500, width, rowNnz, trans, NO_VALUE);
+          testMul(height, 500, width, rowNnz, trans, FLOAT_VALUE);
+        }
+      }
+    }
+  }
+}
+
+TEST(CpuSparseMul, serial) {
+  for (auto isa : {"sse", "avx2", "avx512", "auto"}) {
+    FLAGS_cpu_apply_isa = isa;
+    testAllShapes();
+  }
+  FLAGS_cpu_apply_isa = "auto";
+}
+
+TEST(CpuSparseMul, parallel) {
+  int threads = FLAGS_cpu_apply_threads;
+  int parallelSize = FLAGS_cpu_apply_parallel_size;
+  FLAGS_cpu_apply_parallel_size = 1;
+  for (auto strategy : {"rows", "columns", "auto"}) {
+    FLAGS_sparse_mul_strategy = strategy;
+    for (auto numThreads : {2, 3, 4}) {
+      FLAGS_cpu_apply_threads = numThreads;
+      testAllShapes();
+    }
+  }
+  FLAGS_sparse_mul_strategy = "auto";
+  FLAGS_cpu_apply_threads = threads;
+  FLAGS_cpu_apply_parallel_size = parallelSize;
+}
+
+TEST(CpuSparseMul, strategy) {
+  int threads = FLAGS_cpu_apply_threads;
+  FLAGS_cpu_apply_threads = 4;
+  /// even rows
+  EXPECT_EQ(CpuSparseMulEngine::ROW_PARALLEL,
+            CpuSparseMulEngine::chooseStrategy(128, 12800, 200, 256));
+  /// too few rows
+  EXPECT_EQ(CpuSparseMulEngine::COLUMN_BLOCKED,
+            CpuSparseMulEngine::chooseStrategy(2, 12800, 6400, 256));
+  /// one row of most of the nonzeros
+  EXPECT_EQ(CpuSparseMulEngine::COLUMN_BLOCKED,
+            CpuSparseMulEngine::chooseStrategy(128, 12800, 6000, 256));
+  /// too narrow to split the columns
+  EXPECT_EQ(CpuSparseMulEngine::ROW_PARALLEL,
+            CpuSparseMulEngine::chooseStrategy(2, 12800, 6400, 100));
+  FLAGS_cpu_apply_threads = threads;
+}
+
+static double timeIt(const std::function<void()>& func, int times) {
+  struct timeval begin, end;
+  func();
+  gettimeofday(&begin, nullptr);
+  for (int i = 0; i < times; ++i) {
+    func();
+  }
+  gettimeofday(&end, nullptr);
+  return ((end.tv_sec - begin.tv_sec) + (end.tv_usec - begin.tv_usec) * 1e-6) /
+         times;
+}
+
+/// the loops of CpuMatrix::mul() before CpuSparseMulEngine, for comparison
+template <class MatCType>
+void baselineMul(const Csr& csr, bool valued, bool trans, const CpuMatrix& b,
+                 MatCType* c) {
+  size_t width = b.getWidth();
+  for (size_t i = 0; i + 1 < csr.rows.size(); ++i) {
+    for (int k = csr.rows[i]; k < csr.rows[i + 1]; ++k) {
+      real v = valued ? csr.values[k] : 1;
+      real* cRow = c->getRow(trans ? csr.cols[k] : i);
+      const real* bRow = b.getData() + (trans ? i : csr.cols[k]) * width;
+      for (size_t j = 0; j < width; ++j) {
+        cRow[j] += v * bRow[j];
+      }
+    }
+  }
+}
+
+/**
+ * GFLOPS of the forward, a * b, and of the weight gradient, a^T * b, of a
+ * sparse input layer for the nonzeros of
+ * - bag of words: 100 words per sample, of a zipf distribution;
+ * - ids: 8 ids per sample, of a zipf distribution, no value;
+ * - one long document: one sample of 20000 words, the others of 20.
+ */
+TEST(CpuSparseMul, benchmark) {
+  const size_t batchSize = 128;
+  const size_t dim = 100000;
+  const size_t width = 256;
+  const int times = 5;
+
+  /// zipf distribution of the words, of exponent 1.1
+  std::vector<double> cdf(dim);
+  double sum = 0;
+  for (size_t i = 0; i < dim; ++i) {
+    sum += 1 / std::pow(i + 1.0, 1.1);
+    cdf[i] = sum;
+  }
+  auto zipf = [&]() {
+    double x = sum * rand() / RAND_MAX;  // NOLINT
+    return std::min<int>(std::lower_bound(cdf.begin(), cdf.end(), x) -
+                             cdf.begin(),
+                         dim - 1);
+  };
+  size_t row = 0;
+  struct Input {
+    std::string name;
+    Csr csr;
+    SparseValueType valueType;
+  };
+  std::vector<Input> inputs = {
+      {"bag of words",
+       randCsr(batchSize, []() { return 50 + rand() % 101; }, zipf),
+       FLOAT_VALUE},
+      {"ids", randCsr(batchSize, []() { return 8; }, zipf), NO_VALUE},
+      {"one long document",
+       randCsr(batchSize, [&]() { return row++ == 0 ? 20000 : 20; }, zipf),
+       FLOAT_VALUE}};
+
+  CpuMatrix weight(dim, width);
+  CpuMatrix output(batchSize, width);
+  weight.randomizeUniform();
+  output.randomizeUniform();
+
+  auto bench = [&](const std::string& name, size_t nnz,
+                   const std::function<void()>& func) {
+    double seconds = timeIt(func, times);
+    LOG(INFO) << name << ": " << 2e-9 * nnz * width / seconds << " GFLOPS";
+  };
+
+  for (auto& input : inputs) {
+    size_t nnz = input.csr.cols.size();
+    bool valued = input.valueType == FLOAT_VALUE;
+    CpuSparseMatrixPtr a = makeSparse(input.csr, batchSize, dim,
+                                      input.valueType);
+    MatrixPtr aTransPtr = a->getTranspose();
+    auto aTrans = dynamic_cast<CpuSparseMatrix*>(aTransPtr.get());
+    SparseAutoGrowRowCpuMatrix weightGrad(dim, width);
+    LOG(INFO) << input.name << ", " << nnz << " nonzeros:";
+
+    bench("forward baseline", nnz, [&]() {
+      output.zeroMem();
+      baselineMul(input.csr, valued, false, weight, &output);
+    });
+    bench("weight grad baseline", nnz, [&]() {
+      weightGrad.zeroMem();
+      baselineMul(input.csr, valued, true, output, &weightGrad);
+    });
+
+    int threads = FLAGS_cpu_apply_threads;
+    for (int numThreads : {1, threads}) {
+      FLAGS_cpu_apply_threads = numThreads;
+      std::string suffix = numThreads == 1 ? " one thread" : " all threads";
+      bench("forward" + suffix, nnz,
+            [&]() { output.mul(a.get(), &weight, 1, 0); });
+      bench("weight grad" + suffix, nnz,
+            [&]() { weightGrad.mul(aTrans, &output, 1, 0); });
+    }
+    FLAGS_cpu_apply_threads = threads;
+  }
+}
+
+int main(int argc, char** argv) {
+  paddle::initMain(argc, argv);
+  /// the weight gradients of the small tests use most of their rows
+  FLAGS_allow_inefficient_sparse_update = true;
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
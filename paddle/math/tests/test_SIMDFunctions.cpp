@@ -19,6 +19,7 @@ limitations under the License. */
 
 #include <gtest/gtest.h>
 
+#include <cmath>
 #include <random>
 #include <functional>
 #include <algorithm>
@@ -170,6 +171,51 @@ TEST(SIMDFunction, decayL1_WithoutLR) {
   }
 }
 
+TEST(SIMDFunction, addHalfTo) {
+  auto A = NewRandomVector();
+  auto ACopy = NewVector();
+  memcpy(ACopy.get(), A.get(), sizeof(float) * VECTOR_LEN);
+
+  // every half, including subnormals, infinities and NaNs
+  std::unique_ptr<uint16_t[]> B(new uint16_t[VECTOR_LEN]);
+  for (size_t i = 0; i < VECTOR_LEN; ++i) {
+    B[i] = RandomEngine();
+  }
+
+  // an odd length covers the tail of the simd loop
+  const size_t len = VECTOR_LEN - 3;
+  paddle::simd::naive::addHalfTo<float>(A.get(), B.get(), len);
+  paddle::simd::addHalfTo<float>(ACopy.get(), B.get(), len);
+
+  for (size_t i = 0; i < VECTOR_LEN; ++i) {
+    if (std::isnan(A[i])) {
+      ASSERT_TRUE(std::isnan(ACopy[i]));
+    } else {
+      ASSERT_EQ(A[i], ACopy[i]);
+    }
+  }
+}
+
+TEST(SIMDFunction, addInt8To) {
+  auto A = NewRandomVector();
+  auto ACopy = NewVector();
+  memcpy(ACopy.get(), A.get(), sizeof(float) * VECTOR_LEN);
+
+  std::unique_ptr<int8_t[]> B(new int8_t[VECTOR_LEN]);
+  for (size_t i = 0; i < VECTOR_LEN; ++i) {
+    B[i] = RandomEngine();
+  }
+  float scale = 0.37f;
+
+  const size_t len = VECTOR_LEN - 3;
+  paddle::simd::naive::addInt8To<float>(A.get(), B.get(), scale, len);
+  paddle::simd::addInt8To<float>(ACopy.get(), B.get(), scale, len);
+
+  for (size_t i = 0; i < VECTOR_LEN; ++i) {
+    ASSERT_NEAR(A[i], ACopy[i], EPSILON);
+  }
+}
+
 int main(int argc, char** argv) {
   paddle::initMain(argc, argv);
   testing::InitGoogleTest(&argc, argv);
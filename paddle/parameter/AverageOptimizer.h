@@ -58,6 +58,9 @@ public:
     return optimizer_->startCatchUpWith();
   }
   virtual void finishCatchUpWith() { return optimizer_->finishCatchUpWith(); }
+  virtual TraverseCallback needCatchUpBeforeForward() const {
+    return optimizer_->needCatchUpBeforeForward();
+  }
 
   virtual TraverseCallback apply();
   virtual TraverseCallback restore();
@@ -15,6 +15,7 @@ limitations under the License. */
 
 #include "paddle/utils/Util.h"
 #include "paddle/utils/Flags.h"
+#include "paddle/math/SIMDFunctions.h"
 
 #include "FirstOrderOptimizer.h"
 
@@ -24,6 +25,139 @@ P_DEFINE_bool(log_clipping, false, "enable log clipping or not");
 
 namespace paddle {
 
+void SgdOptimizer::updateWithGradientSum(const VectorPtr vecs[],
+                                         const ParameterConfig& paraConfig,
+                                         real gradSumRate,
+                                         size_t sparseId) const {
+  if (sparseId != -1LU || vecs[PARAMETER_VALUE]->useGpu()) {
+    ParameterOptimizer::updateWithGradientSum(vecs, paraConfig, gradSumRate,
+                                              sparseId);
+    return;
+  }
+  real torch_learningRate = optConfig_.learning_method() == "torch_momentum" ?
+                            1.0 - paraConfig.momentum() : 1.0;
+  simd::svrgMomentum(vecs[PARAMETER_VALUE]->getData(),
+                     vecs[PARAMETER_MOMENTUM]->getData(),
+                     vecs[PARAMETER_GRADIENT]->getData(),
+                     vecs[PARAMETER_GRADIENT_SUM]->getData(),
+                     (real)(learningRate_ * paraConfig.learning_rate() *
+                            (firstTime_ ? 1.0 : torch_learningRate)),
+                     gradSumRate, (real)paraConfig.momentum(),
+                     (real)(applyDecay_ ? paraConfig.decay_rate() : 0),
+                     vecs[PARAMETER_VALUE]->getSize());
+}
+
+void SvrgOptimizer::init(size_t numRows, const ParameterConfig* config) {
+  optimizer_->init(numRows, config);
+  t0Vec_.resize(numRows);
+  t0Vec_.assign(t0Vec_.size(), 0);
+  timer_ = 0;
+  baseTimer_ = 0;
+  etaSums_.assign(1, 0.0);
+  if (config && (config->sparse_update() || config->sparse_remote_update())) {
+    CHECK(isSgd_) << "lazy svrg of sparse parameter " << config->name()
+                  << " only supports sgd";
+    CHECK_EQ(config->momentum(), 0.0f)
+        << "not support momentum in lazy svrg of " << config->name();
+    // the decay of sparse rows is caught up by OptimizerWithRegularizerSparse
+    CHECK(!applyDecay_ || config->decay_rate() == 0.0f) << config->name();
+  }
+}
+
+void SvrgOptimizer::update(const VectorPtr vecs[],
+                           const ParameterConfig& config,
+                           size_t sparseId) const {
+  if (sparseId != -1LU) {
+    // W(t0) -> W(t)
+    catchUpWith(vecs, config, sparseId);
+    // W(t) -> W(t+1)
+    t0Vec_[sparseId] = timer_ + 1;
+  }
+  optimizer_->updateWithGradientSum(vecs, config, optConfig_.batch_rate(),
+                                    sparseId);
+}
+
+void SvrgOptimizer::finishBatch() {
+  optimizer_->finishBatch();
+  if (!t0Vec_.empty()) {
+    etaSums_.push_back(etaSums_.back() +
+                       (double)learningRate_ * optConfig_.batch_rate());
+  }
+  ++timer_;
+}
+
+ParameterOptimizer::TraverseCallback SvrgOptimizer::needCatchUpBeforeForward()
+    const {
+  if (t0Vec_.empty() || timer_ == 0) {
+    return nullptr;
+  }
+  return [this](const VectorPtr vecs[], const ParameterConfig& config,
+                size_t sparseId) {
+    if (sparseId == -1LU) return;
+    // W(t0) -> W(t), update() then takes it to W(t+1)
+    catchUpWith(vecs, config, sparseId);
+    t0Vec_[sparseId] = timer_;
+  };
+}
+
+ParameterOptimizer::TraverseCallback SvrgOptimizer::startCatchUpWith() const {
+  TraverseCallbackVec callbacks;
+
+  if (auto callback = optimizer_->startCatchUpWith()) {
+    callbacks.emplace_back(callback);
+  }
+
+  if (!t0Vec_.empty() && timer_ > 0) {
+    callbacks.emplace_back(
+        [this](const VectorPtr vecs[], const ParameterConfig& config,
+               size_t sparseId) {
+          if (sparseId == -1LU) return;
+          catchUpWith(vecs, config, sparseId);
+          t0Vec_[sparseId] = timer_;
+        });
+  }
+
+  return composeCallbacks(callbacks);
+}
+
+void SvrgOptimizer::finishCatchUpWith() {
+  optimizer_->finishCatchUpWith();
+  if (!t0Vec_.empty()) {
+    // all the rows are up to timer_ now
+    baseTimer_ = timer_;
+    etaSums_.assign(1, 0.0);
+  }
+}
+
+void SvrgOptimizer::catchUpWith(const VectorPtr vecs[],
+                                const ParameterConfig& config,
+                                size_t sparseId) const {
+  CHECK_LT(sparseId, t0Vec_.size());
+  int64_t t0 = t0Vec_[sparseId];
+  if (t0 >= timer_) return;
+  CHECK_GE(t0, baseTimer_) << "row " << sparseId << " of " << config.name()
+                           << " missed the last catch up";
+  double rate = etaSums_[timer_ - baseTimer_] - etaSums_[t0 - baseTimer_];
+  vecs[PARAMETER_VALUE]->add(*vecs[PARAMETER_GRADIENT_SUM],
+                             (real)(-rate * config.learning_rate()));
+}
+
+void SvrgOptimizer::updateAndClearGradient(
+    const VectorPtr vecs[], const ParameterConfig& config) const {
+  if (!isSgd_ || config.momentum() != 0.0) {
+    update(vecs, config, -1LU);
+    vecs[PARAMETER_GRADIENT]->zeroMem();
+    return;
+  }
+  auto eta = learningRate_ * config.learning_rate();
+  svrgUpdateCpu(eta, optConfig_.batch_rate() * eta,
+                applyDecay_ ? config.decay_rate() : 0,
+                vecs[PARAMETER_VALUE]->getSize(),
+                vecs[PARAMETER_VALUE]->getData(),
+                vecs[PARAMETER_GRADIENT]->getData(),
+                vecs[PARAMETER_GRADIENT_SUM]->getData());
+}
+
 SparseMomentumParameterOptimizer::SparseMomentumParameterOptimizer(
     const OptimizationConfig& optConfig)
     : ParameterOptimizer(optConfig) {
@@ -115,10 +249,9 @@ void AdagradParameterOptimizer::update(const VectorPtr vecs[],
                                        size_t sparseId) const {
   vecs[PARAMETER_GRADIENT_SQURESUM1]->addSquare(*vecs[PARAMETER_GRADIENT],
                                                 1.0f);
-  vecs[PARAMETER_LEARNING_RATE]->add(*vecs[PARAMETER_GRADIENT_SQURESUM],
-                                     *vecs[PARAMETER_GRADIENT_SQURESUM1]);
-  vecs[PARAMETER_LEARNING_RATE]->add(optConfig_.ada_epsilon());
-  vecs[PARAMETER_LEARNING_RATE]->invSqrt(*vecs[PARAMETER_LEARNING_RATE]);
+  vecs[PARAMETER_LEARNING_RATE]->invSqrtSum(
+      *vecs[PARAMETER_GRADIENT_SQURESUM], *vecs[PARAMETER_GRADIENT_SQURESUM1],
+      optConfig_.ada_epsilon());
 
   vecs[PARAMETER_VALUE]->sgdUpdate(
       *vecs[PARAMETER_GRADIENT], *vecs[PARAMETER_MOMENTUM],
@@ -126,6 +259,28 @@ void AdagradParameterOptimizer::update(const VectorPtr vecs[],
       config.momentum(), applyDecay_ ? config.decay_rate() : 0);
 }
 
+void AdagradParameterOptimizer::updateWithGradientSum(
+    const VectorPtr vecs[], const ParameterConfig& config, real gradSumRate,
+    size_t sparseId) const {
+  if (sparseId != -1LU || vecs[PARAMETER_VALUE]->useGpu()) {
+    ParameterOptimizer::updateWithGradientSum(vecs, config, gradSumRate,
+                                              sparseId);
+    return;
+  }
+  simd::svrgAdagrad(vecs[PARAMETER_VALUE]->getData(),
+                    vecs[PARAMETER_MOMENTUM]->getData(),
+                    vecs[PARAMETER_LEARNING_RATE]->getData(),
+                    vecs[PARAMETER_GRADIENT_SQURESUM1]->getData(),
+                    vecs[PARAMETER_GRADIENT_SQURESUM]->getData(),
+                    vecs[PARAMETER_GRADIENT]->getData(),
+                    vecs[PARAMETER_GRADIENT_SUM]->getData(),
+                    (real)(learningRate_ * config.learning_rate()),
+                    gradSumRate, (real)config.momentum(),
+                    (real)(applyDecay_ ? config.decay_rate() : 0),
+                    (real)optConfig_.ada_epsilon(),
+                    vecs[PARAMETER_VALUE]->getSize());
+}
+
 ParameterOptimizer::TraverseCallback
 AdagradParameterOptimizer::needSpecialTraversal(
     const ParameterConfig& config) const {
@@ -168,6 +323,28 @@ void AdaDeltaParameterOptimizer::update(const VectorPtr vecs[],
       config.momentum(), applyDecay_ ? config.decay_rate() : 0);
 }
 
+void AdaDeltaParameterOptimizer::updateWithGradientSum(
+    const VectorPtr vecs[], const ParameterConfig& config, real gradSumRate,
+    size_t sparseId) const {
+  if (vecs[PARAMETER_VALUE]->useGpu()) {
+    ParameterOptimizer::updateWithGradientSum(vecs, config, gradSumRate,
+                                              sparseId);
+    return;
+  }
+  CHECK(sparseId == -1LU) << "Sparse update is not supported";
+  simd::svrgAdadelta(vecs[PARAMETER_VALUE]->getData(),
+                     vecs[PARAMETER_MOMENTUM]->getData(),
+                     vecs[PARAMETER_LEARNING_RATE]->getData(),
+                     vecs[PARAMETER_GRADIENT_SQURESUM]->getData(),
+                     vecs[PARAMETER_GRADIENT_SQURESUM1]->getData(),
+                     vecs[PARAMETER_GRADIENT]->getData(),
+                     vecs[PARAMETER_GRADIENT_SUM]->getData(),
+                     (real)(learningRate_ * config.learning_rate()),
+                     gradSumRate, (real)config.momentum(),
+                     (real)(applyDecay_ ? config.decay_rate() : 0), rou_,
+                     epsilon_, vecs[PARAMETER_VALUE]->getSize());
+}
+
 void RMSPropParameterOptimizer::update(const VectorPtr vecs[],
                                        const ParameterConfig& config,
                                        size_t sparseId) const {
@@ -195,11 +372,9 @@ void RMSPropParameterOptimizer::update(const VectorPtr vecs[],
   // learn_rate = 1/sqrt( ( E(g_t^2) - (E(g_t))^2 + epsilon )
   // Basiclly if the sign of the gradient changes more often,
   // the learning rate will be decreased.
-  vecs[PARAMETER_LEARNING_RATE]->assign(*vecs[PARAMETER_GRADIENT_SQURESUM]);
-  vecs[PARAMETER_LEARNING_RATE]->addSquare(*vecs[PARAMETER_GRADIENT_SQURESUM1],
-                                           -1.0f);
-  vecs[PARAMETER_LEARNING_RATE]->add(optConfig_.ada_epsilon());
-  vecs[PARAMETER_LEARNING_RATE]->invSqrt(*vecs[PARAMETER_LEARNING_RATE]);
+  vecs[PARAMETER_LEARNING_RATE]->invSqrtVar(
+      *vecs[PARAMETER_GRADIENT_SQURESUM], *vecs[PARAMETER_GRADIENT_SQURESUM1],
+      optConfig_.ada_epsilon());
 
   vecs[PARAMETER_VALUE]->sgdUpdate(
       *vecs[PARAMETER_GRADIENT], *vecs[PARAMETER_MOMENTUM],
@@ -207,6 +382,29 @@ void RMSPropParameterOptimizer::update(const VectorPtr vecs[],
       config.momentum(), applyDecay_ ? config.decay_rate() : 0);
 }
 
+void RMSPropParameterOptimizer::updateWithGradientSum(
+    const VectorPtr vecs[], const ParameterConfig& config, real gradSumRate,
+    size_t sparseId) const {
+  if (sparseId != -1LU || vecs[PARAMETER_VALUE]->useGpu()) {
+    ParameterOptimizer::updateWithGradientSum(vecs, config, gradSumRate,
+                                              sparseId);
+    return;
+  }
+  simd::svrgRmsprop(vecs[PARAMETER_VALUE]->getData(),
+                    vecs[PARAMETER_MOMENTUM]->getData(),
+                    vecs[PARAMETER_LEARNING_RATE]->getData(),
+                    vecs[PARAMETER_GRADIENT_SQURESUM]->getData(),
+                    vecs[PARAMETER_GRADIENT_SQURESUM1]->getData(),
+                    vecs[PARAMETER_GRADIENT]->getData(),
+                    vecs[PARAMETER_GRADIENT_SUM]->getData(),
+                    (real)(learningRate_ * config.learning_rate()),
+                    gradSumRate, (real)config.momentum(),
+                    (real)(applyDecay_ ? config.decay_rate() : 0), rou_,
+                    timer_ == 0 ? 1.0f : 1.0f - rou_,
+                    (real)optConfig_.ada_epsilon(),
+                    vecs[PARAMETER_VALUE]->getSize());
+}
+
 void DecayedAdagradParameterOptimizer::update(const VectorPtr vecs[],
                                               const ParameterConfig& config,
                                               size_t sparseId) const {
@@ -230,9 +428,8 @@ void DecayedAdagradParameterOptimizer::update(const VectorPtr vecs[],
   // learn_rate = 1/sqrt( ( E(g_t^2) + epsilon )
   // Basiclly if the bigger the magnitude gradient is,
   // the smaller the learning rate will be.
-  vecs[PARAMETER_LEARNING_RATE]->assign(optConfig_.ada_epsilon());
-  vecs[PARAMETER_LEARNING_RATE]->add(*vecs[PARAMETER_GRADIENT_SQURESUM]);
-  vecs[PARAMETER_LEARNING_RATE]->invSqrt(*vecs[PARAMETER_LEARNING_RATE]);
+  vecs[PARAMETER_LEARNING_RATE]->invSqrtAdd(*vecs[PARAMETER_GRADIENT_SQURESUM],
+                                            optConfig_.ada_epsilon());
 
   vecs[PARAMETER_VALUE]->sgdUpdate(
       *vecs[PARAMETER_GRADIENT], *vecs[PARAMETER_MOMENTUM],
@@ -240,6 +437,28 @@ void DecayedAdagradParameterOptimizer::update(const VectorPtr vecs[],
       config.momentum(), applyDecay_ ? config.decay_rate() : 0);
 }
 
+void DecayedAdagradParameterOptimizer::updateWithGradientSum(
+    const VectorPtr vecs[], const ParameterConfig& config, real gradSumRate,
+    size_t sparseId) const {
+  if (sparseId != -1LU || vecs[PARAMETER_VALUE]->useGpu()) {
+    ParameterOptimizer::updateWithGradientSum(vecs, config, gradSumRate,
+                                              sparseId);
+    return;
+  }
+  simd::svrgDecayedAdagrad(vecs[PARAMETER_VALUE]->getData(),
+                           vecs[PARAMETER_MOMENTUM]->getData(),
+                           vecs[PARAMETER_LEARNING_RATE]->getData(),
+                           vecs[PARAMETER_GRADIENT_SQURESUM]->getData(),
+                           vecs[PARAMETER_GRADIENT]->getData(),
+                           vecs[PARAMETER_GRADIENT_SUM]->getData(),
+                           (real)(learningRate_ * config.learning_rate()),
+                           gradSumRate, (real)config.momentum(),
+                           (real)(applyDecay_ ? config.decay_rate() : 0),
+                           rou_, timer_ == 0 ? 1.0f : 1.0f - rou_,
+                           (real)optConfig_.ada_epsilon(),
+                           vecs[PARAMETER_VALUE]->getSize());
+}
+
 void AdamParameterOptimizer::update(const VectorPtr vecs[],
                                     const ParameterConfig& config,
                                     size_t sparseId) const {
@@ -260,10 +479,31 @@ void AdamParameterOptimizer::update(const VectorPtr vecs[],
   // \theta_t = \theta_{t-1} - \alpha * \sqrt(1-\beta_2^t) / (1-\beta_1^t) * tmp
   g->sqrt(*v);
   g->dotDiv(*m, *g, 0., epsilon_);
+  theta->add(*theta, 1.0, *g, -calcAlpha(config));
+}
+
+void AdamParameterOptimizer::updateWithGradientSum(
+    const VectorPtr vecs[], const ParameterConfig& config, real gradSumRate,
+    size_t sparseId) const {
+  if (vecs[PARAMETER_VALUE]->useGpu()) {
+    ParameterOptimizer::updateWithGradientSum(vecs, config, gradSumRate,
+                                              sparseId);
+    return;
+  }
+  CHECK(sparseId == -1UL) << "Sparse update is not supported";
+  simd::svrgAdam(vecs[PARAMETER_VALUE]->getData(),
+                 vecs[PARAMETER_MOMENTUM]->getData(),
+                 vecs[PARAMETER_SECOND_MOMENTUM]->getData(),
+                 vecs[PARAMETER_GRADIENT]->getData(),
+                 vecs[PARAMETER_GRADIENT_SUM]->getData(), calcAlpha(config),
+                 gradSumRate, beta1_, beta2_, epsilon_,
+                 vecs[PARAMETER_VALUE]->getSize());
+}
+
+real AdamParameterOptimizer::calcAlpha(const ParameterConfig& config) const {
   real alpha = config.learning_rate() * learningRate_;
-  alpha = alpha * std::sqrt(1 - std::pow(beta2_, step_)) /
-          (1 - std::pow(beta1_, step_));
-  theta->add(*theta, 1.0, *g, -alpha);
+  return alpha * std::sqrt(1 - std::pow(beta2_, step_)) /
+         (1 - std::pow(beta1_, step_));
 }
 
 void AdamaxParameterOptimizer::update(const VectorPtr vecs[],
@@ -290,6 +530,26 @@ void AdamaxParameterOptimizer::update(const VectorPtr vecs[],
   theta->add(*theta, 1.0, *g, -learningRate);
 }
 
+void AdamaxParameterOptimizer::updateWithGradientSum(
+    const VectorPtr vecs[], const ParameterConfig& config, real gradSumRate,
+    size_t sparseId) const {
+  if (vecs[PARAMETER_VALUE]->useGpu()) {
+    ParameterOptimizer::updateWithGradientSum(vecs, config, gradSumRate,
+                                              sparseId);
+    return;
+  }
+  CHECK(sparseId == -1UL) << "Sparse update is not supported";
+  real learningRate = config.learning_rate() * learningRate_;
+  learningRate /= (1 - std::pow(beta1_, step_));
+  simd::svrgAdamax(vecs[PARAMETER_VALUE]->getData(),
+                   vecs[PARAMETER_MOMENTUM]->getData(),
+                   vecs[PARAMETER_WEIGHTED_INFINITY_NORM]->getData(),
+                   vecs[PARAMETER_GRADIENT]->getData(),
+                   vecs[PARAMETER_GRADIENT_SUM]->getData(), learningRate,
+                   gradSumRate, beta1_, beta2_,
+                   vecs[PARAMETER_VALUE]->getSize());
+}
+
 
 void OptimizerWithGradientClipping::update(const VectorPtr vecs[],
                                            const ParameterConfig& config,
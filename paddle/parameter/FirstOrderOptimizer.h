@@ -17,6 +17,7 @@ limitations under the License. */
 
 #include "ParameterOptimizer.h"
 #include "Regularizer.h"
+#include "ParameterUpdateFunctions.h"
 
 namespace paddle {
 
@@ -43,40 +44,14 @@ public:
         paraConfig.momentum(),
         applyDecay_ ? paraConfig.decay_rate() : 0);
   }
+  virtual void updateWithGradientSum(const VectorPtr vecs[],
+                                     const ParameterConfig& paraConfig,
+                                     real gradSumRate, size_t sparseId) const;
   virtual void finishBatch() {
         firstTime_ = false;
   }
 };
 
-/**
- * SVRG, stochastic variance reduction optimization.
- * http://papers.nips.cc/paper/4937-accelerating-stochastic-gradient-descent-using-predictive-variance-reduction.pdf
-*/
-class SvrgOptimizer : public SgdOptimizer {
-public:
-  explicit SvrgOptimizer(const OptimizationConfig& optConfig)
-      : SgdOptimizer(optConfig) {
-    addParameterType(PARAMETER_GRADIENT_SUM);
-    addParameterType(PARAMETER_SNAPSHOT_VALUE);
-  }
-
-  virtual void update(const VectorPtr vecs[], const ParameterConfig& paraConfig,
-                      size_t sparseId) const {
-    (void)sparseId;
-    /** 
-     *g = grad + gradSum/numBatches
-     *grad = \partial f_b(w_t) - \partial f_b(w)
-     *gradSum = \partial f(w)
-     *w_{t+1} = w_t - \eta g_t
-    */
-    auto eta = learningRate_ * paraConfig.learning_rate();
-    vecs[PARAMETER_VALUE]->svrgUpdate(
-            *vecs[PARAMETER_GRADIENT], *vecs[PARAMETER_GRADIENT_SUM],
-            eta, optConfig_.batch_rate() * eta,
-            applyDecay_ ? paraConfig.decay_rate() : 0);
-  }
-};
-
 // SGD optimization with sparse support.
 class SparseMomentumParameterOptimizer : public ParameterOptimizer {
   /* sparse momentum optimizer
@@ -142,6 +117,9 @@ public:
   }
   virtual void update(const VectorPtr vecs[], const ParameterConfig& config,
                       size_t sparseId) const;
+  virtual void updateWithGradientSum(const VectorPtr vecs[],
+                                     const ParameterConfig& config,
+                                     real gradSumRate, size_t sparseId) const;
   virtual TraverseCallback needSpecialTraversal(
       const ParameterConfig& config) const;
 
@@ -172,6 +150,9 @@ public:
 
   virtual void update(const VectorPtr vecs[], const ParameterConfig& config,
                       size_t sparseId) const;
+  virtual void updateWithGradientSum(const VectorPtr vecs[],
+                                     const ParameterConfig& config,
+                                     real gradSumRate, size_t sparseId) const;
 
 protected:
   real rou_;
@@ -204,6 +185,9 @@ public:
 
   virtual void update(const VectorPtr vecs[], const ParameterConfig& config,
                       size_t sparseId) const;
+  virtual void updateWithGradientSum(const VectorPtr vecs[],
+                                     const ParameterConfig& config,
+                                     real gradSumRate, size_t sparseId) const;
 
 protected:
   real rou_;
@@ -245,6 +229,9 @@ public:
 
   virtual void update(const VectorPtr vecs[], const ParameterConfig& config,
                       size_t sparseId) const;
+  virtual void updateWithGradientSum(const VectorPtr vecs[],
+                                     const ParameterConfig& config,
+                                     real gradSumRate, size_t sparseId) const;
 
 protected:
   real rou_;
@@ -282,8 +269,14 @@ public:
 
   virtual void update(const VectorPtr vecs[], const ParameterConfig& config,
                       size_t sparseId) const;
+  virtual void updateWithGradientSum(const VectorPtr vecs[],
+                                     const ParameterConfig& config,
+                                     real gradSumRate, size_t sparseId) const;
 
 protected:
+  /// \alpha * \sqrt(1-\beta_2^t) / (1-\beta_1^t)
+  real calcAlpha(const ParameterConfig& config) const;
+
   real beta1_;
   real beta2_;
   real epsilon_;
@@ -311,6 +304,9 @@ public:
 
   virtual void update(const VectorPtr vecs[], const ParameterConfig& config,
                       size_t sparseId) const;
+  virtual void updateWithGradientSum(const VectorPtr vecs[],
+                                     const ParameterConfig& config,
+                                     real gradSumRate, size_t sparseId) const;
 
 protected:
   real beta1_;
@@ -373,6 +369,9 @@ public:
       const ParameterConfig& config) const {
     return optimizer_->needSpecialTraversal(config);
   }
+  virtual TraverseCallback needCatchUpBeforeForward() const {
+    return optimizer_->needCatchUpBeforeForward();
+  }
   virtual void update(const VectorPtr vecs[], const ParameterConfig& config,
                       size_t sparseId) const;
 
@@ -382,4 +381,101 @@ protected:
   std::unique_ptr<ParameterOptimizer> optimizer_;
 };
 
+/**
+ * SVRG, stochastic variance reduction optimization.
+ * http://papers.nips.cc/paper/4937-accelerating-stochastic-gradient-descent-using-predictive-variance-reduction.pdf
+ *
+ * The variance reduced gradient
+ *   g = grad + gradSum/numBatches
+ *   grad = \partial f_b(w_t) - \partial f_b(w)
+ *   gradSum = \partial f(w)
+ * is fed to another optimizer (momentum, adagrad, adam, ...),
+ * which does the actual update by updateWithGradientSum().
+ *
+ * For sparse rows (numRows > 0 in init()) the update is lazy. A row which is
+ * not in the batch only has the gradSum/numBatches term, so it is applied
+ * for all the skipped batches at once. The rows of a batch are caught up
+ * by needCatchUpBeforeForward() before the forward pass, so that
+ * \partial f_b(w_t) is computed at the actual w_t, and all the rows by
+ * startCatchUpWith() at the end of pass and before saving.
+ * Only sgd without momentum is supported for sparse rows.
+ */
+class SvrgOptimizer : public ParameterOptimizer {
+public:
+  SvrgOptimizer(const OptimizationConfig& optConfig,
+                ParameterOptimizer* optimizer)
+      : ParameterOptimizer(optConfig),
+        optimizer_(optimizer),
+        isSgd_(dynamic_cast<SgdOptimizer*>(optimizer) != nullptr),
+        timer_(0),
+        baseTimer_(0) {
+    parameterTypes_ = optimizer_->getParameterTypes();
+    addParameterType(PARAMETER_GRADIENT_SUM);
+    addParameterType(PARAMETER_SNAPSHOT_VALUE);
+  }
+
+  virtual void init(size_t numRows, const ParameterConfig* config);
+
+  virtual void startPass() { optimizer_->startPass(); }
+  virtual void finishPass() { optimizer_->finishPass(); }
+
+  virtual void startBatch(int64_t numSamplesProcessed) {
+    optimizer_->startBatch(numSamplesProcessed);
+    learningRate_ = optimizer_->getLearningRate();
+  }
+  virtual void finishBatch();
+
+  virtual TraverseCallback needSpecialTraversal(
+      const ParameterConfig& config) const {
+    return optimizer_->needSpecialTraversal(config);
+  }
+
+  virtual void update(const VectorPtr vecs[], const ParameterConfig& config,
+                      size_t sparseId) const;
+
+  virtual TraverseCallback needCatchUpBeforeForward() const;
+  virtual TraverseCallback startCatchUpWith() const;
+  virtual void finishCatchUpWith();
+
+  /**
+   * update() and grad = 0 on the cpu buffers, used by PSERVER_OP_SVRG.
+   * Plain sgd without momentum does it in one pass.
+   */
+  void updateAndClearGradient(const VectorPtr vecs[],
+                              const ParameterConfig& config) const;
+
+  virtual void setNoDecay() {
+    applyDecay_ = false;
+    optimizer_->setNoDecay();
+  }
+
+protected:
+  /// value -= sum_{t0 <= t < timer_} lr(t) * gradSum/numBatches for row
+  /// sparseId
+  void catchUpWith(const VectorPtr vecs[], const ParameterConfig& config,
+                   size_t sparseId) const;
+
+  std::unique_ptr<ParameterOptimizer> optimizer_;
+  bool isSgd_;
+
+  /**
+   *  counting batches,
+   *  t(timer_) is current time,
+   *  t0(t0Vec_) are the times that the rows are up to.
+   *  if one block is update by multi threads,
+   *  caller should hash sparse ids to avoid write conflict in t0Vec_.
+   */
+  int64_t timer_;
+  mutable std::vector<int64_t> t0Vec_;
+
+  /**
+   *  prefix sums of lr * batch_rate of the batches since baseTimer_,
+   *  etaSums_[t - baseTimer_] is the sum over batches [baseTimer_, t).
+   *  The skipped batches are charged at their own learning rate,
+   *  not at the current one, when the schedule decays.
+   */
+  int64_t baseTimer_;
+  std::vector<double> etaSums_;
+};
+
 }  // namespace paddle
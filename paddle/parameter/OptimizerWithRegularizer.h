@@ -60,6 +60,10 @@ public:
     return optimizer_->needSpecialTraversal(config);
   }
 
+  virtual TraverseCallback needCatchUpBeforeForward() const {
+    return optimizer_->needCatchUpBeforeForward();
+  }
+
   virtual void update(const VectorPtr vecs[], const ParameterConfig& config,
                       size_t sparseId) const {
     optimizer_->update(vecs, config, sparseId);
@@ -251,6 +251,70 @@ SparsePrefetchRowCpuMatrix* Parameter::getPrefetchMatrix() {
   return nullptr;
 }
 
+void BufferViews::add(const std::shared_ptr<BaseMatrix>& view,
+                      size_t offset) {
+  std::lock_guard<std::mutex> guard(lock_);
+  views_.emplace_back(view, offset);
+}
+
+void BufferViews::setData(real* data) {
+  std::lock_guard<std::mutex> guard(lock_);
+  size_t numAlive = 0;
+  for (auto& view : views_) {
+    if (auto mat = view.first.lock()) {
+      mat->setData(data + view.second);
+      views_[numAlive++] = view;
+    }
+  }
+  // drop the views of the layers which are gone
+  views_.resize(numAlive);
+}
+
+void Parameter::registerValueView(const std::shared_ptr<BaseMatrix>& view) {
+  const VectorPtr& value = bufs_[PARAMETER_VALUE];
+  if (!view || !value) return;
+  real* data = view->data_;
+  CHECK(data >= value->getData() &&
+        data < value->getData() + value->getSize())
+      << "view is not on the value of " << getName();
+  if (!bufViews_[PARAMETER_VALUE]) {
+    bufViews_[PARAMETER_VALUE] = std::make_shared<BufferViews>();
+  }
+  bufViews_[PARAMETER_VALUE]->add(view, data - value->getData());
+}
+
+void Parameter::shareBufferViews(ParameterType type, Parameter* from,
+                                 ParameterType fromType) {
+  if (!from->bufViews_[fromType]) {
+    from->bufViews_[fromType] = std::make_shared<BufferViews>();
+  }
+  bufViews_[type] = from->bufViews_[fromType];
+}
+
+void Parameter::swapSnapshotValue() {
+  const VectorPtr& value = bufs_[PARAMETER_VALUE];
+  const VectorPtr& snapshot = bufs_[PARAMETER_SNAPSHOT_VALUE];
+  CHECK(value && snapshot) << getName();
+  if (isSparse() || isSparseRemoteUpdate() || isValueShared()) {
+    // the matrices of these keep their own structure on the memory
+    snapshot->deepSwap(*value);
+    setValueUpdated();
+    return;
+  }
+
+  value->swapMemory(*snapshot);
+  for (auto type : {PARAMETER_VALUE, PARAMETER_SNAPSHOT_VALUE}) {
+    real* data = bufs_[type]->getData();
+    if (mats_[type]) {
+      mats_[type]->setData(data);
+    }
+    if (bufViews_[type]) {
+      bufViews_[type]->setData(data);
+    }
+  }
+  setValueUpdated();
+}
+
 void Parameter::updateWithGradient(real learningRate) {
   sgdUpdate(learningRate * config_.learning_rate(), config_.momentum(),
             config_.decay_rate(), bufs_[PARAMETER_VALUE].get(),
@@ -18,6 +18,8 @@ limitations under the License. */
 #include <stdint.h>
 
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -52,6 +54,24 @@ struct Segment {
   int64_t beginPos;  // beginning position in the local value or grad buffer
 };
 
+/**
+ * Vectors and matrices created by layers on a parameter buffer, e.g. the
+ * bias of a layer, or the peephole weights of an lstm. They are shared by
+ * all the parameters which share the buffer, and are moved to the new
+ * memory when Parameter::swapSnapshotValue() swaps the buffer memory.
+ */
+class BufferViews {
+public:
+  /// view must stay inside the buffer, offset is its position in the buffer
+  void add(const std::shared_ptr<BaseMatrix>& view, size_t offset);
+
+  /// point every living view to data + offset
+  void setData(real* data);
+
+private:
+  std::mutex lock_;
+  std::vector<std::pair<std::weak_ptr<BaseMatrix>, size_t>> views_;
+};
 
 class Parameter;
 typedef std::shared_ptr<Parameter> ParameterPtr;
@@ -213,6 +233,29 @@ public:
 
   float getInitStandardDeviation() const { return config_.initial_std(); }
 
+  /**
+   * Register a view created on PARAMETER_VALUE outside of getMat(), so that
+   * it follows the value when swapSnapshotValue() is called.
+   */
+  void registerValueView(const std::shared_ptr<BaseMatrix>& view);
+
+  /**
+   * Share the registered views of buffer fromType of from. Call it when
+   * buffer type of this parameter shares the memory of that buffer.
+   */
+  void shareBufferViews(ParameterType type, Parameter* from,
+                        ParameterType fromType);
+
+  /**
+   * Swap PARAMETER_VALUE and PARAMETER_SNAPSHOT_VALUE.
+   *
+   * For dense parameters only the memory is exchanged, the buffers, their
+   * matrices and the registered views are pointed to the other memory,
+   * which also moves the parameters sharing the buffers. Sparse values are
+   * swapped element by element.
+   */
+  void swapSnapshotValue();
+
   void setValueUpdated() { updated_ = true; }
 
   void clearValueUpdated() { updated_ = false; }
@@ -364,6 +407,9 @@ protected:
   /// Int vectors, used in some User defined parameter types
   IVectorPtr intBufs_[NUM_PARAMETER_TYPES];
 
+  /// Views of bufs_ created outside of mats_, see registerValueView()
+  std::shared_ptr<BufferViews> bufViews_[NUM_PARAMETER_TYPES];
+
   int sharedCount_;
   int updateCounter_;
   std::vector<Segment> gradSegments_;  // segments of non-zero gradient
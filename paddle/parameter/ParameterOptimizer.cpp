@@ -26,15 +26,8 @@ limitations under the License. */
 
 namespace paddle {
 
-ParameterOptimizer* ParameterOptimizer::create(
-    const OptimizationConfig& optConfig, bool inPserver) {
-  if (inPserver && optConfig.num_batches_per_send_parameter() > 1) {
-    return new AddOptimizer(optConfig);
-  }
-  if (optConfig.algorithm() == "svrg") {
-    VLOG(1) << "create svrg parameter optimizer";
-    return new SvrgOptimizer(optConfig);
-  }
+static ParameterOptimizer* createFirstOrderOptimizer(
+    const OptimizationConfig& optConfig) {
   if (optConfig.learning_method() == "momentum") {
     return new SgdOptimizer(optConfig);
   }
@@ -65,4 +58,18 @@ ParameterOptimizer* ParameterOptimizer::create(
   return nullptr;
 }
 
+ParameterOptimizer* ParameterOptimizer::create(
+    const OptimizationConfig& optConfig, bool inPserver) {
+  if (inPserver && optConfig.num_batches_per_send_parameter() > 1) {
+    return new AddOptimizer(optConfig);
+  }
+  ParameterOptimizer* optimizer = createFirstOrderOptimizer(optConfig);
+  if (optimizer && optConfig.algorithm() == "svrg") {
+    VLOG(1) << "create svrg parameter optimizer with "
+            << optConfig.learning_method();
+    return new SvrgOptimizer(optConfig, optimizer);
+  }
+  return optimizer;
+}
+
 }  // namespace paddle
@@ -115,6 +115,20 @@ public:
   virtual void update(const VectorPtr vecs[], const ParameterConfig& config,
                       size_t sparseId = -1LU) const = 0;
 
+  /**
+   * update() with the variance reduced gradient of SVRG
+   * PARAMETER_GRADIENT + gradSumRate * PARAMETER_GRADIENT_SUM.
+   * PARAMETER_GRADIENT may be changed.
+   * Optimizers override it to do the update in one pass over the buffers.
+   */
+  virtual void updateWithGradientSum(const VectorPtr vecs[],
+                                     const ParameterConfig& config,
+                                     real gradSumRate,
+                                     size_t sparseId = -1LU) const {
+    vecs[PARAMETER_GRADIENT]->add(*vecs[PARAMETER_GRADIENT_SUM], gradSumRate);
+    update(vecs, config, sparseId);
+  }
+
  /**
   * following hooks catch up with current time for sparse update,
   * In the beginning, call startCatchUpWith() and check return.
@@ -143,6 +157,19 @@ public:
   virtual TraverseCallback startCatchUpWith() const { return nullptr; }
   virtual void finishCatchUpWith() {}
 
+ /**
+  * Some optimizers update the sparse rows lazily, and the rows not in the
+  * batch are behind the current time until they are updated again. The
+  * returned callback brings the rows used by the coming batch up to the
+  * current time, so that forward() and backward() see the actual values.
+  * Call it after startBatch() and before forward(), over the rows of the
+  * batch, the same way as the callback of startCatchUpWith().
+  *
+  * @return callback if the rows need to be caught up with before forward,
+  *         else return nullptr.
+  */
+  virtual TraverseCallback needCatchUpBeforeForward() const { return nullptr; }
+
  /**
   * following two hooks used by averager,
   * apply to final parameter value (PARAMETER_VALUE or PARAMETER_APPLY).
@@ -33,6 +33,16 @@ void sgdUpdateCpu(real learningRate, real momentum, real decayRate, size_t size,
   }
 }
 
+void svrgUpdateCpu(real learningRate, real gradSumRate, real decayRate,
+                   size_t size, real* value, real* grad, const real* gradSum) {
+  decayRate *= learningRate;
+  for (size_t i = 0; i < size; ++i) {
+    value[i] -= learningRate * grad[i] + gradSumRate * gradSum[i] +
+                decayRate * value[i];
+    grad[i] = 0;
+  }
+}
+
 void sgdUpdate(real learningRate, real momentum, real decayRate, Vector* value,
                Vector* grad, Vector* momentumVec) {
   size_t size = value->getSize();
@@ -41,4 +41,15 @@ void sgdUpdateAvx(float learningRate, float momentum, float decayRate,
                   size_t size, float* value, const float* grad,
                   float* momentumVec);
 
+/**
+ * Performs the SVRG update and clears the gradient in one pass.
+ *
+ * value = value - learningRate * grad
+ *               - gradSumRate * gradSum
+ *               - learningRate * decayRate * value
+ * grad = 0
+ */
+void svrgUpdateCpu(real learningRate, real gradSumRate, real decayRate,
+                   size_t size, real* value, real* grad, const real* gradSum);
+
 }  // namespace paddle
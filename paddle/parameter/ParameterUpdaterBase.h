@@ -75,6 +75,11 @@ public:
   // trainer should catch up with before parameter is saved or sended.
   virtual void catchUpWith() {}
 
+  // lazily updated sparse rows used by the coming batch are caught up
+  // with before forward(). Trainer calls it after startBatch() and
+  // GradientMachine::prefetch(), which registers the rows of the batch.
+  virtual void catchUpBatchRows() {}
+
   // following two hooks used by averager
   // apply to final parameter value (PARAMETER_VALUE or PARAMETER_APPLY).
   // restore() will restore orginal value if it apply to PARAMETER_VALUE.
@@ -157,6 +162,12 @@ public:
         [&](int tid, size_t numThreads) { updaters_[tid]->catchUpWith(); });
   }
 
+  virtual void catchUpBatchRows() {
+    syncThreadPool_->execPlusOwner([&](int tid, size_t numThreads) {
+      updaters_[tid]->catchUpBatchRows();
+    });
+  }
+
 #ifndef PADDLE_DISABLE_TIMER
   virtual void setForwardbackwardTime(uint64_t delta) {
     for (auto& updater : updaters_) {
@@ -32,6 +32,7 @@ Weight::Weight(size_t height, size_t width, ParameterPtr param) {
   weight_ = param->getMat(PARAMETER_VALUE);
   if (!weight_ && vPtr) {
     weight_ = Matrix::create(vPtr->getMemoryHandle(), height, width);
+    param->registerValueView(weight_);
   }
   if (weight_) {
     CHECK_EQ(height, weight_->getHeight());
@@ -62,6 +63,7 @@ Weight::Weight(size_t height, size_t width, ParameterPtr param, size_t offset) {
   if (vPtr) {
     weight_ = Matrix::create(vPtr->getData() + offset, height, width,
                              /* trans */ false, param->useGpu());
+    param->registerValueView(weight_);
   }
 
   // weightGrad
@@ -19,6 +19,7 @@ limitations under the License. */
 #include <gtest/gtest.h>
 #include <paddle/utils/Flags.h>
 #include <paddle/parameter/ParameterUpdateFunctions.h>
+#include <paddle/parameter/FirstOrderOptimizer.h>
 #include <paddle/utils/Stat.h>
 #include <paddle/utils/Thread.h>
 
@@ -147,6 +148,268 @@ TEST_F(CommonTest, sgdUpdate) {
   testStat_.printAllStatus();
 }
 
+TEST_F(CommonTest, svrgUpdate) {
+  for (auto& size : sizeVec_) {
+    CpuVector value(size), grad(size), gradSum(size);
+    value.rand();
+    grad.rand();
+    gradSum.rand();
+    CpuVector expectedValue(size);
+    expectedValue.copyFrom(value);
+    expectedValue.svrgUpdate(grad, gradSum, learningRate_,
+                             0.1 * learningRate_, 0.01);
+
+    svrgUpdateCpu(learningRate_, 0.1 * learningRate_, 0.01, size,
+                  value.getData(), grad.getData(), gradSum.getData());
+    for (size_t i = 0; i < size; ++i) {
+      ASSERT_NEAR(expectedValue.getData()[i], value.getData()[i], 1e-6);
+    }
+    ASSERT_EQ(0, grad.getAbsMax());
+  }
+}
+
+// the fused svrg update of each optimizer should be the same as
+// grad += batch_rate * gradSum followed by its plain update, for the value
+// and all the buffers of the optimizer
+TEST_F(CommonTest, svrgOptimizer) {
+  const size_t size = 1027;
+  for (auto method : {"momentum", "adagrad", "adadelta", "rmsprop",
+                      "decayed_adagrad", "adam", "adamax"}) {
+    OptimizationConfig optConfig;
+    optConfig.set_learning_method(method);
+    optConfig.set_learning_rate(0.1);
+    optConfig.set_batch_rate(0.25);
+    OptimizationConfig refConfig = optConfig;
+    optConfig.set_algorithm("svrg");
+    ParameterConfig paraConfig;
+    paraConfig.set_learning_rate(1.0);
+    paraConfig.set_momentum(0.9);
+    paraConfig.set_decay_rate(0.01);
+
+    std::unique_ptr<ParameterOptimizer> optimizer(
+        ParameterOptimizer::create(optConfig));
+    std::unique_ptr<ParameterOptimizer> refOptimizer(
+        ParameterOptimizer::create(refConfig));
+    ASSERT_TRUE(dynamic_cast<SvrgOptimizer*>(optimizer.get()));
+
+    VectorPtr vecs[NUM_PARAMETER_TYPES];
+    VectorPtr refVecs[NUM_PARAMETER_TYPES];
+    for (auto type : optimizer->getParameterTypes()) {
+      vecs[type] = Vector::create(size, false);
+      vecs[type]->rand();
+      if (type != PARAMETER_VALUE && type != PARAMETER_MOMENTUM &&
+          type != PARAMETER_GRADIENT_SUM) {
+        // the statistics of the gradient start from 0, as in training
+        vecs[type]->zeroMem();
+      }
+      refVecs[type] = Vector::create(size, false);
+      refVecs[type]->copyFrom(*vecs[type]);
+    }
+    optimizer->init(0, &paraConfig);
+    refOptimizer->init(0, &paraConfig);
+    for (int batch = 0; batch < 3; ++batch) {
+      vecs[PARAMETER_GRADIENT]->rand();
+      refVecs[PARAMETER_GRADIENT]->copyFrom(*vecs[PARAMETER_GRADIENT]);
+      optimizer->startBatch(batch * 10);
+      refOptimizer->startBatch(batch * 10);
+
+      optimizer->update(vecs, paraConfig, -1LU);
+      refVecs[PARAMETER_GRADIENT]->add(*refVecs[PARAMETER_GRADIENT_SUM],
+                                       optConfig.batch_rate());
+      refOptimizer->update(refVecs, paraConfig, -1LU);
+
+      optimizer->finishBatch();
+      refOptimizer->finishBatch();
+    }
+    for (auto type : optimizer->getParameterTypes()) {
+      if (type == PARAMETER_GRADIENT) continue;
+      for (size_t i = 0; i < size; ++i) {
+        real expected = refVecs[type]->getData()[i];
+        ASSERT_NEAR(expected, vecs[type]->getData()[i],
+                    1e-5 * std::max((real)1, std::abs(expected)))
+            << method << " type=" << type << " i=" << i;
+      }
+    }
+  }
+}
+
+// lazy svrg on sparse rows should be the same as updating every row
+// in every batch, after catching up
+TEST_F(CommonTest, svrgOptimizerSparse) {
+  const size_t height = 20;
+  const size_t width = 7;
+  OptimizationConfig optConfig;
+  optConfig.set_learning_method("momentum");
+  optConfig.set_learning_rate(0.1);
+  optConfig.set_batch_rate(0.25);
+  optConfig.set_algorithm("svrg");
+  ParameterConfig paraConfig;
+  paraConfig.set_learning_rate(1.0);
+  paraConfig.set_sparse_update(true);
+
+  std::unique_ptr<ParameterOptimizer> lazy(
+      ParameterOptimizer::create(optConfig));
+  std::unique_ptr<ParameterOptimizer> dense(
+      ParameterOptimizer::create(optConfig));
+  lazy->init(height, &paraConfig);
+  dense->init(0, &paraConfig);
+
+  VectorPtr lazyBufs[NUM_PARAMETER_TYPES];
+  VectorPtr denseBufs[NUM_PARAMETER_TYPES];
+  for (auto type : lazy->getParameterTypes()) {
+    lazyBufs[type] = Vector::create(height * width, false);
+    lazyBufs[type]->rand();
+    denseBufs[type] = Vector::create(height * width, false);
+    denseBufs[type]->copyFrom(*lazyBufs[type]);
+  }
+  lazyBufs[PARAMETER_MOMENTUM]->zeroMem();
+  denseBufs[PARAMETER_MOMENTUM]->zeroMem();
+
+  VectorPtr vecs[NUM_PARAMETER_TYPES];
+  for (auto type : lazy->getParameterTypes()) {
+    vecs[type] = Vector::create(nullptr, 0, false);
+  }
+  for (int batch = 0; batch < 10; ++batch) {
+    lazy->startBatch(batch * 10);
+    dense->startBatch(batch * 10);
+    denseBufs[PARAMETER_GRADIENT]->zeroMem();
+    // rows batch % 3, batch % 3 + 3, ... are in the batch
+    for (size_t row = batch % 3; row < height; row += 3) {
+      for (auto type : lazy->getParameterTypes()) {
+        vecs[type]->subVecFrom(*lazyBufs[type], row * width, width);
+      }
+      vecs[PARAMETER_GRADIENT]->rand();
+      denseBufs[PARAMETER_GRADIENT]->subVec(row * width, width)->copyFrom(
+          *vecs[PARAMETER_GRADIENT]);
+      lazy->update(vecs, paraConfig, row);
+    }
+    dense->update(denseBufs, paraConfig, -1LU);
+    lazy->finishBatch();
+    dense->finishBatch();
+  }
+
+  auto callback = lazy->startCatchUpWith();
+  ASSERT_TRUE(callback);
+  for (size_t row = 0; row < height; ++row) {
+    for (auto type : lazy->getParameterTypes()) {
+      vecs[type]->subVecFrom(*lazyBufs[type], row * width, width);
+    }
+    callback(vecs, paraConfig, row);
+  }
+  lazy->finishCatchUpWith();
+
+  for (size_t i = 0; i < height * width; ++i) {
+    ASSERT_NEAR(denseBufs[PARAMETER_VALUE]->getData()[i],
+                lazyBufs[PARAMETER_VALUE]->getData()[i], 1e-5);
+  }
+}
+
+// the gradient of f_b(w) = |w - c|^2 / 2 depends on the value, so the rows
+// of a batch are caught up with before the gradient is computed. All the
+// numbers are dyadic, so lazy and dense svrg agree bit for bit even with a
+// decaying learning rate.
+TEST_F(CommonTest, svrgOptimizerSparseQuadratic) {
+  const size_t height = 20;
+  const size_t width = 7;
+  OptimizationConfig optConfig;
+  optConfig.set_learning_method("momentum");
+  optConfig.set_learning_rate(0.5);
+  // halved every two batches
+  optConfig.set_learning_rate_schedule("discexp");
+  optConfig.set_learning_rate_decay_a(0.5);
+  optConfig.set_learning_rate_decay_b(20);
+  optConfig.set_batch_rate(0.25);
+  optConfig.set_algorithm("svrg");
+  ParameterConfig paraConfig;
+  paraConfig.set_learning_rate(1.0);
+  paraConfig.set_sparse_update(true);
+
+  std::unique_ptr<ParameterOptimizer> lazy(
+      ParameterOptimizer::create(optConfig));
+  std::unique_ptr<ParameterOptimizer> dense(
+      ParameterOptimizer::create(optConfig));
+  lazy->init(height, &paraConfig);
+  dense->init(0, &paraConfig);
+
+  VectorPtr lazyBufs[NUM_PARAMETER_TYPES];
+  VectorPtr denseBufs[NUM_PARAMETER_TYPES];
+  for (auto type : lazy->getParameterTypes()) {
+    lazyBufs[type] = Vector::create(height * width, false);
+    lazyBufs[type]->zeroMem();
+    denseBufs[type] = Vector::create(height * width, false);
+  }
+  for (size_t i = 0; i < height * width; ++i) {
+    lazyBufs[PARAMETER_VALUE]->getData()[i] = (real)((i * 7) % 9) - 4;
+    lazyBufs[PARAMETER_SNAPSHOT_VALUE]->getData()[i] = (real)((i * 5) % 7) - 3;
+    lazyBufs[PARAMETER_GRADIENT_SUM]->getData()[i] = (real)((i * 3) % 5) - 2;
+  }
+  for (auto type : lazy->getParameterTypes()) {
+    denseBufs[type]->copyFrom(*lazyBufs[type]);
+  }
+
+  VectorPtr vecs[NUM_PARAMETER_TYPES];
+  for (auto type : lazy->getParameterTypes()) {
+    vecs[type] = Vector::create(nullptr, 0, false);
+  }
+  auto setupRow = [&](size_t row) {
+    for (auto type : lazy->getParameterTypes()) {
+      vecs[type]->subVecFrom(*lazyBufs[type], row * width, width);
+    }
+  };
+  // \partial f_b(w_t) - \partial f_b(w_s) = w_t - w_s
+  auto calcGrad = [](VectorPtr bufs[]) {
+    bufs[PARAMETER_GRADIENT]->copyFrom(*bufs[PARAMETER_VALUE]);
+    bufs[PARAMETER_GRADIENT]->add(*bufs[PARAMETER_SNAPSHOT_VALUE], -1.0f);
+  };
+
+  int batch = 0;
+  for (int pass = 0; pass < 2; ++pass) {
+    for (int i = 0; i < 4; ++i, ++batch) {
+      lazy->startBatch(batch * 10);
+      dense->startBatch(batch * 10);
+      auto catchUp = lazy->needCatchUpBeforeForward();
+      ASSERT_EQ(batch > 0, (bool)catchUp);
+
+      // forward and backward, rows batch % 3, batch % 3 + 3, ...
+      denseBufs[PARAMETER_GRADIENT]->zeroMem();
+      for (size_t row = batch % 3; row < height; row += 3) {
+        setupRow(row);
+        if (catchUp) {
+          catchUp(vecs, paraConfig, row);
+        }
+        calcGrad(vecs);
+        VectorPtr denseRow[NUM_PARAMETER_TYPES];
+        for (auto type : lazy->getParameterTypes()) {
+          denseRow[type] = denseBufs[type]->subVec(row * width, width);
+        }
+        calcGrad(denseRow);
+      }
+
+      for (size_t row = batch % 3; row < height; row += 3) {
+        setupRow(row);
+        lazy->update(vecs, paraConfig, row);
+      }
+      dense->update(denseBufs, paraConfig, -1LU);
+      lazy->finishBatch();
+      dense->finishBatch();
+    }
+
+    auto callback = lazy->startCatchUpWith();
+    ASSERT_TRUE(callback);
+    for (size_t row = 0; row < height; ++row) {
+      setupRow(row);
+      callback(vecs, paraConfig, row);
+    }
+    lazy->finishCatchUpWith();
+
+    for (size_t i = 0; i < height * width; ++i) {
+      ASSERT_EQ(denseBufs[PARAMETER_VALUE]->getData()[i],
+                lazyBufs[PARAMETER_VALUE]->getData()[i])
+          << "pass=" << pass << " i=" << i;
+    }
+  }
+}
+
 TEST_F(CommonTest, syncThreadPool) {
   SyncThreadPool pool(10);
 
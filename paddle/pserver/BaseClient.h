@@ -50,6 +50,8 @@ protected:
     SendRequest parallelRequests;
     /// store data, such as features for metric learning
     SendDataRequestVec parallelDataRequests;
+    /// compressed gradients of the parameters, referred by parallelInputIovs
+    std::vector<std::vector<char>> compressedBuffers;
   };
 
 public:
@@ -0,0 +1,194 @@
+/* Copyright (c) 2016 Baidu, Inc. All Rights Reserve.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include "GradientCompression.h"
+
+#include <string.h>
+#include <algorithm>
+#include <cmath>
+
+#include "paddle/math/SIMDFunctions.h"
+#include "paddle/utils/Logging.h"
+#include "paddle/utils/ThreadLocal.h"
+
+namespace paddle {
+
+/// indices of a block sorted by the residual, for top k
+static ThreadLocal<std::vector<uint32_t>> topkIndex_;
+
+GradientCompression getGradientCompression(const std::string& name) {
+  if (name == "none") {
+    return GRADIENT_COMPRESSION_NONE;
+  } else if (name == "fp16") {
+    return GRADIENT_COMPRESSION_FP16;
+  } else if (name == "int8") {
+    return GRADIENT_COMPRESSION_INT8;
+  } else if (name == "topk") {
+    return GRADIENT_COMPRESSION_TOPK;
+  }
+  LOG(FATAL) << "Unknown gradient compression: " << name;
+  return GRADIENT_COMPRESSION_NONE;
+}
+
+/// number of elements sent from a block of size elements
+static size_t getNumTopk(size_t size, real ratio) {
+  size_t k = (size_t)std::ceil(size * ratio);
+  return std::min(size, std::max(k, (size_t)1));
+}
+
+GradientCompressor::GradientCompressor(const ParameterConfig& config)
+    : type_(config.gradient_compression()),
+      size_(config.size()),
+      blockSize_(config.parameter_block_size()),
+      topkRatio_(config.gradient_topk_ratio()) {
+  CHECK_GT(blockSize_, 0UL);
+  if (type_ == GRADIENT_COMPRESSION_TOPK) {
+    CHECK(topkRatio_ > 0 && topkRatio_ <= 1) << "gradient_topk_ratio "
+                                             << topkRatio_;
+    residual_.resize(size_, 0);
+  }
+}
+
+size_t GradientCompressor::getBlockBytes(size_t size) const {
+  switch (type_) {
+    case GRADIENT_COMPRESSION_NONE:
+      return size * sizeof(real);
+    case GRADIENT_COMPRESSION_FP16:
+      return size * sizeof(uint16_t);
+    case GRADIENT_COMPRESSION_INT8:
+      return sizeof(float) + size * sizeof(int8_t);
+    case GRADIENT_COMPRESSION_TOPK:
+      return sizeof(uint32_t) +
+             getNumTopk(size, topkRatio_) * (sizeof(uint32_t) + sizeof(float));
+  }
+  LOG(FATAL) << "Unknown gradient compression: " << type_;
+  return 0;
+}
+
+size_t GradientCompressor::getBufferBytes() const {
+  size_t numBlocks = (size_ + blockSize_ - 1) / blockSize_;
+  return numBlocks * getBlockBytes(blockSize_);
+}
+
+void GradientCompressor::compressBlock(const real* grad, size_t beginPos,
+                                       size_t size, char* out) {
+  switch (type_) {
+    case GRADIENT_COMPRESSION_NONE:
+      memcpy(out, grad, size * sizeof(real));
+      break;
+    case GRADIENT_COMPRESSION_FP16: {
+      uint16_t* halfs = reinterpret_cast<uint16_t*>(out);
+      for (size_t i = 0; i < size; ++i) {
+        halfs[i] = simd::floatToHalf(grad[i]);
+      }
+      break;
+    }
+    case GRADIENT_COMPRESSION_INT8: {
+      real maxAbs = 0;
+      for (size_t i = 0; i < size; ++i) {
+        maxAbs = std::max(maxAbs, std::abs(grad[i]));
+      }
+      // the payload is float whatever real is
+      float scale = static_cast<float>(maxAbs / 127);
+      memcpy(out, &scale, sizeof(scale));
+      int8_t* q = reinterpret_cast<int8_t*>(out + sizeof(scale));
+      if (scale == 0) {
+        memset(q, 0, size);
+        break;
+      }
+      // round up with probability of the fraction, so that the expectation
+      // is the gradient itself. xorshift is enough for the rounding noise.
+      uint32_t state = ThreadLocalRandomEngine::get()() | 1;
+      float invScale = 1.0f / scale;
+      for (size_t i = 0; i < size; ++i) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        float u = (state >> 8) * (1.0f / (1 << 24));
+        int v = (int)std::floor(grad[i] * invScale + u);
+        q[i] = (int8_t)std::max(-127, std::min(127, v));
+      }
+      break;
+    }
+    case GRADIENT_COMPRESSION_TOPK: {
+      real* residual = &residual_[beginPos];
+      for (size_t i = 0; i < size; ++i) {
+        residual[i] += grad[i];
+      }
+      uint32_t k = getNumTopk(size, topkRatio_);
+      auto& index = *topkIndex_;
+      index.resize(size);
+      for (size_t i = 0; i < size; ++i) {
+        index[i] = i;
+      }
+      std::nth_element(index.begin(), index.begin() + (k - 1), index.end(),
+                       [residual](uint32_t a, uint32_t b) {
+                         return std::abs(residual[a]) > std::abs(residual[b]);
+                       });
+      /// sorted indices make the scatter on pserver cache friendly
+      std::sort(index.begin(), index.begin() + k);
+
+      memcpy(out, &k, sizeof(k));
+      uint32_t* ids = reinterpret_cast<uint32_t*>(out + sizeof(k));
+      float* values = reinterpret_cast<float*>(ids + k);
+      for (uint32_t j = 0; j < k; ++j) {
+        ids[j] = index[j];
+        values[j] = static_cast<float>(residual[index[j]]);
+        // keeps what float loses of a double residual for later
+        residual[index[j]] -= values[j];
+      }
+      break;
+    }
+  }
+}
+
+void addCompressedGradient(GradientCompression type, const char* data,
+                           size_t bytes, real* dst, size_t size) {
+  switch (type) {
+    case GRADIENT_COMPRESSION_NONE:
+      CHECK_GE(bytes, size * sizeof(real));
+      simd::addTo(dst, reinterpret_cast<const real*>(data), size);
+      break;
+    case GRADIENT_COMPRESSION_FP16:
+      CHECK_GE(bytes, size * sizeof(uint16_t));
+      simd::addHalfTo(dst, reinterpret_cast<const uint16_t*>(data), size);
+      break;
+    case GRADIENT_COMPRESSION_INT8: {
+      CHECK_GE(bytes, sizeof(float) + size);
+      float scale;
+      memcpy(&scale, data, sizeof(scale));
+      const int8_t* q = reinterpret_cast<const int8_t*>(data + sizeof(scale));
+      simd::addInt8To(dst, q, (real)scale, size);
+      break;
+    }
+    case GRADIENT_COMPRESSION_TOPK: {
+      uint32_t k;
+      CHECK_GE(bytes, sizeof(k));
+      memcpy(&k, data, sizeof(k));
+      CHECK_LE(k, size);
+      CHECK_GE(bytes, sizeof(k) + k * (sizeof(uint32_t) + sizeof(float)));
+      const uint32_t* ids = reinterpret_cast<const uint32_t*>(data + sizeof(k));
+      const float* values = reinterpret_cast<const float*>(ids + k);
+      for (uint32_t j = 0; j < k; ++j) {
+        CHECK_LT(ids[j], size);
+        dst[ids[j]] += static_cast<real>(values[j]);
+      }
+      break;
+    }
+    default:
+      LOG(FATAL) << "Unknown gradient compression: " << type;
+  }
+}
+
+}  // namespace paddle
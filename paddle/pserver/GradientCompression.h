@@ -0,0 +1,81 @@
+/* Copyright (c) 2016 Baidu, Inc. All Rights Reserve.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "paddle/utils/TypeDefs.h"
+#include "ParameterConfig.pb.h"
+
+namespace paddle {
+
+/// parse --gradient_compression
+GradientCompression getGradientCompression(const std::string& name);
+
+/**
+ * @brief trainer side encoder of the dense gradient blocks of one parameter
+ *
+ * @note  the encoding of each type is documented in GradientCompression.
+ *        The size of a compressed block only depends on the block size, so
+ *        the iovs of a request can be prepared before compressing, and the
+ *        blocks of one parameter can be compressed by several threads.
+ *
+ *        With GRADIENT_COMPRESSION_TOPK, the elements which are not sent
+ *        are accumulated in a residual and sent in a later batch (error
+ *        feedback), so no gradient is lost.
+ */
+class GradientCompressor {
+public:
+  explicit GradientCompressor(const ParameterConfig& config);
+
+  GradientCompression getType() const { return type_; }
+
+  /// bytes of a compressed block of size elements
+  size_t getBlockBytes(size_t size) const;
+
+  /// bytes of all the compressed blocks of the parameter
+  size_t getBufferBytes() const;
+
+  /// offset of compressed block blockId in a buffer of getBufferBytes()
+  size_t getBlockOffset(int64_t blockId) const {
+    return blockId * getBlockBytes(blockSize_);
+  }
+
+  /**
+   * compress grad[0, size), which begins at beginPos of the parameter,
+   * into getBlockBytes(size) bytes of out. Different blocks can be
+   * compressed concurrently.
+   */
+  void compressBlock(const real* grad, size_t beginPos, size_t size,
+                     char* out);
+
+private:
+  GradientCompression type_;
+  size_t size_;
+  size_t blockSize_;
+  real topkRatio_;
+  /// gradients not sent yet, only for GRADIENT_COMPRESSION_TOPK
+  std::vector<real> residual_;
+};
+
+/**
+ * dst[0, size) += the block compressed by GradientCompressor in data,
+ * which has at least the bytes of the compressed block.
+ */
+void addCompressedGradient(GradientCompression type, const char* data,
+                           size_t bytes, real* dst, size_t size);
+
+}  // namespace paddle
@@ -15,6 +15,8 @@ limitations under the License. */
 
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <netdb.h>
 #include <netinet/in.h>
 #include <fcntl.h>
@@ -24,6 +26,7 @@ limitations under the License. */
 #include <net/if.h>
 #include <net/if_arp.h>
 #include <sstream>
+#include <chrono>
 #include <linux/tcp.h>
 
 #include "LightNetwork.h"
@@ -47,6 +50,18 @@ P_DEFINE_int32(sock_send_buf_size, 1024 * 1024 * 40,
 P_DEFINE_int32(sock_recv_buf_size, 1024 * 1024 * 40,
                "restrict sock recv buff size");
 
+/// with many trainers most of the connections are idle at any time,
+/// polling them saves the threads and context switches of idle connections
+P_DEFINE_int32(sock_server_threads, 0,
+               "number of threads serving the tcp connections of one socket "
+               "server with epoll, more are added while all of them are "
+               "blocked in requests. 0 for one thread per connection");
+
+/// trainers and pservers on one host skip the tcp stack and its buffers
+P_DEFINE_int32(sock_shm_size, 1024 * 1024 * 16,
+               "size of each direction of the shared memory ring used by a "
+               "tcp connection to a server on the same host. 0 to disable");
+
 namespace paddle {
 
 /**
@@ -118,7 +133,7 @@ void setOption(int sockfd) {
  *       read and write.
  */
 SocketServer::SocketServer(const std::string &addr, int port, int rdmaCpu)
-    : port_(port), addr_(addr), stopping_(false) {
+    : port_(port), addr_(addr), stopping_(false), nextConnectionId_(0) {
   if (rdmaCpu == -1) {
     tcpRdma_ = F_TCP;
     socket_ = 0;
@@ -150,7 +165,8 @@ SocketServer::~SocketServer() {
  * @brief start one tcp server which hosts parameter server
  *
  * @note do tcp socket bind and listen. it will spawn one thread
- *       for each connection
+ *       for each connection, or hand the connections to SocketReactor
+ *       if --sock_server_threads > 0
  */
 void SocketServer::tcpServer() {
   int newsockfd;
@@ -186,6 +202,11 @@ void SocketServer::tcpServer() {
   listen(socket_, maxPendingConnections_);
   clilen = sizeof(cli_addr);
 
+  if (FLAGS_sock_server_threads > 0) {
+    reactor_.reset(new SocketReactor(this, FLAGS_sock_server_threads));
+    reactor_->start();
+  }
+
   while (true) {
     /// Accept actual connection from the client
     newsockfd = accept(socket_, (struct sockaddr *)&cli_addr, &clilen);
@@ -197,11 +218,16 @@ void SocketServer::tcpServer() {
     char peerName[kPeerNameLen];
     CHECK(inet_ntop(AF_INET, &cli_addr.sin_addr, peerName, kPeerNameLen));
 
+    if (reactor_) {
+      reactor_->addChannel(createChannel(newsockfd, std::string(peerName)));
+      continue;
+    }
     SocketWorker *worker =
         new SocketWorker(createChannel(newsockfd, std::string(peerName)), this);
     worker->start();
     worker->detach();
   }
+  reactor_.reset();
   close(socket_);
   LOG(INFO) << "pserver accept thread finish, addr=" << addr_
             << " port=" << port_;
@@ -312,6 +338,7 @@ RdmaClientDaemons::~RdmaClientDaemons() {
 void SocketWorker::run() {
   LOG(INFO) << "worker started, peer = " << channel_->getPeerName();
 
+  *server_->connectionId_ = server_->nextConnectionId_++;
   std::vector<iovec> inputIovs;
 
   while (true) {
@@ -328,15 +355,176 @@ void SocketWorker::run() {
   }
 
   LOG(INFO) << "worker begin to finish, peer = " << channel_->getPeerName();
+  server_->onConnectionClosed(*server_->connectionId_);
   delete this;
 }
 
+SocketReactor::SocketReactor(SocketServer *server, size_t numThreads)
+    : server_(server),
+      numThreads_(numThreads),
+      numWorkers_(0),
+      numIdleWorkers_(0),
+      stopping_(false) {
+  CHECK_GT(numThreads_, 0UL);
+  epollFd_ = epoll_create1(EPOLL_CLOEXEC);
+  PCHECK(epollFd_ >= 0) << "ERROR creating epoll";
+  stopFd_ = eventfd(0, EFD_CLOEXEC);
+  PCHECK(stopFd_ >= 0) << "ERROR creating eventfd";
+  struct epoll_event event;
+  memset(&event, 0, sizeof(event));
+  event.events = EPOLLIN;
+  event.data.fd = stopFd_;
+  PCHECK(epoll_ctl(epollFd_, EPOLL_CTL_ADD, stopFd_, &event) == 0);
+
+  std::lock_guard<std::mutex> guard(queueLock_);
+  for (size_t i = 0; i < numThreads_; ++i) {
+    addWorker();
+  }
+}
+
+SocketReactor::~SocketReactor() {
+  {
+    std::lock_guard<std::mutex> guard(queueLock_);
+    stopping_ = true;
+  }
+  uint64_t one = 1;
+  PCHECK(::write(stopFd_, &one, sizeof(one)) == sizeof(one));
+  this->join();
+
+  /// workers busy in requests finish them first
+  {
+    std::unique_lock<std::mutex> guard(queueLock_);
+    queueCond_.notify_all();
+    exitCond_.wait(guard, [this] { return numWorkers_ == 0; });
+    readyQueue_.clear();
+  }
+  connections_.clear();
+  close(epollFd_);
+  close(stopFd_);
+}
+
+void SocketReactor::addChannel(std::unique_ptr<SocketChannel> channel) {
+  CHECK_EQ(channel->getChannelType(), F_TCP);
+  int fd = channel->getTcpSocket();
+  ConnectionPtr conn = std::make_shared<Connection>();
+  conn->channel = std::move(channel);
+  conn->id = server_->nextConnectionId_++;
+  LOG(INFO) << "connection added, peer = " << conn->channel->getPeerName();
+  {
+    std::lock_guard<std::mutex> guard(connectionsLock_);
+    connections_[fd] = conn;
+  }
+  arm(fd, EPOLL_CTL_ADD);
+}
+
+void SocketReactor::arm(int fd, int op) {
+  struct epoll_event event;
+  memset(&event, 0, sizeof(event));
+  /// one shot, so no other worker takes the connection until it is rearmed
+  event.events = EPOLLIN | EPOLLONESHOT;
+  event.data.fd = fd;
+  PCHECK(epoll_ctl(epollFd_, op, fd, &event) == 0) << " fd=" << fd;
+}
+
+void SocketReactor::run() {
+  constexpr int kMaxEvents = 64;
+  struct epoll_event events[kMaxEvents];
+  while (true) {
+    int num = epoll_wait(epollFd_, events, kMaxEvents, -1);
+    if (num < 0) {
+      PCHECK(errno == EINTR) << "ERROR on epoll_wait";
+      continue;
+    }
+    for (int i = 0; i < num; ++i) {
+      int fd = events[i].data.fd;
+      if (fd == stopFd_) {
+        return;
+      }
+      ConnectionPtr conn;
+      {
+        std::lock_guard<std::mutex> guard(connectionsLock_);
+        auto it = connections_.find(fd);
+        CHECK(it != connections_.end()) << " fd=" << fd;
+        conn = it->second;
+      }
+      dispatch(std::move(conn));
+    }
+  }
+}
+
+void SocketReactor::dispatch(ConnectionPtr conn) {
+  std::lock_guard<std::mutex> guard(queueLock_);
+  readyQueue_.push_back(std::move(conn));
+  if (readyQueue_.size() > numIdleWorkers_) {
+    /// the busy workers may be blocked in their requests for long
+    addWorker();
+  } else {
+    queueCond_.notify_one();
+  }
+}
+
+void SocketReactor::addWorker() {
+  ++numWorkers_;
+  std::thread([this]() { work(); }).detach();
+}
+
+void SocketReactor::work() {
+  constexpr int kIdleSeconds = 60;
+  std::unique_lock<std::mutex> guard(queueLock_);
+  while (!stopping_) {
+    if (!readyQueue_.empty()) {
+      ConnectionPtr conn = std::move(readyQueue_.front());
+      readyQueue_.pop_front();
+      guard.unlock();
+      handle(conn);
+      conn.reset();
+      guard.lock();
+      continue;
+    }
+    ++numIdleWorkers_;
+    auto status =
+        queueCond_.wait_for(guard, std::chrono::seconds(kIdleSeconds));
+    --numIdleWorkers_;
+    if (status == std::cv_status::timeout && readyQueue_.empty() &&
+        numWorkers_ > numThreads_) {
+      break;
+    }
+  }
+  --numWorkers_;
+  exitCond_.notify_all();
+}
+
+void SocketReactor::handle(const ConnectionPtr &conn) {
+  int fd = conn->channel->getTcpSocket();
+  std::unique_ptr<MsgReader> msgReader = conn->channel->readMessage();
+  if (!msgReader) {
+    LOG(INFO) << "connection finish, peer = " << conn->channel->getPeerName();
+    PCHECK(epoll_ctl(epollFd_, EPOLL_CTL_DEL, fd, nullptr) == 0);
+    server_->onConnectionClosed(conn->id);
+    std::lock_guard<std::mutex> guard(connectionsLock_);
+    connections_.erase(fd);
+    return;
+  }
+
+  /// the callback may be kept by the handler and called with the response
+  /// of a later request, so it holds the connection
+  auto callback = [conn](const std::vector<iovec> &outputIovs) {
+    conn->channel->writeMessage(outputIovs);
+  };
+
+  *server_->connectionId_ = conn->id;
+  server_->handleRequest(std::move(msgReader), callback);
+  arm(fd, EPOLL_CTL_MOD);
+}
+
 /**
  * @brief start one tcp connection to tcp server
  * @param[in] serverAddr  tcp server ip
  * @param[in] serverPort  tcp server port
  *
- * @note each object contains one channel which accept byte stream
+ * @note each object contains one channel which accept byte stream.
+ *       the data goes through shared memory if the server is on the
+ *       same host and --sock_shm_size > 0
  */
 void SocketClient::TcpClient(const std::string &serverAddr, int serverPort) {
   struct sockaddr_in serv_addr;
@@ -366,6 +554,18 @@ void SocketClient::TcpClient(const std::string &serverAddr, int serverPort) {
 
   channel_.reset(new SocketChannel(sockfd, serverAddr));
   tcpRdma_ = F_TCP;
+
+  /// the server is on this host if the connection has the same address on
+  /// both ends, which holds for loopback and local interfaces
+  struct sockaddr_in localAddr, peerAddr;
+  socklen_t localLen = sizeof(localAddr);
+  socklen_t peerLen = sizeof(peerAddr);
+  PCHECK(getsockname(sockfd, (sockaddr *)&localAddr, &localLen) == 0);
+  PCHECK(getpeername(sockfd, (sockaddr *)&peerAddr, &peerLen) == 0);
+  if (FLAGS_sock_shm_size > 0 &&
+      localAddr.sin_addr.s_addr == peerAddr.sin_addr.s_addr) {
+    channel_->requestShm(FLAGS_sock_shm_size);
+  }
 }
 
 /**
@@ -21,14 +21,20 @@ limitations under the License. */
 #include <thread>
 #include <vector>
 #include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <unordered_map>
 
 #include "paddle/utils/Thread.h"
+#include "paddle/utils/ThreadLocal.h"
 
 struct sxi_socket;
 
 namespace paddle {
 
 class SocketWorker;
+class SocketReactor;
 
 /**
  * @brief class for holding all parameters processing for current port
@@ -51,6 +57,16 @@ public:
   typedef std::function<void(const std::vector<iovec>& outputIovs)>
       ResponseCallback;
 
+  /**
+   * @brief id of the connection whose request is handled by this thread
+   *
+   * @note  requests of one connection are handled one at a time, but not
+   *        always by the same thread (see SocketReactor), so the state
+   *        kept across requests of a connection should be indexed by this
+   *        id instead of being kept in ThreadLocal.
+   */
+  int64_t getConnectionId() { return *connectionId_; }
+
 protected:
   //
   // The derived class needs to implement this function
@@ -60,6 +76,12 @@ protected:
   virtual void handleRequest(std::unique_ptr<MsgReader> msgReader,
                              ResponseCallback callback) = 0;
 
+  //
+  // Called after the last request of a connection, when the peer has
+  // closed it. The derived class drops the state kept for the connection,
+  // e.g. the requests waiting for the end of a batch.
+  virtual void onConnectionClosed(int64_t connectionId) { (void)connectionId; }
+
   std::unique_ptr<SocketChannel> createChannel(int sock,
                                                const std::string& peerName) {
     return std::unique_ptr<SocketChannel>(new SocketChannel(sock, peerName));
@@ -70,6 +92,7 @@ protected:
   }
 
   friend class SocketWorker;
+  friend class SocketReactor;
 
 private:
   void rdmaServer();
@@ -89,6 +112,11 @@ protected:
   int socket_;
   int maxPendingConnections_;
   bool stopping_;
+  /// serves tcp connections if --sock_server_threads > 0
+  std::unique_ptr<SocketReactor> reactor_;
+
+  std::atomic<int64_t> nextConnectionId_;
+  ThreadLocal<int64_t> connectionId_;
 };
 
 
@@ -112,6 +140,76 @@ protected:
   enum ChannelType tcpRdma_;
 };
 
+/**
+ * @brief class for serving all tcp connections of one socket server with
+ *        a small pool of threads
+ *
+ * @note  one poll thread waits for requests on all the connections with
+ *        epoll, and hands each connection with a pending request to the
+ *        worker threads. The worker reads and handles the request in the
+ *        same way as SocketWorker, so the blocks of the request are still
+ *        read by MsgReader straight into the buffers of the handler. A
+ *        connection is handled by at most one worker at a time, so its
+ *        requests are handled in order.
+ *
+ *        Idle connections hold no thread. Request handlers may block for a
+ *        long time, e.g. waiting for the gradients of other trainers, so a
+ *        worker is added when all the workers are busy, and the workers
+ *        beyond numThreads exit after being idle for a while.
+ */
+class SocketReactor : public Thread {
+public:
+  SocketReactor(SocketServer* server, size_t numThreads);
+  ~SocketReactor();
+
+  /// poll thread main context
+  virtual void run();
+
+  /// start serving channel, which must be a tcp channel
+  void addChannel(std::unique_ptr<SocketChannel> channel);
+
+protected:
+  struct Connection {
+    std::unique_ptr<SocketChannel> channel;
+    int64_t id;
+  };
+  typedef std::shared_ptr<Connection> ConnectionPtr;
+
+  /// worker thread main context
+  void work();
+
+  /// read and handle one request of conn
+  void handle(const ConnectionPtr& conn);
+
+  /// queue conn for the workers, add a worker if all of them are busy
+  void dispatch(ConnectionPtr conn);
+
+  /// start one more worker, queueLock_ must be held
+  void addWorker();
+
+  /// wait for the next request of fd
+  void arm(int fd, int op);
+
+  SocketServer* server_;
+  size_t numThreads_;
+  int epollFd_;
+  /// wakes up the poll thread to stop
+  int stopFd_;
+
+  /// connections indexed by socket fd
+  std::mutex connectionsLock_;
+  std::unordered_map<int, ConnectionPtr> connections_;
+
+  /// guards the members below
+  std::mutex queueLock_;
+  std::condition_variable queueCond_;
+  std::condition_variable exitCond_;
+  std::deque<ConnectionPtr> readyQueue_;
+  size_t numWorkers_;
+  size_t numIdleWorkers_;
+  bool stopping_;
+};
+
 /**
  * @brief class for providing rdma client deamon thread
  *
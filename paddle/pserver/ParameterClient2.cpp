@@ -23,6 +23,33 @@ limitations under the License. */
 
 P_DEFINE_string(pservers, "127.0.0.1", "Comma separated addresses of pservers");
 P_DEFINE_int32(parallel_thread_num, 1, "Thread number for parameter send");
+P_DEFINE_string(gradient_compression, "none",
+                "Compression of the dense gradients sent to pservers: none, "
+                "fp16, int8 (stochastic rounding, scale per block) or topk "
+                "(largest elements of each block, the rest is sent later)");
+P_DEFINE_double(gradient_topk_ratio, 0.01,
+                "Fraction of the block elements sent by "
+                "--gradient_compression=topk");
+P_DEFINE_string(parameter_sharding, "hash",
+                "Placement of the dense parameter blocks on pservers: hash "
+                "(one block size, by block id) or balanced (block size per "
+                "parameter, balancing bytes and update flops of pservers). "
+                "All the trainers must use the same one");
+P_DEFINE_int32(gradient_compression_min_size, 4096,
+               "Gradients of parameters smaller than it are not compressed");
+P_DEFINE_bool(cache_send_layout, true,
+              "Build the blocks of dense parameters once and send them to "
+              "pservers once instead of in every request");
+P_DEFINE_string(sparse_row_freq_file, "",
+                "File of \"parameter_name row_id frequency\" lines. The "
+                "listed sparse rows are placed on pservers by frequency "
+                "instead of by hash. All the trainers must use the same one");
+P_DEFINE_int64(sparse_row_cache_size, 0,
+               "Max number of prefetched sparse rows cached by the trainer, "
+               "0 to disable the cache");
+P_DEFINE_int32(sparse_row_cache_staleness, 1,
+               "Cached sparse rows are fetched again after this number of "
+               "batches");
 
 namespace paddle {
 
@@ -44,29 +71,12 @@ void copyToRepeatedField(const std::vector<T>& src,
 }
 
 ParameterClient2::ParameterClient2(bool separate, int port, int numPorts)
-    : BaseClient(separate, numPorts), port_(port) {
+    : BaseClient(separate, numPorts), port_(port), cachingRows_(false) {
 #ifndef PADDLE_DISABLE_TIMER
     forwardbackwordTime_ = 0;
 #endif
 }
 
-
-int ParameterClient2::calcParameterBlockSize(
-    const std::vector<ParameterPtr>& parameters, size_t serviceNum) {
-  size_t totalSize = 0;
-  for (auto& para : parameters) {
-    totalSize += para->getSize();
-  }
-  size_t perServerSize = totalSize / serviceNum;
-
-  int sizeBits = 64 - __builtin_clzl(perServerSize);
-
-  /// 2^10 is min block size
-  /// 2^7 will be max number of blocks in one pserver
-  int blockSizeBits = std::max((sizeBits - 7), 10);
-  return 1 << blockSizeBits;
-}
-
 void ParameterClient2::initThreads() {
   threadNum_ = serviceNum_;
   if (FLAGS_parallel_thread_num > 1) {
@@ -83,14 +93,32 @@ bool ParameterClient2::init(const std::vector<ParameterPtr>& parameters) {
   std::vector<std::string> hosts;
   str::split(FLAGS_pservers, ',', &hosts);
   serviceNum_ = hosts.size() * numPorts_;
-  uint64_t denseBlockSize = calcParameterBlockSize(parameters, serviceNum_);
+  sharding_.reset(new ParameterSharding(parameters, serviceNum_,
+                                        FLAGS_parameter_sharding,
+                                        FLAGS_sparse_row_freq_file));
 
   /// setup prefetch matrix if exists
   for (auto& para : parameters) {
     /// set block size for each parameter
     para->getConfig().set_parameter_block_size(
-            para->getConfig().sparse_remote_update() ?
-            para->getConfig().dims(1) : denseBlockSize);
+        sharding_->getShard(para->getID()).blockSize);
+  }
+
+  /// pserver learns the compression from the configs sent by setConfig()
+  GradientCompression compression =
+      getGradientCompression(FLAGS_gradient_compression);
+  compressors_.clear();
+  for (auto& para : parameters) {
+    ParameterConfig& config = para->getConfig();
+    if (compression == GRADIENT_COMPRESSION_NONE ||
+        config.sparse_remote_update() ||
+        para->getSize() < (size_t)FLAGS_gradient_compression_min_size) {
+      config.set_gradient_compression(GRADIENT_COMPRESSION_NONE);
+      continue;
+    }
+    config.set_gradient_compression(compression);
+    config.set_gradient_topk_ratio(FLAGS_gradient_topk_ratio);
+    compressors_[para->getID()].reset(new GradientCompressor(config));
   }
 
   for (auto& para : parameters) {
@@ -131,6 +159,20 @@ bool ParameterClient2::init(const std::vector<ParameterPtr>& parameters) {
 
   sparseDistribution_.reset(new SparseParameterDistribution(serviceNum_));
 
+  bool hasSparse = false;
+  for (auto& para : parameters) {
+    hasSparse |= para->getConfig().sparse_remote_update();
+  }
+  if (hasSparse && FLAGS_sparse_row_cache_size > 0) {
+    size_t capacity = std::max<int64_t>(
+        FLAGS_sparse_row_cache_size / serviceNum_, 1);
+    for (size_t i = 0; i < serviceNum_; ++i) {
+      rowCaches_.emplace_back(
+          new SparseRowCache(capacity, FLAGS_sparse_row_cache_staleness));
+    }
+    cachedRows_.resize(serviceNum_);
+  }
+
   sleep(2);
 
   initThreads();
@@ -150,6 +192,54 @@ void ParameterClient2::destroy() {
   parameterMap_.clear();
   allSegments_.clear();
   clients_.clear();
+  sendLayouts_.clear();
+
+  if (!rowCaches_.empty()) {
+    int64_t hits = 0;
+    int64_t misses = 0;
+    for (auto& cache : rowCaches_) {
+      hits += cache->getNumHits();
+      misses += cache->getNumMisses();
+    }
+    LOG(INFO) << "sparse row cache: hits=" << hits << " misses=" << misses;
+    rowCaches_.clear();
+  }
+}
+
+real* ParameterClient2::getRecvBuffer(Parameter* parameter,
+                                      ParameterType recvParameterType,
+                                      uint64_t beginPos) {
+  if (parameter->getBuf(recvParameterType)) {
+    return parameter->getBuf(recvParameterType)->getPoint(beginPos);
+  }
+  auto recvMat = dynamic_cast<SparseRowCpuMatrix*>(
+      parameter->getMat(recvParameterType).get());
+  CHECK(recvMat);
+  size_t width = parameter->getConfig().dims(1);
+  return recvMat->getLocalRow(beginPos / width);
+}
+
+void ParameterClient2::updateRowCache(int serverId,
+                                      const SendParameterResponse& response,
+                                      const std::vector<void*>& bufs,
+                                      ParameterType recvParameterType) {
+  /// before put(), which may evict the cached rows
+  for (const auto& row : cachedRows_[serverId]) {
+    Parameter* parameter = parameterMap_[row.paraId].get();
+    memcpy(getRecvBuffer(parameter, recvParameterType, row.beginPos),
+           row.values, sizeof(real) * parameter->getConfig().dims(1));
+  }
+  cachedRows_[serverId].clear();
+
+  SparseRowCache& cache = *rowCaches_[serverId];
+  for (int i = 0; i < response.blocks_size(); ++i) {
+    const ParameterBlock& block = response.blocks(i);
+    if (!parameterMap_[block.para_id()]->getConfig().sparse_remote_update()) {
+      continue;
+    }
+    cache.put(block.para_id(), block.block_id(), (const real*)bufs[i],
+              block.block_size());
+  }
 }
 
 void ParameterClient2::sendParallel(int tid, size_t numThreads,
@@ -185,21 +275,15 @@ void ParameterClient2::sendParallel(int tid, size_t numThreads,
       auto it = parameterMap_.find(block.para_id());
       CHECK(it != parameterMap_.end());
       Parameter* parameter = it->second.get();
-      real* buf = nullptr;
-      if (parameter->getBuf(recvParameterType)) {
-        buf = parameter->getBuf(recvParameterType)->getPoint(block.begin_pos());
-      } else {
-        auto recvMat = dynamic_cast<SparseRowCpuMatrix*>(
-            parameter->getMat(recvParameterType).get());
-        CHECK(recvMat);
-        size_t width = parameter->getConfig().dims(1);
-        buf = recvMat->getLocalRow(block.begin_pos() / width);
-      }
       /// sparse_id is not useful while receiving data since sparse data
       /// storage is continuous, do commit recieved data as that of dense.
-      bufs.push_back(buf);
+      bufs.push_back(
+          getRecvBuffer(parameter, recvParameterType, block.begin_pos()));
     }
     msgReader->readBlocks(bufs);
+    if (cachingRows_) {
+      updateRowCache(i, response, bufs, recvParameterType);
+    }
   }
 }
 
@@ -210,6 +294,7 @@ void ParameterClient2::prepareSendData(
     BatchStatus batchStatus, SendJob* sendJob) {
   sendJob->parallelRequests.resize(serviceNum_);
   sendJob->parallelInputIovs.resize(serviceNum_);
+  size_t numCompressed = 0;
 
   for (auto& request : sendJob->parallelRequests) {
 #ifndef PADDLE_DISABLE_TIMER
@@ -226,18 +311,33 @@ void ParameterClient2::prepareSendData(
     request.set_batch_status(batchStatus);
     CHECK_EQ(request.blocks_size(), 0);
   }
+  /// only sendAndReceiveParameter() fills the cached rows after receiving
+  cachingRows_ = !rowCaches_.empty() && sendJob == &sendJob_ &&
+                 updateMode == PSERVER_UPDATE_MODE_GET_PARAM_SPARSE;
+  if (cachingRows_) {
+    for (size_t i = 0; i < rowCaches_.size(); ++i) {
+      rowCaches_[i]->tick();
+      cachedRows_[i].clear();
+    }
+  }
+  if (FLAGS_cache_send_layout &&
+      prepareCachedSendData(updateMode, parameterType, parameterSegments,
+                            sendJob)) {
+    return;
+  }
   for (const auto& segments : parameterSegments) {
     const auto it = parameterMap_.find(segments.id);
     CHECK(it != parameterMap_.end());
     Parameter* parameter = it->second.get();
     CHECK(parameter != nullptr) << "parameter is nullptr";
-    int64_t nameHash = std::hash<std::string>()(segments.name);
+    const ParameterSharding::Shard& shard = sharding_->getShard(segments.id);
     bool sendingPara = !(updateMode == PSERVER_UPDATE_MODE_GET_PARAM ||
                          updateMode == PSERVER_UPDATE_MODE_GET_PARAM_SPARSE ||
                          updateMode == PSERVER_UPDATE_MODE_SET_PARAM_ZERO);
     bool sparseUpdate = parameter->getConfig().sparse_remote_update() &&
                         (updateMode == PSERVER_UPDATE_MODE_ADD_GRADIENT ||
                          updateMode == PSERVER_UPDATE_MODE_ASYNC_SGD ||
+                         updateMode == PSERVER_UPDATE_MODE_SSP_SGD ||
                          updateMode == PSERVER_UPDATE_MODE_GET_PARAM_SPARSE);
 
     const auto blockSize = parameter->getConfig().parameter_block_size();
@@ -258,10 +358,18 @@ void ParameterClient2::prepareSendData(
         uint64_t endDim = 0;
         for (size_t row = 0; row < nLocalBlocks; ++row) {
           int64_t blockId = localIndices[row];  // local row -> sparse row
-          int serverId = std::abs((blockId + nameHash) % serviceNum_);
+          int serverId = shard.getServerId(blockId, serviceNum_);
           if (serverId % numThreads != (size_t)tid) {
             continue;
           }
+          if (cachingRows_) {
+            if (const real* values =
+                    rowCaches_[serverId]->get(segments.id, blockId)) {
+              cachedRows_[serverId].push_back(
+                  {segments.id, row * blockSize, values});
+              continue;
+            }
+          }
 
           beginDim = blockId * blockSize;
           endDim = std::min<int64_t>(beginDim + blockSize, paraSize);
@@ -289,11 +397,26 @@ void ParameterClient2::prepareSendData(
     } else {  /// parameter set for dense and sparse
       real* buf = sendingPara ?
           parameter->getBuf(parameterType)->getPoint(0) : nullptr;
+      /// only the accumulated gradients are compressed
+      GradientCompressor* compressor = nullptr;
+      char* compressedBuf = nullptr;
+      auto compressorIt = compressors_.find(segments.id);
+      if (buf && updateMode == PSERVER_UPDATE_MODE_ADD_GRADIENT &&
+          parameterType == PARAMETER_GRADIENT &&
+          compressorIt != compressors_.end()) {
+        compressor = compressorIt->second.get();
+        if (sendJob->compressedBuffers.size() <= numCompressed) {
+          sendJob->compressedBuffers.resize(numCompressed + 1);
+        }
+        auto& compressed = sendJob->compressedBuffers[numCompressed++];
+        compressed.resize(compressor->getBufferBytes());
+        compressedBuf = compressed.data();
+      }
       uint64_t endDim = 0;
       for (uint64_t beginDim = 0; beginDim < paraSize; beginDim = endDim) {
         endDim = std::min<int64_t>(beginDim + blockSize, paraSize);
         int64_t blockId = beginDim / blockSize;
-        int serverId = std::abs((blockId + nameHash) % serviceNum_);
+        int serverId = shard.getServerId(blockId, serviceNum_);
 
         auto& request = sendJob->parallelRequests[serverId];
         ParameterBlock* block = request.add_blocks();
@@ -301,17 +424,117 @@ void ParameterClient2::prepareSendData(
         block->set_block_id(blockId);
         block->set_begin_pos(beginDim);
         block->set_block_size(endDim - beginDim);
-        if (buf) {
+        if (compressor) {
+          sendJob->parallelInputIovs[serverId].push_back(
+              {compressedBuf + compressor->getBlockOffset(blockId),
+               compressor->getBlockBytes(endDim - beginDim)});
+        } else if (buf) {
             sendJob->parallelInputIovs[serverId].push_back({buf + beginDim,
                      sizeof(real) * ((size_t) (endDim - beginDim))});
         }
       }
+
+      if (compressor) {
+        REGISTER_TIMER("compressGradient");
+        syncThreadPool_->exec([&](int tid, size_t numThreads) {
+          int64_t numBlocks = (paraSize + blockSize - 1) / blockSize;
+          for (int64_t blockId = tid; blockId < numBlocks;
+               blockId += numThreads) {
+            uint64_t beginDim = blockId * blockSize;
+            uint64_t endDim = std::min<int64_t>(beginDim + blockSize, paraSize);
+            compressor->compressBlock(
+                buf + beginDim, beginDim, endDim - beginDim,
+                compressedBuf + compressor->getBlockOffset(blockId));
+          }
+        });
+      }
     }
   }  // parameterSegments
 
   sparseDistribution_->checkAndResetDistribution();
 }
 
+bool ParameterClient2::prepareCachedSendData(
+    ParameterUpdateMode updateMode, ParameterType parameterType,
+    const std::vector<ParameterSegments>& parameterSegments,
+    SendJob* sendJob) {
+  if (updateMode == PSERVER_UPDATE_MODE_GET_PARAM_SPARSE) {
+    return false;
+  }
+  bool sendingPara = !(updateMode == PSERVER_UPDATE_MODE_GET_PARAM ||
+                       updateMode == PSERVER_UPDATE_MODE_SET_PARAM_ZERO);
+  bool compressing = updateMode == PSERVER_UPDATE_MODE_ADD_GRADIENT &&
+                     parameterType == PARAMETER_GRADIENT;
+  std::vector<int64_t> key = {updateMode, parameterType};
+  std::vector<real*> bufs;
+  key.reserve(parameterSegments.size() + 2);
+  bufs.reserve(parameterSegments.size());
+  for (const auto& segments : parameterSegments) {
+    const auto it = parameterMap_.find(segments.id);
+    CHECK(it != parameterMap_.end());
+    Parameter* parameter = it->second.get();
+    if (parameter->getConfig().sparse_remote_update() ||
+        (compressing && compressors_.count(segments.id))) {
+      return false;
+    }
+    key.push_back(segments.id);
+    bufs.push_back(sendingPara ? parameter->getBuf(parameterType)->getPoint(0)
+                               : nullptr);
+  }
+
+  std::lock_guard<std::mutex> guard(sendLayoutsMutex_);
+  bool newLayout = sendLayouts_.count(key) == 0;
+  SendLayout& layout = sendLayouts_[key];
+  if (newLayout) {
+    layout.cacheId = sendLayouts_.size() - 1;
+  }
+  if (newLayout || layout.bufs != bufs) {
+    /// the pservers replace the blocks of the id with the new ones
+    layout.bufs = bufs;
+    layout.requests.assign(serviceNum_, SendParameterRequest());
+    layout.iovs.assign(serviceNum_, std::vector<iovec>());
+    layout.sent.assign(serviceNum_, false);
+    for (size_t i = 0; i < parameterSegments.size(); ++i) {
+      size_t paraId = parameterSegments[i].id;
+      Parameter* parameter = parameterMap_[paraId].get();
+      const ParameterSharding::Shard& shard = sharding_->getShard(paraId);
+      const auto blockSize = parameter->getConfig().parameter_block_size();
+      CHECK_GE(blockSize, 1LU) << "blockSize should > 0 " << blockSize;
+      const auto paraSize = parameter->getSize();
+      uint64_t endDim = 0;
+      for (uint64_t beginDim = 0; beginDim < paraSize; beginDim = endDim) {
+        endDim = std::min<int64_t>(beginDim + blockSize, paraSize);
+        int64_t blockId = beginDim / blockSize;
+        int serverId = shard.getServerId(blockId, serviceNum_);
+
+        ParameterBlock* block = layout.requests[serverId].add_blocks();
+        block->set_para_id(paraId);
+        block->set_block_id(blockId);
+        block->set_begin_pos(beginDim);
+        block->set_block_size(endDim - beginDim);
+        if (bufs[i]) {
+          layout.iovs[serverId].push_back(
+              {bufs[i] + beginDim, sizeof(real) * (size_t)(endDim - beginDim)});
+        }
+      }
+    }
+  }
+
+  for (int i = 0; i < serviceNum_; ++i) {
+    auto& request = sendJob->parallelRequests[i];
+    if (layout.requests[i].blocks_size() == 0) {
+      continue;
+    }
+    request.set_blocks_cache_id(layout.cacheId);
+    if (!layout.sent[i]) {
+      *request.mutable_blocks() = layout.requests[i].blocks();
+      layout.sent[i] = true;
+    }
+    sendJob->parallelInputIovs[i] = layout.iovs[i];
+  }
+  return true;
+}
+
 void ParameterClient2::sendAndReceiveParameter(
     ParameterUpdateMode updateMode, ParameterType parameterType,
     const std::vector<ParameterSegments>& parameterSegments, int64_t numSamples,
@@ -461,6 +684,8 @@ void ParameterClient2::setConfig(const OptimizationConfig& optConfig,
   *request.mutable_opt_config() = optConfig;
   request.set_save_dir(saveDir);
   request.set_is_sparse_server(isSparseServer);
+  sharding_->toProto(&request);
+  sharding_->printLoad();
 
   std::vector<SetConfigRequest> requests;
   requests.resize(clients_.size());
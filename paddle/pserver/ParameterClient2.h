@@ -16,6 +16,7 @@ limitations under the License. */
 #pragma once
 
 #include <atomic>
+#include <map>
 #include <mutex>
 #include <vector>
 #include <unordered_map>
@@ -32,7 +33,10 @@ limitations under the License. */
 
 #include "ParameterService.pb.h"
 
+#include "GradientCompression.h"
+#include "ParameterSharding.h"
 #include "SparseParameterDistribution.h"
+#include "SparseRowCache.h"
 #include "ProtoServer.h"
 
 P_DECLARE_int32(parallel_thread_num);
@@ -229,9 +233,6 @@ public:
 
   ~ParameterClient2();
 
-  static int calcParameterBlockSize(const std::vector<ParameterPtr>& parameters,
-                                    size_t serviceNum);
-
 public:
   bool init(const std::vector<ParameterPtr>& parameters);
 
@@ -539,9 +540,38 @@ private:
       ParameterType sendBackParameterType,  // send back type in pserver
       BatchStatus batchStatus, SendJob* sendJob);
 
+  /**
+   * @brief build the blocks and iovecs of dense parameters from a cached
+   *        layout, the request header is already in sendJob.
+   *
+   * @note  the layout of the blocks only changes with the parameters, so
+   *        it is built once per (update mode, parameter type, parameters).
+   *        The blocks go to each pserver with the first request of the
+   *        layout, the later requests only carry its blocks_cache_id.
+   *
+   * @return false if some parameter is sparse or compressed, then
+   *         prepareSendData() builds the request as usual.
+   */
+  bool prepareCachedSendData(
+      ParameterUpdateMode updateMode, ParameterType parameterType,
+      const std::vector<ParameterSegments>& parameterSegments,
+      SendJob* sendJob);
+
   /// start necessary threads for threadPool
   void initThreads();
 
+  /// where the received block of a parameter is written
+  real* getRecvBuffer(Parameter* parameter, ParameterType recvParameterType,
+                      uint64_t beginPos);
+
+  /**
+   * @brief fill the rows taken from the row cache of a pserver, and cache
+   *        the rows received from it.
+   */
+  void updateRowCache(int serverId, const SendParameterResponse& response,
+                      const std::vector<void*>& bufs,
+                      ParameterType recvParameterType);
+
 protected:
   /// start port number of pserver
   /// it deduce all ports for dense and sparse with some rules
@@ -561,9 +591,44 @@ protected:
   /// module for sensing sparse parameters distribution on all pservers
   std::unique_ptr<SparseParameterDistribution> sparseDistribution_;
 
+  /// placement of the parameter blocks on the pservers
+  std::unique_ptr<ParameterSharding> sharding_;
+
+  /// gradient compressors of the parameters with gradient_compression
+  std::unordered_map<size_t, std::unique_ptr<GradientCompressor>>
+      compressors_;
+
   /// thread pool for parallelizing all connections to pservers
   std::unique_ptr<SyncThreadPool> syncThreadPool_;
 
+  /// prefetched sparse rows of each pserver, empty if disabled
+  std::vector<std::unique_ptr<SparseRowCache>> rowCaches_;
+  struct CachedRow {
+    size_t paraId;
+    /// local offset of the row, as begin_pos of its block
+    uint64_t beginPos;
+    const real* values;
+  };
+  /// rows of each pserver taken from rowCaches_ by the current prefetch
+  std::vector<std::vector<CachedRow>> cachedRows_;
+  /// whether sendJob_ is a prefetch using rowCaches_
+  bool cachingRows_;
+
+  /// blocks and iovecs of dense parameters, see prepareCachedSendData()
+  struct SendLayout {
+    int64_t cacheId;
+    /// buffers of the parameters referred by iovs
+    std::vector<real*> bufs;
+    /// blocks for each pserver
+    std::vector<SendParameterRequest> requests;
+    std::vector<std::vector<iovec>> iovs;
+    /// whether the blocks have been sent to each pserver
+    std::vector<bool> sent;
+  };
+  /// keyed by update mode, parameter type and parameter ids
+  std::map<std::vector<int64_t>, SendLayout> sendLayouts_;
+  std::mutex sendLayoutsMutex_;
+
   bool passFinish_;
 };
 
@@ -14,9 +14,18 @@ limitations under the License. */
 
 #include "ParameterServer2.h"
 
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include <unistd.h>
+
 #include <algorithm>
 #include <fstream>
+#include <limits>
+#include <map>
+#include <sstream>
 
+#include "GradientCompression.h"
 #include "paddle/math/SIMDFunctions.h"
 
 #include "paddle/parameter/AverageOptimizer.h"
@@ -31,6 +40,12 @@ limitations under the License. */
 #include "paddle/utils/GlobalConstants.h"
 
 P_DEFINE_int32(pserver_num_threads, 1, "number of threads for sync op exec");
+P_DEFINE_int32(pserver_parallel_add_min_size, 64 * 1024,
+               "add the gradients of a request with pserver_num_threads "
+               "threads if it has at least this number of elements");
+P_DEFINE_bool(pserver_cpu_affinity, false,
+              "pin the pserver_num_threads threads to cpus, spread over "
+              "the numa nodes");
 P_DEFINE_double(async_lagged_ratio_min, 1.0,
                 "control config_.async_lagged_grad_discard_ratio() min value");
 P_DEFINE_double(
@@ -40,6 +55,57 @@ P_DEFINE_double(
 
 namespace paddle {
 
+/// the numa node of cpu, 0 if unknown
+static int getCpuNode(int cpu) {
+  for (int node = 0; node < CPU_SETSIZE; ++node) {
+    std::ostringstream os;
+    os << "/sys/devices/system/cpu/cpu" << cpu << "/node" << node;
+    if (access(os.str().c_str(), F_OK) == 0) {
+      return node;
+    }
+    os.str("");
+    os << "/sys/devices/system/node/node" << node;
+    if (access(os.str().c_str(), F_OK) != 0) {
+      break;
+    }
+  }
+  return 0;
+}
+
+/**
+ * pin the threads of pool to the cpus allowed for the process. Thread i
+ * goes to numa node i % numNodes, so that the blocks updated by the threads
+ * spread over the memory of all the nodes.
+ */
+static void pinThreads(SyncThreadPool* pool) {
+  cpu_set_t allowed;
+  CHECK_EQ(sched_getaffinity(0, sizeof(allowed), &allowed), 0)
+      << strerror(errno);
+  std::map<int, std::vector<int>> nodeCpus;
+  for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+    if (CPU_ISSET(cpu, &allowed)) {
+      nodeCpus[getCpuNode(cpu)].push_back(cpu);
+    }
+  }
+  std::vector<int> cpus;
+  for (size_t i = 0; cpus.size() < (size_t)CPU_COUNT(&allowed); ++i) {
+    for (auto& pair : nodeCpus) {
+      if (i < pair.second.size()) {
+        cpus.push_back(pair.second[i]);
+      }
+    }
+  }
+  LOG(INFO) << "pserver: pin " << pool->getNumThreads() << " threads to "
+            << nodeCpus.size() << " numa nodes";
+  pool->exec([&](int tid, size_t numThreads) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpus[tid % cpus.size()], &set);
+    int ret = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    CHECK_EQ(ret, 0) << strerror(ret);
+  });
+}
+
 const std::string ParameterServer2::kRetMsgInvalidMatrixHandle =
     "Invalid matrix handle";
 const std::string ParameterServer2::kRetMsgInvalidVectorHandle =
@@ -58,6 +124,8 @@ ParameterServer2::ParameterServer2(const std::string& addr, int port,
       numPassFinishClients_(0),
       allClientPassFinish_(false),
       serverId_(-1),
+      numGradientBlocks_(0),
+      gradientBytes_(0),
       batchId_(-1) {
  /**
   * register function for remote client calling, these functions
@@ -85,6 +153,9 @@ ParameterServer2::ParameterServer2(const std::string& addr, int port,
   /// thread pool for parallelizing some computations
   if (FLAGS_pserver_num_threads > 1) {
     syncThreadPool_.reset(new SyncThreadPool(FLAGS_pserver_num_threads, false));
+    if (FLAGS_pserver_cpu_affinity) {
+      pinThreads(syncThreadPool_.get());
+    }
   }
 }
 
@@ -120,6 +191,9 @@ bool ParameterServer2::init() {
   asyncTrainerCommitStat_.resize(FLAGS_num_gradient_servers);
   asyncTrainerCommitStat_.assign(asyncTrainerCommitStat_.size(), 0);
 
+  sspClocks_.assign(FLAGS_num_gradient_servers, 0);
+  sspPassFinished_.assign(FLAGS_num_gradient_servers, false);
+
   return true;
 }
 
@@ -157,8 +231,33 @@ void ParameterServer2::setConfig(const SetConfigRequest& request,
     CHECK_EQ(config.sparse_remote_update(), isSparseServer_);
   }
 
+    size_t plannedSize = 0;
+    for (const auto& shard : request.shards()) {
+      auto it = configMap_.find(shard.para_id());
+      CHECK(it != configMap_.end()) << "Unknown parameter " << shard.para_id();
+      CHECK_EQ(it->second.parameter_block_size(), shard.block_size());
+      CHECK_EQ(shard.hot_rows_size(), shard.hot_row_server_ids_size());
+      for (int i = 0; i < shard.hot_rows_size(); ++i) {
+        hotRowServerIds_[shard.para_id()][shard.hot_rows(i)] =
+            shard.hot_row_server_ids(i);
+      }
+      if (shard.server_ids_size() == 0) continue;
+      auto& serverIds = blockServerIds_[shard.para_id()];
+      serverIds.assign(shard.server_ids().begin(), shard.server_ids().end());
+      for (size_t i = 0; i < serverIds.size(); ++i) {
+        if (serverIds[i] != serverId_) continue;
+        plannedSize += std::min(shard.block_size(),
+                                it->second.size() - i * shard.block_size());
+      }
+    }
+    if (!blockServerIds_.empty()) {
+      LOG(INFO) << "pserver " << serverId_ << ": " << plannedSize
+                << " dense parameter elements by the sharding plan";
+    }
+
     config_ = request.opt_config();
-    if (config_.algorithm() == TrainAlgorithm::AsyncSGD) {
+    if (config_.algorithm() == TrainAlgorithm::AsyncSGD ||
+        (config_.algorithm() == TrainAlgorithm::SVRG && config_.async_svrg())) {
       auto asyncLaggedRatio = config_.async_lagged_grad_discard_ratio();
       if (asyncLaggedRatio <= FLAGS_async_lagged_ratio_min) {
         LOG(INFO) << "WARNING: async_lagged_grad_discard_ratio is too small"
@@ -277,6 +376,23 @@ void ParameterServer2::setParameter(const SendParameterRequest& request,
           << " data_size=" << buffer.size;
     }
 
+    auto serverIdsIt = blockServerIds_.find(block.para_id());
+    if (serverIdsIt != blockServerIds_.end()) {
+      CHECK_EQ(serverIdsIt->second.at(block.block_id()), serverId_)
+          << "Block " << block.block_id() << " of parameter "
+          << block.para_id() << " is not on this pserver by the plan of "
+          << "setConfig, do all trainers use the same --parameter_sharding "
+          << "and --pservers?";
+    }
+    auto hotRowsIt = hotRowServerIds_.find(block.para_id());
+    if (hotRowsIt != hotRowServerIds_.end()) {
+      auto rowIt = hotRowsIt->second.find(block.block_id());
+      CHECK(rowIt == hotRowsIt->second.end() || rowIt->second == serverId_)
+          << "Row " << block.block_id() << " of parameter " << block.para_id()
+          << " is not on this pserver by the plan of setConfig, do all "
+          << "trainers use the same --sparse_row_freq_file?";
+    }
+
     /// add a new block
     if (blockIdMap_.count(key) == 0) {
       blockOffsetMap_[key] = totalSize;
@@ -295,8 +411,8 @@ void ParameterServer2::setParameter(const SendParameterRequest& request,
     const auto types = sgdOptimizerGetTypes(config_, true /*inPserver*/);
     for (const auto type : types) {
       vectors_[type].reset(new CpuVector(size_));
-      vectors_[type]->zeroMem();
     }
+    zeroVectors(types);
 
     blockInfos_.resize(numBlocks);
     for (auto& info : blockInfos_) {
@@ -352,7 +468,8 @@ void ParameterServer2::setParameter(const SendParameterRequest& request,
 void ParameterServer2::addGradient(const SendParameterRequest& request,
                                    std::vector<Buffer>& inputBuffers,
                                    SendParameterResponse* response,
-                                   std::vector<Buffer>* outputBuffers) {
+                                   std::vector<Buffer>* outputBuffers,
+                                   CachedBlocks* cache) {
   VLOG(1) << "pserver: addGradient";
 
   /// forwardbackward delta from all trainers
@@ -371,18 +488,24 @@ void ParameterServer2::addGradient(const SendParameterRequest& request,
   {
     /// approximately pure network overhead
     REGISTER_TIMER_DYNAMIC_SET(
-        "pushRecv", timeToMicroSecond(*handleRequestBegin_), -1, *statSet_);
+        "pushRecv", timeToMicroSecond(getHandleRequestBegin()), -1, *statSet_);
   }
 
 #ifndef PADDLE_DISABLE_TIMER
-  gettimeofday(&(*addGradBegin_), nullptr);
+  {
+    struct timeval begin;
+    gettimeofday(&begin, nullptr);
+    std::lock_guard<std::mutex> guard(addGradBeginLock_);
+    addGradBegin_[getConnectionId()] = begin;
+  }
 #endif
 
   /// barrier fluctuation caused by network and previous forwardbackward
   if (!numPassFinishClients_) {
+    struct timeval handleRequestBegin = getHandleRequestBegin();
     REGISTER_BARRIER_TIMER_SERVER_SET(
         *statSet_, "handleReqBegin", FLAGS_num_gradient_servers,
-        request.trainer_id(), (*handleRequestBegin_),
+        request.trainer_id(), handleRequestBegin,
         isSparseServer_ ? "_sparseUpdater" : "_denseUpdater");
   }
 
@@ -396,36 +519,7 @@ void ParameterServer2::addGradient(const SendParameterRequest& request,
   {
     REGISTER_TIMER_DYNAMIC("addGradCore", -1, *statSet_);
     ReadLockGuard guard(parameterMutex_);
-    int bufferIndex = 0;
-    for (const auto& block : request.blocks()) {
-      int64_t offset = getBlockOffset(block);
-      CHECK_GE(offset, 0) << "Only existing parameter block is allowed: "
-                          << " id=" << block.para_id()
-                          << " block id=" << block.block_id();
-
-      int64_t blockId = getBlockId(block);
-      CHECK_GE(blockId, 0) << "Only existing parameter block is allowed: "
-                          << " id=" << block.para_id()
-                          << " block id=" << block.block_id();
-
-      Buffer buffer = inputBuffers[bufferIndex];
-      ++bufferIndex;
-
-      const real* gradientBuffer = buffer.base;
-      real* gradientSumBuffer = vectors_[PARAMETER_GRADIENT]->getPoint(offset);
-
-      size_t size = buffer.size;
-
-      BlockInfo& info = blockInfos_[blockId];
-      const ParameterConfig& config = getParameterConfig(blockId);
-      if (config.sparse_remote_update()) {
-        CHECK_EQ(size, config.parameter_block_size());
-      } else {  // dense
-        CHECK_LE(size, config.parameter_block_size());
-      }
-      std::lock_guard<std::mutex> guard(*info.lock);
-      simd::addTo(gradientSumBuffer, gradientBuffer, size);
-    }
+    addGradientBlocks(request, inputBuffers, cache);
 
     if (!numPassFinishClients_) {
       REGISTER_BARRIER_TIMER_SERVER(
@@ -472,7 +566,7 @@ void ParameterServer2::addGradient(const SendParameterRequest& request,
     {
       /// total time except overhead of network.
       REGISTER_TIMER_DYNAMIC_SET("sendParaNoRecvNoSend",
-                                 timeToMicroSecond(*addGradBegin_), -1,
+                                 timeToMicroSecond(getAddGradBegin()), -1,
                                  *statSet_);
     }
   }
@@ -589,7 +683,9 @@ void ParameterServer2::asyncSGD(const SendParameterRequest& request,
     outputBuffers->reserve(request.blocks_size());
   }
 
-  bool commitGradient = asyncGrdientCommitCheckAndStat(request);
+  /// ssp bounds the staleness by waiting instead of discarding
+  bool ssp = request.update_mode() == PSERVER_UPDATE_MODE_SSP_SGD;
+  bool commitGradient = ssp || asyncGrdientCommitCheckAndStat(request);
 
   VectorPtr* vecs = Parameter::getTlsTempBufs();
   size_t bufferIndex = 0;
@@ -630,7 +726,8 @@ void ParameterServer2::asyncSGD(const SendParameterRequest& request,
       localBlockBitset[blockId] = true;
     }
 
-    if (!isSparseServer_ && request.send_back_parameter()) {  // dense
+    /// ssp sends back after waiting for the other trainers
+    if (!isSparseServer_ && request.send_back_parameter() && !ssp) {  // dense
       int type = request.send_back_parameter_type();
       sendBackParameter(block, type, response, &buffer, outputBuffers);
     }
@@ -671,6 +768,48 @@ void ParameterServer2::asyncSGD(const SendParameterRequest& request,
   }
 }
 
+void ParameterServer2::sspSGD(const SendParameterRequest& request,
+                              std::vector<Buffer>& inputBuffers,
+                              SendParameterResponse* response,
+                              std::vector<Buffer>* outputBuffers) {
+  CHECK_GE(config_.ssp_staleness(), 0)
+      << "ssp_staleness should be set for PSERVER_UPDATE_MODE_SSP_SGD";
+  asyncSGD(request, inputBuffers, response, outputBuffers);
+  if (request.batch_status() == BATCH_FINISH ||
+      request.batch_status() == BATCH_START_AND_FINISH) {
+    sspTickAndWait(request.trainer_id());
+  }
+
+  if (isSparseServer_ || !request.send_back_parameter()) {
+    return;
+  }
+  ReadLockGuard guard(parameterMutex_);
+  size_t bufferIndex = 0;
+  for (const auto& block : request.blocks()) {
+    /// the gradient buffer is reused to hold the value sent back
+    Buffer buffer = inputBuffers[bufferIndex++];
+    int type = request.send_back_parameter_type();
+    sendBackParameter(block, type, response, &buffer, outputBuffers);
+  }
+}
+
+void ParameterServer2::sspTickAndWait(int trainerId) {
+  CHECK_LT((size_t)trainerId, sspClocks_.size());
+  const int64_t staleness = config_.ssp_staleness();
+  sspCond_.notify_all([&] { ++sspClocks_[trainerId]; });
+
+  REGISTER_TIMER_DYNAMIC("sspWait", -1, *statSet_);
+  sspCond_.wait([&] {
+    for (size_t i = 0; i < sspClocks_.size(); ++i) {
+      if (!sspPassFinished_[i] &&
+          sspClocks_[trainerId] - sspClocks_[i] > staleness) {
+        return false;
+      }
+    }
+    return true;
+  });
+}
+
 void ParameterServer2::getParameter(const SendParameterRequest& request,
                                     std::vector<Buffer>& inputBuffers,
                                     SendParameterResponse* response,
@@ -772,22 +911,67 @@ void ParameterServer2::readAllBlocks(
     MsgReader* msgReader, std::vector<ParameterServer2::Buffer>* buffers) {
   auto& buffer = *readWriteBuffer_;
   size_t numBlocks = msgReader->getNumBlocks();
-  buffer.resizeWithAlignHints(msgReader->getTotalLength()/sizeof(real),
-                              numBlocks);
+  /// compressed gradient blocks may not be a multiple of sizeof(real)
+  buffer.resizeWithAlignHints(
+      msgReader->getTotalLength() / sizeof(real) + numBlocks, numBlocks);
   std::vector<void*> bufs(numBlocks);
   buffers->clear();
   buffers->reserve(numBlocks);
   buffer.resetAlignAlloc();
   for (size_t i = 0; i < numBlocks; ++i) {
     size_t len = msgReader->getBlockLength(i);
-    CHECK_EQ(len % sizeof(real), (size_t)0);
-    size_t size = len / sizeof(real);
+    size_t size = (len + sizeof(real) - 1) / sizeof(real);
     bufs[i] = buffer.nextBlock(size);
     buffers->push_back({(real*)bufs[i], size});
   }
   msgReader->readBlocks(bufs);
 }
 
+ParameterServer2::CachedBlocks* ParameterServer2::getCachedBlocks(
+    const SendParameterRequest& request) {
+  std::lock_guard<std::mutex> guard(blocksCacheLock_);
+  auto key = std::make_pair(getConnectionId(), request.blocks_cache_id());
+  if (request.blocks_size() > 0) {
+    CachedBlocks& cache = blocksCache_[key];
+    cache.blocks = request.blocks();
+    cache.blockIds.clear();
+    cache.offsets.clear();
+    return &cache;
+  }
+  auto it = blocksCache_.find(key);
+  CHECK(it != blocksCache_.end())
+      << "Unknown blocks_cache_id " << request.blocks_cache_id()
+      << " from trainer " << request.trainer_id();
+  return &it->second;
+}
+
+void ParameterServer2::onConnectionClosed(int64_t connectionId) {
+  ProtoServer::onConnectionClosed(connectionId);
+  {
+    std::lock_guard<std::mutex> guard(addGradBeginLock_);
+    addGradBegin_.erase(connectionId);
+  }
+  {
+    /// a trainer which died in the middle of a batch leaves its requests,
+    /// and the callbacks holding the connection
+    std::lock_guard<std::mutex> guard(pendingBatchesLock_);
+    auto it = pendingBatches_.find(connectionId);
+    if (it != pendingBatches_.end()) {
+      LOG(WARNING) << "connection " << connectionId << " closed with "
+                   << it->second.requestVec.size() << " pending requests";
+      pendingBatches_.erase(it);
+    }
+  }
+
+  /// the cache ids are only known to the connection
+  std::lock_guard<std::mutex> guard(blocksCacheLock_);
+  auto begin = blocksCache_.lower_bound(
+      std::make_pair(connectionId, std::numeric_limits<int64_t>::min()));
+  auto end = blocksCache_.lower_bound(
+      std::make_pair(connectionId + 1, std::numeric_limits<int64_t>::min()));
+  blocksCache_.erase(begin, end);
+}
+
 void ParameterServer2::sendParameter(const SendParameterRequest& request,
                                      std::unique_ptr<MsgReader> msgReader,
                                      ProtoResponseCallbackEx callback) {
@@ -797,42 +981,77 @@ void ParameterServer2::sendParameter(const SendParameterRequest& request,
   readAllBlocks(msgReader.get(), &inputBuffers);
   msgReader.reset();
 
+  /// lend the cached blocks to a request without blocks, the requests of a
+  /// connection are handled one by one, so nobody else uses them meanwhile
+  CachedBlocks* cache =
+      request.has_blocks_cache_id() ? getCachedBlocks(request) : nullptr;
+  SendParameterRequest cachedRequest;
+  const SendParameterRequest* fullRequest = &request;
+  if (cache && request.blocks_size() == 0) {
+    cachedRequest.CopyFrom(request);
+    cachedRequest.mutable_blocks()->Swap(&cache->blocks);
+    fullRequest = &cachedRequest;
+  }
+
   switch (request.update_mode()) {
     case PSERVER_UPDATE_MODE_SET_PARAM:
     case PSERVER_UPDATE_MODE_SET_PARAM_ZERO:
-      setParameter(request, inputBuffers, &response, &outputBuffers);
+      setParameter(*fullRequest, inputBuffers, &response, &outputBuffers);
       break;
     case PSERVER_UPDATE_MODE_GET_PARAM:
-      getParameter(request, inputBuffers, &response, &outputBuffers);
+      getParameter(*fullRequest, inputBuffers, &response, &outputBuffers);
       break;
     case PSERVER_UPDATE_MODE_GET_PARAM_SPARSE:
-      getParameterSparse(request, inputBuffers, &response, &outputBuffers);
+      getParameterSparse(*fullRequest, inputBuffers, &response,
+                         &outputBuffers);
       break;
     case PSERVER_UPDATE_MODE_ASYNC_SGD:
-      asyncSGD(request, inputBuffers, &response, &outputBuffers);
+      asyncSGD(*fullRequest, inputBuffers, &response, &outputBuffers);
+      break;
+    case PSERVER_UPDATE_MODE_SSP_SGD:
+      sspSGD(*fullRequest, inputBuffers, &response, &outputBuffers);
       break;
     case PSERVER_UPDATE_MODE_ADD_GRADIENT:
-      addGradient(request, inputBuffers, &response, &outputBuffers);
+      addGradient(*fullRequest, inputBuffers, &response, &outputBuffers,
+                  cache);
       break;
     case PSERVER_UPDATE_MODE_AVERAGE_PARAMETER:
       break;
   }
+  if (fullRequest == &cachedRequest) {
+    cachedRequest.mutable_blocks()->Swap(&cache->blocks);
+  }
   switch (request.update_mode()) {
     case PSERVER_UPDATE_MODE_ADD_GRADIENT:
-      (*requestVec_).push_back(request);
-      (*callbackVec_).push_back(callback);
       if (request.batch_status() == BATCH_FINISH ||
           request.batch_status() == BATCH_START_AND_FINISH) {
-        for (size_t i = 0; i < (*requestVec_).size(); i++) {
+        std::vector<SendParameterRequest> requestVec;
+        std::vector<ProtoResponseCallbackEx> callbackVec;
+        {
+          std::lock_guard<std::mutex> guard(pendingBatchesLock_);
+          auto it = pendingBatches_.find(getConnectionId());
+          if (it != pendingBatches_.end()) {
+            requestVec.swap(it->second.requestVec);
+            callbackVec.swap(it->second.callbackVec);
+            pendingBatches_.erase(it);
+          }
+        }
+        requestVec.push_back(request);
+        callbackVec.push_back(callback);
+        for (size_t i = 0; i < requestVec.size(); i++) {
           ReadLockGuard guard(parameterMutex_);
-          SendParameterRequest& request = (*requestVec_)[i];
+          SendParameterRequest& request = requestVec[i];
           SendParameterResponse responseTemp;
 
           std::vector<iovec> outputIovs;
           if (request.send_back_parameter()) {
             CHECK(!isSparseServer_);
             std::vector<Buffer> outputBuffersTemp;
-            for (const auto& block : request.blocks()) {
+            const auto& blocks =
+                request.blocks_size() == 0 && request.has_blocks_cache_id()
+                    ? getCachedBlocks(request)->blocks
+                    : request.blocks();
+            for (const auto& block : blocks) {
               int type = request.send_back_parameter_type();
               sendBackParameter(block, type, &responseTemp, &outputBuffersTemp);
             }
@@ -842,11 +1061,9 @@ void ParameterServer2::sendParameter(const SendParameterRequest& request,
             }
           }
 
-          ProtoResponseCallbackEx& callbackTemp = (*callbackVec_)[i];
+          ProtoResponseCallbackEx& callbackTemp = callbackVec[i];
           callbackTemp(responseTemp, outputIovs);
         }
-        (*requestVec_).clear();
-        (*callbackVec_).clear();
 
         /// barrier perfromance while all data are send finished.
         /// indicates network flucatuation for big message.
@@ -861,16 +1078,22 @@ void ParameterServer2::sendParameter(const SendParameterRequest& request,
         {
           /// total time including overhead of network.
           REGISTER_TIMER_DYNAMIC_SET("sendParaTotal",
-                                     timeToMicroSecond(*handleRequestBegin_),
+                                     timeToMicroSecond(getHandleRequestBegin()),
                                      -1, *statSet_);
         }
         /// all time exhausted in pserverServer except recieve network.
         {
           /// total time except overhead of network receive
           REGISTER_TIMER_DYNAMIC_SET("sendParaNoRecv",
-                                     timeToMicroSecond(*addGradBegin_), -1,
+                                     timeToMicroSecond(getAddGradBegin()), -1,
                                      *statSet_);
         }
+      } else {
+        /// answered together with the last request of the batch
+        std::lock_guard<std::mutex> guard(pendingBatchesLock_);
+        PendingBatch& pending = pendingBatches_[getConnectionId()];
+        pending.requestVec.push_back(request);
+        pending.callbackVec.push_back(callback);
       }
       break;
     case PSERVER_UPDATE_MODE_SET_PARAM:
@@ -878,6 +1101,7 @@ void ParameterServer2::sendParameter(const SendParameterRequest& request,
     case PSERVER_UPDATE_MODE_GET_PARAM:
     case PSERVER_UPDATE_MODE_GET_PARAM_SPARSE:
     case PSERVER_UPDATE_MODE_ASYNC_SGD:
+    case PSERVER_UPDATE_MODE_SSP_SGD:
     case PSERVER_UPDATE_MODE_AVERAGE_PARAMETER:
       std::vector<iovec> outputIovs;
       outputIovs.reserve(outputBuffers.size());
@@ -1010,7 +1234,113 @@ void ParameterServer2::clearUnusedSegments(CpuVector* vec) {
   }
 }
 
+void ParameterServer2::addGradientBlocks(const SendParameterRequest& request,
+                                         std::vector<Buffer>& inputBuffers,
+                                         CachedBlocks* cache) {
+  std::vector<int64_t> localBlockIds;
+  std::vector<int64_t> localOffsets;
+  std::vector<int64_t>& blockIds = cache ? cache->blockIds : localBlockIds;
+  std::vector<int64_t>& offsets = cache ? cache->offsets : localOffsets;
+  if (blockIds.empty()) {
+    blockIds.reserve(request.blocks_size());
+    offsets.reserve(request.blocks_size());
+    for (const auto& block : request.blocks()) {
+      int64_t offset = getBlockOffset(block);
+      CHECK_GE(offset, 0) << "Only existing parameter block is allowed: "
+                          << " id=" << block.para_id()
+                          << " block id=" << block.block_id();
+
+      int64_t blockId = getBlockId(block);
+      CHECK_GE(blockId, 0) << "Only existing parameter block is allowed: "
+                          << " id=" << block.para_id()
+                          << " block id=" << block.block_id();
+      blockIds.push_back(blockId);
+      offsets.push_back(offset);
+    }
+  }
+  CHECK_EQ(blockIds.size(), inputBuffers.size());
+  size_t totalSize = 0;
+  for (const auto& buffer : inputBuffers) {
+    totalSize += buffer.size;
+  }
+  numGradientBlocks_ += blockIds.size();
+  gradientBytes_ += totalSize * sizeof(real);
+
+  std::unique_lock<std::mutex> poolGuard(syncThreadPoolMutex_,
+                                         std::defer_lock);
+  if (syncThreadPool_ && blockIds.size() > 1 &&
+      totalSize >= (size_t)FLAGS_pserver_parallel_add_min_size &&
+      poolGuard.try_lock()) {
+    syncThreadPool_->exec([&](int tid, size_t numThreads) {
+      for (size_t i = 0; i < blockIds.size(); ++i) {
+        if ((size_t)blockIds[i] % numThreads == (size_t)tid) {
+          addGradientBlock(request.blocks(i), blockIds[i], offsets[i],
+                           inputBuffers[i]);
+        }
+      }
+    });
+  } else {
+    for (size_t i = 0; i < blockIds.size(); ++i) {
+      addGradientBlock(request.blocks(i), blockIds[i], offsets[i],
+                       inputBuffers[i]);
+    }
+  }
+}
+
+void ParameterServer2::addGradientBlock(const ParameterBlock& block,
+                                        int64_t blockId, int64_t offset,
+                                        const Buffer& buffer) {
+  const real* gradientBuffer = buffer.base;
+  real* gradientSumBuffer = vectors_[PARAMETER_GRADIENT]->getPoint(offset);
+  size_t size = buffer.size;
+
+  BlockInfo& info = blockInfos_[blockId];
+  const ParameterConfig& config = getParameterConfig(blockId);
+  /// the requests of one trainer are handled one by one, its blocks need
+  /// no lock if no other trainer adds to them
+  std::unique_lock<std::mutex> guard(*info.lock, std::defer_lock);
+  if (FLAGS_num_gradient_servers > 1) {
+    guard.lock();
+  }
+  if (config.gradient_compression() != GRADIENT_COMPRESSION_NONE) {
+    CHECK_LE(block.block_size(), config.parameter_block_size());
+    addCompressedGradient(config.gradient_compression(),
+                          reinterpret_cast<const char*>(gradientBuffer),
+                          size * sizeof(real), gradientSumBuffer,
+                          block.block_size());
+    return;
+  }
+  if (config.sparse_remote_update()) {
+    CHECK_EQ(size, config.parameter_block_size());
+  } else {  // dense
+    CHECK_LE(size, config.parameter_block_size());
+  }
+  simd::addTo(gradientSumBuffer, gradientBuffer, size);
+}
+
+void ParameterServer2::zeroVectors(const std::vector<ParameterType>& types) {
+  int64_t numBlocks = blockIdMap_.size();
+  /// the blocks are stored in the order of their ids
+  std::vector<int64_t> offsets(numBlocks + 1);
+  for (const auto& pair : blockIdMap_) {
+    offsets[pair.second] = blockOffsetMap_.at(pair.first);
+  }
+  offsets[numBlocks] = size_;
+
+  std::lock_guard<std::mutex> guard(syncThreadPoolMutex_);
+  SyncThreadPool::execHelper(syncThreadPool_.get(), [&](int tid,
+                                                        size_t numThreads) {
+    for (int64_t blockId = tid; blockId < numBlocks; blockId += numThreads) {
+      for (const auto type : types) {
+        memset(vectors_[type]->getPoint(offsets[blockId]), 0,
+               sizeof(real) * (offsets[blockId + 1] - offsets[blockId]));
+      }
+    }
+  });
+}
+
 void ParameterServer2::parallelExecForEachBlock(ExecFunc func) {
+  std::lock_guard<std::mutex> guard(syncThreadPoolMutex_);
   SyncThreadPool::execHelper(syncThreadPool_.get(), [&](int tid,
                                                         size_t numThreads) {
     int64_t numBlocks = blockIdMap_.size();
@@ -1047,24 +1377,67 @@ void ParameterServer2::op_SGD(const Operation& operation,
     REGISTER_TIMER_DYNAMIC("op_SGD", -1, *statSet_);
 
     parallelExecForEachBlock([&](int64_t blockId, const VectorPtr vecs[]) {
-      BlockInfo& info = blockInfos_[blockId];
-      const ParameterConfig& config = getParameterConfig(blockId);
-      int64_t offset = info.offset;
-      size_t size = config.parameter_block_size();
+      sgdUpdateBlock(blockId, vecs);
+    });
+  }
 
-      info.optimizer->startBatch(numSamplesProcessed_);
+  batchId_++;
+  tuningSgdMidOutput();
+}
 
-      for (const auto type : info.optimizer->getParameterTypes()) {
-          vecs[type]->subVecFrom(*vectors_[type], offset, size);
+void ParameterServer2::sgdUpdateBlock(int64_t blockId,
+                                      const VectorPtr vecs[]) {
+  BlockInfo& info = blockInfos_[blockId];
+  const ParameterConfig& config = getParameterConfig(blockId);
+  int64_t offset = info.offset;
+  size_t size = config.parameter_block_size();
+
+  info.optimizer->startBatch(numSamplesProcessed_);
+
+  for (const auto type : info.optimizer->getParameterTypes()) {
+      vecs[type]->subVecFrom(*vectors_[type], offset, size);
+  }
+  info.optimizer->update(vecs, config,
+          config.sparse_remote_update() ? 0 : -1LU);
+  vecs[PARAMETER_GRADIENT]->zeroMem();
+
+  if (auto callback = info.optimizer->needSpecialTraversal(config)) {
+    blockTraverse(info, config, offset, size, vecs, callback);
+  }
+  info.optimizer->finishBatch();
+}
+
+void ParameterServer2::op_SVRG(const Operation& operation,
+                               OperationResult* result) {
+  (void)operation;
+  (void)result;
+
+  if (allClientPassFinish_) {
+    /// when all clients signal pass finished, the update
+    /// is empty.
+    return;
+  }
+
+  {
+    REGISTER_TIMER_DYNAMIC("op_SVRG", -1, *statSet_);
+
+    parallelExecForEachBlock([&](int64_t blockId, const VectorPtr vecs[]) {
+      BlockInfo& info = blockInfos_[blockId];
+      const ParameterConfig& config = getParameterConfig(blockId);
+      // the optimizer may be wrapped by a regularizer
+      auto optimizer = dynamic_cast<SvrgOptimizer*>(info.optimizer.get());
+      if (!optimizer || config.sparse_remote_update()) {
+        sgdUpdateBlock(blockId, vecs);
+        return;
       }
-      info.optimizer->update(vecs, config,
-              config.sparse_remote_update() ? 0 : -1LU);
-      vecs[PARAMETER_GRADIENT]->zeroMem();
 
-      if (auto callback = info.optimizer->needSpecialTraversal(config)) {
-        blockTraverse(info, config, offset, size, vecs, callback);
+      size_t size = config.parameter_block_size();
+      for (const auto type : optimizer->getParameterTypes()) {
+        vecs[type]->subVecFrom(*vectors_[type], info.offset, size);
       }
-      info.optimizer->finishBatch();
+      optimizer->startBatch(numSamplesProcessed_);
+      optimizer->updateAndClearGradient(vecs, config);
+      optimizer->finishBatch();
     });
   }
 
@@ -1409,6 +1782,7 @@ ParameterServer2::OperatorFunction ParameterServer2::opFuncs[] = {
     &ParameterServer2::op_randomize,        // PSERVER_OP_RANDOMIZE = 16
     &ParameterServer2::op_apply,            // PSERVER_OP_APPLY = 17
     &ParameterServer2::op_COPY_ZERO,      // PSERVER_OP_COPY_ZERO = 18;
+    &ParameterServer2::op_SVRG,           // PSERVER_OP_SVRG = 19;
 };
 
 void ParameterServer2::doOperation(const DoOperationRequest& request,
@@ -1483,7 +1857,20 @@ void ParameterServer2::synchronize(const SynchronizeRequest& request,
 void ParameterServer2::asyncFinishPass(const SynchronizeRequest& request,
                                        ProtoResponseCallback callback) {
   CHECK_LT(request.sync_object_id(), SyncObject_ARRAYSIZE);
+  /// ssp trainers still in the pass must not wait for this one
+  bool ssp = (size_t)request.trainer_id() < sspClocks_.size();
+  if (ssp) {
+    sspCond_.notify_all(
+        [&] { sspPassFinished_[request.trainer_id()] = true; });
+  }
   synchronizeBarriers_[request.sync_object_id()]->wait();
+  /// the clock restarts with the next pass
+  if (ssp) {
+    sspCond_.notify_all([&] {
+      sspClocks_[request.trainer_id()] = 0;
+      sspPassFinished_[request.trainer_id()] = false;
+    });
+  }
   callback(SynchronizeResponse());
 
   if (request.trainer_id() == 0) {
@@ -1553,6 +1940,7 @@ void ParameterServer2::tuningSgdMidOutput() {
     statSet_->printAllStatus();
     /// not reset raw data for reducing the overhead of performance tuning
     statSet_->reset(false);
+    printLoadAndReset();
   }
 }
 
@@ -1567,6 +1955,13 @@ void ParameterServer2::tuningSgdFinished() {
    * tuning
    */
   statSet_->reset();
+  printLoadAndReset();
+}
+
+void ParameterServer2::printLoadAndReset() {
+  LOG(INFO) << "pserver " << serverId_ << " load: size=" << size_
+            << " gradient blocks=" << numGradientBlocks_.exchange(0)
+            << " gradient bytes=" << gradientBytes_.exchange(0);
 }
 
 void ParameterServer2::tuningAsyncsgdMidOutput() {
@@ -16,6 +16,7 @@ limitations under the License. */
 #pragma once
 
 #include <atomic>
+#include <map>
 #include <mutex>
 #include <string>
 #include <vector>
@@ -246,8 +247,27 @@ protected:
   ThreadBarrier gradientReadyBarrier_;
   ThreadBarrier parameterReadyBarrier_;
   ThreadBarrier passBarrier_;
-  ThreadLocal<std::vector<SendParameterRequest>> requestVec_;
-  ThreadLocal<std::vector<ProtoResponseCallbackEx>> callbackVec_;
+
+  /// requests of ADD_GRADIENT are answered at the end of the batch.
+  /// requests of one connection may be handled by different threads,
+  /// so they are kept per connection instead of per thread.
+  struct PendingBatch {
+    std::vector<SendParameterRequest> requestVec;
+    std::vector<ProtoResponseCallbackEx> callbackVec;
+  };
+  std::mutex pendingBatchesLock_;
+  std::unordered_map<int64_t, PendingBatch> pendingBatches_;
+
+  /// blocks of the requests with blocks_cache_id, kept per connection like
+  /// pendingBatches_ and keyed by (connection id, cache id). The block ids
+  /// and offsets are looked up once by addGradientBlocks().
+  struct CachedBlocks {
+    google::protobuf::RepeatedPtrField<ParameterBlock> blocks;
+    std::vector<int64_t> blockIds;
+    std::vector<int64_t> offsets;
+  };
+  std::mutex blocksCacheLock_;
+  std::map<std::pair<int64_t, int64_t>, CachedBlocks> blocksCache_;
 
   std::atomic<int> numPassFinishClients_;
   bool allClientPassFinish_;
@@ -290,17 +310,46 @@ protected:
   /// stat per trainer_id
   std::vector<size_t> asyncTrainerCommitStat_;
 
-  /// only used by controller and other control cmd from trainer number 0
+  /// stale synchronous parallel, see sspSGD(). guard the following members
+  LockedCondition sspCond_;
+  /// batches finished by each trainer in the current pass
+  std::vector<int64_t> sspClocks_;
+  /// trainers in asyncFinishPass(), the others do not wait for them
+  std::vector<bool> sspPassFinished_;
+
+  /// used by controller and other control cmd from trainer number 0, and
+  /// by addGradient() for large requests
   std::unique_ptr<SyncThreadPool> syncThreadPool_;
+  /// SyncThreadPool runs one job at a time
+  std::mutex syncThreadPoolMutex_;
 
   /// pserver for sparse remote update parameters
   bool isSparseServer_;
 
+  /// <para_id, pserver of each block> planned by the trainers and sent by
+  /// setConfig(), see ParameterSharding. no entry for hash placement
+  std::unordered_map<size_t, std::vector<int>> blockServerIds_;
+  /// <para_id, <row id, pserver>> of the hot sparse rows in the plan
+  std::unordered_map<size_t, std::unordered_map<int64_t, int>>
+      hotRowServerIds_;
+
+  /// gradients added since the last log, to check the balance of pservers
+  std::atomic<int64_t> numGradientBlocks_;
+  std::atomic<int64_t> gradientBytes_;
+
   /// barrier performance tuning sync-sgd required
   std::atomic<int64_t> batchId_;
 
-  /// the beginning of addGradient without network overhead
-  ThreadLocal<struct timeval> addGradBegin_;
+  /// the beginning of addGradient without network overhead, per
+  /// connection like handleRequestBegin_
+  std::mutex addGradBeginLock_;
+  std::unordered_map<int64_t, struct timeval> addGradBegin_;
+
+  /// the beginning of addGradient of the current request of the connection
+  struct timeval getAddGradBegin() {
+    std::lock_guard<std::mutex> guard(addGradBeginLock_);
+    return addGradBegin_[getConnectionId()];
+  }
 
   /**
    * tuning barrier performance
@@ -328,6 +377,9 @@ protected:
   bool asyncGrdientCommitCheckAndStat(const SendParameterRequest& request);
   void printAsyncGradientCommitStatAndReset();
 
+  /// log the gradients added since the last call
+  void printLoadAndReset();
+
 public:
   /// disable default parameter for overloading
   /// @rdmaCpu:the id of cpu core hosting RDMA server(0-N)
@@ -489,6 +541,24 @@ public:
                 SendParameterResponse* response,
                 std::vector<Buffer>* outputBuffers);
 
+  /**
+   * @brief async-sgd with bounded staleness (stale synchronous parallel)
+   *
+   * @note  the gradients are applied at once like asyncSGD() and never
+   *        discarded. The last request of a batch advances the clock of
+   *        the trainer, and its response waits while the trainer is more
+   *        than ssp_staleness batches ahead of the slowest trainer still
+   *        in the pass. So the parameters sent back contain all the
+   *        updates of the other trainers up to that many batches ago.
+   */
+  void sspSGD(const SendParameterRequest& request,
+              std::vector<Buffer>& inputBuffers,
+              SendParameterResponse* response,
+              std::vector<Buffer>* outputBuffers);
+
+  /// advance the clock of the trainer and wait for the slowest trainer
+  void sspTickAndWait(int trainerId);
+
   /**
    * @brief merge gradients from all trainer
    *
@@ -501,7 +571,8 @@ public:
   void addGradient(const SendParameterRequest& request,
                    std::vector<Buffer>& inputBuffers,
                    SendParameterResponse* response,
-                   std::vector<Buffer>* outputBuffers);
+                   std::vector<Buffer>* outputBuffers,
+                   CachedBlocks* cache = nullptr);
 
   /**
    * @brief get dense parameters from pserver
@@ -648,6 +719,36 @@ protected:
    */
   typedef std::function<void(int64_t blockId, const VectorPtr vecs[])> ExecFunc;
   void parallelExecForEachBlock(ExecFunc func);
+
+  /**
+   * add the gradient blocks of a request to PARAMETER_GRADIENT.
+   *
+   * large requests are split among syncThreadPool_, block i always goes to
+   * thread i % numThreads like parallelExecForEachBlock(), so a block stays
+   * in the cache and the numa node of the thread updating it. If the pool
+   * is busy with another request, the blocks are added by the caller.
+   *
+   * the block ids and offsets are kept in cache if given.
+   */
+  void addGradientBlocks(const SendParameterRequest& request,
+                         std::vector<Buffer>& inputBuffers,
+                         CachedBlocks* cache = nullptr);
+
+  /**
+   * the blocks cached for request.blocks_cache_id() on this connection.
+   * they are replaced by the blocks of the request if it has any.
+   */
+  CachedBlocks* getCachedBlocks(const SendParameterRequest& request);
+
+  /// drops the requests of the connection waiting for the end of the batch,
+  /// the blocks cached for it and its request times
+  virtual void onConnectionClosed(int64_t connectionId);
+
+  void addGradientBlock(const ParameterBlock& block, int64_t blockId,
+                        int64_t offset, const Buffer& buffer);
+
+  /// zero the new vectors, each block by the thread which will update it
+  void zeroVectors(const std::vector<ParameterType>& types);
   void blockTraverse(BlockInfo& info, const ParameterConfig& config,
                      int64_t offset, size_t size, const VectorPtr vecs[],
                      const ParameterOptimizer::TraverseCallback& callback);
@@ -670,6 +771,11 @@ public:
 
   void op_SGD(const Operation& operation, OperationResult* result);
 
+  void op_SVRG(const Operation& operation, OperationResult* result);
+
+  /// update one block with its optimizer and clear its gradient
+  void sgdUpdateBlock(int64_t blockId, const VectorPtr vecs[]);
+
   void op_RESET(const Operation& operation, OperationResult* result);
 
   void op_utv(const Operation& operation, OperationResult* result);
@@ -0,0 +1,284 @@
+/* Copyright (c) 2016 Baidu, Inc. All Rights Reserve.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include "ParameterSharding.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <queue>
+
+namespace paddle {
+
+ParameterSharding::ParameterSharding(
+    const std::vector<ParameterPtr>& parameters, size_t numServers,
+    const std::string& method, const std::string& rowFreqFile)
+    : numServers_(numServers),
+      serverBytes_(numServers, 0),
+      serverFlops_(numServers, 0) {
+  CHECK_GT(numServers_, 0UL);
+  for (auto& para : parameters) {
+    Shard& shard = shards_[para->getID()];
+    shard.nameHash = std::hash<std::string>()(para->getName());
+    if (para->getConfig().sparse_remote_update()) {
+      shard.blockSize = para->getConfig().dims(1);
+      addSparseLoad(para);
+    }
+  }
+  if (!rowFreqFile.empty()) {
+    planHotRows(parameters, rowFreqFile);
+  }
+
+  if (method == "balanced") {
+    planBalanced(parameters);
+    return;
+  }
+  CHECK_EQ(method, "hash") << "Unknown parameter sharding method";
+  size_t blockSize = calcHashBlockSize(parameters, numServers_);
+  for (auto& para : parameters) {
+    const ParameterConfig& config = para->getConfig();
+    if (config.sparse_remote_update()) continue;
+    Shard& shard = shards_[para->getID()];
+    shard.blockSize = blockSize;
+    double flops = getUpdateFlops(config);
+    for (size_t begin = 0; begin < para->getSize(); begin += blockSize) {
+      size_t len = std::min(blockSize, para->getSize() - begin);
+      int serverId = shard.getServerId(begin / blockSize, numServers_);
+      serverBytes_[serverId] += len * sizeof(real);
+      serverFlops_[serverId] += len * flops;
+    }
+  }
+}
+
+size_t ParameterSharding::calcHashBlockSize(
+    const std::vector<ParameterPtr>& parameters, size_t numServers) {
+  size_t totalSize = 0;
+  for (auto& para : parameters) {
+    totalSize += para->getSize();
+  }
+  size_t perServerSize = totalSize / numServers;
+
+  int sizeBits = 64 - __builtin_clzl(perServerSize);
+
+  /// 2^10 is min block size
+  /// 2^7 will be max number of blocks in one pserver
+  int blockSizeBits = std::max((sizeBits - 7), 10);
+  return 1 << blockSizeBits;
+}
+
+double ParameterSharding::getUpdateFlops(const ParameterConfig& config) {
+  /// the optimizer is the same for all the parameters, only the parts
+  /// differing between parameters matter for the balance
+  double flops = 2;
+  if (config.momentum() != 0) flops += 2;
+  if (config.decay_rate() != 0) flops += 2;
+  if (config.decay_rate_l1() != 0) flops += 3;
+  return flops;
+}
+
+std::vector<int> ParameterSharding::assignLeastLoaded(
+    const std::vector<double>& costs, size_t numServers) {
+  typedef std::pair<double, int> Load;  // (cost, serverId)
+  std::priority_queue<Load, std::vector<Load>, std::greater<Load>> loads;
+  for (size_t i = 0; i < numServers; ++i) {
+    loads.push({0, (int)i});
+  }
+  std::vector<int> serverIds;
+  serverIds.reserve(costs.size());
+  for (double cost : costs) {
+    Load load = loads.top();
+    loads.pop();
+    serverIds.push_back(load.second);
+    load.first += cost;
+    loads.push(load);
+  }
+  return serverIds;
+}
+
+void ParameterSharding::addSparseLoad(const ParameterPtr& para) {
+  /// assume all the rows are updated
+  double flops = getUpdateFlops(para->getConfig());
+  for (size_t i = 0; i < numServers_; ++i) {
+    serverBytes_[i] += (double)para->getSize() * sizeof(real) / numServers_;
+    serverFlops_[i] += (double)para->getSize() * flops / numServers_;
+  }
+}
+
+void ParameterSharding::planHotRows(
+    const std::vector<ParameterPtr>& parameters,
+    const std::string& rowFreqFile) {
+  std::unordered_map<std::string, const ParameterPtr*> sparseParas;
+  for (auto& para : parameters) {
+    if (para->getConfig().sparse_remote_update()) {
+      sparseParas[para->getName()] = &para;
+    }
+  }
+
+  struct Row {
+    double cost;
+    size_t paraId;
+    int64_t rowId;
+  };
+  std::vector<Row> rows;
+  std::ifstream fin(rowFreqFile);
+  CHECK(fin) << "Fail to open " << rowFreqFile;
+  std::string name;
+  int64_t rowId;
+  double freq;
+  while (fin >> name >> rowId >> freq) {
+    auto it = sparseParas.find(name);
+    if (it == sparseParas.end()) continue;
+    const ParameterPtr& para = *it->second;
+    CHECK(rowId >= 0 && (size_t)rowId < para->getConfig().dims(0))
+        << "Row " << rowId << " out of range in " << rowFreqFile;
+    /// a prefetch of the row sends its width
+    rows.push_back({freq * para->getConfig().dims(1), para->getID(), rowId});
+  }
+
+  /// the order only depends on the file, so all trainers agree
+  std::sort(rows.begin(), rows.end(), [](const Row& a, const Row& b) {
+    if (a.cost != b.cost) return a.cost > b.cost;
+    if (a.paraId != b.paraId) return a.paraId < b.paraId;
+    return a.rowId < b.rowId;
+  });
+
+  std::vector<double> costs;
+  costs.reserve(rows.size());
+  for (auto& row : rows) {
+    costs.push_back(row.cost);
+  }
+  std::vector<int> serverIds = assignLeastLoaded(costs, numServers_);
+  for (size_t i = 0; i < rows.size(); ++i) {
+    shards_[rows[i].paraId].rowServerIds[rows[i].rowId] = serverIds[i];
+  }
+  LOG(INFO) << rows.size() << " hot sparse rows placed by " << rowFreqFile;
+}
+
+void ParameterSharding::planBalanced(
+    const std::vector<ParameterPtr>& parameters) {
+  /// the same minimum as hash placement, smaller blocks cost more to send
+  constexpr size_t kMinBlockSize = 1024;
+  /// more blocks balance better, the max load is at most the mean plus
+  /// the cost of one block
+  constexpr size_t kBlocksPerServer = 32;
+
+  double totalBytes = 0;
+  double totalFlops = 0;
+  for (auto& para : parameters) {
+    const ParameterConfig& config = para->getConfig();
+    if (config.sparse_remote_update()) continue;
+    totalBytes += (double)para->getSize() * sizeof(real);
+    totalFlops += para->getSize() * getUpdateFlops(config);
+  }
+  if (totalBytes == 0) return;
+
+  struct Block {
+    double cost;
+    size_t paraId;
+    int64_t blockId;
+    size_t size;
+    double flops;
+  };
+  std::vector<Block> blocks;
+  const double blockCost = 1.0 / (numServers_ * kBlocksPerServer);
+  for (auto& para : parameters) {
+    const ParameterConfig& config = para->getConfig();
+    if (config.sparse_remote_update()) continue;
+    double flops = getUpdateFlops(config);
+    /// share of the total load of one element
+    double elementCost = 0.5 * sizeof(real) / totalBytes +
+                         0.5 * flops / totalFlops;
+    size_t paraSize = std::max(para->getSize(), (size_t)1);
+    size_t blockSize = std::max(
+        kMinBlockSize, (size_t)std::ceil(blockCost / elementCost));
+    blockSize = std::min(blockSize, paraSize);
+
+    Shard& shard = shards_[para->getID()];
+    shard.blockSize = blockSize;
+    shard.serverIds.resize((para->getSize() + blockSize - 1) / blockSize);
+    for (size_t begin = 0; begin < para->getSize(); begin += blockSize) {
+      size_t len = std::min(blockSize, para->getSize() - begin);
+      blocks.push_back({len * elementCost, para->getID(),
+                        (int64_t)(begin / blockSize), len, flops});
+    }
+  }
+
+  /// the order only depends on the configs, so all trainers agree
+  std::sort(blocks.begin(), blocks.end(), [](const Block& a, const Block& b) {
+    if (a.cost != b.cost) return a.cost > b.cost;
+    if (a.paraId != b.paraId) return a.paraId < b.paraId;
+    return a.blockId < b.blockId;
+  });
+
+  std::vector<double> costs;
+  costs.reserve(blocks.size());
+  for (auto& block : blocks) {
+    costs.push_back(block.cost);
+  }
+  std::vector<int> serverIds = assignLeastLoaded(costs, numServers_);
+  for (size_t i = 0; i < blocks.size(); ++i) {
+    const Block& block = blocks[i];
+    int serverId = serverIds[i];
+    shards_[block.paraId].serverIds[block.blockId] = serverId;
+    serverBytes_[serverId] += block.size * sizeof(real);
+    serverFlops_[serverId] += block.size * block.flops;
+  }
+}
+
+void ParameterSharding::toProto(SetConfigRequest* request) const {
+  /// ordered by id
+  std::map<size_t, const Shard*> shards;
+  for (auto& pair : shards_) {
+    shards[pair.first] = &pair.second;
+  }
+  for (auto& pair : shards) {
+    ParameterShard* shard = request->add_shards();
+    shard->set_para_id(pair.first);
+    shard->set_block_size(pair.second->blockSize);
+    for (int serverId : pair.second->serverIds) {
+      shard->add_server_ids(serverId);
+    }
+    std::map<int64_t, int> rows(pair.second->rowServerIds.begin(),
+                                pair.second->rowServerIds.end());
+    for (auto& row : rows) {
+      shard->add_hot_rows(row.first);
+      shard->add_hot_row_server_ids(row.second);
+    }
+  }
+}
+
+void ParameterSharding::printLoad() const {
+  double totalBytes = 0;
+  double totalFlops = 0;
+  double maxBytes = 0;
+  double maxFlops = 0;
+  for (size_t i = 0; i < numServers_; ++i) {
+    LOG(INFO) << "pserver " << i << " load per batch:"
+              << " gradient bytes=" << serverBytes_[i]
+              << " update flops=" << serverFlops_[i];
+    totalBytes += serverBytes_[i];
+    totalFlops += serverFlops_[i];
+    maxBytes = std::max(maxBytes, serverBytes_[i]);
+    maxFlops = std::max(maxFlops, serverFlops_[i]);
+  }
+  if (totalBytes > 0) {
+    LOG(INFO) << "pserver load max/mean:"
+              << " bytes=" << maxBytes * numServers_ / totalBytes
+              << " flops=" << maxFlops * numServers_ / totalFlops;
+  }
+}
+
+}  // namespace paddle
@@ -0,0 +1,135 @@
+/* Copyright (c) 2016 Baidu, Inc. All Rights Reserve.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "paddle/parameter/Parameter.h"
+#include "ParameterService.pb.h"
+
+namespace paddle {
+
+/**
+ * @brief placement of the parameter blocks on the pservers
+ *
+ * @note  with --parameter_sharding=hash, all the dense parameters use one
+ *        block size derived from the total size, and block i of a
+ *        parameter goes to pserver (i + hash(name)) % numServers. Large
+ *        parameters then put more blocks on some pservers than others.
+ *
+ *        With --parameter_sharding=balanced, each dense parameter gets its
+ *        own block size, so that all the blocks cost about the same, and
+ *        the blocks are assigned to the least loaded pserver from the most
+ *        expensive one (LPT scheduling). The cost of a block is the mean
+ *        of its share of the total bytes and of the total update flops.
+ *
+ *        Rows of sparse_remote_update parameters are placed by the hash,
+ *        each row is a block and they spread evenly in number. But the
+ *        accesses of sparse rows are often heavy-tailed, so the rows listed
+ *        in rowFreqFile are placed by their access frequency instead, from
+ *        the most frequent one to the pserver with the least frequent hot
+ *        rows. Each line of the file is "parameter_name row_id frequency",
+ *        e.g. the feature counts of the training data.
+ *
+ *        The plan only depends on the parameter configs, numServers and
+ *        rowFreqFile, so all the trainers compute the same plan. The
+ *        trainer calling setConfig() sends it to the pservers, which check
+ *        the blocks they get against it.
+ */
+class ParameterSharding {
+public:
+  /// blocks of one parameter
+  struct Shard {
+    size_t blockSize;
+    int64_t nameHash;
+    /// pserver of each block, empty for hash placement
+    std::vector<int> serverIds;
+    /// <row id, pserver> of the hot rows of a sparse parameter
+    std::unordered_map<int64_t, int> rowServerIds;
+
+    int getServerId(int64_t blockId, size_t numServers) const {
+      if (!rowServerIds.empty()) {
+        auto it = rowServerIds.find(blockId);
+        if (it != rowServerIds.end()) {
+          return it->second;
+        }
+      }
+      if (serverIds.empty()) {
+        return std::abs((blockId + nameHash) % (int64_t)numServers);
+      }
+      return serverIds[blockId];
+    }
+  };
+
+  ParameterSharding(const std::vector<ParameterPtr>& parameters,
+                    size_t numServers, const std::string& method,
+                    const std::string& rowFreqFile = "");
+
+  const Shard& getShard(size_t paraId) const {
+    auto it = shards_.find(paraId);
+    CHECK(it != shards_.end()) << "Unknown parameter id " << paraId;
+    return it->second;
+  }
+
+  size_t getNumServers() const { return numServers_; }
+
+  /// estimated bytes of the gradients sent to each pserver per batch
+  const std::vector<double>& getServerBytes() const { return serverBytes_; }
+
+  /// estimated update flops of each pserver per batch
+  const std::vector<double>& getServerFlops() const { return serverFlops_; }
+
+  /// the plan in SetConfigRequest
+  void toProto(SetConfigRequest* request) const;
+
+  /// log the estimated load of the pservers
+  void printLoad() const;
+
+  /// the block size of the original hash placement
+  static size_t calcHashBlockSize(const std::vector<ParameterPtr>& parameters,
+                                  size_t numServers);
+
+  /// rough update flops per element of a parameter in pserver
+  static double getUpdateFlops(const ParameterConfig& config);
+
+  /**
+   * LPT scheduling of the jobs, given in decreasing cost: each job goes to
+   * the least loaded pserver, the one of the smallest id on ties.
+   * The max load is at most the mean plus the cost of one job.
+   *
+   * @return the pserver of each job
+   */
+  static std::vector<int> assignLeastLoaded(const std::vector<double>& costs,
+                                            size_t numServers);
+
+protected:
+  void planBalanced(const std::vector<ParameterPtr>& parameters);
+
+  /// add the load of sparse parameters, whose rows spread evenly
+  void addSparseLoad(const ParameterPtr& para);
+
+  /// place the sparse rows in rowFreqFile by their frequency
+  void planHotRows(const std::vector<ParameterPtr>& parameters,
+                   const std::string& rowFreqFile);
+
+  size_t numServers_;
+  std::unordered_map<size_t, Shard> shards_;
+  std::vector<double> serverBytes_;
+  std::vector<double> serverFlops_;
+};
+
+}  // namespace paddle
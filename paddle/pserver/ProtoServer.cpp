@@ -30,7 +30,12 @@ void ProtoServer::handleRequest(std::unique_ptr<MsgReader> msgReader,
   auto it = nameToFuncMap_.find(funcName);
   if (it != nameToFuncMap_.end()) {
 #ifndef PADDLE_DISABLE_TIMER
-    gettimeofday(&(*(handleRequestBegin_)), nullptr);
+    struct timeval begin;
+    gettimeofday(&begin, nullptr);
+    {
+      std::lock_guard<std::mutex> guard(handleRequestBeginLock_);
+      handleRequestBegin_[getConnectionId()] = begin;
+    }
 #endif
     it->second(std::move(msgReader), callback);
   } else {
@@ -40,6 +45,16 @@ void ProtoServer::handleRequest(std::unique_ptr<MsgReader> msgReader,
   }
 }
 
+struct timeval ProtoServer::getHandleRequestBegin() {
+  std::lock_guard<std::mutex> guard(handleRequestBeginLock_);
+  return handleRequestBegin_[getConnectionId()];
+}
+
+void ProtoServer::onConnectionClosed(int64_t connectionId) {
+  std::lock_guard<std::mutex> guard(handleRequestBeginLock_);
+  handleRequestBegin_.erase(connectionId);
+}
+
 void ProtoServer::registerServiceFunctionImp(const std::string& funcName,
                                              ServiceFunction func) {
   CHECK(!nameToFuncMap_.count(funcName))
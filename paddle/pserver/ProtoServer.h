@@ -18,6 +18,8 @@ limitations under the License. */
 #include "LightNetwork.h"
 
 #include <map>
+#include <mutex>
+#include <unordered_map>
 
 #include <google/protobuf/message_lite.h>
 
@@ -29,7 +31,8 @@ namespace paddle {
    * connection. Here define one parameter server as single TCP server
    * binding on single port. All connections share single tcp ProtoServer
    * object, each connection handles all requests from specified trainer
-   * within single worker thread.
+   * within single worker thread, or with a small pool of threads polling
+   * all connections if --sock_server_threads > 0.
    * to accelerate bandwidth efficiency and harness multicore for pserver
    * optimization to reduce pserver latency, you could launch more port
    * for single NIC hardward with --port=N(N>1) for small cluster job.
@@ -111,8 +114,17 @@ protected:
                                   ServiceFunction func);
 
 protected:
-  /// Tuning bare network overhead: the beginning of receiving request
-  ThreadLocal<struct timeval> handleRequestBegin_;
+  /// the beginning of receiving the current request of the connection
+  struct timeval getHandleRequestBegin();
+
+  /// drops the request time of the connection
+  virtual void onConnectionClosed(int64_t connectionId);
+
+  /// Tuning bare network overhead: the beginning of receiving request.
+  /// Kept per connection, the requests of one connection may be served by
+  /// different threads with --sock_server_threads > 0
+  std::mutex handleRequestBeginLock_;
+  std::unordered_map<int64_t, struct timeval> handleRequestBegin_;
 
   /// mapping to find rpc function while handling request
   std::map<std::string, ServiceFunction> nameToFuncMap_;
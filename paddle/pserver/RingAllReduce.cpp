@@ -0,0 +1,178 @@
+/* Copyright (c) 2016 Baidu, Inc. All Rights Reserve.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include "RingAllReduce.h"
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "paddle/utils/Stat.h"
+
+P_DEFINE_int32(ring_connect_timeout, 300,
+               "seconds to wait for the next trainer in the ring to listen");
+
+namespace paddle {
+
+/// whether a tcp server listens on addr:port
+static bool isListening(const std::string& addr, int port) {
+  struct addrinfo hints;
+  struct addrinfo* result = nullptr;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  std::string service = std::to_string(port);
+  int ret = getaddrinfo(addr.c_str(), service.c_str(), &hints, &result);
+  CHECK_EQ(ret, 0) << "ERROR, no such host: " << addr << " "
+                   << gai_strerror(ret);
+  int sock = socket(AF_INET, SOCK_STREAM, 0);
+  PCHECK(sock >= 0) << "ERROR opening socket";
+  bool connected = connect(sock, result->ai_addr, result->ai_addrlen) == 0;
+  close(sock);
+  freeaddrinfo(result);
+  return connected;
+}
+
+RingAllReduce::RingAllReduce(const std::vector<std::string>& trainers,
+                             int port, int trainerId)
+    : ProtoServer(trainers.at(trainerId), port + trainerId),
+      trainerId_(trainerId),
+      numTrainers_(trainers.size()),
+      numCalls_(0),
+      activeCall_(-1),
+      data_(nullptr),
+      size_(0),
+      numSentSteps_(0),
+      numRecvSteps_(0) {
+  REGISTER_SERVICE_FUNCTION_EX(RingAllReduce, ringChunk);
+  start();
+  if (numTrainers_ == 1) {
+    return;
+  }
+
+  int nextId = (trainerId_ + 1) % numTrainers_;
+  const std::string& nextAddr = trainers[nextId];
+  int nextPort = port + nextId;
+  for (int i = 0; !isListening(nextAddr, nextPort); ++i) {
+    CHECK_LT(i, FLAGS_ring_connect_timeout)
+        << "trainer " << nextId << " is not listening on " << nextAddr << ":"
+        << nextPort;
+    sleep(1);
+  }
+  next_.reset(new ProtoClient(nextAddr, nextPort));
+  LOG(INFO) << "ring allreduce: trainer " << trainerId_ << " of "
+            << numTrainers_ << " sends to " << nextAddr << ":" << nextPort;
+}
+
+RingAllReduce::~RingAllReduce() { next_.reset(); }
+
+void RingAllReduce::getChunk(int chunk, size_t* begin, size_t* end) const {
+  *begin = size_ * chunk / numTrainers_;
+  *end = size_ * (chunk + 1) / numTrainers_;
+}
+
+int RingAllReduce::getSendChunk(int step) const {
+  int chunk = step < numTrainers_ - 1
+                  ? trainerId_ - step                             // reduce
+                  : trainerId_ + 1 - (step - (numTrainers_ - 1));  // gather
+  return (chunk % numTrainers_ + numTrainers_) % numTrainers_;
+}
+
+void RingAllReduce::allReduce(real* data, size_t size) {
+  if (numTrainers_ == 1) {
+    return;
+  }
+  REGISTER_TIMER("ringAllReduce");
+  int64_t callId = numCalls_++;
+  cond_.notify_all([&] {
+    activeCall_ = callId;
+    data_ = data;
+    size_ = size;
+    numSentSteps_ = 0;
+    numRecvSteps_ = 0;
+  });
+
+  const int numSteps = 2 * (numTrainers_ - 1);
+  RingChunkRequest request;
+  RingChunkResponse response;
+  request.set_call_id(callId);
+  for (int step = 0; step < numSteps; ++step) {
+    size_t begin = 0;
+    size_t end = 0;
+    getChunk(getSendChunk(step), &begin, &end);
+    std::vector<iovec> iovs;
+    if (end > begin) {
+      iovs.push_back({data + begin, (end - begin) * sizeof(real)});
+    }
+    request.set_step(step);
+    next_->send("ringChunk", request, iovs);
+    cond_.notify_all([&] { numSentSteps_ = step + 1; });
+
+    /// the chunk of the next step is the one received in this step
+    cond_.wait([&] { return numRecvSteps_ > step; });
+    next_->recv(&response);
+  }
+
+  cond_.notify_all([&] {
+    activeCall_ = -1;
+    data_ = nullptr;
+  });
+}
+
+void RingAllReduce::broadcast(real* data, size_t size, int rootId) {
+  if (trainerId_ != rootId) {
+    memset(data, 0, sizeof(real) * size);
+  }
+  allReduce(data, size);
+}
+
+void RingAllReduce::ringChunk(const RingChunkRequest& request,
+                              std::unique_ptr<MsgReader> msgReader,
+                              ProtoResponseCallbackEx callback) {
+  const int step = request.step();
+  /// the chunk received in step was sent in step + 1 - numTrainers_ and
+  /// earlier, wait for these sends, and for the call to start
+  cond_.wait([&] {
+    return activeCall_ == request.call_id() && numSentSteps_ >= step;
+  });
+
+  size_t begin = 0;
+  size_t end = 0;
+  getChunk(getRecvChunk(step), &begin, &end);
+  size_t len = end - begin;
+  if (len > 0) {
+    CHECK_EQ(msgReader->getNextBlockLength(), len * sizeof(real))
+        << "all the trainers must reduce the same size";
+    if (step < numTrainers_ - 1) {
+      recvBuffer_.resize(len);
+      msgReader->readNextBlock(recvBuffer_.data());
+      /// the chunks are not aligned as simd::addTo() requires
+      real* dst = data_ + begin;
+      for (size_t i = 0; i < len; ++i) {
+        dst[i] += recvBuffer_[i];
+      }
+    } else {
+      msgReader->readNextBlock(data_ + begin);
+    }
+  }
+  msgReader.reset();
+
+  cond_.notify_all([&] { numRecvSteps_ = step + 1; });
+  RingChunkResponse response;
+  callback(response, std::vector<iovec>());
+}
+
+}  // namespace paddle
@@ -0,0 +1,94 @@
+/* Copyright (c) 2016 Baidu, Inc. All Rights Reserve.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "paddle/utils/Locks.h"
+#include "paddle/utils/TypeDefs.h"
+#include "ProtoServer.h"
+#include "ParameterService.pb.h"
+
+namespace paddle {
+
+/**
+ * @brief sum of a vector over all the trainers without pservers
+ *
+ * @note  the trainers form a ring, trainer i listens on
+ *        trainers[i]:(port + i) and sends to trainer i + 1. The vector is
+ *        split into numTrainers chunks. In the numTrainers - 1
+ *        reduce-scatter steps, each trainer adds the chunk it receives to
+ *        its own and passes it on, so every chunk ends up summed on one
+ *        trainer. In the numTrainers - 1 allgather steps, the summed chunks
+ *        go around the ring once more.
+ *
+ *        Each trainer sends and receives 2 * (numTrainers - 1) / numTrainers
+ *        of the vector, whatever the number of trainers. Every chunk is
+ *        summed once in ring order and then copied, so all the trainers get
+ *        the same bits.
+ */
+class RingAllReduce : public ProtoServer {
+public:
+  RingAllReduce(const std::vector<std::string>& trainers, int port,
+                int trainerId);
+  ~RingAllReduce();
+
+  int getNumTrainers() const { return numTrainers_; }
+  int getTrainerId() const { return trainerId_; }
+
+  /// sum data over all the trainers in place, all the trainers must call it
+  /// with the same size
+  void allReduce(real* data, size_t size);
+
+  /// copy data of trainer rootId to the other trainers
+  void broadcast(real* data, size_t size, int rootId);
+
+  /// handle the chunk from the previous trainer
+  void ringChunk(const RingChunkRequest& request,
+                 std::unique_ptr<MsgReader> msgReader,
+                 ProtoResponseCallbackEx callback);
+
+protected:
+  /// [begin, end) of chunk i
+  void getChunk(int chunk, size_t* begin, size_t* end) const;
+
+  /// chunk sent in step, the one received in step - 1
+  int getSendChunk(int step) const;
+
+  /// chunk received in step
+  int getRecvChunk(int step) const { return getSendChunk(step + 1); }
+
+  int trainerId_;
+  int numTrainers_;
+  std::unique_ptr<ProtoClient> next_;
+
+  /// number of allReduce() calls, used by the calling thread only
+  int64_t numCalls_;
+  /// guard the following members shared with ringChunk()
+  LockedCondition cond_;
+  int64_t activeCall_;
+  real* data_;
+  size_t size_;
+  /// steps sent to the next trainer and received from the previous one
+  int numSentSteps_;
+  int numRecvSteps_;
+
+  /// reduce-scatter chunks before they are added, used by ringChunk() only
+  std::vector<real> recvBuffer_;
+};
+
+}  // namespace paddle
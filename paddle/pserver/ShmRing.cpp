@@ -0,0 +1,237 @@
+/* Copyright (c) 2016 Baidu, Inc. All Rights Reserve.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+
+#include "ShmRing.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <sstream>
+
+#include "paddle/utils/Logging.h"
+
+namespace paddle {
+
+ShmRing::ShmRing(Header* header, AliveFunc isPeerAlive)
+    : header_(header),
+      data_((char*)(header + 1)),
+      capacity_(header->capacity),
+      isPeerAlive_(isPeerAlive) {}
+
+void ShmRing::init(Header* header, size_t capacity) {
+  header->head = 0;
+  header->tail = 0;
+  header->readerWaiting = 0;
+  header->writerWaiting = 0;
+  header->capacity = capacity;
+  PCHECK(sem_init(&header->dataSem, /* pshared= */1, 0) == 0);
+  PCHECK(sem_init(&header->spaceSem, /* pshared= */1, 0) == 0);
+}
+
+template <class Cond>
+bool ShmRing::wait(std::atomic<int32_t>* waiting, sem_t* sem, Cond cond) {
+  /// check whether the peer is gone at this interval while waiting
+  constexpr long kCheckIntervalNs = 100 * 1000 * 1000;
+  while (!cond()) {
+    /// the other side posts sem if it sees waiting after changing the ring,
+    /// so cond() must be checked again after setting waiting
+    waiting->store(1);
+    if (cond()) {
+      waiting->store(0);
+      break;
+    }
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_nsec += kCheckIntervalNs;
+    if (ts.tv_nsec >= 1000 * 1000 * 1000) {
+      ts.tv_sec += 1;
+      ts.tv_nsec -= 1000 * 1000 * 1000;
+    }
+    int ret = sem_timedwait(sem, &ts);
+    waiting->store(0);
+    if (ret != 0) {
+      PCHECK(errno == ETIMEDOUT || errno == EINTR);
+      if (errno == ETIMEDOUT && !cond() && !isPeerAlive_()) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+size_t ShmRing::write(const void* buf, size_t size) {
+  /// publish the data in chunks, so the reader copies while this copies
+  const uint64_t chunk = std::max(capacity_ / 4, (uint64_t)1);
+  const uint64_t tail = header_->tail.load(std::memory_order_relaxed);
+  size_t total = 0;
+  while (total < size) {
+    uint64_t head = 0;
+    uint64_t curTail = tail + total;
+    if (!wait(&header_->writerWaiting, &header_->spaceSem, [&] {
+          head = header_->head.load(std::memory_order_acquire);
+          return curTail - head < capacity_;
+        })) {
+      break;
+    }
+    uint64_t len = std::min<uint64_t>(size - total, chunk);
+    len = std::min(len, capacity_ - (curTail - head));
+    uint64_t pos = curTail % capacity_;
+    uint64_t first = std::min(len, capacity_ - pos);
+    memcpy(data_ + pos, (const char*)buf + total, first);
+    memcpy(data_, (const char*)buf + total + first, len - first);
+    total += len;
+    header_->tail.store(tail + total);
+    if (header_->readerWaiting.load()) {
+      PCHECK(sem_post(&header_->dataSem) == 0);
+    }
+  }
+  return total;
+}
+
+size_t ShmRing::read(void* buf, size_t size) {
+  const uint64_t head = header_->head.load(std::memory_order_relaxed);
+  size_t total = 0;
+  while (total < size) {
+    uint64_t tail = 0;
+    uint64_t curHead = head + total;
+    if (!wait(&header_->readerWaiting, &header_->dataSem, [&] {
+          tail = header_->tail.load(std::memory_order_acquire);
+          return tail != curHead;
+        })) {
+      break;
+    }
+    uint64_t len = std::min<uint64_t>(size - total, tail - curHead);
+    uint64_t pos = curHead % capacity_;
+    uint64_t first = std::min(len, capacity_ - pos);
+    memcpy((char*)buf + total, data_ + pos, first);
+    memcpy((char*)buf + total + first, data_, len - first);
+    total += len;
+    header_->head.store(head + total);
+    if (header_->writerWaiting.load()) {
+      PCHECK(sem_post(&header_->spaceSem) == 0);
+    }
+  }
+  return total;
+}
+
+size_t ShmRing::writev(const struct iovec* iovs, int iovcnt) {
+  size_t total = 0;
+  for (int i = 0; i < iovcnt; ++i) {
+    size_t len = write(iovs[i].iov_base, iovs[i].iov_len);
+    total += len;
+    if (len < iovs[i].iov_len) break;
+  }
+  return total;
+}
+
+size_t ShmRing::readv(const struct iovec* iovs, int iovcnt) {
+  size_t total = 0;
+  for (int i = 0; i < iovcnt; ++i) {
+    size_t len = read(iovs[i].iov_base, iovs[i].iov_len);
+    total += len;
+    if (len < iovs[i].iov_len) break;
+  }
+  return total;
+}
+
+std::unique_ptr<ShmSegment> ShmSegment::create(size_t ringSize) {
+  static std::atomic<int> counter(0);
+  std::ostringstream os;
+  os << "/paddle_sock_" << getpid() << "_" << counter++;
+  std::string name = os.str();
+
+  ringSize = (ringSize + kRingOffset - 1) / kRingOffset * kRingOffset;
+  size_t size = kRingOffset + 2 * ShmRing::getMappedSize(ringSize);
+  int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+  if (fd < 0) {
+    LOG(WARNING) << "shm_open " << name << ": " << strerror(errno);
+    return nullptr;
+  }
+  /// tmpfs does not reserve the pages of a truncated file, a write to a
+  /// page that does not fit in /dev/shm would raise SIGBUS later
+  int err = posix_fallocate(fd, 0, size);
+  if (err != 0) {
+    LOG(WARNING) << "allocating shared memory " << name << " size=" << size
+                 << ": " << strerror(err);
+    close(fd);
+    shm_unlink(name.c_str());
+    return nullptr;
+  }
+  void* addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (addr == MAP_FAILED) {
+    LOG(WARNING) << "mapping shared memory " << name << " size=" << size
+                 << ": " << strerror(errno);
+    close(fd);
+    shm_unlink(name.c_str());
+    return nullptr;
+  }
+  close(fd);
+
+  std::unique_ptr<ShmSegment> segment(
+      new ShmSegment(name, addr, size, ringSize));
+  *(uint64_t*)addr = ringSize;
+  ShmRing::init(segment->getClientRing(), ringSize);
+  ShmRing::init(segment->getServerRing(), ringSize);
+  return segment;
+}
+
+std::unique_ptr<ShmSegment> ShmSegment::open(const std::string& name) {
+  int fd = shm_open(name.c_str(), O_RDWR, 0600);
+  if (fd < 0) {
+    LOG(WARNING) << "shm_open " << name << ": " << strerror(errno);
+    return nullptr;
+  }
+  struct stat st;
+  void* addr = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && (size_t)st.st_size > kRingOffset) {
+    addr = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+                0);
+  }
+  if (addr == MAP_FAILED) {
+    LOG(WARNING) << "mapping shared memory " << name << ": "
+                 << strerror(errno);
+    close(fd);
+    return nullptr;
+  }
+  close(fd);
+
+  size_t ringSize = *(uint64_t*)addr;
+  CHECK_EQ((size_t)st.st_size,
+           kRingOffset + 2 * ShmRing::getMappedSize(ringSize))
+      << " shared memory " << name;
+  return std::unique_ptr<ShmSegment>(
+      new ShmSegment(name, addr, st.st_size, ringSize));
+}
+
+void ShmSegment::unlink() {
+  if (linked_) {
+    /// it may have been unlinked by the peer
+    shm_unlink(name_.c_str());
+    linked_ = false;
+  }
+}
+
+ShmSegment::~ShmSegment() {
+  unlink();
+  PCHECK(munmap(addr_, size_) == 0);
+}
+
+}  // namespace paddle
@@ -0,0 +1,131 @@
+/* Copyright (c) 2016 Baidu, Inc. All Rights Reserve.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+
+#pragma once
+
+#include <semaphore.h>
+#include <sys/uio.h>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+
+namespace paddle {
+
+/**
+ * @brief byte stream from one process to another through a ring buffer in
+ *        shared memory
+ *
+ * @note  one reader and one writer. read() and write() block until all the
+ *        bytes are transferred, and return early only if isPeerAlive
+ *        returns false while waiting. The waiting side sleeps on a process
+ *        shared semaphore, which is posted only if the other side finds it
+ *        sleeping, so a busy stream costs no syscall.
+ */
+class ShmRing {
+public:
+  /// header of the ring in shared memory, followed by the data
+  struct alignas(64) Header {
+    std::atomic<uint64_t> head;  /// total bytes read
+    char pad0[64 - sizeof(std::atomic<uint64_t>)];
+    std::atomic<uint64_t> tail;  /// total bytes written
+    char pad1[64 - sizeof(std::atomic<uint64_t>)];
+    std::atomic<int32_t> readerWaiting;
+    std::atomic<int32_t> writerWaiting;
+    uint64_t capacity;
+    sem_t dataSem;   /// posted when data is written
+    sem_t spaceSem;  /// posted when data is read
+  };
+
+  typedef std::function<bool()> AliveFunc;
+
+  /// header is at the beginning of capacity + sizeof(Header) mapped bytes
+  ShmRing(Header* header, AliveFunc isPeerAlive);
+
+  /// initialize a new ring in shared memory
+  static void init(Header* header, size_t capacity);
+
+  static size_t getMappedSize(size_t capacity) {
+    return sizeof(Header) + capacity;
+  }
+
+  size_t read(void* buf, size_t size);
+  size_t write(const void* buf, size_t size);
+  size_t readv(const struct iovec* iovs, int iovcnt);
+  size_t writev(const struct iovec* iovs, int iovcnt);
+
+protected:
+  /// wait on sem until cond() or the peer is dead, return cond()
+  template <class Cond>
+  bool wait(std::atomic<int32_t>* waiting, sem_t* sem, Cond cond);
+
+  Header* header_;
+  char* data_;
+  uint64_t capacity_;
+  AliveFunc isPeerAlive_;
+};
+
+/**
+ * @brief shared memory segment holding the two rings of a channel
+ *
+ * @note  created by the client side of a connection under a unique name,
+ *        which is sent to the server through the tcp connection. The
+ *        server opens it and unlinks the name, so it is freed by the
+ *        kernel when both sides unmap it.
+ */
+class ShmSegment {
+public:
+  /// create a segment with two rings of ringSize bytes
+  static std::unique_ptr<ShmSegment> create(size_t ringSize);
+
+  /// open the segment created by the peer, return nullptr on failure
+  static std::unique_ptr<ShmSegment> open(const std::string& name);
+
+  ~ShmSegment();
+
+  const std::string& getName() const { return name_; }
+
+  /// remove the name of the segment, the mapping is kept
+  void unlink();
+
+  /// ring from the client to the server
+  ShmRing::Header* getClientRing() { return ring(0); }
+
+  /// ring from the server to the client
+  ShmRing::Header* getServerRing() { return ring(1); }
+
+protected:
+  ShmSegment(const std::string& name, void* addr, size_t size,
+             size_t ringSize)
+      : name_(name), addr_(addr), size_(size), ringSize_(ringSize),
+        linked_(true) {}
+
+  /// the ring size is stored in the first cache line of the segment
+  static constexpr size_t kRingOffset = 64;
+
+  ShmRing::Header* ring(int i) {
+    return (ShmRing::Header*)((char*)addr_ + kRingOffset +
+                              i * ShmRing::getMappedSize(ringSize_));
+  }
+
+  std::string name_;
+  void* addr_;
+  size_t size_;
+  size_t ringSize_;
+  bool linked_;
+};
+
+}  // namespace paddle
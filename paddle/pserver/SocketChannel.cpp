@@ -20,6 +20,7 @@ limitations under the License. */
 #include <sys/socket.h>
 #include <netdb.h>
 #include <netinet/in.h>
+#include <poll.h>
 #include <unistd.h>
 #include "RDMANetwork.h"
 
@@ -28,10 +29,10 @@ limitations under the License. */
 namespace paddle {
 
 SocketChannel::~SocketChannel() {
-  if (tcpRdma_ == F_TCP)
-    close(tcpSocket_);
-  else
+  if (tcpRdma_ == F_RDMA)
     rdma::close(rdmaSocket_);
+  else
+    close(tcpSocket_);
   LOG(INFO) << "destory connection in socket channel, peer = " << peerName_;
 }
 
@@ -41,6 +42,8 @@ size_t SocketChannel::read(void* buf, size_t size) {
     ssize_t len;
     if (tcpRdma_ == F_TCP)
       len = ::read(tcpSocket_, (char*)buf + total, size - total);
+    else if (tcpRdma_ == F_SHM)
+      len = shmIn_->read((char*)buf + total, size - total);
     else
       len = rdma::read(rdmaSocket_, (char*)buf + total, size - total);
 
@@ -59,6 +62,8 @@ size_t SocketChannel::write(const void* buf, size_t size) {
     ssize_t len;
     if (tcpRdma_ == F_TCP)
       len = ::write(tcpSocket_, (const char*)buf + total, size - total);
+    else if (tcpRdma_ == F_SHM)
+      len = shmOut_->write((const char*)buf + total, size - total);
     else
       len = rdma::write(rdmaSocket_, (char*)buf + total, size - total);
 
@@ -118,7 +123,9 @@ static size_t readwritev(IOFunc iofunc, SocketType socket, iovec* iovs,
 /// rdma::readv and rdma::writev can take advantage of RDMA blocking offload
 /// transfering
 size_t SocketChannel::writev(const std::vector<struct iovec>& iovs) {
-  if (tcpRdma_ == F_TCP)
+  if (tcpRdma_ == F_SHM)
+    return shmOut_->writev(&iovs[0], iovs.size());
+  else if (tcpRdma_ == F_TCP)
     return readwritev(::writev, tcpSocket_, const_cast<iovec*>(&iovs[0]),
                       iovs.size(), UIO_MAXIOV, peerName_);
   else
@@ -127,7 +134,9 @@ size_t SocketChannel::writev(const std::vector<struct iovec>& iovs) {
 }
 
 size_t SocketChannel::readv(std::vector<struct iovec>* iovs) {
-  if (tcpRdma_ == F_TCP)
+  if (tcpRdma_ == F_SHM)
+    return shmIn_->readv(&(*iovs)[0], iovs->size());
+  else if (tcpRdma_ == F_TCP)
     return readwritev(::readv, tcpSocket_, const_cast<iovec*>(&(*iovs)[0]),
                       iovs->size(), UIO_MAXIOV, peerName_);
   else
@@ -136,6 +145,17 @@ size_t SocketChannel::readv(std::vector<struct iovec>* iovs) {
 }
 
 void SocketChannel::writeMessage(const std::vector<struct iovec>& userIovs) {
+  if (shmRingSize_) {
+    std::call_once(shmOnce_, [this] { connectShm(); });
+  }
+  if (tcpRdma_ == F_SHM) {
+    /// announce the message on the socket before writing it to the ring,
+    /// the ring may be too small to hold it before the peer starts reading
+    char bell = 0;
+    PCHECK(::write(tcpSocket_, &bell, sizeof(bell)) == sizeof(bell))
+        << " peer=" << peerName_;
+  }
+
   MessageHeader header;
   header.numIovs = userIovs.size();
 
@@ -161,6 +181,18 @@ void SocketChannel::writeMessage(const std::vector<struct iovec>& userIovs) {
 }
 
 std::unique_ptr<MsgReader> SocketChannel::readMessage() {
+  if (shmRingSize_) {
+    std::call_once(shmOnce_, [this] { connectShm(); });
+  }
+  if (tcpRdma_ == F_SHM) {
+    char bell;
+    ssize_t len = ::read(tcpSocket_, &bell, sizeof(bell));
+    PCHECK(len >= 0) << " peer=" << peerName_;
+    if (len == 0) {
+      return nullptr;
+    }
+  }
+
   MessageHeader header;
 
   size_t len = read(&header, sizeof(header));
@@ -170,6 +202,11 @@ std::unique_ptr<MsgReader> SocketChannel::readMessage() {
 
   PCHECK(len == sizeof(header));
 
+  if (header.numIovs == kShmHandshake) {
+    acceptShm(header);
+    return readMessage();
+  }
+
   std::unique_ptr<MsgReader> msgReader(new MsgReader(this, header.numIovs));
 
   CHECK_EQ(msgReader->getTotalLength() + sizeof(header) +
@@ -180,6 +217,70 @@ std::unique_ptr<MsgReader> SocketChannel::readMessage() {
   return msgReader;
 }
 
+void SocketChannel::connectShm() {
+  std::unique_ptr<ShmSegment> segment = ShmSegment::create(shmRingSize_);
+  if (!segment) {
+    return;
+  }
+  const std::string& name = segment->getName();
+  MessageHeader header;
+  header.totalLength = sizeof(header) + name.size();
+  header.numIovs = kShmHandshake;
+  std::vector<iovec> iovs = {{&header, sizeof(header)},
+                             {const_cast<char*>(name.data()), name.size()}};
+  PCHECK(writev(iovs) == (size_t)header.totalLength);
+
+  char accepted = 0;
+  PCHECK(read(&accepted, sizeof(accepted)) == sizeof(accepted))
+      << " peer=" << peerName_;
+  if (!accepted) {
+    LOG(WARNING) << "peer " << peerName_ << " cannot open shared memory "
+                 << name << ", use tcp";
+    return;
+  }
+  ShmRing::Header* in = segment->getServerRing();
+  ShmRing::Header* out = segment->getClientRing();
+  startShm(std::move(segment), in, out);
+}
+
+void SocketChannel::acceptShm(const MessageHeader& header) {
+  CHECK_EQ(tcpRdma_, F_TCP);
+  std::string name(header.totalLength - sizeof(header), 0);
+  PCHECK(read(&name[0], name.size()) == name.size());
+  std::unique_ptr<ShmSegment> segment = ShmSegment::open(name);
+  char accepted = segment != nullptr;
+  PCHECK(write(&accepted, sizeof(accepted)) == sizeof(accepted))
+      << " peer=" << peerName_;
+  if (!segment) {
+    return;
+  }
+  /// freed by the kernel once both sides unmap it
+  segment->unlink();
+  ShmRing::Header* in = segment->getClientRing();
+  ShmRing::Header* out = segment->getServerRing();
+  startShm(std::move(segment), in, out);
+}
+
+void SocketChannel::startShm(std::unique_ptr<ShmSegment> segment,
+                             ShmRing::Header* in, ShmRing::Header* out) {
+  auto isPeerAlive = [this] { return this->isPeerAlive(); };
+  shmSegment_ = std::move(segment);
+  shmIn_.reset(new ShmRing(in, isPeerAlive));
+  shmOut_.reset(new ShmRing(out, isPeerAlive));
+  tcpRdma_ = F_SHM;
+  LOG(INFO) << "use shared memory " << shmSegment_->getName()
+            << " for connection, peer = " << peerName_;
+}
+
+bool SocketChannel::isPeerAlive() const {
+  struct pollfd fd;
+  fd.fd = tcpSocket_;
+  fd.events = POLLRDHUP;
+  fd.revents = 0;
+  PCHECK(poll(&fd, 1, 0) >= 0);
+  return !(fd.revents & (POLLRDHUP | POLLHUP | POLLERR));
+}
+
 MsgReader::MsgReader(SocketChannel* channel, size_t numBlocks)
     : channel_(channel), blockLengths_(numBlocks), currentBlockIndex_(0) {
   size_t size = numBlocks * sizeof(blockLengths_[0]);
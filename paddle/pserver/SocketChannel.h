@@ -20,8 +20,11 @@ limitations under the License. */
 #include <sys/uio.h>
 
 #include <memory>
+#include <mutex>
 #include <vector>
 
+#include "ShmRing.h"
+
 struct sxi_sock;
 
 namespace paddle {
@@ -30,6 +33,8 @@ class SocketChannel;
 enum ChannelType {
   F_TCP = 1,
   F_RDMA = 2,
+  /// tcp connection whose data goes through shared memory, see requestShm()
+  F_SHM = 3,
 };
 
 /// reading a set of blocks of data from SocketChannel.
@@ -87,11 +92,11 @@ protected:
 class SocketChannel {
 public:
   SocketChannel(int socket, const std::string& peerName)
-      : tcpSocket_(socket), peerName_(peerName) {
+      : tcpSocket_(socket), peerName_(peerName), shmRingSize_(0) {
     tcpRdma_ = F_TCP;
   }
   SocketChannel(struct sxi_sock* socket, const std::string& peerName)
-      : rdmaSocket_(socket), peerName_(peerName) {
+      : rdmaSocket_(socket), peerName_(peerName), shmRingSize_(0) {
     tcpRdma_ = F_RDMA;
   }
 
@@ -99,6 +104,29 @@ public:
 
   const std::string& getPeerName() const { return peerName_; }
 
+  enum ChannelType getChannelType() const { return tcpRdma_; }
+
+  /// socket fd of a tcp or shared memory channel
+  int getTcpSocket() const { return tcpSocket_; }
+
+  /**
+   * @brief move the data of this client tcp channel to shared memory
+   *
+   * @note  the peer must be on the same host. Before the first message, a
+   *        segment with two rings of ringSize bytes is created and offered
+   *        to the server, which switches to it in readMessage(). The
+   *        channel stays on tcp if the server cannot open the segment,
+   *        e.g. in another ipc namespace.
+   *
+   *        The tcp connection is kept. Each message is announced by one
+   *        byte on it, so the server can still poll the socket (see
+   *        SocketReactor), and the sides find the peer gone by it.
+   */
+  void requestShm(size_t ringSize) {
+    CHECK_EQ(tcpRdma_, F_TCP);
+    shmRingSize_ = ringSize;
+  }
+
   /**
    * @brief read size bytes.
    *
@@ -145,10 +173,33 @@ protected:
     int64_t iovLengths[0];
   };
 
+  /// numIovs of the message offering shared memory, followed by its name
+  static constexpr int64_t kShmHandshake = -1;
+
+  /// client: offer a shared memory segment and switch to it if accepted
+  void connectShm();
+
+  /// server: open the segment offered by header and switch to it
+  void acceptShm(const MessageHeader& header);
+
+  /// use segment, reading from in and writing to out
+  void startShm(std::unique_ptr<ShmSegment> segment, ShmRing::Header* in,
+                ShmRing::Header* out);
+
+  /// whether the tcp connection is not closed by the peer
+  bool isPeerAlive() const;
+
   int tcpSocket_;
   struct sxi_sock* rdmaSocket_;
   const std::string peerName_;
   enum ChannelType tcpRdma_;
+
+  /// for F_SHM
+  size_t shmRingSize_;
+  std::once_flag shmOnce_;
+  std::unique_ptr<ShmSegment> shmSegment_;
+  std::unique_ptr<ShmRing> shmIn_;
+  std::unique_ptr<ShmRing> shmOut_;
 };
 
 }  // namespace paddle
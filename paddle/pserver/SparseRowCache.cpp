@@ -0,0 +1,66 @@
+/* Copyright (c) 2016 Baidu, Inc. All Rights Reserve.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include "SparseRowCache.h"
+
+#include <iterator>
+
+#include "paddle/utils/Logging.h"
+
+namespace paddle {
+
+SparseRowCache::SparseRowCache(size_t capacity, int64_t maxStaleness)
+    : capacity_(capacity),
+      maxStaleness_(maxStaleness),
+      clock_(0),
+      numHits_(0),
+      numMisses_(0) {
+  CHECK_GT(capacity_, 0UL);
+  CHECK_GE(maxStaleness_, 0);
+  index_.reserve(capacity_);
+}
+
+const real* SparseRowCache::get(size_t paraId, int64_t rowId) {
+  auto it = index_.find(Key(paraId, rowId));
+  if (it == index_.end() || clock_ - it->second->version > maxStaleness_) {
+    ++numMisses_;
+    return nullptr;
+  }
+  ++numHits_;
+  entries_.splice(entries_.begin(), entries_, it->second);
+  return it->second->values.data();
+}
+
+void SparseRowCache::put(size_t paraId, int64_t rowId, const real* values,
+                         size_t width) {
+  Key key(paraId, rowId);
+  auto it = index_.find(key);
+  if (it != index_.end()) {
+    entries_.splice(entries_.begin(), entries_, it->second);
+  } else if (entries_.size() < capacity_) {
+    entries_.emplace_front();
+    index_[key] = entries_.begin();
+  } else {
+    /// reuse the least recently used entry
+    index_.erase(entries_.back().key);
+    entries_.splice(entries_.begin(), entries_, std::prev(entries_.end()));
+    index_[key] = entries_.begin();
+  }
+  Entry& entry = entries_.front();
+  entry.key = key;
+  entry.version = clock_;
+  entry.values.assign(values, values + width);
+}
+
+}  // namespace paddle
@@ -0,0 +1,94 @@
+/* Copyright (c) 2016 Baidu, Inc. All Rights Reserve.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <functional>
+#include <list>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "paddle/utils/TypeDefs.h"
+
+namespace paddle {
+
+/**
+ * @brief LRU cache of the sparse rows prefetched from one pserver
+ *
+ * @note  The version of a cached row is the clock of the cache when the
+ *        row was fetched, and the clock ticks once per prefetch. A row is
+ *        only fetched again when its version is more than maxStaleness
+ *        clocks old, so the hot rows of skewed data are fetched once every
+ *        maxStaleness + 1 batches instead of every batch. The values used
+ *        by the trainer may then miss the updates of the last maxStaleness
+ *        batches, as in async sgd.
+ *
+ *        Not thread safe, ParameterClient2 keeps one cache per pserver and
+ *        each pserver is handled by one thread at a time.
+ */
+class SparseRowCache {
+public:
+  /// capacity is the max number of cached rows
+  SparseRowCache(size_t capacity, int64_t maxStaleness);
+
+  /// advance the clock, called once per prefetch
+  void tick() { ++clock_; }
+
+  /**
+   * @brief look up a row which is fresh enough
+   * @return the cached values, or nullptr if the row must be fetched.
+   *         It is valid until the next put().
+   */
+  const real* get(size_t paraId, int64_t rowId);
+
+  /// cache a fetched row with the current clock as its version
+  void put(size_t paraId, int64_t rowId, const real* values, size_t width);
+
+  size_t size() const { return entries_.size(); }
+
+  int64_t getNumHits() const { return numHits_; }
+  int64_t getNumMisses() const { return numMisses_; }
+
+protected:
+  typedef std::pair<size_t, int64_t> Key;  // (paraId, rowId)
+
+  struct KeyHash {
+    size_t operator()(const Key& key) const {
+      return std::hash<int64_t>()(key.second) ^ (key.first << 20);
+    }
+  };
+
+  struct Entry {
+    Key key;
+    int64_t version;
+    std::vector<real> values;
+  };
+
+  size_t capacity_;
+  int64_t maxStaleness_;
+  int64_t clock_;
+
+  /// the most recently used in front
+  std::list<Entry> entries_;
+  std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> index_;
+
+  int64_t numHits_;
+  int64_t numMisses_;
+};
+
+}  // namespace paddle
@@ -0,0 +1,118 @@
+/* Copyright (c) 2016 Baidu, Inc. All Rights Reserve.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <random>
+
+#include "paddle/pserver/GradientCompression.h"
+#include "paddle/utils/Util.h"
+
+using namespace paddle;  // NOLINT
+
+static const size_t kSize = 1000;
+static const size_t kBlockSize = 300;
+
+static ParameterConfig makeConfig(GradientCompression type) {
+  ParameterConfig config;
+  config.set_name("para");
+  config.set_size(kSize);
+  config.set_parameter_block_size(kBlockSize);
+  config.set_gradient_compression(type);
+  config.set_gradient_topk_ratio(0.1);
+  return config;
+}
+
+static std::vector<real> randomGradient() {
+  std::mt19937 engine(kSize);
+  std::uniform_real_distribution<real> dist(-1, 1);
+  std::vector<real> grad(kSize);
+  for (auto& g : grad) {
+    g = dist(engine);
+  }
+  return grad;
+}
+
+/// compress grad block by block and add the decoded blocks to sum
+static void sendGradient(GradientCompressor* compressor,
+                         const std::vector<real>& grad,
+                         std::vector<real>* sum) {
+  std::vector<char> buffer(compressor->getBufferBytes());
+  for (size_t begin = 0; begin < kSize; begin += kBlockSize) {
+    size_t size = std::min(kBlockSize, kSize - begin);
+    size_t blockId = begin / kBlockSize;
+    char* block = buffer.data() + compressor->getBlockOffset(blockId);
+    compressor->compressBlock(grad.data() + begin, begin, size, block);
+    addCompressedGradient(compressor->getType(), block,
+                          compressor->getBlockBytes(size),
+                          sum->data() + begin, size);
+  }
+}
+
+TEST(GradientCompression, fp16) {
+  GradientCompressor compressor(makeConfig(GRADIENT_COMPRESSION_FP16));
+  auto grad = randomGradient();
+  std::vector<real> sum(kSize, 0);
+  sendGradient(&compressor, grad, &sum);
+  for (size_t i = 0; i < kSize; ++i) {
+    EXPECT_NEAR(grad[i], sum[i], 1e-3);
+  }
+}
+
+TEST(GradientCompression, int8) {
+  GradientCompressor compressor(makeConfig(GRADIENT_COMPRESSION_INT8));
+  auto grad = randomGradient();
+  std::vector<real> sum(kSize, 0);
+  const int kRounds = 400;
+  for (int round = 0; round < kRounds; ++round) {
+    sendGradient(&compressor, grad, &sum);
+  }
+  // stochastic rounding is unbiased: the mean converges to the gradient
+  for (size_t i = 0; i < kSize; ++i) {
+    EXPECT_NEAR(grad[i], sum[i] / kRounds, 2e-3);
+  }
+}
+
+TEST(GradientCompression, topk) {
+  GradientCompressor compressor(makeConfig(GRADIENT_COMPRESSION_TOPK));
+  auto grad = randomGradient();
+  std::vector<real> sum(kSize, 0);
+  sendGradient(&compressor, grad, &sum);
+  // the values are sent as float
+  const real kFloatError = 1e-6;
+  size_t numSent = 0;
+  for (size_t i = 0; i < kSize; ++i) {
+    if (sum[i] != 0) {
+      EXPECT_NEAR(grad[i], sum[i], kFloatError);
+      ++numSent;
+    }
+  }
+  EXPECT_EQ(30UL + 30UL + 30UL + 10UL, numSent);
+
+  // the residual is sent by the following zero gradients
+  std::vector<real> zero(kSize, 0);
+  for (int round = 0; round < 10; ++round) {
+    sendGradient(&compressor, zero, &sum);
+  }
+  for (size_t i = 0; i < kSize; ++i) {
+    EXPECT_NEAR(grad[i], sum[i], kFloatError);
+  }
+}
+
+int main(int argc, char** argv) {
+  paddle::initMain(argc, argv);
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -12,6 +12,8 @@ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 See the License for the specific language governing permissions and
 limitations under the License. */
 
+#include <atomic>
+
 #include <paddle/pserver/ParameterClient2.h>
 #include <paddle/pserver/ParameterServer2.h>
 #include <gtest/gtest.h>
@@ -22,6 +24,8 @@ using namespace paddle;  // NOLINT
 using namespace std;     // NOLINT
 
 P_DECLARE_int32(num_gradient_servers);
+P_DECLARE_int32(pserver_num_threads);
+P_DECLARE_int32(pserver_parallel_add_min_size);
 P_DEFINE_string(server_addr, "127.0.0.1", "assign server address");
 P_DEFINE_int32(server_cpu, 0, "assign server cpu");
 
@@ -79,12 +83,15 @@ public:
   void setConfigTest();
   void setStatusTest();
   void sendParameterTest();
+  void cachedSendTest();
+  void addGradientTest(int numBatches, vector<VectorPtr>* values);
   void sendDataTest(SendDataType type, size_t size);
   void operationTest();
   void mergeBlockSegmentTest();
   void checkSegments(const BlockSegments& expected, const BlockSegments& segs);
   void waitPassFinishTest();
   void synchronizeTest();
+  void sspTest();
 
 protected:
   ParameterClient2 client_;
@@ -165,6 +172,101 @@ void ParameterServer2Tester::sendParameterTest() {
   }
 }
 
+void ParameterServer2Tester::cachedSendTest() {
+  setup();
+
+  /// the blocks are only sent in the first round, the pservers reuse them
+  for (int round = 0; round < 3; ++round) {
+    vector<CpuVector> values;
+    for (auto& parameter : parameters_) {
+      parameter->getBuf(PARAMETER_VALUE)->rand();
+      values.emplace_back(parameter->getSize());
+      values.back().copyFrom(*parameter->getBuf(PARAMETER_VALUE));
+    }
+    client_.sendAndReceiveParameter(PSERVER_UPDATE_MODE_SET_PARAM,
+                                    PARAMETER_VALUE,
+                                    0,       // numSamples = 0
+                                    0,       // cost = 0
+                                    false);  // sendBackParameter = false
+    for (auto& parameter : parameters_) {
+      parameter->getBuf(PARAMETER_VALUE)->zeroMem();
+    }
+    client_.sendAndReceiveParameter(PSERVER_UPDATE_MODE_GET_PARAM,
+                                    PARAMETER_VALUE,
+                                    0,      // numSamples = 0
+                                    0,      // cost = 0
+                                    true);  // sendBackParameter = true
+
+    for (size_t i = 0; i != parameters_.size(); ++i) {
+      EXPECT_EQ(0, memcmp(values[i].getData(),
+                          parameters_[i]->getBuf(PARAMETER_VALUE)->getData(),
+                          sizeof(real) * parameters_[i]->getSize()));
+    }
+  }
+}
+
+/// two trainers send the same gradients in every run, the final values
+/// must not depend on how the pserver adds them
+void ParameterServer2Tester::addGradientTest(int numBatches,
+                                             vector<VectorPtr>* values) {
+  setup();
+
+  const int numTrainers = 2;
+  vector<ParameterPtr> trainerParameters[numTrainers];
+  ParameterClient2 clients[numTrainers];
+  /// the clients are used in the threads of the workers only
+  ThreadWorker workers[numTrainers];
+  for (int i = 0; i < numTrainers; ++i) {
+    for (auto& parameter : parameters_) {
+      trainerParameters[i].emplace_back(
+          new Parameter(parameter->getConfig(), /* useGpu= */ false));
+      trainerParameters[i].back()->setID(parameter->getID());
+    }
+    ParameterClient2* client = &clients[i];
+    vector<ParameterPtr>* parameters = &trainerParameters[i];
+    workers[i].addJob([client, parameters]() {
+      CHECK(client->init(*parameters));
+    });
+  }
+  for (auto& worker : workers) {
+    worker.wait();
+  }
+
+  for (int batch = 0; batch < numBatches; ++batch) {
+    for (int i = 0; i < numTrainers; ++i) {
+      for (auto& parameter : trainerParameters[i]) {
+        real* grad = parameter->getBuf(PARAMETER_GRADIENT)->getData();
+        for (size_t j = 0; j < parameter->getSize(); ++j) {
+          grad[j] = (real)((j * 7 + batch * 13 + i * 29) % 101) / 101 - 0.5;
+        }
+      }
+      ParameterClient2* client = &clients[i];
+      workers[i].addJob([client]() {
+        client->sendAndReceiveParameter(PSERVER_UPDATE_MODE_ADD_GRADIENT,
+                                        PARAMETER_GRADIENT,
+                                        10,     // numSamples = 10
+                                        0,      // cost = 0
+                                        true);  // sendBackParameter = true
+      });
+    }
+    PreparedOperations ops;
+    ops.addOperation(PSERVER_OP_SGD);
+    client_.doOperation(ops,
+                        /* waitForGradient= */ true,
+                        /* sendBackParameter= */ true);
+    for (auto& worker : workers) {
+      worker.wait();
+    }
+  }
+
+  client_.getParameter();
+  values->clear();
+  for (auto& parameter : parameters_) {
+    values->push_back(Vector::create(parameter->getSize(), false));
+    values->back()->copyFrom(*parameter->getBuf(PARAMETER_VALUE));
+  }
+}
+
 void ParameterServer2Tester::sendDataTest(SendDataType type, size_t size) {
   ParameterClient2 client1(true);
   client1.init(parameters_);
@@ -534,8 +636,104 @@ void ParameterServer2Tester::synchronizeTest() {
   LOG(INFO) << "Pass 2 finished";
 }
 
+void ParameterServer2Tester::sspTest() {
+  setup();
+  // a trainer may be at most two batches ahead of the other
+  config_.set_ssp_staleness(2);
+
+  ParameterClient2 client1;
+  ParameterClient2 client2;
+
+  ThreadWorker worker1;
+  ThreadWorker worker2;
+
+  std::atomic<int> numFinished(0);
+
+  worker1.addJob([&]() {
+    client1.init(parameters_);
+    client1.setTrainerId(0);
+  });
+  worker2.addJob([&]() {
+    client2.init(parameters_);
+    client2.setTrainerId(1);
+  });
+  // call asyncFinishPass to reset the clocks at pserver
+  worker1.addJob([&]() { client1.asyncFinishPass(); });
+  worker2.addJob([&]() { client2.asyncFinishPass(); });
+  worker1.wait();
+  worker2.wait();
+
+  auto update1 = [&]() {
+    client1.sendAndReceiveParameter(PSERVER_UPDATE_MODE_SSP_SGD,
+                                    PARAMETER_VALUE,
+                                    0,      // numSamples = 0
+                                    0,      // cost = 0
+                                    true);  // sendBackParameter = true
+    ++numFinished;
+  };
+  for (int i = 0; i < 5; ++i) {
+    worker1.addJob(update1);
+  }
+  worker1.addJob([&]() { client1.asyncFinishPass(); });
+
+  sleep(1);
+  EXPECT_EQ(2, numFinished);
+
+  worker2.addJob([&]() {
+    client2.sendAndReceiveParameter(PSERVER_UPDATE_MODE_SSP_SGD,
+                                    PARAMETER_VALUE, 0, 0, true);
+  });
+  worker2.wait();
+  sleep(1);
+  EXPECT_EQ(3, numFinished);
+
+  // trainer 1 finishing the pass releases trainer 0
+  worker2.addJob([&]() { client2.asyncFinishPass(); });
+  worker1.wait();
+  worker2.wait();
+  EXPECT_EQ(5, numFinished);
+}
+
 TEST(ParameterServer2, sendParameter) { g_server->sendParameterTest(); }
 
+TEST(ParameterServer2, cachedSend) { g_server->cachedSendTest(); }
+
+TEST(ParameterServer2, parallelAddGradient) {
+  int oldFlagsPort = FLAGS_port;
+  int oldFlagsNumThreads = FLAGS_pserver_num_threads;
+  int oldFlagsParallelAddMinSize = FLAGS_pserver_parallel_add_min_size;
+  FLAGS_pserver_parallel_add_min_size = 1;
+
+  /// a serial pserver and a parallel one get the same gradients
+  const int numThreads[] = {1, 4};
+  vector<VectorPtr> values[2];
+  for (int i = 0; i < 2; ++i) {
+    FLAGS_port = oldFlagsPort + 4 + i;
+    FLAGS_pserver_num_threads = numThreads[i];
+    std::unique_ptr<ParameterServer2Tester> server;
+    if (FLAGS_rdma_tcp == "rdma") {
+      server.reset(new ParameterServer2Tester(FLAGS_server_addr, FLAGS_port,
+                                              FLAGS_server_cpu + i));
+    } else {
+      server.reset(new ParameterServer2Tester(FLAGS_server_addr, FLAGS_port));
+    }
+    server->start();
+    sleep(2);
+    server->addGradientTest(/* numBatches= */ 5, &values[i]);
+  }
+
+  FLAGS_port = oldFlagsPort;
+  FLAGS_pserver_num_threads = oldFlagsNumThreads;
+  FLAGS_pserver_parallel_add_min_size = oldFlagsParallelAddMinSize;
+
+  ASSERT_EQ(values[0].size(), values[1].size());
+  for (size_t i = 0; i < values[0].size(); ++i) {
+    ASSERT_EQ(values[0][i]->getSize(), values[1][i]->getSize());
+    EXPECT_EQ(0, memcmp(values[0][i]->getData(), values[1][i]->getData(),
+                        sizeof(real) * values[0][i]->getSize()));
+  }
+}
+
 TEST(ParameterServer2, setConfig) { g_server->setConfigTest(); }
 
 TEST(ParameterServer2, setStatus) { g_server->setStatusTest(); }
@@ -548,6 +746,8 @@ TEST(ParameterServer2, waitPassFinish) { g_server->waitPassFinishTest(); }
 
 TEST(ParameterServer2, synchronize) { g_server->synchronizeTest(); }
 
+TEST(ParameterServer2, ssp) { g_server->sspTest(); }
+
 TEST(ParameterServer2, sendData) {
   // Set gserver and pserver all 3, so that the test is sufficient.
   int oldFlagsPortsNUm = FLAGS_ports_num;
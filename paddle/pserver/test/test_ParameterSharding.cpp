@@ -0,0 +1,111 @@
+/* Copyright (c) 2016 Baidu, Inc. All Rights Reserve.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <numeric>
+
+#include "paddle/pserver/ParameterSharding.h"
+#include "paddle/utils/Util.h"
+
+using namespace paddle;  // NOLINT
+
+TEST(ParameterSharding, leastLoaded) {
+  /// loads after each job:
+  /// 7,0,0  7,6,0  7,6,5  7,6,9  7,9,9  9,9,9  11,9,9  11,10,9
+  std::vector<double> costs = {7, 6, 5, 4, 3, 2, 2, 1};
+  std::vector<int> expected = {0, 1, 2, 2, 1, 0, 0, 1};
+  EXPECT_EQ(expected, ParameterSharding::assignLeastLoaded(costs, 3));
+
+  std::vector<double> loads(3, 0);
+  for (size_t i = 0; i < costs.size(); ++i) {
+    loads[expected[i]] += costs[i];
+  }
+  double mean = (loads[0] + loads[1] + loads[2]) / 3;
+  EXPECT_LE(*std::max_element(loads.begin(), loads.end()), mean + costs[0]);
+}
+
+static std::vector<ParameterPtr> createDenseParameters() {
+  const size_t sizes[] = {1 << 20, 300000, 70000, 5000, 1500};
+  std::vector<ParameterPtr> parameters;
+  for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+    ParameterConfig config;
+    config.set_name("para" + std::to_string(i));
+    config.set_para_id(i);
+    config.set_size(sizes[i]);
+    config.add_dims(1);
+    config.add_dims(sizes[i]);
+    /// the parameters cost differently per element
+    if (i % 2) config.set_momentum(0.9);
+    if (i % 3) config.set_decay_rate(1e-4);
+    parameters.emplace_back(new Parameter(config, /* useGpu= */ false,
+                                          /* doInit= */ false));
+    parameters.back()->setID(i);
+  }
+  return parameters;
+}
+
+TEST(ParameterSharding, balanced) {
+  const size_t numServers = 4;
+  std::vector<ParameterPtr> parameters = createDenseParameters();
+  ParameterSharding sharding(parameters, numServers, "balanced");
+
+  /// the cost of a pserver is its mean share of the bytes and the flops
+  const std::vector<double>& bytes = sharding.getServerBytes();
+  const std::vector<double>& flops = sharding.getServerFlops();
+  double totalBytes = std::accumulate(bytes.begin(), bytes.end(), 0.0);
+  double totalFlops = std::accumulate(flops.begin(), flops.end(), 0.0);
+  double maxCost = 0;
+  for (size_t i = 0; i < numServers; ++i) {
+    maxCost = std::max(maxCost, 0.5 * bytes[i] / totalBytes +
+                                    0.5 * flops[i] / totalFlops);
+  }
+  /// the max is at most the mean plus one block, which is about
+  /// 1 / (32 * numServers) of the total
+  EXPECT_LE(maxCost * numServers, 1.0 + 1.0 / 32 + 1e-6);
+
+  /// every block is placed on a pserver
+  for (auto& para : parameters) {
+    const ParameterSharding::Shard& shard = sharding.getShard(para->getID());
+    size_t numBlocks =
+        (para->getSize() + shard.blockSize - 1) / shard.blockSize;
+    ASSERT_EQ(numBlocks, shard.serverIds.size());
+    for (int serverId : shard.serverIds) {
+      EXPECT_LT(serverId, (int)numServers);
+      EXPECT_GE(serverId, 0);
+    }
+  }
+}
+
+/// every trainer computes the plan from its own parameters
+TEST(ParameterSharding, deterministic) {
+  std::vector<ParameterPtr> parameters1 = createDenseParameters();
+  std::vector<ParameterPtr> parameters2 = createDenseParameters();
+  std::reverse(parameters2.begin(), parameters2.end());
+
+  SetConfigRequest request1;
+  SetConfigRequest request2;
+  ParameterSharding(parameters1, 3, "balanced").toProto(&request1);
+  ParameterSharding(parameters2, 3, "balanced").toProto(&request2);
+  ASSERT_EQ(5, request1.shards_size());
+  EXPECT_EQ(request1.SerializePartialAsString(),
+            request2.SerializePartialAsString());
+}
+
+int main(int argc, char** argv) {
+  paddle::initMain(argc, argv);
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
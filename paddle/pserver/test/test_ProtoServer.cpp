@@ -15,16 +15,25 @@ limitations under the License. */
 #include "paddle/utils/Util.h"
 
 #include <gtest/gtest.h>
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <set>
+#include <thread>
 
 #include "paddle/utils/Stat.h"
 #include "paddle/math/Vector.h"
 #include "paddle/pserver/ProtoServer.h"
+#include "paddle/pserver/ShmRing.h"
 #include "ParameterService.pb.h"
 
 P_DEFINE_string(server_addr, "127.0.0.1", "Server address");
 P_DEFINE_int64(dim, 50000000, "Data size");
 P_DEFINE_bool(test_proto_server, true, "whether to test ProtoServer");
 P_DEFINE_bool(benchmark, false, "Do benchmark. Skip some tests");
+P_DEFINE_int32(num_clients, 16, "Number of clients of the concurrent test");
+
+P_DECLARE_int32(sock_shm_size);
 
 using namespace paddle;  // NOLINT
 
@@ -32,16 +41,22 @@ class MyServer : public ProtoServer {
 public:
   explicit MyServer(int port, int rdmaCpu = -1)
       : ProtoServer(FLAGS_server_addr, port, rdmaCpu),
-        status_(PSERVER_STATUS_NOT_SET) {
+        status_(PSERVER_STATUS_NOT_SET),
+        barrier_(FLAGS_num_clients) {
     REGISTER_SERVICE_FUNCTION(MyServer, getStatus);
     REGISTER_SERVICE_FUNCTION(MyServer, setStatus);
     REGISTER_SERVICE_FUNCTION_EX(MyServer, getStatusEx);
+    REGISTER_SERVICE_FUNCTION(MyServer, waitPassStart);
   }
   void getStatus(const GetStatusRequest& request,
                  ProtoResponseCallback callback) {
     (void)request;
     GetStatusResponse response;
     response.set_status(status_);
+    {
+      std::lock_guard<std::mutex> guard(lock_);
+      lastConnectionId_ = getConnectionId();
+    }
     callback(response);
   }
 
@@ -63,9 +78,49 @@ public:
     callback(response);
   }
 
+  /// blocks until all the clients come, and records the connection
+  void waitPassStart(const WaitPassStartRequest& request,
+                     ProtoResponseCallback callback) {
+    (void)request;
+    {
+      std::lock_guard<std::mutex> guard(lock_);
+      connectionIds_.insert(getConnectionId());
+    }
+    barrier_.wait();
+    WaitPassStartResponse response;
+    callback(response);
+  }
+
+  size_t getNumConnections() {
+    std::lock_guard<std::mutex> guard(lock_);
+    return connectionIds_.size();
+  }
+
+  /// the connection of the last getStatus request
+  int64_t getLastConnectionId() {
+    std::lock_guard<std::mutex> guard(lock_);
+    return lastConnectionId_;
+  }
+
+  bool isClosed(int64_t connectionId) {
+    std::lock_guard<std::mutex> guard(lock_);
+    return closedConnectionIds_.count(connectionId) > 0;
+  }
+
 protected:
+  virtual void onConnectionClosed(int64_t connectionId) {
+    ProtoServer::onConnectionClosed(connectionId);
+    std::lock_guard<std::mutex> guard(lock_);
+    closedConnectionIds_.insert(connectionId);
+  }
+
   PServerStatus status_;
   std::string buffer_;
+  ThreadBarrier barrier_;
+  std::mutex lock_;
+  std::set<int64_t> connectionIds_;
+  int64_t lastConnectionId_ = -1;
+  std::set<int64_t> closedConnectionIds_;
 };
 
 TEST(ProtoServer, regular) {
@@ -99,6 +154,105 @@ TEST(ProtoServer, regular) {
   delete client;
 }
 
+MyServer* gServer = nullptr;
+
+// the requests block on each other, all of them have to be served together
+TEST(ProtoServer, concurrent) {
+  if (FLAGS_rdma_tcp == "rdma") return;
+  std::vector<std::unique_ptr<ProtoClient>> clients;
+  for (int i = 0; i < FLAGS_num_clients; ++i) {
+    clients.emplace_back(new ProtoClient(FLAGS_server_addr, FLAGS_port));
+  }
+  for (int k = 0; k < 3; ++k) {
+    std::vector<std::thread> threads;
+    for (auto& client : clients) {
+      threads.emplace_back([&client]() {
+        WaitPassStartRequest request;
+        WaitPassStartResponse response;
+        client->sendAndRecv("waitPassStart", request, &response);
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+    // every connection keeps its id
+    EXPECT_EQ((size_t)FLAGS_num_clients, gServer->getNumConnections());
+  }
+}
+
+// the server is told about the connection closed by the client
+TEST(ProtoServer, connectionClosed) {
+  int64_t connectionId;
+  {
+    ProtoClient client(FLAGS_server_addr, FLAGS_port);
+    GetStatusRequest request;
+    GetStatusResponse response;
+    client.sendAndRecv("getStatus", request, &response);
+    connectionId = gServer->getLastConnectionId();
+    EXPECT_FALSE(gServer->isClosed(connectionId));
+  }
+  for (int i = 0; i < 1000 && !gServer->isClosed(connectionId); ++i) {
+    usleep(10000);
+  }
+  EXPECT_TRUE(gServer->isClosed(connectionId));
+}
+
+// the message is larger than the rings of a shared memory channel
+TEST(ProtoServer, largeMessage) {
+  ProtoClient client(FLAGS_server_addr, FLAGS_port);
+  std::vector<int32_t> data(9 * 1024 * 1024 + 1);
+  for (size_t i = 0; i < data.size(); ++i) {
+    data[i] = i * 2654435761U;
+  }
+  std::vector<int32_t> echo(data.size());
+  for (int k = 0; k < 3; ++k) {
+    GetStatusRequest request;
+    GetStatusResponse response;
+    auto msgReader = client.sendAndRecv(
+        "getStatusEx", request,
+        {{&data[0], data.size() * sizeof(int32_t)}}, &response);
+    ASSERT_EQ(msgReader->getNumBlocks(), (size_t)1);
+    ASSERT_EQ(msgReader->getNextBlockLength(), data.size() * sizeof(int32_t));
+    msgReader->readNextBlock(&echo[0]);
+    EXPECT_TRUE(data == echo);
+  }
+}
+
+// the pages of a segment are reserved when it is created
+TEST(ShmSegment, reserved) {
+  size_t ringSize = 1024 * 1024;
+  auto segment = ShmSegment::create(ringSize);
+  ASSERT_TRUE(segment != nullptr);
+  struct stat st;
+  ASSERT_EQ(0, stat(("/dev/shm" + segment->getName()).c_str(), &st));
+  EXPECT_GE((size_t)st.st_blocks * 512, 2 * ringSize);
+}
+
+// the connection stays on tcp if the shared memory cannot be allocated
+TEST(ProtoServer, shmFallback) {
+  if (FLAGS_rdma_tcp == "rdma" || FLAGS_sock_shm_size == 0) {
+    return;
+  }
+  // a file size limit below the segment size makes the allocation fail
+  struct rlimit oldLimit;
+  PCHECK(getrlimit(RLIMIT_FSIZE, &oldLimit) == 0);
+  struct rlimit limit = oldLimit;
+  limit.rlim_cur = FLAGS_sock_shm_size / 2;
+  auto oldHandler = signal(SIGXFSZ, SIG_IGN);
+  PCHECK(setrlimit(RLIMIT_FSIZE, &limit) == 0);
+
+  ProtoClient client(FLAGS_server_addr, FLAGS_port);
+  GetStatusRequest request;
+  GetStatusResponse response;
+  client.sendAndRecv("getStatus", request, &response);
+
+  PCHECK(setrlimit(RLIMIT_FSIZE, &oldLimit) == 0);
+  signal(SIGXFSZ, oldHandler);
+
+  EXPECT_EQ(F_TCP, client.getChannel()->getChannelType());
+  client.sendAndRecv("getStatus", request, &response);
+}
+
 TEST(ProtoServer, extended) {
 #ifndef PADDLE_ONLY_CPU
   ProtoClient* client;
@@ -169,6 +323,7 @@ int main(int argc, char** argv) {
   }
 
   server->start();
+  gServer = server;
   usleep(10000);
 
   int ret = RUN_ALL_TESTS();
@@ -0,0 +1,168 @@
+/* Copyright (c) 2016 Baidu, Inc. All Rights Reserve.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include <gtest/gtest.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cmath>
+#include <random>
+
+#include "paddle/pserver/RingAllReduce.h"
+#include "paddle/utils/Util.h"
+
+using namespace paddle;  // NOLINT
+
+P_DECLARE_int32(port);
+
+static const size_t kSizes[] = {1, 3, 1000, 100003};
+
+static std::vector<real> randomVector(int trainerId, size_t size) {
+  std::mt19937 engine(trainerId * 7919 + size);
+  std::uniform_real_distribution<real> dist(-1, 1);
+  std::vector<real> vec(size);
+  for (auto& v : vec) {
+    v = dist(engine);
+  }
+  return vec;
+}
+
+static void writeAll(int fd, const void* buf, size_t size) {
+  for (size_t done = 0; done < size;) {
+    ssize_t n = write(fd, (const char*)buf + done, size - done);
+    PCHECK(n > 0);
+    done += n;
+  }
+}
+
+static void readAll(int fd, void* buf, size_t size) {
+  for (size_t done = 0; done < size;) {
+    ssize_t n = read(fd, (char*)buf + done, size - done);
+    PCHECK(n > 0);
+    done += n;
+  }
+}
+
+/**
+ * run numTrainers processes, each of them calls allReduce() on its random
+ * vector of each size in kSizes, and return the results of every trainer
+ */
+static std::vector<std::vector<std::vector<real>>> runTrainers(
+    int numTrainers, int rootId = -1) {
+  std::vector<std::string> trainers(numTrainers, "127.0.0.1");
+  std::vector<pid_t> pids;
+  std::vector<int> fds;
+  for (int trainerId = 0; trainerId < numTrainers; ++trainerId) {
+    int pipefd[2];
+    PCHECK(pipe(pipefd) == 0);
+    pid_t pid = fork();
+    PCHECK(pid >= 0);
+    if (pid == 0) {
+      close(pipefd[0]);
+      RingAllReduce ring(trainers, FLAGS_port, trainerId);
+      for (size_t size : kSizes) {
+        auto vec = randomVector(trainerId, size);
+        if (rootId >= 0) {
+          ring.broadcast(vec.data(), size, rootId);
+        } else {
+          ring.allReduce(vec.data(), size);
+        }
+        writeAll(pipefd[1], vec.data(), size * sizeof(real));
+      }
+      close(pipefd[1]);
+      _exit(0);
+    }
+    close(pipefd[1]);
+    pids.push_back(pid);
+    fds.push_back(pipefd[0]);
+  }
+
+  std::vector<std::vector<std::vector<real>>> results(numTrainers);
+  for (int trainerId = 0; trainerId < numTrainers; ++trainerId) {
+    for (size_t size : kSizes) {
+      std::vector<real> vec(size);
+      readAll(fds[trainerId], vec.data(), size * sizeof(real));
+      results[trainerId].push_back(vec);
+    }
+    close(fds[trainerId]);
+    int status = 0;
+    PCHECK(waitpid(pids[trainerId], &status, 0) == pids[trainerId]);
+    EXPECT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  }
+  return results;
+}
+
+static void checkAllReduce(int numTrainers) {
+  auto results = runTrainers(numTrainers);
+  for (size_t k = 0; k < sizeof(kSizes) / sizeof(kSizes[0]); ++k) {
+    size_t size = kSizes[k];
+    std::vector<double> sum(size, 0);
+    for (int trainerId = 0; trainerId < numTrainers; ++trainerId) {
+      auto vec = randomVector(trainerId, size);
+      for (size_t i = 0; i < size; ++i) {
+        sum[i] += vec[i];
+      }
+    }
+    for (int trainerId = 0; trainerId < numTrainers; ++trainerId) {
+      const auto& result = results[trainerId][k];
+      // all the trainers get the same bits
+      EXPECT_EQ(0, memcmp(results[0][k].data(), result.data(),
+                          size * sizeof(real)));
+      for (size_t i = 0; i < size; ++i) {
+        EXPECT_NEAR(sum[i], result[i], 1e-5);
+      }
+    }
+  }
+}
+
+TEST(RingAllReduce, oneTrainer) { checkAllReduce(1); }
+
+TEST(RingAllReduce, twoTrainers) {
+  // the sum of two gradients does not depend on the order, it has the bits
+  // of the pserver, which adds them to a zero gradient
+  auto results = runTrainers(2);
+  for (size_t k = 0; k < sizeof(kSizes) / sizeof(kSizes[0]); ++k) {
+    size_t size = kSizes[k];
+    auto a = randomVector(0, size);
+    auto b = randomVector(1, size);
+    for (size_t i = 0; i < size; ++i) {
+      real sum = 0;
+      sum += a[i];
+      sum += b[i];
+      EXPECT_EQ(sum, results[0][k][i]);
+      EXPECT_EQ(sum, results[1][k][i]);
+    }
+  }
+}
+
+TEST(RingAllReduce, threeTrainers) { checkAllReduce(3); }
+
+TEST(RingAllReduce, fourTrainers) { checkAllReduce(4); }
+
+TEST(RingAllReduce, broadcast) {
+  const int kRootId = 2;
+  auto results = runTrainers(4, kRootId);
+  for (size_t k = 0; k < sizeof(kSizes) / sizeof(kSizes[0]); ++k) {
+    auto root = randomVector(kRootId, kSizes[k]);
+    for (auto& result : results) {
+      EXPECT_EQ(root, result[k]);
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  paddle::initMain(argc, argv);
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,120 @@
+/* Copyright (c) 2016 Baidu, Inc. All Rights Reserve.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include <gtest/gtest.h>
+
+#include <stdio.h>
+#include <fstream>
+
+#include "paddle/pserver/ParameterSharding.h"
+#include "paddle/pserver/SparseRowCache.h"
+#include "paddle/utils/Util.h"
+
+using namespace paddle;  // NOLINT
+
+TEST(SparseRowCache, lru) {
+  SparseRowCache cache(/* capacity= */ 2, /* maxStaleness= */ 10);
+  real row0[] = {1, 2, 3};
+  real row1[] = {4, 5, 6};
+  real row2[] = {7, 8, 9};
+  EXPECT_EQ(nullptr, cache.get(0, 0));
+  cache.put(0, 0, row0, 3);
+  cache.put(0, 1, row1, 3);
+  const real* values = cache.get(0, 0);
+  ASSERT_NE(nullptr, values);
+  EXPECT_EQ(0, memcmp(values, row0, sizeof(row0)));
+
+  /// row 1 is the least recently used
+  cache.put(1, 0, row2, 3);
+  EXPECT_EQ(2UL, cache.size());
+  EXPECT_EQ(nullptr, cache.get(0, 1));
+  values = cache.get(1, 0);
+  ASSERT_NE(nullptr, values);
+  EXPECT_EQ(0, memcmp(values, row2, sizeof(row2)));
+  ASSERT_NE(nullptr, cache.get(0, 0));
+  EXPECT_EQ(3, cache.getNumHits());
+  EXPECT_EQ(2, cache.getNumMisses());
+}
+
+TEST(SparseRowCache, staleness) {
+  SparseRowCache cache(/* capacity= */ 4, /* maxStaleness= */ 1);
+  real row[] = {1, 2};
+  cache.put(0, 5, row, 2);
+  EXPECT_NE(nullptr, cache.get(0, 5));
+  cache.tick();
+  EXPECT_NE(nullptr, cache.get(0, 5));
+  cache.tick();
+  EXPECT_EQ(nullptr, cache.get(0, 5));
+
+  /// fetched again
+  row[0] = 3;
+  cache.put(0, 5, row, 2);
+  const real* values = cache.get(0, 5);
+  ASSERT_NE(nullptr, values);
+  EXPECT_EQ(3, values[0]);
+  EXPECT_EQ(1UL, cache.size());
+}
+
+TEST(ParameterSharding, hotRows) {
+  ParameterConfig config;
+  config.set_name("emb");
+  config.set_para_id(0);
+  config.set_size(100 * 8);
+  config.add_dims(100);
+  config.add_dims(8);
+  config.set_sparse_remote_update(true);
+  std::vector<ParameterPtr> parameters;
+  parameters.emplace_back(new Parameter(config, /* useGpu= */ false,
+                                        /* doInit= */ false));
+  parameters[0]->setID(0);
+
+  std::string file = "test_SparseRowCache_freq.txt";
+  {
+    std::ofstream fout(file);
+    fout << "emb 7 100\n"
+         << "emb 3 90\n"
+         << "emb 5 10\n"
+         << "dense 1 1000\n";
+  }
+
+  ParameterSharding hash(parameters, 2, "hash");
+  ParameterSharding sharding(parameters, 2, "hash", file);
+  remove(file.c_str());
+
+  const ParameterSharding::Shard& shard = sharding.getShard(0);
+  EXPECT_EQ(8UL, shard.blockSize);
+  int server7 = shard.getServerId(7, 2);
+  EXPECT_NE(server7, shard.getServerId(3, 2));
+  /// row 3 costs less than row 7, row 5 goes with it
+  EXPECT_EQ(shard.getServerId(3, 2), shard.getServerId(5, 2));
+  for (int64_t row = 0; row < 100; ++row) {
+    if (row == 7 || row == 3 || row == 5) continue;
+    EXPECT_EQ(hash.getShard(0).getServerId(row, 2),
+              shard.getServerId(row, 2));
+  }
+
+  SetConfigRequest request;
+  sharding.toProto(&request);
+  ASSERT_EQ(1, request.shards_size());
+  EXPECT_EQ(3, request.shards(0).hot_rows_size());
+  EXPECT_EQ(3, request.shards(0).hot_row_server_ids_size());
+  EXPECT_EQ(3, request.shards(0).hot_rows(0));
+  EXPECT_EQ(server7, request.shards(0).hot_row_server_ids(2));
+}
+
+int main(int argc, char** argv) {
+  paddle::initMain(argc, argv);
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
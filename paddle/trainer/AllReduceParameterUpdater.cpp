@@ -0,0 +1,117 @@
+/* Copyright (c) 2016 Baidu, Inc. All Rights Reserve.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include "AllReduceParameterUpdater.h"
+
+#include "paddle/utils/Flags.h"
+#include "paddle/utils/Stat.h"
+#include "paddle/utils/StringUtil.h"
+
+P_DEFINE_string(trainers, "127.0.0.1",
+                "Comma separated addresses of the trainers for allreduce, "
+                "one address is used by all the trainers");
+
+namespace paddle {
+
+AllReduceParameterUpdater::AllReduceParameterUpdater(
+    const OptimizationConfig& optConfig)
+    : SgdLocalUpdater(optConfig), batchSize_(0) {
+  std::vector<std::string> trainers;
+  str::split(FLAGS_trainers, ',', &trainers);
+  if (trainers.size() == 1) {
+    trainers.resize(FLAGS_num_gradient_servers, trainers[0]);
+  }
+  CHECK_EQ(trainers.size(), (size_t)FLAGS_num_gradient_servers)
+      << "--trainers should list --num_gradient_servers addresses";
+  ring_.reset(new RingAllReduce(trainers, FLAGS_port, FLAGS_trainer_id));
+}
+
+void AllReduceParameterUpdater::init(std::vector<ParameterPtr>& parameters) {
+  SgdLocalUpdater::init(parameters);
+
+  size_t totalSize = 0;
+  for (auto& para : parameters_) {
+    CHECK(!para->isGradSparseUpdate() && !para->isSparseRemoteUpdate())
+        << "AllReduceParameterUpdater only supports dense parameters: "
+        << para->getName();
+    totalSize += para->getSize();
+  }
+  buffer_.resize(totalSize + 2);
+
+  size_t offset = 0;
+  for (auto& para : parameters_) {
+    CpuVector(para->getSize(), buffer_.data() + offset)
+        .copyFrom(*para->getBuf(PARAMETER_VALUE));
+    offset += para->getSize();
+  }
+  ring_->broadcast(buffer_.data(), totalSize, /* rootId= */ 0);
+  offset = 0;
+  for (auto& para : parameters_) {
+    para->getBuf(PARAMETER_VALUE)
+        ->copyFrom(CpuVector(para->getSize(), buffer_.data() + offset));
+    para->setValueUpdated();
+    offset += para->getSize();
+  }
+}
+
+PassType AllReduceParameterUpdater::startBatch(int64_t batchSize) {
+  batchSize_ = batchSize;
+  return PASS_TRAIN;
+}
+
+void AllReduceParameterUpdater::finishBatch(real cost) {
+  reduceAndUpdate(/* active= */ true);
+}
+
+bool AllReduceParameterUpdater::finishPass(real cost) {
+  /// the other trainers may still have batches in this pass
+  while (reduceAndUpdate(/* active= */ false) > 0) {
+  }
+  return SgdLocalUpdater::finishPass(cost);
+}
+
+int AllReduceParameterUpdater::reduceAndUpdate(bool active) {
+  /// the gradients are zero after the last update if not active
+  size_t offset = 0;
+  for (auto& para : parameters_) {
+    CpuVector(para->getSize(), buffer_.data() + offset)
+        .copyFrom(*para->getBuf(PARAMETER_GRADIENT));
+    offset += para->getSize();
+  }
+  /// batch sizes are exact in real up to 2^24 samples per batch
+  buffer_[offset] = active ? batchSize_ : 0;
+  buffer_[offset + 1] = active ? 1 : 0;
+  ring_->allReduce(buffer_.data(), buffer_.size());
+
+  int64_t numSamples = buffer_[offset];
+  int numActiveTrainers = buffer_[offset + 1];
+  if (numActiveTrainers == 0) {
+    return 0;
+  }
+
+  REGISTER_TIMER("allReduceUpdate");
+  numSamplesProcessed_ += numSamples;
+  optimizer_->startBatch(numSamplesProcessed_);
+  offset = 0;
+  for (auto& para : parameters_) {
+    para->getBuf(PARAMETER_GRADIENT)
+        ->copyFrom(CpuVector(para->getSize(), buffer_.data() + offset));
+    SgdLocalUpdater::updateImpl(para.get());
+    offset += para->getSize();
+  }
+  optimizer_->finishBatch();
+  return numActiveTrainers;
+}
+
+}  // namespace paddle
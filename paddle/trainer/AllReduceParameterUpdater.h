@@ -0,0 +1,76 @@
+/* Copyright (c) 2016 Baidu, Inc. All Rights Reserve.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "paddle/pserver/RingAllReduce.h"
+#include "ParameterUpdater.h"
+
+namespace paddle {
+
+/**
+ * @brief synchronous SGD without pservers, the trainers sum their
+ *        gradients with RingAllReduce and every trainer runs the optimizer
+ *        on the sum.
+ *
+ * @note  It is selected by --use_allreduce in cluster mode. The trainers
+ *        are listed in --trainers, trainer i listens on port + i.
+ *
+ *        The sum of the gradients and of the batch sizes is what the
+ *        pservers compute in sync SGD, and the optimizer runs on every
+ *        trainer with the same input, so the trainers keep the same
+ *        parameters without sending them.
+ *
+ *        Only dense parameters are supported. The trainers may have
+ *        different numbers of batches in a pass, the ones finishing
+ *        earlier join the reductions of the others with no gradient
+ *        in finishPass().
+ */
+class AllReduceParameterUpdater : public SgdLocalUpdater {
+public:
+  explicit AllReduceParameterUpdater(const OptimizationConfig& optConfig);
+
+  /// trainer 0 also sends its initial values to the others
+  virtual void init(std::vector<ParameterPtr>& parameters);
+
+  virtual PassType startBatch(int64_t batchSize);
+
+  virtual void finishBatch(real cost);
+
+  virtual bool finishPass(real cost);
+
+protected:
+  /// the gradients are only complete after allReduce() in finishBatch()
+  virtual void updateImpl(Parameter* para) {}
+
+  /**
+   * @brief sum the gradients and the batch sizes of all the trainers, and
+   *        update the parameters with the sum
+   * @param active whether this trainer did a batch
+   * @return number of trainers which did a batch
+   */
+  int reduceAndUpdate(bool active);
+
+  std::unique_ptr<RingAllReduce> ring_;
+  int64_t batchSize_;
+
+  /// gradients of all the parameters followed by the batch size and the
+  /// active flag
+  std::vector<real> buffer_;
+};
+
+}  // namespace paddle
@@ -0,0 +1,202 @@
+/* Copyright (c) 2016 Baidu, Inc. All Rights Reserve.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+
+#include "FullGradientEngine.h"
+
+#include "paddle/utils/Logging.h"
+#include "paddle/utils/Stat.h"
+
+namespace paddle {
+
+FullGradientEngine::FullGradientEngine(
+    const ModelConfig& config, const std::vector<ParameterPtr>& parameters,
+    size_t numThreads, int logPeriod)
+    : parameters_(parameters),
+      logPeriod_(logPeriod),
+      exhausted_(false),
+      numBatches_(0),
+      maxBatches_(-1) {
+  CHECK_GT(numThreads, 0UL);
+  CHECK(isSupported(parameters_));
+
+  // share values with the main parameters, create own gradients. The
+  // threads would update the shared static parameters concurrently.
+  ParamInitCallback paramInitCb = [this](int paramId, Parameter* para) {
+    if (para->isStatic()) {
+      para->enableType(PARAMETER_VALUE);
+    } else {
+      parameterInitNN(paramId, para, &parameters_);
+    }
+  };
+  for (size_t i = 0; i < numThreads; ++i) {
+    NeuralNetwork* nn = NeuralNetwork::create(config);
+    nn->init(config, paramInitCb, {PARAMETER_VALUE, PARAMETER_GRADIENT},
+             /* useGpu= */false);
+    networks_.emplace_back(nn);
+  }
+  networkBatches_.resize(numThreads, 0);
+  threads_.reset(new SyncThreadPool(numThreads, /* checkOwner= */false));
+  LOG(INFO) << "full gradient engine: " << numThreads << " threads";
+}
+
+bool FullGradientEngine::isSupported(
+    const std::vector<ParameterPtr>& parameters) {
+  for (auto& para : parameters) {
+    if (para->useGpu() || !para->getBuf(PARAMETER_VALUE)) {
+      return false;
+    }
+    if (para->isStatic()) continue;
+    if (para->isGradSparseUpdate() || para->isSparse() ||
+        !para->getBuf(PARAMETER_GRADIENT_SUM)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+int64_t FullGradientEngine::calcFullGradient(DataProvider* dataProvider,
+                                             int64_t batchSize,
+                                             TrainerStats* stats,
+                                             int64_t maxBatches) {
+  exhausted_ = false;
+  numBatches_ = 0;
+  maxBatches_ = maxBatches;
+  threads_->exec([this, dataProvider, batchSize, stats](int tid,
+                                                        size_t numThreads) {
+    computeThread(tid, dataProvider, batchSize, stats);
+  });
+
+  {
+    REGISTER_TIMER("reduceFullGrad");
+    reduceGradients();
+  }
+  mergeStaticParameters();
+  return numBatches_;
+}
+
+int64_t FullGradientEngine::getNextBatch(DataProvider* dataProvider,
+                                         int64_t batchSize,
+                                         std::vector<Argument>* inArgs,
+                                         int64_t* batchId) {
+  REGISTER_TIMER("getTrainBatchFullGrad");
+  std::lock_guard<std::mutex> guard(dataLock_);
+  // the double buffer blocks if it is asked again after the end of pass
+  if (exhausted_ || numBatches_ == maxBatches_) return 0;
+
+  DataBatch dataBatch;
+  int64_t num = dataProvider->getNextBatch(batchSize, &dataBatch);
+  if (num == 0) {
+    exhausted_ = true;
+    return 0;
+  }
+  const std::vector<Argument>& streams = dataBatch.getStreams();
+  if (dataProvider->getConfig().async_load_data()) {
+    // The double buffer keeps the batch in a thread local buffer until
+    // this thread asks for the next one.
+    *inArgs = streams;
+  } else {
+    // The data provider may reuse its buffers for the next batch.
+    inArgs->resize(streams.size());
+    for (size_t i = 0; i < streams.size(); ++i) {
+      (*inArgs)[i].resizeAndCopyFrom(streams[i], /* useGpu= */false);
+    }
+  }
+  *batchId = numBatches_++;
+  return num;
+}
+
+void FullGradientEngine::computeThread(int tid, DataProvider* dataProvider,
+                                       int64_t batchSize,
+                                       TrainerStats* stats) {
+  NeuralNetwork* network = networks_[tid].get();
+  auto& paras = network->getParameters();
+  for (size_t i = 0; i < paras.size(); ++i) {
+    if (paras[i]->isStatic()) {
+      paras[i]->getBuf(PARAMETER_VALUE)->copyFrom(
+          *parameters_[i]->getBuf(PARAMETER_VALUE));
+    } else {
+      paras[i]->clearGradient();
+    }
+  }
+  networkBatches_[tid] = 0;
+
+  std::vector<Argument> inArgs;
+  std::vector<Argument> outArgs;
+  while (true) {
+    int64_t batchId = 0;
+    int64_t num = getNextBatch(dataProvider, batchSize, &inArgs, &batchId);
+    if (num == 0) break;
+    {
+      REGISTER_TIMER("forwardBackwardFullGrad");
+      // the gradients keep accumulating over the batches of this thread
+      network->forwardBackward(inArgs, &outArgs, PASS_TRAIN, nullptr);
+    }
+    ++networkBatches_[tid];
+
+    real cost = Argument::sumCosts(outArgs);
+    std::lock_guard<std::mutex> guard(statsLock_);
+    *stats += { num, cost };
+    if ((batchId + 1) % logPeriod_ == 0) {
+      LOG(INFO) << " Batch=" << batchId + 1 << " " << *stats;
+    }
+  }
+}
+
+void FullGradientEngine::reduceGradients() {
+  size_t numNetworks = networks_.size();
+  // log(n) rounds, network i takes network i + stride in round stride
+  for (size_t stride = 1; stride < numNetworks; stride *= 2) {
+    threads_->exec([this, stride, numNetworks](int tid, size_t numThreads) {
+      size_t dst = tid;
+      if (dst % (2 * stride) != 0 || dst + stride >= numNetworks) return;
+      auto& dstParas = networks_[dst]->getParameters();
+      auto& srcParas = networks_[dst + stride]->getParameters();
+      for (size_t i = 0; i < dstParas.size(); ++i) {
+        if (dstParas[i]->isStatic()) continue;
+        dstParas[i]->getBuf(PARAMETER_GRADIENT)->add(
+            *srcParas[i]->getBuf(PARAMETER_GRADIENT));
+      }
+    });
+  }
+
+  auto& sumParas = networks_[0]->getParameters();
+  threads_->exec([this, &sumParas](int tid, size_t numThreads) {
+    for (size_t i = tid; i < sumParas.size(); i += numThreads) {
+      if (sumParas[i]->isStatic()) continue;
+      parameters_[i]->getBuf(PARAMETER_GRADIENT_SUM)->add(
+          *sumParas[i]->getBuf(PARAMETER_GRADIENT));
+    }
+  });
+}
+
+void FullGradientEngine::mergeStaticParameters() {
+  std::vector<size_t> computed;
+  for (size_t tid = 0; tid < networks_.size(); ++tid) {
+    if (networkBatches_[tid] > 0) computed.push_back(tid);
+  }
+  if (computed.empty()) return;
+
+  for (size_t i = 0; i < parameters_.size(); ++i) {
+    if (!parameters_[i]->isStatic()) continue;
+    const VectorPtr& value = parameters_[i]->getBuf(PARAMETER_VALUE);
+    value->zeroMem();
+    for (size_t tid : computed) {
+      value->add(*networks_[tid]->getParameters()[i]->getBuf(PARAMETER_VALUE));
+    }
+    value->mulScalar(1.0 / computed.size());
+  }
+}
+
+}  // namespace paddle
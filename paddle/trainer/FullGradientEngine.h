@@ -0,0 +1,111 @@
+/* Copyright (c) 2016 Baidu, Inc. All Rights Reserve.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "paddle/gserver/dataproviders/DataProvider.h"
+#include "paddle/gserver/gradientmachines/NeuralNetwork.h"
+#include "paddle/utils/DisableCopy.h"
+#include "paddle/utils/Thread.h"
+#include "TrainerInternalConfig.h"
+
+namespace paddle {
+
+/**
+ * @brief Computes the SVRG full gradient g = \sum_b \partial f_b(w_s)
+ * with several threads.
+ *
+ * Nothing is updated during the full gradient pass, so the batches are
+ * independent. Every thread owns a network which shares PARAMETER_VALUE
+ * with the main parameters and has its own PARAMETER_GRADIENT. The threads
+ * pull batches from the data provider by themselves and keep accumulating
+ * into their own gradients, which are reduced pairwise at the end of the
+ * pass and added to PARAMETER_GRADIENT_SUM of the main parameters.
+ *
+ * The static parameters, e.g. the moving statistics of batch norm, are
+ * changed by forward(). Every thread has its own copy of them, which starts
+ * from the main value, and the main value is the average of the copies of
+ * the threads which computed batches at the end of the pass.
+ *
+ * Data loading overlaps with computing if the data provider loads data
+ * asynchronously (async_load_data), otherwise every thread copies its batch
+ * out of the data provider before computing.
+ */
+class FullGradientEngine {
+public:
+  /**
+   * @param config      model config.
+   * @param parameters  main parameters, their values are w_s in the pass.
+   * @param numThreads  number of computing threads.
+   * @param logPeriod   log the stats every logPeriod batches.
+   */
+  FullGradientEngine(const ModelConfig& config,
+                     const std::vector<ParameterPtr>& parameters,
+                     size_t numThreads, int logPeriod);
+
+  /// Whether the gradients of the parameters can be computed by the engine.
+  static bool isSupported(const std::vector<ParameterPtr>& parameters);
+
+  /**
+   * PARAMETER_GRADIENT_SUM += \sum_b \partial f_b(PARAMETER_VALUE) for the
+   * next maxBatches batches of dataProvider, or all the remaining batches
+   * if maxBatches < 0.
+   *
+   * @return number of batches.
+   */
+  int64_t calcFullGradient(DataProvider* dataProvider, int64_t batchSize,
+                           TrainerStats* stats, int64_t maxBatches = -1);
+
+  size_t getNumThreads() const { return networks_.size(); }
+
+private:
+  /// compute batches until the data provider is exhausted
+  void computeThread(int tid, DataProvider* dataProvider, int64_t batchSize,
+                     TrainerStats* stats);
+
+  /// get the next batch into inArgs, return its size, 0 at the end of pass
+  int64_t getNextBatch(DataProvider* dataProvider, int64_t batchSize,
+                       std::vector<Argument>* inArgs, int64_t* batchId);
+
+  /// pairwise reduce the thread gradients into PARAMETER_GRADIENT_SUM
+  void reduceGradients();
+
+  /// average the static parameters of the threads into the main ones
+  void mergeStaticParameters();
+
+  std::vector<ParameterPtr> parameters_;
+  std::vector<std::unique_ptr<NeuralNetwork>> networks_;
+  /// number of batches computed by each network in this pass
+  std::vector<int64_t> networkBatches_;
+  std::unique_ptr<SyncThreadPool> threads_;
+  int logPeriod_;
+
+  /// guards the data provider and the counters below
+  std::mutex dataLock_;
+  bool exhausted_;
+  int64_t numBatches_;
+  int64_t maxBatches_;
+
+  /// guards the stats
+  std::mutex statsLock_;
+
+  DISABLE_COPY(FullGradientEngine);
+};
+
+}  // namespace paddle
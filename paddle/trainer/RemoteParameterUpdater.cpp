@@ -192,7 +192,8 @@ void RemoteParameterUpdater::finishBatch(real cost) {
   const std::string& algorithm = config_.algorithm();
   ParameterUpdateMode mode;
   if (algorithm == TrainAlgorithm::AsyncSGD) {
-    mode = PSERVER_UPDATE_MODE_ASYNC_SGD;
+    mode = config_.ssp_staleness() >= 0 ? PSERVER_UPDATE_MODE_SSP_SGD
+                                        : PSERVER_UPDATE_MODE_ASYNC_SGD;
   } else if (algorithm == TrainAlgorithm::SGD) {
     mode = PSERVER_UPDATE_MODE_ADD_GRADIENT;
   } else {
@@ -407,7 +408,8 @@ void ConcurrentRemoteParameterUpdater::send(Parameter* para) {
   const std::string& algorithm = config_.algorithm();
   ParameterUpdateMode mode;
   if (algorithm == TrainAlgorithm::AsyncSGD) {
-    mode = PSERVER_UPDATE_MODE_ASYNC_SGD;
+    mode = config_.ssp_staleness() >= 0 ? PSERVER_UPDATE_MODE_SSP_SGD
+                                        : PSERVER_UPDATE_MODE_ASYNC_SGD;
   } else if (algorithm == TrainAlgorithm::SGD) {
     mode = PSERVER_UPDATE_MODE_ADD_GRADIENT;
   } else {
@@ -669,7 +671,8 @@ void SparseRemoteParameterUpdater::finishBatch(real cost) {
   const std::string& algorithm = config_.algorithm();
   ParameterUpdateMode mode;
   if (algorithm == TrainAlgorithm::AsyncSGD) {
-    mode = PSERVER_UPDATE_MODE_ASYNC_SGD;
+    mode = config_.ssp_staleness() >= 0 ? PSERVER_UPDATE_MODE_SSP_SGD
+                                        : PSERVER_UPDATE_MODE_ASYNC_SGD;
   } else if (algorithm == TrainAlgorithm::SGD) {
     mode = PSERVER_UPDATE_MODE_ADD_GRADIENT;
   } else {
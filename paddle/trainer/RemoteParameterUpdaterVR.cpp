@@ -19,11 +19,18 @@ limitations under the License. */
 
 namespace paddle {
 
+static const hl_stream_t kDeviceToHostStream = HPPL_STREAM_1;
+
 VRRemoteParameterUpdater::VRRemoteParameterUpdater(
-    OptimizationConfig config, int passCount)
-    : RemoteParameterUpdater(config, passCount) {
+    OptimizationConfig config, int passCount, bool pipelined)
+    : RemoteParameterUpdater(config, passCount),
+      phase_(kFullGradient),
+      pipelined_(pipelined),
+      numPendingSends_(0) {
   addParameterType(PARAMETER_GRADIENT_SUM);
   addParameterType(PARAMETER_SNAPSHOT_VALUE);
+  // the send threads of the client pipeline the per parameter sends
+  separateSendAndRecv_ = pipelined;
 }
 
 void VRRemoteParameterUpdater::init(std::vector<ParameterPtr>& parameters) {
@@ -40,6 +47,7 @@ void VRRemoteParameterUpdater::init(std::vector<ParameterPtr>& parameters) {
       cpuParameters_.back()->enableType(PARAMETER_SNAPSHOT_VALUE);
     }
   }
+  sent_.resize(parameters_.size(), false);
 
   parameterClient_.reset(new ParameterClient2(separateSendAndRecv_));
   parameterClient_->init(cpuParameters_);
@@ -63,11 +71,17 @@ void VRRemoteParameterUpdater::controller() {
   CHECK_EQ(config_.algorithm(), TrainAlgorithm::SVRG) << "SVRG not supported";
   ParameterClient2 client(false);
   client.init(cpuParameters_);
+  bool firstPass = true;
   while (true) {
     /*start pass for full gradient*/ {
       client.waitPassStart();
 
       PreparedOperations ops;
+      if (config_.async_svrg() && !firstPass) {
+        // finish the last inner pass
+        ops.addOperation(PSERVER_OP_FINISH_PASS);
+      }
+      firstPass = false;
       ops.addOperation(PSERVER_OP_START_PASS);
       client.doOperation(ops,
                          /* waitForGradient= */ false,
@@ -84,6 +98,16 @@ void VRRemoteParameterUpdater::controller() {
        client.doOperation(ops, true, true, false);
     }
 
+    if (config_.async_svrg()) {
+      // The trainers send the gradients of the inner pass without this
+      // controller. The next waitPassStart() returns after all of them
+      // finish the inner pass.
+      if (++passCount_ == expectedPassCount_) {
+        break;
+      }
+      continue;
+    }
+
     /*start pass for each mini-batch*/ {
       client.waitPassStart();
 
@@ -93,7 +117,7 @@ void VRRemoteParameterUpdater::controller() {
     }
     while (true) {
       PreparedOperations ops;
-      ops.addOperation(PSERVER_OP_SGD);
+      ops.addOperation(PSERVER_OP_SVRG);
       client.doOperation(ops, true, true, false);
       if (client.isPassFinish()) {
         break;
@@ -112,17 +136,75 @@ void VRRemoteParameterUpdater::controller() {
   }
 }
 
+void VRRemoteParameterUpdater::updateImpl(Parameter* para) {
+  if (!pipelined_ || getUpdateMode() != PSERVER_UPDATE_MODE_ADD_GRADIENT ||
+      para->getConfig().sparse_remote_update() || para->isGradSparseUpdate()) {
+    // asynchronous pservers take every request as a step, so the inner pass
+    // of async_svrg still sends all the gradients in finishBatch()
+    return;
+  }
+  REGISTER_TIMER("update");
+  size_t pid = nonStaticParaIDMap_[para->getID()];
+  std::lock_guard<std::mutex> guard(sendMutex_);
+  if (FLAGS_use_gpu) {
+    SetDevice device(para->getDeviceId());
+    REGISTER_TIMER("copySingleParaFromDevice");
+    cpuParameters_[pid]
+        ->getBuf(PARAMETER_GRADIENT)
+        ->copyFrom(*para->getBuf(PARAMETER_GRADIENT), kDeviceToHostStream);
+    hl_stream_synchronize(kDeviceToHostStream);
+  }
+  std::vector<ParameterSegments> segments(1);
+  segments[0].name = para->getName();
+  segments[0].id = para->getID();
+  parameterClient_->sendParameter(PSERVER_UPDATE_MODE_ADD_GRADIENT,
+                                  PARAMETER_GRADIENT, segments, batchSize_,
+                                  0,     // cost = 0
+                                  true,  // sendBackParameter
+                                  batchStatus_);
+  batchStatus_ = BATCH_ON;
+  sent_[pid] = true;
+  ++numPendingSends_;
+}
+
 void VRRemoteParameterUpdater::finishBatch(real cost) {
   CHECK_EQ(config_.algorithm(), TrainAlgorithm::SVRG) << "SVRG not supported";
-  copyParametersFromDevice(PARAMETER_GRADIENT);
+  ParameterUpdateMode mode = getUpdateMode();
 
-  {
+  if (numPendingSends_ == 0) {
+    copyParametersFromDevice(PARAMETER_GRADIENT);
     REGISTER_TIMER("sendAndRecv_dense");
-    parameterClient_->sendAndReceiveParameter(PSERVER_UPDATE_MODE_ADD_GRADIENT,
+    parameterClient_->sendAndReceiveParameter(mode,
                                               PARAMETER_GRADIENT, // sendType
                                               batchSize_,
                                               0,  // cost = 0
-                                              true // sendBackParameter);
+                                              true);  // sendBackParameter
+  } else {
+    // the parameters without gradient callback are sent with the last request
+    std::vector<ParameterSegments> segments;
+    for (size_t pid = 0; pid < parameters_.size(); ++pid) {
+      if (sent_[pid]) {
+        sent_[pid] = false;
+        continue;
+      }
+      auto& para = parameters_[pid];
+      if (FLAGS_use_gpu) {
+        cpuParameters_[pid]
+            ->getBuf(PARAMETER_GRADIENT)
+            ->copyFrom(*para->getBuf(PARAMETER_GRADIENT));
+      }
+      segments.push_back({para->getName(), para->getID()});
+    }
+    REGISTER_TIMER("sendAndRecv_dense");
+    parameterClient_->sendParameter(mode, PARAMETER_GRADIENT, segments,
+                                    batchSize_,
+                                    0,     // cost = 0
+                                    true,  // sendBackParameter
+                                    BATCH_FINISH);
+    for (; numPendingSends_ >= 0; --numPendingSends_) {
+      parameterClient_->recvParameter();
+    }
+    numPendingSends_ = 0;
   }
 
   copyParametersToDevice(PARAMETER_VALUE);
@@ -135,12 +217,21 @@ void VRRemoteParameterUpdater::finishBatch(real cost) {
 
 void VRRemoteParameterUpdater::startPass() {
   CHECK_EQ(config_.algorithm(), TrainAlgorithm::SVRG) << "SVRG not supported";
-  parameterClient_->waitPassStart();
+  if (config_.async_svrg() && phase_ == kInnerLoop) {
+    parameterClient_->asyncStartPass();
+  } else {
+    parameterClient_->waitPassStart();
+  }
 }
 
 bool VRRemoteParameterUpdater::finishPass(real cost) {
   CHECK_EQ(config_.algorithm(), TrainAlgorithm::SVRG) << "SVRG not supported";
-  parameterClient_->waitPassFinish();
+  if (config_.async_svrg()) {
+    // all the trainers get the same w_s for the next full gradient pass
+    parameterClient_->asyncFinishPass();
+  } else {
+    parameterClient_->waitPassFinish();
+  }
   parameterClient_->getParameter();
   copyParametersToDevice(PARAMETER_VALUE);
 
@@ -14,6 +14,7 @@ limitations under the License. */
 
 #pragma once
 
+#include <mutex>
 #include <thread>
 #include "paddle/pserver/ParameterClient2.h"
 #include "ParameterUpdater.h"
@@ -22,16 +23,66 @@ limitations under the License. */
 
 namespace paddle {
 
+/**
+ * Remote updater for SVRG.
+ *
+ * Every outer iteration has a full gradient pass and an inner pass. The
+ * full gradient is always aggregated synchronously into
+ * PARAMETER_GRADIENT_SUM of the pservers. If async_svrg is set, the inner
+ * pass sends the variance reduced gradients like async_sgd, and the
+ * pservers discard the too lagged ones.
+ *
+ * If pipelined, the synchronous inner pass sends the gradient of each dense
+ * parameter as soon as backward calls update() on it, so the transfer
+ * overlaps with the backward of the lower layers. The pservers hold the
+ * responses until the gradients of all trainers are added, and
+ * finishBatch() sends the rest of the parameters and receives the updated
+ * values of all of them.
+ */
 class VRRemoteParameterUpdater : public RemoteParameterUpdater {
 public:
-  VRRemoteParameterUpdater(OptimizationConfig config, int expectedPassCount);
+  VRRemoteParameterUpdater(OptimizationConfig config, int expectedPassCount,
+                           bool pipelined = false);
+
+  /// the passes of an outer iteration
+  enum Phase {
+    /// the full gradient at w_s, always aggregated synchronously
+    kFullGradient,
+    /// the variance reduced steps from w_s
+    kInnerLoop,
+  };
 
   virtual void init(std::vector<ParameterPtr>& parameters);
   virtual void finishBatch(real cost);
   virtual void startPass();
   virtual bool finishPass(real cost);
+
+  /// the phase of the next pass, set by the trainer before startPass()
+  void setPhase(Phase phase) { phase_ = phase; }
+
 protected:
   virtual void controller();
+
+  /// send the gradient of para if pipelined
+  virtual void updateImpl(Parameter* para);
+
+  /// the update mode of the current batch
+  ParameterUpdateMode getUpdateMode() const {
+    return config_.async_svrg() && phase_ == kInnerLoop
+               ? PSERVER_UPDATE_MODE_ASYNC_SGD
+               : PSERVER_UPDATE_MODE_ADD_GRADIENT;
+  }
+
+  /// the phase of the current pass
+  Phase phase_;
+  /// send the gradients during backward
+  bool pipelined_;
+  /// guard the sends, update() may be called by several gradient threads
+  std::mutex sendMutex_;
+  /// the parameters sent by updateImpl() in this batch, indexed by pid
+  std::vector<bool> sent_;
+  /// number of sendParameter() waiting for recvParameter()
+  int numPendingSends_;
 };
 
 }  // namespace paddle
@@ -0,0 +1,194 @@
+/* Copyright (c) 2016 Baidu, Inc. All Rights Reserve.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+
+#include "SnapshotGradientCache.h"
+
+#include <string.h>
+#include <limits>
+
+#include "paddle/math/SIMDFunctions.h"
+#include "paddle/utils/Logging.h"
+#include "paddle/utils/Stat.h"
+
+namespace paddle {
+
+namespace {
+
+/// Size of the arena chunks, several batches share one chunk.
+const size_t kChunkBytes = 64UL * 1024 * 1024;
+
+const size_t kNotCached = std::numeric_limits<size_t>::max();
+
+}  // namespace
+
+SnapshotGradientCache::SnapshotGradientCache(
+    const std::vector<ParameterPtr>& parameters, size_t budgetBytes,
+    bool useFp16)
+    : parameters_(parameters),
+      budgetBytes_(budgetBytes),
+      useFp16_(useFp16),
+      elemBytes_(useFp16 ? sizeof(uint16_t) : sizeof(real)),
+      numCachedParameters_(0),
+      bytesPerBatch_(0),
+      full_(false) {
+  CHECK(isSupported(parameters_));
+  size_t maxSize = 0;
+  bool useGpu = false;
+  for (auto& para : parameters_) {
+    size_t id = para->getID();
+    if (offsets_.size() <= id) {
+      offsets_.resize(id + 1, kNotCached);
+    }
+    if (para->isStatic()) continue;
+    offsets_[id] = bytesPerBatch_;
+    // keep every parameter 16 bytes aligned in the block
+    bytesPerBatch_ += (para->getSize() * elemBytes_ + 15) & ~(size_t)15;
+    ++numCachedParameters_;
+    maxSize = std::max(maxSize, para->getSize());
+    useGpu = useGpu || para->useGpu();
+  }
+  CHECK_GT(bytesPerBatch_, 0UL) << "no gradient to cache";
+  batchesPerChunk_ = std::max(kChunkBytes / bytesPerBatch_, (size_t)1);
+  cpuBuffer_ = Vector::create(maxSize, false);
+  if (useGpu) {
+    deviceBuffer_ = Vector::create(maxSize, true);
+  }
+  LOG(INFO) << "snapshot gradient cache: " << bytesPerBatch_
+            << " bytes per batch, budget " << budgetBytes_ << " bytes, "
+            << (useFp16_ ? "fp16" : "real");
+}
+
+bool SnapshotGradientCache::isSupported(
+    const std::vector<ParameterPtr>& parameters) {
+  for (auto& para : parameters) {
+    if (para->isStatic()) continue;
+    if (!para->getBuf(PARAMETER_GRADIENT) || para->isGradSparseUpdate() ||
+        para->isSparse()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void SnapshotGradientCache::clear() {
+  batches_.clear();
+  full_ = false;
+}
+
+SnapshotGradientCache::Batch* SnapshotGradientCache::getBatchForStore(
+    int64_t batchId, int64_t batchSize) {
+  if (full_) return nullptr;
+  if (batchId + 1 == (int64_t)batches_.size()) {
+    return &batches_.back();
+  }
+  CHECK_EQ(batchId, (int64_t)batches_.size())
+      << "batches must be stored in order";
+  if (bytesPerBatch_ * (batches_.size() + 1) > budgetBytes_) {
+    full_ = true;
+    LOG(INFO) << "snapshot gradient cache is full after " << batches_.size()
+              << " batches, the rest will be recomputed";
+    return nullptr;
+  }
+
+  size_t chunkId = batches_.size() / batchesPerChunk_;
+  size_t indexInChunk = batches_.size() % batchesPerChunk_;
+  if (chunkId == chunks_.size()) {
+    size_t maxBatches = budgetBytes_ / bytesPerBatch_;
+    size_t numBatches = std::min(batchesPerChunk_,
+                                 maxBatches - chunkId * batchesPerChunk_);
+    chunks_.emplace_back(new char[numBatches * bytesPerBatch_]);
+  }
+  batches_.push_back(Batch{chunks_[chunkId].get() +
+                               indexInChunk * bytesPerBatch_,
+                           batchSize, 0});
+  return &batches_.back();
+}
+
+void SnapshotGradientCache::store(int64_t batchId, int64_t batchSize,
+                                  Parameter* para) {
+  size_t offset = offsets_[para->getID()];
+  CHECK_NE(offset, kNotCached) << para->getName();
+  Batch* batch = nullptr;
+  {
+    // the callbacks of different parameters may come from different threads
+    std::lock_guard<std::mutex> guard(lock_);
+    batch = getBatchForStore(batchId, batchSize);
+  }
+  if (!batch) return;
+  CHECK_EQ(batch->batchSize, batchSize);
+
+  const VectorPtr& grad = para->getBuf(PARAMETER_GRADIENT);
+  size_t size = para->getSize();
+  std::unique_lock<std::mutex> bufferGuard(bufferLock_, std::defer_lock);
+  const real* src = grad->getData();
+  if (para->useGpu()) {
+    bufferGuard.lock();
+    cpuBuffer_->subVec(0, size)->copyFrom(*grad);
+    src = cpuBuffer_->getData();
+  }
+  if (useFp16_) {
+    uint16_t* dst = reinterpret_cast<uint16_t*>(batch->data + offset);
+    for (size_t i = 0; i < size; ++i) {
+      dst[i] = simd::floatToHalf(src[i]);
+    }
+  } else {
+    memcpy(batch->data + offset, src, size * sizeof(real));
+  }
+
+  std::lock_guard<std::mutex> guard(lock_);
+  ++batch->numStored;
+}
+
+bool SnapshotGradientCache::contains(int64_t batchId,
+                                     int64_t batchSize) const {
+  return batchId < (int64_t)batches_.size() &&
+         batches_[batchId].numStored == numCachedParameters_ &&
+         batches_[batchId].batchSize == batchSize;
+}
+
+void SnapshotGradientCache::subtractFrom(int64_t batchId, Parameter* para) {
+  REGISTER_TIMER("subtractSnapshotGrad");
+  size_t offset = offsets_[para->getID()];
+  CHECK_NE(offset, kNotCached) << para->getName();
+  CHECK_LT(batchId, (int64_t)batches_.size());
+  const char* data = batches_[batchId].data + offset;
+
+  const VectorPtr& grad = para->getBuf(PARAMETER_GRADIENT);
+  size_t size = para->getSize();
+  const uint16_t* halfs = reinterpret_cast<const uint16_t*>(data);
+  const real* reals = reinterpret_cast<const real*>(data);
+  if (!para->useGpu()) {
+    // decompress and subtract in one pass
+    real* dst = grad->getData();
+    if (useFp16_) {
+      for (size_t i = 0; i < size; ++i) dst[i] -= simd::halfToFloat(halfs[i]);
+    } else {
+      for (size_t i = 0; i < size; ++i) dst[i] -= reals[i];
+    }
+    return;
+  }
+
+  std::lock_guard<std::mutex> guard(bufferLock_);
+  if (useFp16_) {
+    real* buf = cpuBuffer_->getData();
+    for (size_t i = 0; i < size; ++i) buf[i] = simd::halfToFloat(halfs[i]);
+    reals = buf;
+  }
+  VectorPtr cached = deviceBuffer_->subVec(0, size);
+  cached->copyFrom(reals, size);
+  grad->sub(*cached);
+}
+
+}  // namespace paddle
@@ -0,0 +1,108 @@
+/* Copyright (c) 2016 Baidu, Inc. All Rights Reserve.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "paddle/parameter/Parameter.h"
+#include "paddle/utils/DisableCopy.h"
+
+namespace paddle {
+
+/**
+ * @brief Per mini-batch cache of the snapshot gradients \partial f_b(w_s).
+ *
+ * The gradients are stored while calculating the full gradient, and used by
+ * the inner loop of SVRG instead of doing a second forward/backward at w_s.
+ * Batch ids of the two passes line up because the data provider does not
+ * shuffle between them.
+ *
+ * Every batch takes one fixed size block (real or fp16 per element) from a
+ * chunked arena. Batches which do not fit into the byte budget are not
+ * cached, and the caller should recompute the snapshot gradient for them.
+ */
+class SnapshotGradientCache {
+public:
+  /**
+   * @param parameters   parameters to cache, indexed by parameter id.
+   * @param budgetBytes  max bytes used by the cached gradients.
+   * @param useFp16      store gradients as fp16 instead of real.
+   */
+  SnapshotGradientCache(const std::vector<ParameterPtr>& parameters,
+                        size_t budgetBytes, bool useFp16);
+
+  /// Whether the gradients of all the parameters can be cached.
+  static bool isSupported(const std::vector<ParameterPtr>& parameters);
+
+  /// Drop all cached batches. The memory of the arena is kept.
+  void clear();
+
+  /**
+   * Store PARAMETER_GRADIENT of para as the snapshot gradient of batch
+   * batchId. Batch ids must be stored in increasing order.
+   */
+  void store(int64_t batchId, int64_t batchSize, Parameter* para);
+
+  /// Whether all the snapshot gradients of batch batchId are cached.
+  bool contains(int64_t batchId, int64_t batchSize) const;
+
+  /// PARAMETER_GRADIENT -= cached \partial f_b(w_s) of para
+  void subtractFrom(int64_t batchId, Parameter* para);
+
+  size_t getNumCachedBatches() const { return batches_.size(); }
+
+  size_t getUsedBytes() const { return batches_.size() * bytesPerBatch_; }
+
+private:
+  struct Batch {
+    char* data;
+    int64_t batchSize;
+    size_t numStored;
+  };
+
+  /// find or allocate the block of batch batchId, nullptr if over budget
+  Batch* getBatchForStore(int64_t batchId, int64_t batchSize);
+
+  std::vector<ParameterPtr> parameters_;
+  size_t budgetBytes_;
+  bool useFp16_;
+  size_t elemBytes_;
+
+  /// byte offset of each parameter in the block of a batch
+  std::vector<size_t> offsets_;
+  size_t numCachedParameters_;
+  size_t bytesPerBatch_;
+
+  std::vector<std::unique_ptr<char[]>> chunks_;
+  size_t batchesPerChunk_;
+  std::vector<Batch> batches_;
+  bool full_;
+  /// guards batches_ and full_
+  std::mutex lock_;
+
+  /// host buffer to compress from / decompress to
+  VectorPtr cpuBuffer_;
+  /// device buffer for gpu parameters
+  VectorPtr deviceBuffer_;
+  /// guards cpuBuffer_ and deviceBuffer_
+  std::mutex bufferLock_;
+
+  DISABLE_COPY(SnapshotGradientCache);
+};
+
+}  // namespace paddle
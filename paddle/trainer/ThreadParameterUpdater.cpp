@@ -107,6 +107,42 @@ void SgdThreadUpdater::threadTraverse(
   }
 }
 
+void SgdThreadUpdater::threadTraverseBatchRows(
+    const ParameterOptimizer::TraverseCallback& callback, int tid,
+    size_t numThreads, Parameter* para) {
+  VectorPtr* vecs = Parameter::getTlsTempBufs();
+  size_t width = para->getConfig().dims(1);
+
+  if (auto mainMat = dynamic_cast<SparseRowIdsCpuMatrix*>(
+          para->getMat(PARAMETER_GRADIENT).get())) {
+    // From MultiGradientMachine
+    for (auto id : mainMat->getIds(tid)) {
+      for (auto type : parameterTypes_) {
+        vecs[type]->subVecFrom(*para->getBuf(type), id * width, width);
+      }
+      callback(vecs, para->getConfig(), id);
+    }
+  } else if (auto mainMat = dynamic_cast<SparseRowCpuMatrix*>(
+                 para->getMat(PARAMETER_GRADIENT).get())) {
+    // From NeuralNetwork
+    std::vector<unsigned int>& localIndices =
+        mainMat->getIndexDictHandle()->localIndices;
+    auto interval =
+        calcSplitArrayInterval(localIndices.size(), tid, numThreads);
+    for (size_t i = interval.first; i < interval.second; ++i) {
+      auto id = localIndices[i];
+      for (auto type : parameterTypes_) {
+        if (type == PARAMETER_GRADIENT) {
+          vecs[type]->subVecFrom(mainMat->getLocalRow(i), 0, width);
+        } else {
+          vecs[type]->subVecFrom(*para->getBuf(type), id * width, width);
+        }
+      }
+      callback(vecs, para->getConfig(), id);
+    }
+  }
+}
+
 void SgdThreadUpdater::traverse(GetTraverseCallback getTraverseCallback) {
   bool hasCpuPara = false;
   bool hasGpuPara = false;
@@ -156,6 +192,28 @@ void SgdThreadUpdater::catchUpWith() {
   }
 }
 
+void SgdThreadUpdater::catchUpBatchRows() {
+  bool hasCallback = false;
+  std::vector<ParameterOptimizer::TraverseCallback> callbacks(
+      optimizers_.size());
+  for (auto& para : parameters_) {
+    if (para->isGradSparseUpdate()) {
+      int pid = para->getID();
+      callbacks[pid] = optimizers_[pid]->needCatchUpBeforeForward();
+      hasCallback = hasCallback || callbacks[pid];
+    }
+  }
+  if (!hasCallback) return;
+
+  getGlobalSyncThreadPool()->exec([&](int tid, size_t numThreads) {
+    for (auto& para : parameters_) {
+      if (auto& callback = callbacks[para->getID()]) {
+        threadTraverseBatchRows(callback, tid, numThreads, para.get());
+      }
+    }
+  });
+}
+
 void SgdThreadUpdater::apply() {
   catchUpWith();
 
@@ -58,6 +58,9 @@ public:
   // Call finishBatch for each optimizer.
   virtual void finishBatch(real cost);
   virtual void catchUpWith();
+  // Catch up with the rows in the gradients of the sparse parameters,
+  // which are registered by GradientMachine::prefetch().
+  virtual void catchUpBatchRows();
   virtual void apply();
   virtual void restore();
 
@@ -79,6 +82,10 @@ protected:
   // The update function for after update operations, such as averager.
   void threadTraverse(const ParameterOptimizer::TraverseCallback& callback,
                       int tid, size_t numThreads, Parameter* para);
+  // Same as threadTraverse(), but only over the rows of the sparse gradient.
+  void threadTraverseBatchRows(
+      const ParameterOptimizer::TraverseCallback& callback, int tid,
+      size_t numThreads, Parameter* para);
   typedef std::function<const ParameterOptimizer::TraverseCallback(Parameter*)>
     GetTraverseCallback;
   void traverse(GetTraverseCallback getTraverseCallback);
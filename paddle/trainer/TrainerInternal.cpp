@@ -34,6 +34,7 @@ limitations under the License. */
 
 #include "ThreadParameterUpdater.h"
 #include "RemoteParameterUpdater.h"
+#include "AllReduceParameterUpdater.h"
 
 namespace paddle {
 
@@ -219,7 +220,16 @@ void TrainerInternal::createParameterUpdater(bool testing) {
                             intconfig_->num_passes));
   if (parameterUpdater_) { return; }
 
-  if (!intconfig_->local) {
+  if (!intconfig_->local && intconfig_->use_allreduce) {
+    CHECK(alg == TrainAlgorithm::SGD)
+        << "Unsupported algorithm with allreduce: " << alg;
+    CHECK_EQ(config_->getOptConfig().num_batches_per_send_parameter(), 1)
+        << "num_batches_per_send_parameter should be one with allreduce!";
+    // all the parameters are local, testing joins no ring
+    parameterUpdater_.reset(
+        testing ? new SgdLocalUpdater(config_->getOptConfig())
+                : new AllReduceParameterUpdater(config_->getOptConfig()));
+  } else if (!intconfig_->local) {
     if (testing && config_->getOptConfig().use_sparse_remote_updater()) {
       std::unique_ptr<ParameterUpdater> localUpdater;
       localUpdater.reset(
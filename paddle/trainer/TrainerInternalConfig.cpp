@@ -21,6 +21,10 @@ P_DEFINE_int32(dot_period, 1, "Print '.' every so many batches");
 
 P_DEFINE_bool(use_old_updater, false, "Use the old RemoteParameterUpdater");
 
+P_DEFINE_bool(use_allreduce, false,
+              "Sum the gradients among the trainers with ring allreduce "
+              "instead of pservers in cluster mode");
+
 P_DECLARE_int32(num_passes);
 
 P_DECLARE_bool(local);
@@ -40,6 +44,7 @@ std::unique_ptr<TrainerInternalConfig> TrainerInternalConfig::createFromMode(
   config->dot_period = FLAGS_dot_period;
   config->num_passes = FLAGS_num_passes;
   config->use_old_updater = FLAGS_use_old_updater;
+  config->use_allreduce = FLAGS_use_allreduce;
   config->loadsave_parameters_in_pserver = FLAGS_loadsave_parameters_in_pserver;
 
   return std::unique_ptr<TrainerInternalConfig>(config);
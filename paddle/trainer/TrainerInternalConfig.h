@@ -224,6 +224,11 @@ struct TrainerInternalConfig {
    */
   bool use_old_updater;
 
+  /**
+   * use AllReduceParameterUpdater instead of pservers
+   */
+  bool use_allreduce;
+
   /**
    * whether to load and save parameter in pserver
    */
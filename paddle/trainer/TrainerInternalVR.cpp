@@ -31,12 +31,61 @@ limitations under the License. */
 #include "paddle/utils/GlobalConstants.h"
 #include "paddle/gserver/gradientmachines/NeuralNetwork.h"
 #include "paddle/gserver/layers/ValidationLayer.h"
+#include "paddle/math/SparseRowMatrix.h"
 
 #include "ThreadParameterUpdater.h"
 #include "RemoteParameterUpdaterVR.h"
 
+P_DEFINE_bool(svrg_paired_evaluation, true,
+              "Evaluate the snapshot and current parameters side by side "
+              "in one pass instead of swapping parameter buffers, "
+              "if the gradient machine supports it");
+P_DEFINE_int32(svrg_grad_cache_mb, 0,
+               "Memory budget in MB for caching the snapshot gradient of "
+               "each batch during the full gradient pass, "
+               "0 means recomputing it in every batch");
+P_DEFINE_bool(svrg_grad_cache_fp16, true,
+              "Store the cached snapshot gradients as fp16");
+P_DEFINE_int32(svrg_full_grad_threads, 0,
+               "Number of threads computing the full gradient of SVRG "
+               "on different batches in parallel, 0 means trainer_count");
+P_DEFINE_bool(svrg_pipelined_update, false,
+              "Send the gradient of each dense parameter to the pservers "
+              "during backward in the synchronous inner pass of SVRG");
+
 namespace paddle {
 
+namespace {
+
+/**
+ * Calls func(rowId, gradRow) for the rows in the sparse gradient of para.
+ * @return false if the gradient of para is dense
+ */
+bool forEachSparseGradRow(Parameter* para,
+                          const std::function<void(size_t, real*)>& func) {
+  Matrix* mat = para->getMat(PARAMETER_GRADIENT).get();
+  if (auto rowMat = dynamic_cast<SparseRowCpuMatrix*>(mat)) {
+    // from NeuralNetwork
+    auto& localIndices = rowMat->getLocalIndices();
+    for (size_t i = 0; i < localIndices.size(); ++i) {
+      func(localIndices[i], rowMat->getLocalRow(i));
+    }
+    return true;
+  }
+  if (auto idsMat = dynamic_cast<SparseRowIdsCpuMatrix*>(mat)) {
+    // from MultiGradientMachine, rows are merged into the dense buffer
+    for (size_t tid = 0; tid < idsMat->getNumOfThreads(); ++tid) {
+      for (auto id : idsMat->getIds(tid)) {
+        func(id, idsMat->rowBuf(id));
+      }
+    }
+    return true;
+  }
+  return false;
+}
+
+}  // namespace
+
 void TrainerInternalVR::init(const std::shared_ptr<TrainerConfigHelper> &config,
                            const GradientMachinePtr &gradientMachine,
                            std::unique_ptr<TrainerInternalConfig> &&intconfig,
@@ -53,6 +102,52 @@ void TrainerInternalVR::init(const std::shared_ptr<TrainerConfigHelper> &config,
         config_->getConfig().model_config(), intconfig_->mode,
         parameterUpdater_->getParameterTypes()));
     }
+    pairedEvaluation_ = FLAGS_svrg_paired_evaluation &&
+                        gradientMachine_->initPairedEvaluation();
+
+    bool subsampled = config_->getOptConfig().svrg_snapshot_batches() > 0;
+    if (subsampled) {
+      // g is rescaled to the average over the subset on the trainer side
+      CHECK(intconfig_->local)
+          << "svrg_snapshot_batches is only supported in local mode";
+    }
+
+    if (FLAGS_svrg_grad_cache_mb > 0) {
+      auto& parameters = gradientMachine_->getParameters();
+      if (subsampled) {
+        LOG(WARNING) << "snapshot gradient cache is not used with "
+                     << "svrg_snapshot_batches, the inner loop runs on "
+                     << "different batches";
+      } else if (!intconfig_->local) {
+        LOG(WARNING) << "snapshot gradient cache is only for local mode";
+      } else if (!SnapshotGradientCache::isSupported(parameters)) {
+        LOG(WARNING) << "snapshot gradient cache does not support "
+                     << "sparse gradients";
+      } else {
+        gradCache_.reset(new SnapshotGradientCache(
+            parameters, (size_t)FLAGS_svrg_grad_cache_mb << 20,
+            FLAGS_svrg_grad_cache_fp16));
+      }
+    }
+
+    int numThreads = FLAGS_svrg_full_grad_threads > 0
+                         ? FLAGS_svrg_full_grad_threads
+                         : FLAGS_trainer_count;
+    if (numThreads > 1) {
+      auto& parameters = gradientMachine_->getParameters();
+      if (!intconfig_->local || gradCache_) {
+        // the gradient of every batch is needed
+        LOG(INFO) << "full gradient is computed batch by batch";
+      } else if (FLAGS_parallel_nn ||
+                 !FullGradientEngine::isSupported(parameters)) {
+        LOG(WARNING) << "full gradient engine only supports dense "
+                     << "cpu parameters";
+      } else {
+        fullGradEngine_.reset(new FullGradientEngine(
+            config_->getConfig().model_config(), parameters, numThreads,
+            intconfig_->log_period));
+      }
+    }
 }
 
 void TrainerInternalVR::calcGradOneBatch(int64_t batchId,
@@ -65,14 +160,42 @@ void TrainerInternalVR::calcGradOneBatch(int64_t batchId,
   std::vector<Argument> outArgs;
   const std::vector<Argument>& inArgs = dataBatch.getStreams();
 
+  if (gradCache_ && batchId == 0) {
+    gradCache_->clear();
+  }
+
   std::vector<ParaStat> paraStats;
   paraStats.resize(gradientMachine_->getParameters().size());
   UpdateCallback updateCallback =
-      [this, &paraStats](Parameter* para) {
+      [this, &paraStats, batchId, actualBatchSize](Parameter* para) {
+    if (para->isGradSparseUpdate()) {
+      if (intconfig_->local) {
+        // accumulate the rows in the batch only
+        real* gradSum = para->getBuf(PARAMETER_GRADIENT_SUM)->getData();
+        size_t width = para->getConfig().dims(1);
+        forEachSparseGradRow(para, [gradSum, width](size_t id, real* row) {
+          real* sum = gradSum + id * width;
+          for (size_t j = 0; j < width; ++j) {
+            sum[j] += row[j];
+            row[j] = 0;
+          }
+        });
+        if (dynamic_cast<SparseRowCpuMatrix*>(
+                para->getMat(PARAMETER_GRADIENT).get())) {
+          // drop the rows
+          para->clearGradient();
+        }
+      }
+      return;
+    }
     auto& grad = para->getBuf(PARAMETER_GRADIENT);
     paraStats[para->getID()].avgAbsGrad = grad->getAbsSum() / para->getSize();
     paraStats[para->getID()].maxAbsGrad = grad->getAbsMax();
     if (intconfig_->local) {
+      if (gradCache_) {
+        // keep \partial f_b(w_s) for trainOneBatch
+        gradCache_->store(batchId, actualBatchSize, para);
+      }
       // accumulate gradients
       para->getBuf(PARAMETER_GRADIENT_SUM)->add(
                 *para->getBuf(PARAMETER_GRADIENT));
@@ -110,11 +233,22 @@ void TrainerInternalVR::trainOneBatch(int64_t batchId,
 
   PassType passType = parameterUpdater_->startBatch(actualBatchSize);
 
+  if (intconfig_->local) {
+    REGISTER_TIMER("catchUpBatchRows");
+    // the lazily updated sparse rows of the batch are brought up to w_t,
+    // so that \partial f_b(w_t) is computed at the actual values
+    gradientMachine_->prefetch(inArgs);
+    parameterUpdater_->catchUpBatchRows();
+  }
+
   UpdateCallback updateCallback =
       [this, &paraStats](Parameter* para) {
-    auto& grad = para->getBuf(PARAMETER_GRADIENT);
-    paraStats[para->getID()].avgAbsGrad = grad->getAbsSum() / para->getSize();
-    paraStats[para->getID()].maxAbsGrad = grad->getAbsMax();
+    if (!para->isGradSparseUpdate()) {
+      auto& grad = para->getBuf(PARAMETER_GRADIENT);
+      paraStats[para->getID()].avgAbsGrad =
+          grad->getAbsSum() / para->getSize();
+      paraStats[para->getID()].maxAbsGrad = grad->getAbsMax();
+    }
     parameterUpdater_->update(para);
   };
 
@@ -124,18 +258,42 @@ void TrainerInternalVR::trainOneBatch(int64_t batchId,
     timer.start();
 #endif
     REGISTER_TIMER("forwardBackward for Variance Reduction");
-    // w <- snapshot w_s , P_SNAPSHOT_VALUE -> P_VALUE
-    swapParameter();  // SNAPSHOT <-> VALUE
-    // \partial f_b(w_s)
-    gradientMachine_->forwardBackward(
-            inArgs, &outArgs, passType, nullptr);
-    negGradients();
-
-    // w <- w_t, P_VALUE -> P_SNAPSHOT_VALUE
-    swapParameter();  // SNAPSHOT <-> VALUE
-    // g = \partial f_b(w_t) - \partial f_b(w_s)
-    gradientMachine_->forwardBackward(
-            inArgs, &outArgs, passType, updateCallback);
+    if (gradCache_ && gradCache_->contains(batchId, actualBatchSize)) {
+      // g = \partial f_b(w_t) - cached \partial f_b(w_s)
+      UpdateCallback cachedCallback =
+          [this, batchId, &updateCallback](Parameter* para) {
+        gradCache_->subtractFrom(batchId, para);
+        updateCallback(para);
+      };
+      gradientMachine_->forwardBackward(
+              inArgs, &outArgs, passType, cachedCallback);
+    } else if (pairedEvaluation_) {
+      // g = \partial f_b(w_t) - \partial f_b(w_s), in a single pass
+      gradientMachine_->forwardBackwardPaired(
+              inArgs, &outArgs, passType, updateCallback);
+    } else {
+      // w <- snapshot w_s , P_SNAPSHOT_VALUE -> P_VALUE
+      swapParameter();  // SNAPSHOT <-> VALUE
+      // -\partial f_b(w_s), negated as soon as the gradient of a parameter
+      // is merged, MultiGradientMachine does it in its gradient threads
+      UpdateCallback negCallback = [](Parameter* para) {
+        if (!forEachSparseGradRow(para, [para](size_t id, real* row) {
+              for (size_t j = 0; j < para->getConfig().dims(1); ++j) {
+                row[j] = -row[j];
+              }
+            })) {
+          para->getBuf(PARAMETER_GRADIENT)->neg();
+        }
+      };
+      gradientMachine_->forwardBackward(
+              inArgs, &outArgs, passType, negCallback);
+
+      // w <- w_t, P_VALUE -> P_SNAPSHOT_VALUE
+      swapParameter();  // SNAPSHOT <-> VALUE
+      // g = \partial f_b(w_t) - \partial f_b(w_s)
+      gradientMachine_->forwardBackward(
+              inArgs, &outArgs, passType, updateCallback);
+    }
 
 #ifndef PADDLE_DISABLE_TIMER
     timer.stop();
@@ -182,11 +340,7 @@ void TrainerInternalVR::trainOneBatch(int64_t batchId,
 }
 
 void TrainerInternalVR::swapParameter() {
-  auto& parameters = gradientMachine_->getParameters();
-  for (auto& para : parameters) {
-    para->getBuf(PARAMETER_SNAPSHOT_VALUE)->deepSwap(
-            *para->getBuf(PARAMETER_VALUE));
-  }
+  gradientMachine_->swapSnapshotValue();
 }
 
 void TrainerInternalVR::copyParameter(ParameterType fromType,
@@ -196,31 +350,56 @@ void TrainerInternalVR::copyParameter(ParameterType fromType,
   }
   auto& parameters = gradientMachine_->getParameters();
   for (auto& para : parameters) {
+    // static parameters have no SVRG buffers in MultiGradientMachine
+    if (!para->getBuf(fromType) || !para->getBuf(toType)) continue;
+    SetDevice device(para->getDeviceId());
     para->getBuf(toType)->copyFrom(*para->getBuf(fromType));
+    if (toType == PARAMETER_VALUE) {
+      para->setValueUpdated();
+    }
   }
 }
 
-void TrainerInternalVR::negGradients() {
+void TrainerInternalVR::clearGradients(ParameterType parameterType) {
   auto& parameters = gradientMachine_->getParameters();
   for (auto& para : parameters) {
-    para->getBuf(PARAMETER_GRADIENT)->neg();
+    if (parameterType == PARAMETER_GRADIENT) {
+      // also drops the rows of sparse gradients
+      para->clearGradient();
+      continue;
+    }
+    if (!para->getBuf(parameterType)) continue;
+    para->getBuf(parameterType)->zeroMem();
   }
 }
 
-void TrainerInternalVR::clearGradients(ParameterType parameterType) {
+void TrainerInternalVR::scaleGradients(ParameterType parameterType,
+                                       real scale) {
   auto& parameters = gradientMachine_->getParameters();
   for (auto& para : parameters) {
-    para->getBuf(parameterType)->zeroMem();
+    if (!para->getBuf(parameterType)) continue;
+    para->getBuf(parameterType)->mulScalar(scale);
   }
 }
 
+void TrainerInternalVR::startUpdaterPass(bool fullGradient) {
+  // the remote updater sends the gradients of the two passes differently
+  if (auto updater =
+          dynamic_cast<VRRemoteParameterUpdater*>(parameterUpdater_.get())) {
+    updater->setPhase(fullGradient ? VRRemoteParameterUpdater::kFullGradient
+                                   : VRRemoteParameterUpdater::kInnerLoop);
+  }
+  parameterUpdater_->startPass();
+}
+
 void TrainerInternalVR::showParameterStats(const std::vector<ParaStat>&
                                         paraStats) {
   std::vector<ParameterPtr>& parameters = gradientMachine_->getParameters();
   for (auto& parameter : parameters) {
     SetDevice device(parameter->getDeviceId());
     real sum = parameter->getBuf(PARAMETER_VALUE)->getAbsSum();
-    real snapSum = parameter->getBuf(PARAMETER_SNAPSHOT_VALUE)->getAbsSum();
+    const auto& snapshot = parameter->getBuf(PARAMETER_SNAPSHOT_VALUE);
+    real snapSum = snapshot ? snapshot->getAbsSum() : 0;
     const auto& lr = parameter->getBuf(PARAMETER_LEARNING_RATE);
     std::ostringstream osLrHistogram;
     if (lr) {
@@ -252,12 +431,25 @@ void TrainerInternalVR::createParameterUpdater(bool testing) {
     LOG(INFO) << "Creating Local Parameter Updater for SVRG";
     CHECK_EQ(config_->getOptConfig().num_batches_per_send_parameter(), 1)
         << "num_batches_per_send_parameter should be one in local mode!";
-    parameterUpdater_.reset(new SgdLocalUpdater(config_->getOptConfig()));
+    bool useSparseUpdater = false;
+    for (auto& paraConfig : config_->getModelConfig().parameters()) {
+      if (paraConfig.sparse_update()) {
+        useSparseUpdater = true;
+      }
+    }
+    if (useSparseUpdater) {
+      // updates the rows in the batch, lazy for the other rows
+      LOG(INFO) << "Using lazy SVRG for sparse parameters";
+      parameterUpdater_.reset(new SgdThreadUpdater(config_->getOptConfig()));
+    } else {
+      parameterUpdater_.reset(new SgdLocalUpdater(config_->getOptConfig()));
+    }
   } else if (alg == TrainAlgorithm::SVRG) {
     LOG(INFO) << "Creating Remote Parameter Updater for SVRG";
     parameterUpdater_.reset(new VRRemoteParameterUpdater(
                 config_->getOptConfig(),
-                intconfig_->num_passes));
+                intconfig_->num_passes,
+                /* pipelined= */ FLAGS_svrg_pipelined_update));
   } else {
     LOG(FATAL) << "Unsupported algorithm in local mode: " << alg;
   }
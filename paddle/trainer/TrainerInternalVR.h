@@ -28,6 +28,8 @@ limitations under the License. */
 #include "TrainerInternal.h"
 #include "TrainerConfigHelper.h"
 #include "TrainerInternalConfig.h"
+#include "SnapshotGradientCache.h"
+#include "FullGradientEngine.h"
 
 
 namespace paddle {
@@ -38,7 +40,7 @@ namespace paddle {
  */
 class TrainerInternalVR : public TrainerInternal {
 public:
-  TrainerInternalVR() {
+  TrainerInternalVR() : pairedEvaluation_(false) {
   }
 
   /**
@@ -86,7 +88,7 @@ public:
 
   /**
    * swapParameter, P_VALUE <-> P_SNAPSHOT_VALUE
-   *
+   * done by the gradient machine, which knows where the copies are
    */
   void swapParameter();
 
@@ -107,16 +109,32 @@ public:
   }
 
   /**
-   * negGradients, g = -g
-   *
+   * clearGradients,  g = 0
+   * @param parameterType P_GRAD or P_SUM_GRAD
    */
-  void negGradients();
+  void clearGradients(ParameterType parameterType);
 
   /**
-   * clearGradients,  g = 0
+   * scaleGradients,  g = scale * g
    * @param parameterType P_GRAD or P_SUM_GRAD
+   * @param scale scale factor
    */
-  void clearGradients(ParameterType parameterType);
+  void scaleGradients(ParameterType parameterType, real scale);
+
+  /**
+   * startUpdaterPass, starts a pass of the parameter updater
+   * @param fullGradient true for the full gradient pass, false for the
+   *                     inner pass of the outer iteration
+   */
+  void startUpdaterPass(bool fullGradient);
+
+  /**
+   * getFullGradientEngine
+   * @return nullptr if the full gradient is computed batch by batch
+   */
+  FullGradientEngine* getFullGradientEngine() {
+    return fullGradEngine_.get();
+  }
 
 protected:
   /**
@@ -125,6 +143,15 @@ protected:
    * @param toType copy to
    */
   void copyParameter(ParameterType fromType, ParameterType toType);
+
+  /// whether gradientMachine_ evaluates w_s and w_t in one paired pass
+  bool pairedEvaluation_;
+
+  /// snapshot gradient of each batch, nullptr if not enabled
+  std::unique_ptr<SnapshotGradientCache> gradCache_;
+
+  /// computes the full gradient in parallel, nullptr if not enabled
+  std::unique_ptr<FullGradientEngine> fullGradEngine_;
 };
 
 }  // namespace paddle
@@ -21,6 +21,7 @@ limitations under the License. */
 #include <iomanip>
 #include <sstream>
 #include <limits>
+#include <cmath>
 
 #include <google/protobuf/text_format.h>
 
@@ -154,15 +155,30 @@ void TrainerVR::init(const std::shared_ptr<TrainerConfigHelper> &config,
   trainerInternal_->setEvaluator(evaluator_.get());
 }
 
-void TrainerVR::calculateFullGradient(int passId) {
-  this->stats_->reset();
+int64_t TrainerVR::getSnapshotNumBatches(int passId) {
+  const OptimizationConfig& optConfig = config_->getOptConfig();
+  if (optConfig.svrg_snapshot_batches() <= 0) {
+    return -1;
+  }
+  double num = optConfig.svrg_snapshot_batches() *
+               std::pow((double)optConfig.svrg_snapshot_growth(), passId);
+  // the subset is cut at the end of the data anyway
+  return (int64_t)std::min(num, 1e15);
+}
+
+int64_t TrainerVR::calcGradBatches(int64_t maxBatches) {
   int64_t batchId = 0;
   int32_t batchSize = config_->getOptConfig().batch_size();
 
-  trainerInternal_->getParameterUpdater()->startPass();
-  trainerInternal_->getParameterUpdater()->startBatch(0);
-  size_t passSize = 0;
-  while (true) {
+  FullGradientEngine* engine = trainerInternal_->getFullGradientEngine();
+  if (engine) {
+    // batches are computed by several threads, stats_ are updated inside
+    REGISTER_TIMER("TrainBatchFullGrad");
+    return engine->calcFullGradient(dataProvider_.get(), batchSize,
+                                    stats_.get(), maxBatches);
+  }
+
+  while (batchId != maxBatches) {
     DataBatch dataBatch;
 
     int64_t num = 0;
@@ -170,7 +186,6 @@ void TrainerVR::calculateFullGradient(int passId) {
       REGISTER_TIMER("getTrainBatchFullGrad");
       num = dataProvider_->getNextBatch(batchSize, &dataBatch);
     }
-    passSize += num;
     if (num == 0) break;
     {
       REGISTER_TIMER("TrainBatchFullGrad");
@@ -178,14 +193,37 @@ void TrainerVR::calculateFullGradient(int passId) {
     }
     ++batchId;
   }
+  return batchId;
+}
+
+int64_t TrainerVR::calculateFullGradient(int passId, int64_t maxBatches) {
+  this->stats_->reset();
+
+  trainerInternal_->startUpdaterPass(/* fullGradient= */ true);
+  // The remote updater sends the full gradient in finishBatch(). A local
+  // updater must not take a step, SgdThreadUpdater updates in finishBatch().
+  if (!FLAGS_local) {
+    trainerInternal_->getParameterUpdater()->startBatch(0);
+  }
+  int64_t numBatches = calcGradBatches(maxBatches);
+  if (numBatches == 0 && maxBatches > 0) {
+    // the last inner loop stopped right at the end of the data
+    dataProvider_->reset();
+    numBatches = calcGradBatches(maxBatches);
+  }
+  CHECK_GT(numBatches, 0) << "No data from data provider";
 
   trainerInternal_->getGradientMachine()->onPassEnd();
   // actually, at the end of pass, aggregate gradients
-  trainerInternal_->getParameterUpdater()->finishBatch(0);
+  if (!FLAGS_local) {
+    trainerInternal_->getParameterUpdater()->finishBatch(0);
+  }
 
   LOG(INFO) << "Calc Full Gradient: "
             << " Pass=" << passId
+            << " Batches=" << numBatches
             << " " << stats_->getStats(false /*without current cost*/);
+  return numBatches;
 }
 
 void TrainerVR::train(size_t numPasses) {
@@ -201,14 +239,32 @@ void TrainerVR::train(size_t numPasses) {
   // init w_s = w,
   trainerInternal_->copyToSnapshotParameter();
   for (size_t i = 0; i < numPasses; ++i) {
+    int passId = config_->getConfig().start_pass() + i;
     // P_GRAD_SUM = 0
     trainerInternal_->clearGradients(PARAMETER_GRADIENT_SUM);
     // P_GRAD = 0
     trainerInternal_->clearGradients(PARAMETER_GRADIENT);
-    // full gradient g = \sum_b \partial f_b(w_s)
-    calculateFullGradient(config_->getConfig().start_pass() + i);
-    dataProvider_->setSkipShuffle();
-    dataProvider_->reset();
+    int64_t snapshotBatches = getSnapshotNumBatches(passId);
+    if (snapshotBatches < 0) {
+      // full gradient g = \sum_b \partial f_b(w_s)
+      calculateFullGradient(passId);
+      dataProvider_->setSkipShuffle();
+      dataProvider_->reset();
+    } else {
+      // g = \sum_{b \in S} \partial f_b(w_s) on the next |S| batches.
+      // SCSG samples S at random, the next batches are a random subset
+      // only if the data provider shuffles, and S never spans two epochs.
+      int64_t numBatches = calculateFullGradient(passId, snapshotBatches);
+      if (numBatches < snapshotBatches) {
+        // S is cut at the end of the data, start a new epoch
+        dataProvider_->reset();
+      }
+      // batch_rate * g = \frac{1}{|S|} \sum_{b \in S} \partial f_b(w_s)
+      trainerInternal_->scaleGradients(
+          PARAMETER_GRADIENT_SUM,
+          1.0 / (config_->getOptConfig().batch_rate() * numBatches));
+      snapshotBatches = numBatches;
+    }
 
     // P_GRAD = 0
     trainerInternal_->clearGradients(PARAMETER_GRADIENT);
@@ -216,9 +272,14 @@ void TrainerVR::train(size_t numPasses) {
     trainerInternal_->copyFromSnapshotParameter();
     // for each batch, g_{t+1} = \partial f_b(w_t) - \partial f_b(w_s) + g
     // w_{t+1} = w_t - \eta g_{t+1}
-    trainOnePass(config_->getConfig().start_pass() + i);
-    if (i < numPasses - 1) {
-      dataProvider_->reset();
+    if (snapshotBatches < 0) {
+      trainOnePass(passId);
+      if (i < numPasses - 1) {
+        dataProvider_->reset();
+      }
+    } else {
+      // |S| steps on the batches following S
+      trainInnerLoop(passId, snapshotBatches);
     }
     // w_s = w_T, P_VALUE -> P_SNAPSHOT_VALUE
     trainerInternal_->copyToSnapshotParameter();
@@ -228,19 +289,28 @@ void TrainerVR::train(size_t numPasses) {
 }
 
 void TrainerVR::trainOnePass(int passId) {
+  trainInnerLoop(passId, -1);
+}
+
+void TrainerVR::trainInnerLoop(int passId, int64_t numBatches) {
   this->stats_->reset();
   int64_t batchId = 0;
   int32_t batchSize = config_->getOptConfig().batch_size();
 
-  trainerInternal_->getParameterUpdater()->startPass();
+  trainerInternal_->startUpdaterPass(/* fullGradient= */ false);
   evaluator_->start();
-  while (true) {
+  while (batchId != numBatches) {
     DataBatch dataBatch;
 
     int num = 0;
     {
       REGISTER_TIMER("getTrainBatch");
       num = dataProvider_->getNextBatch(batchSize, &dataBatch);
+      if (num == 0 && numBatches > 0) {
+        // a fixed number of batches wraps around the end of the data
+        dataProvider_->reset();
+        num = dataProvider_->getNextBatch(batchSize, &dataBatch);
+      }
     }
     if (num == 0) break;
     {
@@ -89,11 +89,39 @@ protected:
    */
   virtual void trainOnePass(int passId);
 
+  /**
+   * Inner loop of SVRG.
+   *
+   * @param passId pass id, starts from 0
+   * @param numBatches number of batches to train, train until the end of
+   *                   the data if numBatches < 0, or wrap around the end of
+   *                   the data otherwise.
+   */
+  void trainInnerLoop(int passId, int64_t numBatches);
+
   /**
    * calculate the full gradient for a pass of data
    *
+   * @param passId pass id, starts from 0
+   * @param maxBatches only the next maxBatches batches if maxBatches >= 0
+   * @return number of batches
+   */
+  int64_t calculateFullGradient(int passId, int64_t maxBatches = -1);
+
+  /**
+   * accumulate the gradients of the next maxBatches batches into
+   * PARAMETER_GRADIENT_SUM, or all the remaining batches if maxBatches < 0
+   *
+   * @return number of batches
+   */
+  int64_t calcGradBatches(int64_t maxBatches);
+
+  /**
+   * size of the snapshot subset S of outer iteration passId (SCSG)
+   *
+   * @return -1 if the full gradient is used
    */
-  void calculateFullGradient(int passId);
+  int64_t getSnapshotNumBatches(int passId);
 
 protected:
   // trainer Internal
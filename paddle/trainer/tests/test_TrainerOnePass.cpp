@@ -18,6 +18,8 @@ limitations under the License. */
 #include "paddle/trainer/TrainerInternal.h"
 
 #include <gtest/gtest.h>
+#include <sys/wait.h>
+#include <unistd.h>
 #include <paddle/pserver/ParameterServer2.h>
 
 using namespace paddle;  // NOLINT
@@ -121,6 +123,7 @@ P_DECLARE_int32(num_gradient_servers);
 P_DECLARE_int32(port);
 P_DECLARE_bool(local);
 P_DECLARE_bool(use_old_updater);
+P_DECLARE_bool(use_allreduce);
 
 double checkRemoteParameterUpdater(TrainerForTest& trainer) {
   auto gradientMachine = trainer.getGradientMachine();
@@ -291,6 +294,161 @@ TEST(checkRemoteUpdater, cpuDeltaTrainerOldUpdater) {
   checkRemoteParameterUpdaterTest(configFile1, false, false, 1, true, 10);
 }
 
+// 4. test trainer with allreduce, one trainer reduces to its own gradient.
+TEST(checkAllReduceUpdater, cpuTrainer) {
+  FLAGS_use_gpu = false;
+  FLAGS_parallel_nn = false;
+  FLAGS_config = configFile1;
+  FLAGS_trainer_count = 1;
+  FLAGS_num_gradient_servers = 1;
+  srand(FLAGS_seed);
+
+  FLAGS_local = 0;
+  FLAGS_use_allreduce = true;
+  TrainerForTest trainer;
+  trainer.init(TrainerConfigHelper::createFromFlagConfig());
+  EXPECT_EQ(checkRemoteParameterUpdater(trainer), 0);
+
+  FLAGS_use_allreduce = false;
+  FLAGS_local = 1;
+}
+
+// 5. test two trainers, allreduce updates like a pserver.
+/// trains numBatches batches, trainer i skipping its first i batches, and
+/// returns the values of all the parameters
+static vector<real> trainBatches(TrainerForTest& trainer, int numBatches) {
+  auto gradientMachine = trainer.getGradientMachine();
+  auto parameterUpdater = trainer.getParameterUpdaterForTest();
+  auto dataProvider = trainer.getDataProvider();
+  const TrainerConfig& config = trainer.getConfig();
+  int32_t batchSize = config.opt_config().batch_size();
+
+  DataBatch dataBatch;
+  for (int i = 0; i <= FLAGS_trainer_id; ++i) {
+    dataProvider->getNextBatch(batchSize, &dataBatch);
+  }
+  CHECK(dataBatch.getSize()) << "No data from data provider";
+  const vector<Argument>& inArgs = dataBatch.getStreams();
+  vector<Argument> outArgs;
+
+  UpdateCallback updateCallback = [parameterUpdater](Parameter* para) {
+    parameterUpdater->update(para);
+  };
+
+  parameterUpdater->startPass();
+  for (int i = 0; i < numBatches; ++i) {
+    PassType passType = parameterUpdater->startBatch(dataBatch.getSize());
+    gradientMachine->forwardBackward(inArgs, &outArgs, passType,
+                                     updateCallback);
+    parameterUpdater->finishBatch(0);
+  }
+
+  vector<real> values;
+  for (auto& parameter : gradientMachine->getParameters()) {
+    CpuVector value(parameter->getSize());
+    value.copyFrom(*parameter->getBuf(PARAMETER_VALUE));
+    values.insert(values.end(), value.getData(),
+                  value.getData() + value.getSize());
+  }
+  parameterUpdater->finishPass();
+  gradientMachine->finish();
+  return values;
+}
+
+/// forks two trainers with RemoteParameterUpdater on a pserver at
+/// FLAGS_port, or with AllReduceParameterUpdater on FLAGS_port + 1 and
+/// FLAGS_port + 2, and returns the values of each trainer
+static vector<vector<real>> runTwoTrainers(bool useAllReduce,
+                                           int numBatches) {
+  const int numTrainers = 2;
+  FLAGS_use_gpu = false;
+  FLAGS_parallel_nn = false;
+  FLAGS_config = configFile1;
+  FLAGS_trainer_count = 1;
+  int oldFlagsNumGradientServers = FLAGS_num_gradient_servers;
+  FLAGS_num_gradient_servers = numTrainers;
+
+  std::unique_ptr<ParameterServer2> pserver;
+  if (!useAllReduce) {
+    pserver.reset(new ParameterServer2(std::string(), FLAGS_port));
+    pserver->init();
+    pserver->start();
+  }
+
+  vector<pid_t> pids;
+  vector<int> fds;
+  for (int trainerId = 0; trainerId < numTrainers; ++trainerId) {
+    int pipefd[2];
+    PCHECK(pipe(pipefd) == 0);
+    pid_t pid = fork();
+    PCHECK(pid >= 0);
+    if (pid == 0) {
+      close(pipefd[0]);
+      FLAGS_trainer_id = trainerId;
+      FLAGS_local = 0;
+      FLAGS_use_old_updater = true;
+      FLAGS_use_allreduce = useAllReduce;
+      if (useAllReduce) {
+        FLAGS_port = FLAGS_port + 1;
+      }
+      srand(FLAGS_seed);
+      TrainerForTest trainer;
+      trainer.init(TrainerConfigHelper::createFromFlagConfig());
+      vector<real> values = trainBatches(trainer, numBatches);
+      size_t size = values.size();
+      PCHECK(write(pipefd[1], &size, sizeof(size)) == sizeof(size));
+      size_t bytes = size * sizeof(real);
+      for (size_t done = 0; done < bytes;) {
+        ssize_t n = write(pipefd[1], (char*)values.data() + done,
+                          bytes - done);
+        PCHECK(n > 0);
+        done += n;
+      }
+      close(pipefd[1]);
+      _exit(0);
+    }
+    close(pipefd[1]);
+    pids.push_back(pid);
+    fds.push_back(pipefd[0]);
+  }
+
+  vector<vector<real>> results(numTrainers);
+  for (int trainerId = 0; trainerId < numTrainers; ++trainerId) {
+    size_t size = 0;
+    PCHECK(read(fds[trainerId], &size, sizeof(size)) == sizeof(size));
+    results[trainerId].resize(size);
+    size_t bytes = size * sizeof(real);
+    for (size_t done = 0; done < bytes;) {
+      ssize_t n = read(fds[trainerId],
+                       (char*)results[trainerId].data() + done,
+                       bytes - done);
+      PCHECK(n > 0);
+      done += n;
+    }
+    close(fds[trainerId]);
+    int status = 0;
+    PCHECK(waitpid(pids[trainerId], &status, 0) == pids[trainerId]);
+    EXPECT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  }
+  FLAGS_num_gradient_servers = oldFlagsNumGradientServers;
+  return results;
+}
+
+TEST(checkAllReduceUpdater, cpuTwoTrainers) {
+  const int numBatches = 5;
+  auto remoteValues = runTwoTrainers(/* useAllReduce= */ false, numBatches);
+  auto allReduceValues = runTwoTrainers(/* useAllReduce= */ true, numBatches);
+  for (size_t i = 0; i < remoteValues.size(); ++i) {
+    ASSERT_FALSE(remoteValues[i].empty());
+    ASSERT_EQ(remoteValues[i].size(), allReduceValues[i].size());
+    EXPECT_EQ(0, memcmp(remoteValues[i].data(), allReduceValues[i].data(),
+                        remoteValues[i].size() * sizeof(real)));
+  }
+  // all the trainers end with the same values
+  EXPECT_EQ(0, memcmp(allReduceValues[0].data(), allReduceValues[1].data(),
+                      allReduceValues[0].size() * sizeof(real)));
+}
+
 int main(int argc, char** argv) {
   initMain(argc, argv);
   initPython(argc, argv);
@@ -0,0 +1,477 @@
+/* Copyright (c) 2016 Baidu, Inc. All Rights Reserve.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+
+#include <paddle/utils/PythonUtil.h>
+#include <paddle/utils/GlobalConstants.h>
+#include <gtest/gtest.h>
+
+#include "paddle/trainer/TrainerConfigHelper.h"
+#include "paddle/trainer/SnapshotGradientCache.h"
+#include "paddle/trainer/FullGradientEngine.h"
+#include "paddle/trainer/RemoteParameterUpdaterVR.h"
+#include "paddle/trainer/TrainerVR.h"
+#include "paddle/gserver/gradientmachines/GradientMachine.h"
+#include "paddle/pserver/ParameterServer2.h"
+
+using namespace paddle;  // NOLINT
+using namespace std;     // NOLINT
+
+static const string& configFile = "trainer/tests/sample_trainer_config.conf";
+
+P_DECLARE_bool(use_gpu);
+P_DECLARE_string(config);
+P_DECLARE_int32(seed);
+P_DECLARE_int32(trainer_count);
+P_DECLARE_int32(port);
+
+class VRTest : public ::testing::Test {
+protected:
+  virtual void SetUp() {
+    FLAGS_use_gpu = false;
+    FLAGS_config = configFile;
+    srand(FLAGS_seed);
+
+    config_ = TrainerConfigHelper::createFromFlagConfig();
+    config_->getOptConfig().set_algorithm(TrainAlgorithm::SVRG);
+
+    machine_.reset(GradientMachine::create(
+        config_->getConfig().model_config(), GradientMachine::kSVRG,
+        {PARAMETER_VALUE, PARAMETER_GRADIENT, PARAMETER_MOMENTUM,
+         PARAMETER_GRADIENT_SUM, PARAMETER_SNAPSHOT_VALUE}));
+    machine_->randParameters();
+    for (auto& para : machine_->getParameters()) {
+      // w_s is another random point
+      Parameter::randomize(para->getBuf(PARAMETER_SNAPSHOT_VALUE),
+                           para->getConfig());
+    }
+
+    dataProvider_.reset(DataProvider::create(*config_, *config_, false));
+    dataProvider_->setSkipShuffle();
+    dataProvider_->reset();
+    dataProvider_->getNextBatch(config_->getOptConfig().batch_size(),
+                                &dataBatch_);
+    CHECK(dataBatch_.getSize()) << "No data from data provider";
+  }
+
+  void clearGradients() {
+    for (auto& para : machine_->getParameters()) {
+      para->clearGradient();
+    }
+  }
+
+  vector<CpuVector> copyGradients() {
+    vector<CpuVector> grads;
+    for (auto& para : machine_->getParameters()) {
+      grads.emplace_back(para->getSize());
+      grads.back().copyFrom(*para->getBuf(PARAMETER_GRADIENT));
+    }
+    return grads;
+  }
+
+  /**
+   * one outer iteration like TrainerVR, on a pserver at port: a full
+   * gradient pass and an inner pass of three batches
+   *
+   * @return the values after the inner pass, the values of the machine
+   *         are restored
+   */
+  vector<vector<real>> trainRemote(bool pipelined, int port) {
+    const vector<Argument>& inArgs = dataBatch_.getStreams();
+    vector<Argument> outArgs;
+    vector<ParameterPtr> parameters = machine_->getParameters();
+    CHECK(machine_->initPairedEvaluation());
+    int64_t batchSize = dataBatch_.getSize();
+
+    vector<VectorPtr> initValues;
+    for (auto& para : parameters) {
+      for (auto type : {PARAMETER_VALUE, PARAMETER_SNAPSHOT_VALUE}) {
+        initValues.push_back(Vector::create(para->getSize(), false));
+        initValues.back()->copyFrom(*para->getBuf(type));
+      }
+    }
+    clearGradients();
+
+    int oldFlagsPort = FLAGS_port;
+    FLAGS_port = port;
+    ParameterServer2 pserver(std::string(), port);
+    pserver.init();
+    pserver.start();
+    {
+      VRRemoteParameterUpdater updater(config_->getOptConfig(),
+                                       /* expectedPassCount= */ 1,
+                                       pipelined);
+      updater.init(parameters);
+
+      // the full gradient is sent in one finishBatch()
+      updater.setPhase(VRRemoteParameterUpdater::kFullGradient);
+      updater.startPass();
+      updater.startBatch(0);
+      machine_->forwardBackward(inArgs, &outArgs, PASS_TRAIN);
+      updater.finishBatch(0);
+
+      UpdateCallback callback = [&updater](Parameter* para) {
+        updater.update(para);
+      };
+      updater.setPhase(VRRemoteParameterUpdater::kInnerLoop);
+      updater.startPass();
+      for (int i = 0; i < 3; ++i) {
+        updater.startBatch(batchSize);
+        machine_->forwardBackwardPaired(inArgs, &outArgs, PASS_TRAIN,
+                                        callback);
+        updater.finishBatch(Argument::sumCosts(outArgs));
+      }
+      updater.finishPass(0);
+    }
+    FLAGS_port = oldFlagsPort;
+
+    vector<vector<real>> values;
+    size_t k = 0;
+    for (auto& para : parameters) {
+      CpuVector value(para->getSize());
+      value.copyFrom(*para->getBuf(PARAMETER_VALUE));
+      values.emplace_back(value.getData(), value.getData() + value.getSize());
+      for (auto type : {PARAMETER_VALUE, PARAMETER_SNAPSHOT_VALUE}) {
+        para->getBuf(type)->copyFrom(*initValues[k++]);
+      }
+    }
+    return values;
+  }
+
+  std::shared_ptr<TrainerConfigHelper> config_;
+  std::unique_ptr<GradientMachine> machine_;
+  std::unique_ptr<DataProvider> dataProvider_;
+  DataBatch dataBatch_;
+};
+
+TEST_F(VRTest, pairedEvaluation) {
+  const vector<Argument>& inArgs = dataBatch_.getStreams();
+  vector<Argument> outArgs;
+  auto& parameters = machine_->getParameters();
+
+  // reference: swap, forwardBackward, negate, swap, forwardBackward
+  clearGradients();
+  for (auto& para : parameters) {
+    para->getBuf(PARAMETER_SNAPSHOT_VALUE)->deepSwap(
+        *para->getBuf(PARAMETER_VALUE));
+  }
+  machine_->forwardBackward(inArgs, &outArgs, PASS_TRAIN);
+  for (auto& para : parameters) {
+    para->getBuf(PARAMETER_GRADIENT)->neg();
+    para->getBuf(PARAMETER_SNAPSHOT_VALUE)->deepSwap(
+        *para->getBuf(PARAMETER_VALUE));
+  }
+  machine_->forwardBackward(inArgs, &outArgs, PASS_TRAIN);
+  real cost = Argument::sumCosts(outArgs);
+  vector<CpuVector> expected = copyGradients();
+
+  ASSERT_TRUE(machine_->initPairedEvaluation());
+  clearGradients();
+  vector<int> numCallbacks(parameters.size(), 0);
+  UpdateCallback callback = [&numCallbacks](Parameter* para) {
+    ++numCallbacks[para->getID()];
+  };
+  machine_->forwardBackwardPaired(inArgs, &outArgs, PASS_TRAIN, callback);
+  EXPECT_NEAR(cost, Argument::sumCosts(outArgs), 1e-5);
+  vector<CpuVector> actual = copyGradients();
+
+  for (size_t i = 0; i < parameters.size(); ++i) {
+    EXPECT_EQ(1, numCallbacks[i]) << parameters[i]->getName();
+    real* a = actual[i].getData();
+    real* e = expected[i].getData();
+    for (size_t j = 0; j < actual[i].getSize(); ++j) {
+      EXPECT_NEAR(e[j], a[j], 1e-5) << parameters[i]->getName() << " " << j;
+    }
+  }
+}
+
+TEST_F(VRTest, fullGradientEngine) {
+  auto& parameters = machine_->getParameters();
+  // sample_data.txt has 10 samples only
+  int32_t batchSize = 3;
+
+  // reference: batch by batch
+  for (auto& para : parameters) {
+    para->getBuf(PARAMETER_GRADIENT_SUM)->zeroMem();
+  }
+  clearGradients();
+  dataProvider_->reset();
+  TrainerStats expectedStats;
+  int64_t numBatches = 0;
+  vector<Argument> outArgs;
+  while (dataProvider_->getNextBatch(batchSize, &dataBatch_) > 0) {
+    machine_->forwardBackward(dataBatch_.getStreams(), &outArgs, PASS_TRAIN,
+                              [](Parameter* para) {
+      para->getBuf(PARAMETER_GRADIENT_SUM)->add(
+          *para->getBuf(PARAMETER_GRADIENT));
+      para->clearGradient();
+    });
+    expectedStats += { dataBatch_.getSize(), Argument::sumCosts(outArgs) };
+    ++numBatches;
+  }
+  ASSERT_GT(numBatches, 1);
+  vector<CpuVector> expected;
+  for (auto& para : parameters) {
+    expected.emplace_back(para->getSize());
+    expected.back().copyFrom(*para->getBuf(PARAMETER_GRADIENT_SUM));
+  }
+
+  ASSERT_TRUE(FullGradientEngine::isSupported(parameters));
+  FullGradientEngine engine(config_->getConfig().model_config(), parameters,
+                            3, 100);
+  for (int pass = 0; pass < 2; ++pass) {
+    for (auto& para : parameters) {
+      para->getBuf(PARAMETER_GRADIENT_SUM)->zeroMem();
+    }
+    dataProvider_->reset();
+    TrainerStats stats;
+    EXPECT_EQ(numBatches,
+              engine.calcFullGradient(dataProvider_.get(), batchSize, &stats));
+    EXPECT_EQ(expectedStats.getNumProcessed(), stats.getNumProcessed());
+    EXPECT_NEAR(expectedStats.getAvgCost(), stats.getAvgCost(), 1e-5);
+
+    for (size_t i = 0; i < parameters.size(); ++i) {
+      if (parameters[i]->isStatic()) continue;
+      real* a = parameters[i]->getBuf(PARAMETER_GRADIENT_SUM)->getData();
+      real* e = expected[i].getData();
+      for (size_t j = 0; j < expected[i].getSize(); ++j) {
+        // the batches are summed in a different order
+        EXPECT_NEAR(e[j], a[j], 1e-4 * std::max((real)1, std::abs(e[j])))
+            << parameters[i]->getName() << " " << j;
+      }
+    }
+  }
+}
+
+TEST_F(VRTest, swapSnapshotValue) {
+  auto& parameters = machine_->getParameters();
+  const vector<Argument>& inArgs = dataBatch_.getStreams();
+  vector<Argument> outArgs;
+
+  // reference: swap the elements
+  for (auto& para : parameters) {
+    para->getBuf(PARAMETER_SNAPSHOT_VALUE)->deepSwap(
+        *para->getBuf(PARAMETER_VALUE));
+  }
+  machine_->forward(inArgs, &outArgs, PASS_TEST);
+  real snapshotCost = Argument::sumCosts(outArgs);
+  for (auto& para : parameters) {
+    para->getBuf(PARAMETER_SNAPSHOT_VALUE)->deepSwap(
+        *para->getBuf(PARAMETER_VALUE));
+  }
+  machine_->forward(inArgs, &outArgs, PASS_TEST);
+  real cost = Argument::sumCosts(outArgs);
+
+  vector<real*> snapshotData;
+  for (auto& para : parameters) {
+    snapshotData.push_back(para->getBuf(PARAMETER_SNAPSHOT_VALUE)->getData());
+  }
+  machine_->swapSnapshotValue();
+  for (size_t i = 0; i < parameters.size(); ++i) {
+    if (parameters[i]->isStatic()) continue;
+    // only the memory is swapped, the layers see it through their views
+    EXPECT_EQ(snapshotData[i],
+              parameters[i]->getBuf(PARAMETER_VALUE)->getData());
+  }
+  machine_->forward(inArgs, &outArgs, PASS_TEST);
+  EXPECT_NEAR(snapshotCost, Argument::sumCosts(outArgs), 1e-5);
+
+  machine_->swapSnapshotValue();
+  machine_->forward(inArgs, &outArgs, PASS_TEST);
+  EXPECT_NEAR(cost, Argument::sumCosts(outArgs), 1e-5);
+}
+
+TEST_F(VRTest, multiGradientMachine) {
+  auto& modelConfig = config_->getConfig().model_config();
+  FLAGS_trainer_count = 2;
+  std::unique_ptr<GradientMachine> normal(GradientMachine::create(modelConfig));
+  std::unique_ptr<GradientMachine> svrg(GradientMachine::create(
+      modelConfig, GradientMachine::kSVRG,
+      {PARAMETER_VALUE, PARAMETER_GRADIENT, PARAMETER_MOMENTUM,
+       PARAMETER_GRADIENT_SUM, PARAMETER_SNAPSHOT_VALUE}));
+  FLAGS_trainer_count = 1;
+
+  // the SVRG buffers are only allocated for SVRG
+  for (auto& para : normal->getParameters()) {
+    EXPECT_FALSE(para->getBuf(PARAMETER_GRADIENT_SUM)) << para->getName();
+    EXPECT_FALSE(para->getBuf(PARAMETER_SNAPSHOT_VALUE)) << para->getName();
+  }
+  auto& parameters = machine_->getParameters();
+  auto& svrgParameters = svrg->getParameters();
+  ASSERT_EQ(parameters.size(), svrgParameters.size());
+  for (size_t i = 0; i < parameters.size(); ++i) {
+    if (svrgParameters[i]->isStatic()) continue;
+    ASSERT_TRUE(svrgParameters[i]->getBuf(PARAMETER_GRADIENT_SUM));
+    ASSERT_TRUE(svrgParameters[i]->getBuf(PARAMETER_SNAPSHOT_VALUE));
+    for (auto type : {PARAMETER_VALUE, PARAMETER_SNAPSHOT_VALUE}) {
+      svrgParameters[i]->getBuf(type)->copyFrom(*parameters[i]->getBuf(type));
+    }
+  }
+
+  // the threads compute with w_s after the swap
+  vector<Argument> outArgs;
+  machine_->swapSnapshotValue();
+  machine_->forward(dataBatch_.getStreams(), &outArgs, PASS_TEST);
+  real expectedCost = Argument::sumCosts(outArgs);
+  machine_->swapSnapshotValue();
+  svrg->swapSnapshotValue();
+  svrg->forward(dataBatch_.getStreams(), &outArgs, PASS_TEST);
+  EXPECT_NEAR(expectedCost, Argument::sumCosts(outArgs), 1e-5);
+
+  svrg->swapSnapshotValue();
+  for (size_t i = 0; i < parameters.size(); ++i) {
+    if (svrgParameters[i]->isStatic()) continue;
+    CpuVector diff(parameters[i]->getSize());
+    diff.copyFrom(*svrgParameters[i]->getBuf(PARAMETER_VALUE));
+    diff.sub(*parameters[i]->getBuf(PARAMETER_VALUE));
+    EXPECT_EQ(0, diff.getAbsMax()) << parameters[i]->getName();
+  }
+
+  normal->finish();
+  svrg->finish();
+}
+
+TEST_F(VRTest, pipelinedRemoteUpdater) {
+  auto expected = trainRemote(/* pipelined= */ false, FLAGS_port);
+  auto actual = trainRemote(/* pipelined= */ true, FLAGS_port + 1);
+  auto& parameters = machine_->getParameters();
+  for (size_t i = 0; i < parameters.size(); ++i) {
+    EXPECT_EQ(0, memcmp(expected[i].data(), actual[i].data(),
+                        expected[i].size() * sizeof(real)))
+        << parameters[i]->getName();
+  }
+}
+
+TEST_F(VRTest, asyncRemoteUpdater) {
+  auto expected = trainRemote(/* pipelined= */ false, FLAGS_port);
+  config_->getOptConfig().set_async_svrg(true);
+  auto actual = trainRemote(/* pipelined= */ false, FLAGS_port + 1);
+  config_->getOptConfig().set_async_svrg(false);
+
+  // with one trainer, every asynchronous step is applied as it is sent
+  auto& parameters = machine_->getParameters();
+  for (size_t i = 0; i < parameters.size(); ++i) {
+    for (size_t j = 0; j < expected[i].size(); ++j) {
+      EXPECT_NEAR(expected[i][j], actual[i][j], 1e-5)
+          << parameters[i]->getName() << " " << j;
+    }
+  }
+}
+
+/// the outer iterations of TrainerVR without the inner loops
+class SnapshotTrainer : public TrainerVR {
+public:
+  using TrainerVR::getSnapshotNumBatches;
+
+  /// the number of batches of the snapshot gradient of each pass
+  vector<int64_t> calcSnapshotGradients(int numPasses) {
+    dataProvider_->reset();
+    trainerInternal_->getGradientMachine()->start(*config_, dataProvider_);
+    trainerInternal_->copyToSnapshotParameter();
+    vector<int64_t> numBatches;
+    for (int passId = 0; passId < numPasses; ++passId) {
+      trainerInternal_->clearGradients(PARAMETER_GRADIENT_SUM);
+      numBatches.push_back(
+          calculateFullGradient(passId, getSnapshotNumBatches(passId)));
+    }
+    trainerInternal_->getGradientMachine()->finish();
+    return numBatches;
+  }
+};
+
+TEST(TrainerVR, snapshotNumBatches) {
+  FLAGS_use_gpu = false;
+  FLAGS_config = configFile;
+  auto config = TrainerConfigHelper::createFromFlagConfig();
+  OptimizationConfig& optConfig = config->getOptConfig();
+  optConfig.set_algorithm(TrainAlgorithm::SVRG);
+  // sample_data.txt has 10 samples, 4 batches of 3
+  optConfig.set_batch_size(3);
+  optConfig.set_svrg_snapshot_batches(1);
+  optConfig.set_svrg_snapshot_growth(2);
+
+  SnapshotTrainer trainer;
+  trainer.init(config);
+  vector<int64_t> sizes;
+  for (int passId = 0; passId < 5; ++passId) {
+    sizes.push_back(trainer.getSnapshotNumBatches(passId));
+  }
+  EXPECT_EQ(vector<int64_t>({1, 2, 4, 8, 16}), sizes);
+
+  // pass 0 and 1 grow, pass 2 is cut at the end of the data. Pass 3 and
+  // 4 find the data at its end, wrap around and are capped at the full
+  // pass.
+  EXPECT_EQ(vector<int64_t>({1, 2, 1, 4, 4}),
+            trainer.calcSnapshotGradients(5));
+
+  optConfig.set_svrg_snapshot_batches(0);
+  EXPECT_EQ(-1, trainer.getSnapshotNumBatches(0));
+}
+
+static ParameterPtr createParameter(size_t id, size_t height, size_t width) {
+  ParameterConfig config;
+  config.set_name("para" + std::to_string(id));
+  config.set_size(height * width);
+  config.add_dims(height);
+  config.add_dims(width);
+  ParameterPtr para = std::make_shared<Parameter>(config, /* useGpu= */false);
+  para->setID(id);
+  return para;
+}
+
+TEST(SnapshotGradientCache, storeAndSubtract) {
+  vector<ParameterPtr> parameters = {createParameter(0, 10, 30),
+                                     createParameter(1, 1, 7)};
+  for (bool useFp16 : {false, true}) {
+    // every parameter is 16 bytes aligned, leave room for two batches only
+    size_t realBytes = 300 * sizeof(real) + (7 * sizeof(real) + 15) / 16 * 16;
+    size_t bytesPerBatch = useFp16 ? 608 + 16 : realBytes;
+    SnapshotGradientCache cache(parameters, bytesPerBatch * 5 / 2, useFp16);
+    vector<vector<CpuVector>> grads(3);
+    for (int64_t batchId = 0; batchId < 3; ++batchId) {
+      for (auto& para : parameters) {
+        para->getBuf(PARAMETER_GRADIENT)->rand();
+        grads[batchId].emplace_back(para->getSize());
+        grads[batchId].back().copyFrom(*para->getBuf(PARAMETER_GRADIENT));
+        cache.store(batchId, 100, para.get());
+      }
+    }
+    EXPECT_EQ(2UL, cache.getNumCachedBatches());
+    EXPECT_EQ(2 * bytesPerBatch, cache.getUsedBytes());
+    EXPECT_TRUE(cache.contains(1, 100));
+    EXPECT_FALSE(cache.contains(1, 99));
+    EXPECT_FALSE(cache.contains(2, 100));
+
+    for (int64_t batchId = 0; batchId < 2; ++batchId) {
+      for (size_t i = 0; i < parameters.size(); ++i) {
+        auto& grad = parameters[i]->getBuf(PARAMETER_GRADIENT);
+        grad->copyFrom(grads[batchId][i]);
+        cache.subtractFrom(batchId, parameters[i].get());
+        // rand() is in [0, 1), fp16 keeps 11 significant bits
+        EXPECT_LE(grad->getAbsMax(), useFp16 ? 1.0 / 2048 : 0);
+      }
+    }
+
+    cache.clear();
+    EXPECT_EQ(0UL, cache.getNumCachedBatches());
+    EXPECT_FALSE(cache.contains(0, 100));
+  }
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  initMain(argc, argv);
+  initPython(argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -23,6 +23,19 @@ enum ParameterInitStrategy {
   PARAMETER_INIT_UNIFORM = 1;
 }
 
+// how the gradient blocks sent to pserver are encoded
+enum GradientCompression {
+  // raw real
+  GRADIENT_COMPRESSION_NONE = 0;
+  // fp16 per element
+  GRADIENT_COMPRESSION_FP16 = 1;
+  // float scale of the block, then int8 per element, stochastic rounding
+  GRADIENT_COMPRESSION_INT8 = 2;
+  // uint32 k, then k uint32 indices and k float values of the largest
+  // elements in the block, the rest is kept by the trainer and sent later
+  GRADIENT_COMPRESSION_TOPK = 3;
+}
+
 message ParameterUpdaterHookConfig {
   required string type = 1;
   optional string purning_mask_filename = 2;
@@ -76,4 +89,9 @@ message ParameterConfig {
   optional bool is_shared = 23 [default = false];
   // parameter block size
   optional uint64 parameter_block_size = 24 [default = 0];
+  // compression of the gradient sent to pserver, set by trainer
+  optional GradientCompression gradient_compression = 25
+      [default = GRADIENT_COMPRESSION_NONE];
+  // fraction of the elements sent with GRADIENT_COMPRESSION_TOPK
+  optional real gradient_topk_ratio = 26 [default = 0.01];
 }
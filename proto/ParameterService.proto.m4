@@ -38,6 +38,11 @@ enum ParameterUpdateMode {
   // No update. Only get parameters back.
   PSERVER_UPDATE_MODE_GET_PARAM = 5;
   PSERVER_UPDATE_MODE_GET_PARAM_SPARSE = 6;//only get sparse rows
+
+  // Update parameter once a gradient is received like ASYNC_SGD, but a
+  // trainer more than ssp_staleness batches ahead of the slowest one waits
+  // (stale synchronous parallel). No gradient is discarded.
+  PSERVER_UPDATE_MODE_SSP_SGD = 7;
 };
 
 message ParameterBlock {
@@ -85,6 +90,10 @@ message SendParameterRequest {
   // forwardbackward time in usec
   optional uint64 forwardbackward_time = 9;
 
+  // the pserver keeps the blocks of the request under this id for the
+  // connection, a later request with the id and no blocks reuses them.
+  // The trainer sends the blocks of a dense layout once instead of per batch
+  optional int64 blocks_cache_id = 10;
 }
 
 message WaitPassStartRequest {
@@ -117,12 +126,27 @@ message SendParameterResponse  {
   repeated ParameterBlock blocks = 1;
 }
 
+// placement of the blocks of one parameter on the pservers
+message ParameterShard {
+  required uint64 para_id = 1;
+  required uint64 block_size = 2;
+  // pserver of each block. Empty if the blocks are placed by the hash of
+  // the parameter name, which is always the case for sparse rows.
+  repeated int32 server_ids = 3 [packed = true];
+  // sparse rows placed by their access frequency and their pservers, the
+  // other rows are placed by the hash. See --sparse_row_freq_file.
+  repeated int64 hot_rows = 4 [packed = true];
+  repeated int32 hot_row_server_ids = 5 [packed = true];
+}
+
 message SetConfigRequest {
   repeated ParameterConfig param_configs = 1;
   required OptimizationConfig opt_config = 2;
   required string save_dir = 4;
   required int32 server_id = 5;
   required bool is_sparse_server = 6;
+  // how the trainers place the parameter blocks on the pservers
+  repeated ParameterShard shards = 7;
 }
 
 message SetConfigResponse{
@@ -244,6 +268,10 @@ enum MatrixVectorOperation {
 
   // v = u, u = 0
   PSERVER_OP_COPY_ZERO = 18;
+
+  // SVRG update with PARAMETER_GRADIENT_SUM kept in pserver,
+  // PARAMETER_GRADIENT is cleared in the same pass
+  PSERVER_OP_SVRG = 19;
 }
 
 message ProtoVector {
@@ -379,3 +407,16 @@ message SendDataResponse {
   repeated DataBlock blocks = 2;
   required uint64 server_id = 3;
 }
+
+// chunk of a ring allreduce from the previous trainer in the ring,
+// followed by the data block
+message RingChunkRequest {
+  // number of the allreduce calls before this one
+  required int64 call_id = 1;
+  // reduce-scatter steps are [0, num_trainers - 1),
+  // allgather steps are [num_trainers - 1, 2 * num_trainers - 2)
+  required int32 step = 2;
+}
+
+message RingChunkResponse {
+}
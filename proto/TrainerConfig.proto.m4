@@ -130,6 +130,26 @@ message OptimizationConfig {
 
   // batch_rate = 1 / numBatches
   optional real batch_rate = 38 [default = 1.0];
+
+  // SCSG: the snapshot gradient of outer iteration k is the average over
+  // the next svrg_snapshot_batches * svrg_snapshot_growth^k batches,
+  // and the inner loop runs the same number of batches.
+  // Unlike SCSG, which samples the batches at random, these are the next
+  // batches of the data provider. They are a random subset only if the
+  // data provider shuffles the data at each epoch.
+  // 0 means the full gradient over all the data.
+  optional int64 svrg_snapshot_batches = 39 [default = 0];
+  optional real svrg_snapshot_growth = 40 [default = 1.0];
+
+  // SVRG in remote mode: the gradients of the inner loop are sent to the
+  // pservers like async_sgd, without waiting for the other trainers.
+  // The full gradient is still aggregated synchronously.
+  optional bool async_svrg = 41 [default = false];
+
+  // for async sgd: if >= 0, a trainer may run at most ssp_staleness batches
+  // ahead of the slowest trainer in the pass and waits for it otherwise,
+  // instead of discarding lagged gradients by async_lagged_grad_discard_ratio.
+  optional int32 ssp_staleness = 42 [default = -1];
 };
 
 message TrainerConfig {
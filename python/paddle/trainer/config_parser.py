@@ -2998,7 +2998,11 @@ settings = dict(
     mini_batch_size=None,
     algorithm='async_sgd',
     batch_rate=1.0,
+    svrg_snapshot_batches=0,
+    svrg_snapshot_growth=1.0,
+    async_svrg=False,
     async_lagged_grad_discard_ratio=1.5,
+    ssp_staleness=-1,
     learning_method='momentum',
     num_batches_per_send_parameter=None,
     num_batches_per_get_parameter=None,